@@ -0,0 +1,86 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "bmp_io.h"
+#include "image.h"
+#include "traversal.h"
+
+/// @brief Loads the BMP @p name from the assets directory.
+inline Image LoadAsset(const std::string &name) {
+  BmpImg bmp;
+  bmp.read(std::string(PDI_LI_ASSETS_DIR "/") + name);
+  return ImageFromBmp(bmp);
+}
+
+/// @brief Nearest neighbour scale of @p src to @p width x @p height .
+inline Image ScaleNearest(const Image &src, int width, int height) {
+  Image out(width, height);
+
+  ForEachRow(out, [&](int y) {
+    int sy = static_cast<int>(static_cast<int64_t>(y) * src.height() / height);
+    for (int x = 0; x < width; x++) {
+      int sx = static_cast<int>(static_cast<int64_t>(x) * src.width() / width);
+      out.set_pixel(x, y, src.pixel(sx, sy));
+    }
+  });
+
+  return out;
+}
+
+/// @brief A @p side x @p side image with a gradient plus noise on every
+/// channel, so the histograms are spread like on a photograph and the same on
+/// every run.
+inline Image SyntheticImage(int side) {
+  Image out(side, side);
+
+  ForEachRow(out, [&](int y) {
+    uint32_t state = 2463534242u ^ static_cast<uint32_t>(y);
+    byte *row = out.row(y);
+
+    for (int x = 0; x < side; x++) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+
+      int gradient = static_cast<int>(static_cast<int64_t>(x + y) * 255 /
+                                      (2 * side));
+      for (int c = 0; c < Image::kChannels; c++) {
+        int noise = static_cast<int>((state >> (8 * c)) & 0x3f) - 32;
+        int value = gradient + noise;
+        row[x * Image::kChannels + c] =
+            static_cast<byte>(value < 0 ? 0 : value > 255 ? 255 : value);
+      }
+    }
+  });
+
+  return out;
+}
+
+/// @brief Reports pixels/s as items and bytes/s over the samples of @p img ,
+/// in its own @see PixelFormat .
+inline void SetPixelCounters(benchmark::State &state, const Image &img) {
+  int64_t pixels = static_cast<int64_t>(img.width()) * img.height();
+  state.SetItemsProcessed(state.iterations() * pixels);
+  state.SetBytesProcessed(state.iterations() * pixels *
+                          BytesPerPixel(img.format()));
+}
+
+/// Benchmarks whose result did not match their golden file, which makes the
+/// whole run fail, see bench_main.cpp.
+inline std::atomic<int> golden_mismatches{0};
+
+/// @brief Fails the benchmark of @p state because of @p why and counts it in
+/// @see golden_mismatches .
+inline void ReportGoldenMismatch(benchmark::State &state,
+                                 const std::string &why) {
+  golden_mismatches++;
+  state.SkipWithError(why.c_str());
+}
@@ -0,0 +1,172 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_images.h"
+
+namespace {
+
+/// Percentage a benchmark may be slower than its baseline by default.
+const double kDefaultMaxRegression = 10.0;
+
+/// @brief The console reporter, also keeping the time of each benchmark in
+/// seconds per iteration. With repetitions the fastest one is kept, the
+/// least disturbed by the rest of the machine.
+class TimingReporter : public benchmark::ConsoleReporter {
+public:
+  void ReportRuns(const std::vector<Run> &runs) override {
+    ConsoleReporter::ReportRuns(runs);
+
+    for (const Run &run : runs) {
+      if (run.run_type != Run::RT_Iteration || run.iterations == 0) {
+        continue;
+      }
+
+      double seconds = run.GetAdjustedRealTime() /
+                       benchmark::GetTimeUnitMultiplier(run.time_unit);
+      auto [it, inserted] = seconds_.emplace(run.benchmark_name(), seconds);
+      if (!inserted && seconds < it->second) {
+        it->second = seconds;
+      }
+    }
+  }
+
+  const std::map<std::string, double> &seconds() const { return seconds_; }
+
+private:
+  std::map<std::string, double> seconds_;
+};
+
+/// @brief Removes the flag "--<name>=value" from @p argv and returns its
+/// value, or @p fallback when it is not there. Google benchmark refuses the
+/// flags it does not know, so these go before it sees them.
+std::string TakeFlag(int &argc, char **argv, const std::string &name,
+                     const std::string &fallback = "") {
+  std::string prefix = "--" + name + "=";
+  std::string value = fallback;
+
+  int kept = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.rfind(prefix, 0) == 0) {
+      value = arg.substr(prefix.size());
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  argc = kept;
+
+  return value;
+}
+
+/// @brief Reads the "name seconds" lines written by @see SaveBaseline .
+bool LoadBaseline(const std::string &path,
+                  std::map<std::string, double> &seconds) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  std::string name;
+  double value = 0.0;
+  while (file >> name >> value) {
+    seconds[name] = value;
+  }
+
+  return true;
+}
+
+bool SaveBaseline(const std::string &path,
+                  const std::map<std::string, double> &seconds) {
+  std::ofstream file(path);
+  for (const auto &[name, value] : seconds) {
+    file << name << ' ' << value << '\n';
+  }
+
+  return static_cast<bool>(file);
+}
+
+/// @brief Counts the benchmarks of @p current slower than in @p baseline by
+/// more than @p max_regression percent, printing each. Benchmarks missing
+/// on either side are skipped.
+int CountRegressions(const std::map<std::string, double> &current,
+                     const std::map<std::string, double> &baseline,
+                     double max_regression) {
+  int regressions = 0;
+
+  for (const auto &[name, seconds] : current) {
+    auto it = baseline.find(name);
+    if (it == baseline.end() || it->second <= 0.0) {
+      continue;
+    }
+
+    double change = 100.0 * (seconds - it->second) / it->second;
+    if (change > max_regression) {
+      std::fprintf(stderr, "%s: %.1f%% slower than the baseline\n",
+                   name.c_str(), change);
+      regressions++;
+    }
+  }
+
+  return regressions;
+}
+
+} // namespace
+
+/// Runs the benchmarks like benchmark_main, plus three flags of its own:
+/// --save_baseline=<file> writes the time of each benchmark, --baseline=<file>
+/// compares them with the ones of a saved baseline and --max_regression=<%>
+/// sets how much slower one may get (10% by default). The run fails when a
+/// benchmark got slower than that or some result did not match its golden
+/// file (see golden_bench.cpp).
+int main(int argc, char **argv) {
+  std::string baseline_path = TakeFlag(argc, argv, "baseline");
+  std::string save_path = TakeFlag(argc, argv, "save_baseline");
+  double max_regression =
+      std::atof(TakeFlag(argc, argv, "max_regression",
+                         std::to_string(kDefaultMaxRegression))
+                    .c_str());
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+
+  TimingReporter reporter;
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  benchmark::Shutdown();
+
+  int failures = golden_mismatches;
+  if (failures > 0) {
+    std::fprintf(stderr, "%d results did not match their golden file\n",
+                 failures);
+  }
+
+  if (!save_path.empty() && !SaveBaseline(save_path, reporter.seconds())) {
+    std::fprintf(stderr, "Could not write the baseline %s\n",
+                 save_path.c_str());
+    failures++;
+  }
+
+  if (!baseline_path.empty()) {
+    std::map<std::string, double> baseline;
+    if (!LoadBaseline(baseline_path, baseline)) {
+      std::fprintf(stderr, "Could not read the baseline %s\n",
+                   baseline_path.c_str());
+      failures++;
+    } else {
+      failures += CountRegressions(reporter.seconds(), baseline,
+                                   max_regression);
+    }
+  }
+
+  return failures > 0 ? 1 : 0;
+}
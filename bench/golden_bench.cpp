@@ -0,0 +1,162 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_images.h"
+#include "commands.h"
+#include "image_codec.h"
+#include "processing_context.h"
+
+namespace {
+
+/// @brief The file of assets/golden holding the expected result of
+/// @p methods on the asset @p input : "pout.bmp" and "equalize,histogram"
+/// give "pout_equalize_histogram.png". PNG keeps them small and lossless.
+std::string GoldenName(const std::string &input, const std::string &methods) {
+  std::string name = input.substr(0, input.rfind('.')) + "_" + methods;
+  std::replace(name.begin(), name.end(), ',', '_');
+  return name + ".png";
+}
+
+/// @brief Checks @p result against the golden file @p golden : the same size
+/// and no sample further than @p tolerance from the expected one. Gray and
+/// RGB pixels compare by their colors, so a gray golden matches a gray
+/// result of any format.
+/// @param why [out] What differs, when it does
+/// @return Whether @p result matches
+bool MatchesGolden(const Image &result, const std::string &golden,
+                   int tolerance, std::string &why) {
+  DecodedImage decoded;
+  if (decoded.Open(std::string(PDI_LI_ASSETS_DIR "/golden/") + golden) !=
+      BMP_OK) {
+    why = golden + " could not be read";
+    return false;
+  }
+
+  const Image &expected = decoded.image();
+  if (expected.width() != result.width() ||
+      expected.height() != result.height()) {
+    why = golden + " has another size";
+    return false;
+  }
+
+  int worst = 0;
+  for (int y = 0; y < result.height(); y++) {
+    for (int x = 0; x < result.width(); x++) {
+      RGBColor a = result.pixel(x, y);
+      RGBColor b = expected.pixel(x, y);
+      worst = std::max({worst, std::abs(a.r - b.r), std::abs(a.g - b.g),
+                        std::abs(a.b - b.b)});
+    }
+  }
+
+  if (worst > tolerance) {
+    why = golden + " differs by " + std::to_string(worst) + " levels";
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Checks the result of @p methods on the asset @p input against its
+/// golden file (see @see GoldenName ), then times the chain out of place so
+/// every run starts from the same pixels. A mismatch fails the benchmark,
+/// and the run, see bench_main.cpp.
+/// @param tolerance How far a sample may be from the golden one, 0 for a bit
+/// exact match
+void BM_Golden(benchmark::State &state, const char *input,
+               const char *methods, int tolerance) {
+  Pipeline pipeline;
+  if (!PipelineByMethods(methods, pipeline)) {
+    ReportGoldenMismatch(state, std::string("unknown methods ") + methods);
+    return;
+  }
+
+  const Image source = LoadAsset(input);
+  ScratchArena &arena = GetProcessingContext().arena();
+
+  {
+    ScratchScope scope(arena);
+    Image result;
+    FoldedPipeline folded =
+        RunPipeline(source, result, pipeline, true, &scope.arena());
+    std::string why;
+
+    if (!MatchesGolden(folded.rendered ? folded.image : result,
+                       GoldenName(input, methods), tolerance, why)) {
+      ReportGoldenMismatch(state, why);
+      return;
+    }
+  }
+
+  for (auto _ : state) {
+    ScratchScope scope(arena);
+    Image result;
+    FoldedPipeline folded =
+        RunPipeline(source, result, pipeline, true, &scope.arena());
+    benchmark::DoNotOptimize(folded.rendered);
+    benchmark::ClobberMemory();
+  }
+
+  SetPixelCounters(state, source);
+}
+
+} // namespace
+
+// The gray pout.bmp goes through every command, and the color
+// sample_crop.bmp through the ones that treat the channels differently. The
+// Gaussian taps come from exp(), which may round differently on other math
+// libraries, so the blurs allow one level.
+BENCHMARK_CAPTURE(BM_Golden, pout_equalize, "pout.bmp", "equalize", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_equalize_local, "pout.bmp",
+                  "equalize_local", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_cutout, "pout.bmp", "cutout", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_two_peaks, "pout.bmp", "two_peaks", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_otsu, "pout.bmp", "otsu", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_multi_otsu, "pout.bmp", "multi_otsu", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_histogram, "pout.bmp", "histogram", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_equalize_two_peaks_histogram, "pout.bmp",
+                  "equalize,two_peaks,histogram", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_otsu_open, "pout.bmp", "otsu,open", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_otsu_labels, "pout.bmp", "otsu,labels", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_blur, "pout.bmp", "blur", 1)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_box_blur, "pout.bmp", "box_blur", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, pout_sharpen, "pout.bmp", "sharpen", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_equalize, "sample_crop.bmp",
+                  "equalize", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_equalize_luma, "sample_crop.bmp",
+                  "equalize_luma", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_two_peaks, "sample_crop.bmp",
+                  "two_peaks", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_two_peaks_luma, "sample_crop.bmp",
+                  "two_peaks_luma", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_multi_otsu, "sample_crop.bmp",
+                  "multi_otsu", 0)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_blur, "sample_crop.bmp", "blur", 1)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_Golden, sample_crop_histogram, "sample_crop.bmp",
+                  "histogram", 0)
+    ->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,330 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_images.h"
+#include "bit_pack.h"
+#include "histogram.h"
+#include "histogram_index.h"
+#include "luma.h"
+#include "processing.h"
+#include "threshold.h"
+
+namespace {
+
+/// @brief The synthetic image of @p side , kept until a different side is
+/// asked so the 16K one is not alive next to the others.
+const Image &Synthetic(int side) {
+  static Image cached;
+  static int cached_side = 0;
+
+  if (cached_side != side) {
+    cached = Image();
+    cached = SyntheticImage(side);
+    cached_side = side;
+  }
+
+  return cached;
+}
+
+/// @brief The 4096 synthetic image converted to the @see PixelFormat
+/// @p format , kept like @see Synthetic .
+const Image &SyntheticInFormat(int format) {
+  static Image cached;
+  static int cached_format = -1;
+
+  if (cached_format != format) {
+    cached = Image(4096, 4096, static_cast<PixelFormat>(format));
+    CopyPixels(SyntheticImage(4096), cached);
+    cached_format = format;
+  }
+
+  return cached;
+}
+
+const Image &Asset(const std::string &name) {
+  static Image pout = LoadAsset("pout.bmp");
+  static Image sample = LoadAsset("sample.bmp");
+
+  return name == "pout.bmp" ? pout : sample;
+}
+
+/// @brief Times @p kernel running in place on a copy of @p source . None of
+/// the kernels branch on the pixel values, so running one again over its own
+/// output costs the same as the first run.
+void RunInPlace(benchmark::State &state, const Image &source,
+                const std::function<void(Image &)> &kernel) {
+  Image img = source.Clone();
+
+  for (auto _ : state) {
+    kernel(img);
+    benchmark::ClobberMemory();
+  }
+
+  SetPixelCounters(state, img);
+}
+
+/// @brief Times a luma threshold on @p source . The kernels replace the image
+/// they get by a gray one without writing the source, so each run gets a new
+/// view of @p source and takes its gray image from the arena.
+void LumaThreshold(benchmark::State &state, const Image &source,
+                   void (*kernel)(Image &, ScratchArena *)) {
+  ScratchArena &arena = GetProcessingContext().arena();
+
+  for (auto _ : state) {
+    ScratchScope scope(arena);
+    Image img = Image::Wrap(const_cast<byte *>(source.row(0)), source.width(),
+                            source.height(), source.stride(), source.format());
+
+    kernel(img, &arena);
+    benchmark::DoNotOptimize(img.row(0));
+  }
+
+  SetPixelCounters(state, source);
+}
+
+void Histogram(benchmark::State &state, const Image &img) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GetHistogram(img));
+  }
+
+  SetPixelCounters(state, img);
+}
+
+void HistogramImage(benchmark::State &state, const Image &img) {
+  RGBHistogram histogram = GetHistogram(img);
+  int64_t pixels = 0;
+
+  for (auto _ : state) {
+    Image out = CreateHistogramImage(histogram);
+    pixels = static_cast<int64_t>(out.width()) * out.height();
+    benchmark::DoNotOptimize(out.row(0));
+  }
+
+  // Counted over the rendered image, the input is not read.
+  state.SetItemsProcessed(state.iterations() * pixels);
+  state.SetBytesProcessed(state.iterations() * pixels * Image::kChannels);
+}
+
+void EqualizeKernel(Image &img) { Equalize(img); }
+void BinarizeKernel(Image &img) { Binarize(img, 96, 128, 160); }
+void CutoutKernel(Image &img) { Cutout(img); }
+void TwoPeaksKernel(Image &img) { TwoPeaks(img); }
+void EqualizeLocalKernel(Image &img) { EqualizeLocal(img); }
+
+void BM_Histogram(benchmark::State &state) {
+  Histogram(state, Synthetic(static_cast<int>(state.range(0))));
+}
+
+void BM_Equalize(benchmark::State &state) {
+  RunInPlace(state, Synthetic(static_cast<int>(state.range(0))),
+             EqualizeKernel);
+}
+
+void BM_Binarize(benchmark::State &state) {
+  RunInPlace(state, Synthetic(static_cast<int>(state.range(0))),
+             BinarizeKernel);
+}
+
+void BM_Cutout(benchmark::State &state) {
+  RunInPlace(state, Synthetic(static_cast<int>(state.range(0))),
+             CutoutKernel);
+}
+
+void BM_TwoPeaks(benchmark::State &state) {
+  RunInPlace(state, Synthetic(static_cast<int>(state.range(0))),
+             TwoPeaksKernel);
+}
+
+void BM_EqualizeLocal(benchmark::State &state) {
+  RunInPlace(state, Synthetic(static_cast<int>(state.range(0))),
+             EqualizeLocalKernel);
+}
+
+void BM_TwoPeaksLuma(benchmark::State &state) {
+  LumaThreshold(state, Synthetic(static_cast<int>(state.range(0))),
+                TwoPeaksLuma);
+}
+
+void BM_Otsu(benchmark::State &state) {
+  LumaThreshold(state, Synthetic(static_cast<int>(state.range(0))), OtsuLuma);
+}
+
+/// @brief Times packing the cutout of the luma of a @p state.range(0) sided
+/// image into 1bpp rows, as written by --pack-bilevel .
+void BM_PackBits(benchmark::State &state) {
+  Image img = LumaImage(Synthetic(static_cast<int>(state.range(0))));
+  ApplyChannelLUT(img, CutoutLUT());
+  std::vector<byte> packed((img.width() + 7) / 8);
+
+  for (auto _ : state) {
+    for (int y = 0; y < img.height(); y++) {
+      PackBits(img.row(y), img.width(), packed.data());
+    }
+    benchmark::DoNotOptimize(packed.data());
+  }
+
+  SetPixelCounters(state, img);
+}
+
+/// The cut point search alone, for @p state.range(0) classes: the histogram
+/// is taken once, so this is the cost the table commands add to a pixel pass.
+void BM_OtsuSearch(benchmark::State &state) {
+  RGBHistogram histogram = GetHistogram(Synthetic(1024));
+  int classes = static_cast<int>(state.range(0));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(MultiOtsuLUT(histogram, classes));
+  }
+}
+
+void BM_HistogramImage(benchmark::State &state) {
+  HistogramImage(state, Synthetic(static_cast<int>(state.range(0))));
+}
+
+void BM_AssetHistogram(benchmark::State &state, const char *name) {
+  Histogram(state, Asset(name));
+}
+
+void BM_AssetEqualize(benchmark::State &state, const char *name) {
+  RunInPlace(state, Asset(name), EqualizeKernel);
+}
+
+void BM_AssetBinarize(benchmark::State &state, const char *name) {
+  RunInPlace(state, Asset(name), BinarizeKernel);
+}
+
+void BM_AssetCutout(benchmark::State &state, const char *name) {
+  RunInPlace(state, Asset(name), CutoutKernel);
+}
+
+void BM_AssetTwoPeaks(benchmark::State &state, const char *name) {
+  RunInPlace(state, Asset(name), TwoPeaksKernel);
+}
+
+void BM_AssetEqualizeLocal(benchmark::State &state, const char *name) {
+  RunInPlace(state, Asset(name), EqualizeLocalKernel);
+}
+
+void BM_AssetHistogramImage(benchmark::State &state, const char *name) {
+  HistogramImage(state, Asset(name));
+}
+
+void BM_FormatHistogram(benchmark::State &state) {
+  Histogram(state, SyntheticInFormat(static_cast<int>(state.range(0))));
+}
+
+void BM_FormatEqualize(benchmark::State &state) {
+  RunInPlace(state, SyntheticInFormat(static_cast<int>(state.range(0))),
+             EqualizeKernel);
+}
+
+/// The three pixel formats, by their @see PixelFormat value.
+void PixelFormats(benchmark::internal::Benchmark *bench) {
+  bench->ArgName("format")
+      ->DenseRange(0, 2)
+      ->Unit(benchmark::kMicrosecond);
+}
+
+/// @brief Rectangles of a quarter of the side of @p img , spread on it.
+Rectangle QueryArea(const Image &img, int64_t i) {
+  int side = img.width() / 4;
+  int x = static_cast<int>((i * 7919) % (img.width() - side));
+  int y = static_cast<int>((i * 104729) % (img.height() - side));
+
+  return Rectangle{.x = x, .y = y, .width = side, .height = side};
+}
+
+void BM_RegionHistogram(benchmark::State &state) {
+  const Image &img = Synthetic(static_cast<int>(state.range(0)));
+  int64_t i = 0;
+
+  for (auto _ : state) {
+    RGBHistogram histogram{};
+    AccumulateHistogram(img, QueryArea(img, i++), histogram);
+    benchmark::DoNotOptimize(histogram);
+  }
+}
+
+void BM_IndexQuery(benchmark::State &state) {
+  const Image &img = Synthetic(static_cast<int>(state.range(0)));
+  HistogramIndex index(img);
+  int64_t i = 0;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.Query(QueryArea(img, i++)));
+  }
+}
+
+void BM_SlidingWindow(benchmark::State &state) {
+  const Image &img = Synthetic(static_cast<int>(state.range(0)));
+  int side = img.width() / 4;
+  SlidingHistogram window(
+      img, Rectangle{.x = 0, .y = 0, .width = side, .height = side});
+
+  for (auto _ : state) {
+    window.MoveTo((window.window().x + 1) % (img.width() - side), 0);
+    benchmark::DoNotOptimize(window.histogram());
+  }
+}
+
+/// Square sides from 256 up to 16K, multiplying by 4.
+void SyntheticSides(benchmark::internal::Benchmark *bench) {
+  bench->RangeMultiplier(4)->Range(256, 16384)->Unit(benchmark::kMicrosecond);
+}
+
+} // namespace
+
+BENCHMARK(BM_Histogram)->Apply(SyntheticSides);
+BENCHMARK(BM_Equalize)->Apply(SyntheticSides);
+BENCHMARK(BM_Binarize)->Apply(SyntheticSides);
+BENCHMARK(BM_Cutout)->Apply(SyntheticSides);
+BENCHMARK(BM_TwoPeaks)->Apply(SyntheticSides);
+BENCHMARK(BM_EqualizeLocal)->Apply(SyntheticSides);
+BENCHMARK(BM_TwoPeaksLuma)->Apply(SyntheticSides);
+BENCHMARK(BM_Otsu)->Apply(SyntheticSides);
+BENCHMARK(BM_PackBits)->Apply(SyntheticSides);
+BENCHMARK(BM_OtsuSearch)
+    ->ArgName("classes")
+    ->DenseRange(2, kMaxThresholdClasses)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_HistogramImage)->Apply(SyntheticSides);
+BENCHMARK(BM_FormatHistogram)->Apply(PixelFormats);
+BENCHMARK(BM_FormatEqualize)->Apply(PixelFormats);
+BENCHMARK(BM_RegionHistogram)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_IndexQuery)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SlidingWindow)->Arg(4096)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_CAPTURE(BM_AssetHistogram, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetHistogram, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetEqualize, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetEqualize, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetBinarize, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetBinarize, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetCutout, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetCutout, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetTwoPeaks, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetTwoPeaks, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetEqualizeLocal, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetEqualizeLocal, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetHistogramImage, pout, "pout.bmp")
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_AssetHistogramImage, sample, "sample.bmp")
+    ->Unit(benchmark::kMicrosecond);
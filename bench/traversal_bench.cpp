@@ -0,0 +1,95 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <string.h>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_images.h"
+#include "histogram.h"
+#include "processing.h"
+
+namespace {
+
+const int kWidth8K = 7680;
+const int kHeight8K = 4320;
+
+/// @brief Nearest neighbour scale of assets/sample.bmp to 8K, built once.
+const Image &Sample8K() {
+  static Image scaled =
+      ScaleNearest(LoadAsset("sample.bmp"), kWidth8K, kHeight8K);
+
+  return scaled;
+}
+
+/// @brief The traversal order GetHistogram used to have, kept as a baseline.
+RGBHistogram ColumnMajorHistogram(const Image &img) {
+  RGBHistogram histogram{};
+  memset(&histogram, 0, sizeof(RGBHistogram));
+  int step = img.pixel_step();
+
+  for (int x = 0; x < img.width(); x++) {
+    for (int y = 0; y < img.height(); y++) {
+      histogram.red[img.channel_row(kRed, y)[x * step]]++;
+      histogram.green[img.channel_row(kGreen, y)[x * step]]++;
+      histogram.blue[img.channel_row(kBlue, y)[x * step]]++;
+    }
+  }
+
+  return histogram;
+}
+
+/// @brief The traversal order Binarize used to have, kept as a baseline.
+void ColumnMajorBinarize(Image &img, byte cut_point) {
+  int step = img.pixel_step();
+
+  for (int x = 0; x < img.width(); x++) {
+    for (int y = 0; y < img.height(); y++) {
+      for (int c = 0; c < Image::kChannels; c++) {
+        byte &value = img.channel_row(c, y)[x * step];
+        value = value < cut_point ? 0 : 255;
+      }
+    }
+  }
+}
+
+void BM_HistogramColumnMajor(benchmark::State &state) {
+  const Image &img = Sample8K();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ColumnMajorHistogram(img));
+  }
+  SetPixelCounters(state, img);
+}
+
+void BM_HistogramRowMajor(benchmark::State &state) {
+  const Image &img = Sample8K();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GetHistogram(img));
+  }
+  SetPixelCounters(state, img);
+}
+
+void BM_BinarizeColumnMajor(benchmark::State &state) {
+  Image img = Sample8K().Clone();
+  for (auto _ : state) {
+    ColumnMajorBinarize(img, 128);
+    benchmark::ClobberMemory();
+  }
+  SetPixelCounters(state, img);
+}
+
+void BM_BinarizeRowMajor(benchmark::State &state) {
+  Image img = Sample8K().Clone();
+  for (auto _ : state) {
+    Binarize(img, 128, 128, 128);
+    benchmark::ClobberMemory();
+  }
+  SetPixelCounters(state, img);
+}
+
+} // namespace
+
+BENCHMARK(BM_HistogramColumnMajor)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_HistogramRowMajor)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BinarizeColumnMajor)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BinarizeRowMajor)->Unit(benchmark::kMillisecond);
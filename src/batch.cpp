@@ -0,0 +1,331 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "processing_context.h"
+#include "thread_pool.h"
+#include "tiled_image.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::string OutputPath(const std::string &input_bmp,
+                       const std::string &output_dir) {
+  return (std::filesystem::path(output_dir) /
+          std::filesystem::path(input_bmp).filename())
+      .string();
+}
+
+double MegapixelsPerSecond(int64_t pixels, double seconds) {
+  return seconds > 0.0 ? pixels / seconds / 1e6 : 0.0;
+}
+
+/// @brief A file on its way through the stages of @see RunStagedBatch
+struct StagedFile {
+  int job = -1;
+  /// The read error, or BMP_OK when @see bytes holds the file.
+  BmpError error = BMP_OK;
+  std::vector<byte> bytes;
+};
+
+/// @brief Runs the jobs as three stages: a reader thread loading the input
+/// files, the workers of the pool processing them in memory and a writer
+/// thread storing the results. Buffers go around through queues of free
+/// ones, so their capacity is reused from file to file.
+void RunStagedBatch(const Pipeline &pipeline,
+                    const std::vector<BatchJob> &jobs,
+                    const RunOptions &options, BatchReport &report) {
+  ThreadPool &pool = GetThreadPool();
+  int workers = pool.size();
+  // Every buffer can be on a queue at once, so giving one back never blocks.
+  int buffers = 2 * kDefaultQueueDepth + workers;
+
+  BoundedQueue<StagedFile> free_inputs(buffers);
+  BoundedQueue<StagedFile> free_outputs(buffers);
+  BoundedQueue<StagedFile> loaded(kDefaultQueueDepth);
+  BoundedQueue<StagedFile> processed(kDefaultQueueDepth);
+
+  double unused = 0.0;
+  for (int i = 0; i < buffers; i++) {
+    free_inputs.Push(StagedFile{}, unused);
+    free_outputs.Push(StagedFile{}, unused);
+  }
+
+  PipelineStats &stages = report.stages;
+  std::mutex stages_mutex;
+  stages.compute.threads = workers;
+
+  std::thread reader([&] {
+    StageClock clock;
+
+    for (int i = 0; i < static_cast<int>(jobs.size()); i++) {
+      StagedFile file;
+      free_inputs.Pop(file, stages.read.blocked_seconds);
+
+      clock.Lap();
+      file.job = i;
+      file.error = ReadFileBytes(jobs[i].input_bmp, file.bytes);
+      stages.read.busy_seconds += clock.Lap();
+      stages.read.items++;
+
+      loaded.Push(std::move(file), stages.read.blocked_seconds);
+    }
+
+    loaded.Close();
+  });
+
+  std::thread writer([&] {
+    StageClock clock;
+    StagedFile file;
+
+    while (processed.Pop(file, stages.write.starved_seconds)) {
+      clock.Lap();
+      report.files[file.job].error =
+          WriteFileBytes(jobs[file.job].output_bmp, file.bytes);
+      stages.write.busy_seconds += clock.Lap();
+      stages.write.items++;
+
+      free_outputs.Push(std::move(file), unused);
+    }
+  });
+
+  pool.ParallelFor(workers, [&](int) {
+    StageStats compute;
+    StagedFile input;
+    double ignored = 0.0;
+
+    while (loaded.Pop(input, compute.starved_seconds)) {
+      BatchFileReport &report_file = report.files[input.job];
+      const BatchJob &job = jobs[input.job];
+      StagedFile output;
+      free_outputs.Pop(output, ignored);
+
+      StageClock clock;
+      int64_t allocations = ThreadHeapStats().allocations;
+
+      BmpError error = input.error;
+      if (error == BMP_OK) {
+        error = RunCommandInMemory(pipeline, input.bytes, output.bytes,
+                                   ImageFileTypeOf(job.output_bmp), options,
+                                   &report_file.pixels);
+      }
+
+      // Files that can not be viewed in memory, like color paletted ones,
+      // are processed from their paths, writing the output right away.
+      bool written = false;
+      if (error == BMP_INVALID_FILE) {
+        error = RunCommand(pipeline, job.input_bmp, job.output_bmp, options,
+                           &report_file.pixels);
+        written = true;
+      }
+
+      report_file.error = error;
+      report_file.allocations = ThreadHeapStats().allocations - allocations;
+      report_file.seconds = clock.Lap();
+      compute.busy_seconds += report_file.seconds;
+      compute.items++;
+
+      free_inputs.Push(std::move(input), ignored);
+      if (error != BMP_OK || written) {
+        free_outputs.Push(std::move(output), ignored);
+        continue;
+      }
+
+      output.job = input.job;
+      processed.Push(std::move(output), compute.blocked_seconds);
+    }
+
+    std::lock_guard lock(stages_mutex);
+    stages.compute.Merge(compute);
+  });
+
+  processed.Close();
+  reader.join();
+  writer.join();
+}
+
+} // namespace
+
+bool JobsFromList(const std::string &list_file, const std::string &output_dir,
+                  std::vector<BatchJob> &jobs) {
+  std::ifstream list(list_file);
+  if (!list) {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(list, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+
+    jobs.push_back(BatchJob{.input_bmp = line,
+                            .output_bmp = OutputPath(line, output_dir)});
+  }
+
+  return true;
+}
+
+bool JobsFromDirectory(const std::string &input_dir,
+                       const std::string &output_dir,
+                       std::vector<BatchJob> &jobs) {
+  std::error_code error;
+  std::filesystem::directory_iterator entries(input_dir, error);
+  if (error) {
+    return false;
+  }
+
+  std::vector<std::string> inputs;
+  for (const auto &entry : entries) {
+    ImageFileType type;
+    if (entry.is_regular_file() &&
+        (ImageFileTypeByExtension(entry.path().string(), type) ||
+         IsTiledImageFile(entry.path().string()))) {
+      inputs.push_back(entry.path().string());
+    }
+  }
+
+  std::sort(inputs.begin(), inputs.end());
+  for (const std::string &input : inputs) {
+    jobs.push_back(BatchJob{.input_bmp = input,
+                            .output_bmp = OutputPath(input, output_dir)});
+  }
+
+  return true;
+}
+
+BatchReport RunBatch(const Pipeline &pipeline,
+                     const std::vector<BatchJob> &jobs,
+                     const RunOptions &options) {
+  BatchReport report;
+  report.files.resize(jobs.size());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    report.files[i].job = jobs[i];
+  }
+
+  Clock::time_point start = Clock::now();
+  report.staged = options.async_io;
+
+  if (options.async_io && !options.stream) {
+    RunStagedBatch(pipeline, jobs, options, report);
+    report.seconds = SecondsSince(start);
+    report.stages.wall_seconds = report.seconds;
+    return report;
+  }
+
+  std::mutex stages_mutex;
+
+  GetThreadPool().ParallelFor(static_cast<int>(jobs.size()), [&](int i) {
+    BatchFileReport &file = report.files[i];
+    PipelineStats stages;
+
+    Clock::time_point file_start = Clock::now();
+    int64_t allocations = ThreadHeapStats().allocations;
+
+    file.error = RunCommand(pipeline, jobs[i].input_bmp, jobs[i].output_bmp,
+                            options, &file.pixels, &stages);
+    file.allocations = ThreadHeapStats().allocations - allocations;
+    file.seconds = SecondsSince(file_start);
+
+    std::lock_guard lock(stages_mutex);
+    report.stages.read.Merge(stages.read);
+    report.stages.compute.Merge(stages.compute);
+    report.stages.write.Merge(stages.write);
+  });
+
+  // Streamed files run their stages on every worker at once.
+  report.seconds = SecondsSince(start);
+  report.stages.wall_seconds = report.seconds;
+  report.stages.read.threads = GetThreadPool().size();
+  report.stages.compute.threads = GetThreadPool().size();
+  report.stages.write.threads = GetThreadPool().size();
+
+  return report;
+}
+
+BatchReport RunDatasetHistogram(const std::vector<BatchJob> &jobs,
+                                const RunOptions &options,
+                                DatasetHistogram &dataset) {
+  BatchReport report;
+  report.files.resize(jobs.size());
+  std::vector<RGBHistogram> histograms(jobs.size());
+
+  Clock::time_point start = Clock::now();
+
+  GetThreadPool().ParallelFor(static_cast<int>(jobs.size()), [&](int i) {
+    BatchFileReport &file = report.files[i];
+    file.job = BatchJob{jobs[i].input_bmp, "histogram"};
+
+    Clock::time_point file_start = Clock::now();
+    int64_t allocations = ThreadHeapStats().allocations;
+
+    file.error = CountFileHistogram(jobs[i].input_bmp, options, histograms[i],
+                                    &file.pixels);
+    file.allocations = ThreadHeapStats().allocations - allocations;
+    file.seconds = SecondsSince(file_start);
+  });
+
+  // Reduced in the order of the jobs, whatever the order they ran in.
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (report.files[i].error == BMP_OK) {
+      AddToDataset(histograms[i], dataset);
+    }
+  }
+
+  report.seconds = SecondsSince(start);
+  return report;
+}
+
+int PrintBatchReport(const BatchReport &report) {
+  int failures = 0;
+  int64_t total_pixels = 0;
+
+  for (const BatchFileReport &file : report.files) {
+    if (file.error != BMP_OK) {
+      failures++;
+      fmt::print("{} -> {}: failed ({})\n", file.job.input_bmp,
+                 file.job.output_bmp, static_cast<int>(file.error));
+      continue;
+    }
+
+    total_pixels += file.pixels;
+    fmt::print("{} -> {}: {:.2f} MP in {:.1f} ms ({:.1f} MP/s, {} "
+               "allocations)\n",
+               file.job.input_bmp, file.job.output_bmp, file.pixels / 1e6,
+               file.seconds * 1e3,
+               MegapixelsPerSecond(file.pixels, file.seconds),
+               file.allocations);
+  }
+
+  size_t succeeded = report.files.size() - failures;
+  fmt::print("{} files ({} failed), {:.2f} MP in {:.3f} s: {:.1f} MP/s, "
+             "{:.1f} files/s\n",
+             report.files.size(), failures, total_pixels / 1e6,
+             report.seconds,
+             MegapixelsPerSecond(total_pixels, report.seconds),
+             report.seconds > 0.0 ? succeeded / report.seconds : 0.0);
+
+  if (report.staged) {
+    PrintPipelineStats(report.stages);
+  }
+
+  return failures;
+}
@@ -0,0 +1,96 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "commands.h"
+#include "io_pipeline.h"
+
+/// @brief One file processed by @see RunBatch
+struct BatchJob {
+  std::string input_bmp;
+  std::string output_bmp;
+};
+
+/// @brief The outcome of one @see BatchJob
+struct BatchFileReport {
+  BatchJob job;
+  BmpError error = BMP_OK;
+  int64_t pixels = 0;
+  /// Time taken by the file, only on the compute stage with
+  /// @see RunOptions::async_io .
+  double seconds = 0.0;
+  /// Heap allocations made by the worker thread while processing the file.
+  /// Every worker reuses its @see ProcessingContext , so after its first file
+  /// this only counts what the file needs beyond the largest one before it.
+  int64_t allocations = 0;
+};
+
+/// @brief The outcome of a whole @see RunBatch call
+struct BatchReport {
+  std::vector<BatchFileReport> files;
+  /// Wall time of the whole batch.
+  double seconds = 0.0;
+  /// With @see RunOptions::async_io , where the time of each stage went.
+  bool staged = false;
+  PipelineStats stages;
+};
+
+/// @brief Builds the jobs of a list file with one input path per line. Each
+/// output is written on @p output_dir with the name of its input.
+/// @param list_file The file with the input paths
+/// @param output_dir The directory that receives the outputs
+/// @param jobs [out] One job per non empty line
+/// @return false if @p list_file could not be read
+bool JobsFromList(const std::string &list_file, const std::string &output_dir,
+                  std::vector<BatchJob> &jobs);
+
+/// @brief Builds one job for each image file of @p input_dir (see
+/// @see ImageFileTypeByExtension and @see IsTiledImageFile ), writing the
+/// outputs with the same names on @p output_dir .
+/// @param input_dir The directory to be scanned
+/// @param output_dir The directory that receives the outputs
+/// @param jobs [out] One job per image file, sorted by name
+/// @return false if @p input_dir could not be listed
+bool JobsFromDirectory(const std::string &input_dir,
+                       const std::string &output_dir,
+                       std::vector<BatchJob> &jobs);
+
+/// @brief Runs @p pipeline over all the @p jobs on @see GetThreadPool . Each
+/// worker reads, processes and writes its own file, so the I/O of some files
+/// overlaps with the processing of others. With @see RunOptions::async_io
+/// the reads and writes move to a reader and a writer thread instead, with
+/// bounded queues of file buffers between them and the workers, so the
+/// workers only compute (streamed files keep their own staged bands).
+/// @param pipeline The commands to be applied to every file
+/// @param jobs The files to be processed
+/// @param options How the files are read and written
+/// @return The timing and the outcome of every job
+BatchReport RunBatch(const Pipeline &pipeline,
+                     const std::vector<BatchJob> &jobs,
+                     const RunOptions &options);
+
+/// @brief The first pass of a dataset run: counts the histogram of every file
+/// of @p jobs on @see GetThreadPool , reading each file once (see
+/// @see CountFileHistogram ), and adds them to @p dataset in the order of the
+/// jobs. The second pass is a @see RunBatch with the
+/// @see DatasetToHistogram of @p dataset as its @see RunOptions::histogram ,
+/// so every pixel of the set is read twice and every file gets the same
+/// tables.
+/// @param jobs The files to be counted, their outputs are not used
+/// @param options How the files are read
+/// @param dataset [in | out] Receives the counts of the files that could be
+/// read, on top of the ones it has (like the histograms of other machines)
+/// @return The timing and the outcome of every job
+BatchReport RunDatasetHistogram(const std::vector<BatchJob> &jobs,
+                                const RunOptions &options,
+                                DatasetHistogram &dataset);
+
+/// @brief Prints the per file and the aggregate throughput of @p report , and
+/// the occupancy of its stages when it was staged.
+/// @return The number of jobs that failed
+int PrintBatchReport(const BatchReport &report);
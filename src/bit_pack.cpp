@@ -0,0 +1,240 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "bit_pack.h"
+
+#include <string.h>
+
+#include "cpu_features.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PDI_LI_PACK_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PDI_LI_PACK_NEON 1
+#endif
+
+namespace {
+
+/// Samples taken by each step of the vector kernels.
+const int kPackBlock = 16;
+
+/// @brief Packs the @p kPackBlock samples on @p samples into two bytes.
+inline void PackBlock(const byte *samples, byte *packed) {
+#if defined(PDI_LI_PACK_SSE2)
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+
+  // movemask puts the first sample on the lowest bit, so the samples of each
+  // half are reversed first (words, then the bytes of each word).
+  v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+  int mask = _mm_movemask_epi8(v);
+  packed[0] = static_cast<byte>(mask & 0xFF);
+  packed[1] = static_cast<byte>(mask >> 8);
+#elif defined(PDI_LI_PACK_NEON)
+  const uint8x16_t weights = {128, 64, 32, 16, 8, 4, 2, 1,
+                              128, 64, 32, 16, 8, 4, 2, 1};
+
+  uint8x16_t set = vcgeq_u8(vld1q_u8(samples), vdupq_n_u8(128));
+  uint8x16_t bits = vandq_u8(set, weights);
+  uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+
+  packed[0] = static_cast<byte>(vgetq_lane_u64(sums, 0));
+  packed[1] = static_cast<byte>(vgetq_lane_u64(sums, 1));
+#else
+  for (int i = 0; i < 2; i++) {
+    byte bits = 0;
+    for (int x = 0; x < 8; x++) {
+      bits = static_cast<byte>((bits << 1) | (samples[8 * i + x] >> 7));
+    }
+    packed[i] = bits;
+  }
+#endif
+}
+
+#if defined(PDI_LI_X86)
+/// @brief @see PackBits 32 samples at a time: reversing the samples of each
+/// byte to be lets a single movemask write four of them.
+/// @return The first sample left for @see PackBits
+PDI_LI_TARGET_AVX2 int PackBitsAVX2(const byte *samples, int width,
+                                    byte *packed) {
+  const __m256i reverse = _mm256_setr_epi8(
+      7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2,
+      1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + x));
+    uint32_t bits = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_shuffle_epi8(v, reverse)));
+    memcpy(packed + x / 8, &bits, sizeof(bits));
+  }
+
+  return x;
+}
+
+/// @brief @see PackBitsAVX2 64 samples at a time.
+PDI_LI_TARGET_AVX512 int PackBitsAVX512(const byte *samples, int width,
+                                        byte *packed) {
+  const __m512i reverse = _mm512_broadcast_i32x4(_mm_setr_epi8(
+      7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8));
+
+  int x = 0;
+  for (; x + 64 <= width; x += 64) {
+    __m512i v = _mm512_loadu_si512(samples + x);
+    uint64_t bits = _mm512_movepi8_mask(_mm512_shuffle_epi8(v, reverse));
+    memcpy(packed + x / 8, &bits, sizeof(bits));
+  }
+
+  return x;
+}
+
+/// @brief @see IsBilevelRow 32 samples at a time.
+/// @return false if some sample is neither 0 nor 255, and the first sample
+/// left otherwise on @p x
+PDI_LI_TARGET_AVX2 bool IsBilevelRowAVX2(const byte *samples, int count,
+                                         int &x) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i full = _mm256_set1_epi8(-1);
+
+  for (x = 0; x + 32 <= count; x += 32) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples + x));
+    __m256i bilevel = _mm256_or_si256(_mm256_cmpeq_epi8(v, zero),
+                                      _mm256_cmpeq_epi8(v, full));
+
+    if (_mm256_movemask_epi8(bilevel) != -1) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @brief @see IsBilevelRowAVX2 64 samples at a time.
+PDI_LI_TARGET_AVX512 bool IsBilevelRowAVX512(const byte *samples, int count,
+                                             int &x) {
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i full = _mm512_set1_epi8(-1);
+
+  for (x = 0; x + 64 <= count; x += 64) {
+    __m512i v = _mm512_loadu_si512(samples + x);
+    __mmask64 bilevel =
+        _mm512_cmpeq_epi8_mask(v, zero) | _mm512_cmpeq_epi8_mask(v, full);
+
+    if (bilevel != ~__mmask64(0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+} // namespace
+
+bool IsBilevelRow(const byte *samples, int count) {
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  CpuIsa isa = GetCpuIsa();
+  bool bilevel = true;
+  if (isa >= CpuIsa::kAVX512) {
+    bilevel = IsBilevelRowAVX512(samples, count, x);
+  } else if (isa >= CpuIsa::kAVX2) {
+    bilevel = IsBilevelRowAVX2(samples, count, x);
+  }
+
+  if (!bilevel) {
+    return false;
+  }
+#endif
+
+#if defined(PDI_LI_PACK_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i full = _mm_set1_epi8(-1);
+
+  for (; x + kPackBlock <= count; x += kPackBlock) {
+    __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + x));
+    __m128i bilevel =
+        _mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, full));
+
+    if (_mm_movemask_epi8(bilevel) != 0xFFFF) {
+      return false;
+    }
+  }
+#elif defined(PDI_LI_PACK_NEON)
+  for (; x + kPackBlock <= count; x += kPackBlock) {
+    uint8x16_t v = vld1q_u8(samples + x);
+    uint8x16_t bilevel =
+        vorrq_u8(vceqq_u8(v, vdupq_n_u8(0)), vceqq_u8(v, vdupq_n_u8(255)));
+
+    uint64x2_t lanes = vreinterpretq_u64_u8(bilevel);
+
+    if ((vgetq_lane_u64(lanes, 0) & vgetq_lane_u64(lanes, 1)) != ~0ull) {
+      return false;
+    }
+  }
+#endif
+
+  for (; x < count; x++) {
+    if (samples[x] != 0 && samples[x] != 255) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void PackBits(const byte *samples, int width, byte *packed) {
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  CpuIsa isa = GetCpuIsa();
+  if (isa >= CpuIsa::kAVX512) {
+    x = PackBitsAVX512(samples, width, packed);
+  } else if (isa >= CpuIsa::kAVX2) {
+    x = PackBitsAVX2(samples, width, packed);
+  }
+#endif
+
+  for (; x + kPackBlock <= width; x += kPackBlock) {
+    PackBlock(samples + x, packed + x / 8);
+  }
+
+  // The tail goes through a zero padded block.
+  if (x < width) {
+    byte tail[kPackBlock] = {};
+    byte bits[2];
+
+    memcpy(tail, samples + x, width - x);
+    PackBlock(tail, bits);
+    memcpy(packed + x / 8, bits, (width - x + 7) / 8);
+  }
+}
+
+void UnpackIndices(const byte *row, int width, int bits_per_pixel,
+                   byte *indices) {
+  switch (bits_per_pixel) {
+  case 1: {
+    for (int x = 0; x < width; x++) {
+      indices[x] = (row[x >> 3] >> (7 - (x & 7))) & 1;
+    }
+  } break;
+
+  case 4: {
+    for (int x = 0; x < width; x++) {
+      indices[x] = (row[x >> 1] >> ((x & 1) ? 0 : 4)) & 0xF;
+    }
+  } break;
+
+  default: {
+    memcpy(indices, row, width);
+  } break;
+  }
+}
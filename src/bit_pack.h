@@ -0,0 +1,27 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include "image.h"
+
+/// @brief Whether every one of the @p count samples on @p samples is 0 or
+/// 255.
+bool IsBilevelRow(const byte *samples, int count);
+
+/// @brief Packs @p width samples one bit each, the first sample on the most
+/// significant bit of the first byte like the rows of 1bpp BMP files.
+/// Samples from 128 up become a 1. The bits past @p width are zeroed.
+/// @param samples The samples to be packed, usually 0 or 255
+/// @param width The number of samples
+/// @param packed [out] Receives the (width + 7) / 8 bytes
+void PackBits(const byte *samples, int width, byte *packed);
+
+/// @brief Expands a row of a paletted BMP file to one palette index per
+/// byte.
+/// @param row The row as stored on the file
+/// @param width The number of pixels on the row
+/// @param bits_per_pixel 1, 4 or 8
+/// @param indices [out] Receives the @p width indices
+void UnpackIndices(const byte *row, int width, int bits_per_pixel,
+                   byte *indices);
@@ -0,0 +1,760 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "bmp_io.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bit_pack.h"
+#include "profiler.h"
+
+Image ImageFromBmp(BmpImg &bmp, PixelLayout layout) {
+  Image img(bmp.get_width(), bmp.get_height(), layout);
+
+  CopyFromBmp(bmp, img);
+
+  return img;
+}
+
+void CopyFromBmp(BmpImg &bmp, Image &img) {
+  int width = img.width();
+  int height = img.height();
+  int step = img.pixel_step();
+
+  for (int y = 0; y < height; y++) {
+    byte *red = img.channel_row(kRed, y);
+    byte *green = img.channel_row(kGreen, y);
+    byte *blue = img.channel_row(kBlue, y);
+
+    for (int x = 0; x < width; x++) {
+      red[x * step] = bmp.red_at(x, y);
+      green[x * step] = bmp.green_at(x, y);
+      blue[x * step] = bmp.blue_at(x, y);
+    }
+  }
+}
+
+void CopyToBmp(const Image &img, BmpImg &bmp) {
+  int width = img.width();
+  int height = img.height();
+  int step = img.pixel_step();
+
+  for (int y = 0; y < height; y++) {
+    const byte *red = img.channel_row(kRed, y);
+    const byte *green = img.channel_row(kGreen, y);
+    const byte *blue = img.channel_row(kBlue, y);
+
+    for (int x = 0; x < width; x++) {
+      bmp.set_pixel(x, y, red[x * step], green[x * step], blue[x * step]);
+    }
+  }
+}
+
+BmpImg BmpFromImage(const Image &img) {
+  BmpImg bmp(img.width(), img.height());
+
+  CopyToBmp(img, bmp);
+
+  return bmp;
+}
+
+namespace {
+
+const uint16_t kBmpMagic = 0x4D42;
+const uint32_t kFileHeaderSize = 14;
+const uint32_t kInfoHeaderSize = 40;
+const uint32_t kHeadersSize = kFileHeaderSize + kInfoHeaderSize;
+
+/// BI_RGB and BI_BITFIELDS, the compressions read.
+const uint32_t kUncompressed = 0;
+const uint32_t kBitfields = 3;
+
+/// The red, green, blue and alpha masks of BI_BITFIELDS follow the first 40
+/// bytes of the info header: inside it for the longer headers (an alpha mask
+/// from the 56 bytes of the V3 header on, like on the V4 and V5 ones) and
+/// right after a BITMAPINFOHEADER, without the alpha mask.
+const uint32_t kMasksOffset = kHeadersSize;
+const uint32_t kRgbMasksInfoSize = 52;
+const uint32_t kAlphaMaskInfoSize = 56;
+
+/// The BITMAPV5HEADER, the longest info header.
+const uint32_t kV5InfoHeaderSize = 124;
+
+/// Bytes @see ParseHeaders may read: the headers and the color masks.
+const uint32_t kMaxHeadersSize = kMasksOffset + 16;
+
+uint16_t ReadU16(const byte *p) { return p[0] | (p[1] << 8); }
+
+uint32_t ReadU32(const byte *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void WriteU16(byte *p, uint16_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+}
+
+void WriteU32(byte *p, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (value >> (8 * i)) & 0xFF;
+  }
+}
+
+size_t PaddedRowBytes(int width, int bits_per_pixel) {
+  return (static_cast<size_t>(width) * bits_per_pixel + 31) / 32 * 4;
+}
+
+/// @brief Whether the BI_BITFIELDS masks at @p masks are the ones of the
+/// B, G, R, A bytes of 32bpp files, with or without the alpha mask.
+/// @param has_alpha_mask Whether the masks hold an alpha mask, which may be
+/// 0 for files that leave the fourth byte unused
+bool IsBgraMasks(const byte *masks, bool has_alpha_mask) {
+  uint32_t alpha = has_alpha_mask ? ReadU32(masks + 12) : 0;
+
+  return ReadU32(masks) == 0x00FF0000 && ReadU32(masks + 4) == 0x0000FF00 &&
+         ReadU32(masks + 8) == 0x000000FF &&
+         (alpha == 0 || alpha == 0xFF000000);
+}
+
+/// @brief Parses the BITMAPFILEHEADER and the BITMAPINFOHEADER (or the V4
+/// and V5 headers that extend it) of the @p size bytes of @p header , which
+/// must hold at least @see kHeadersSize bytes. BI_BITFIELDS is read for
+/// 32bpp files with the masks of @see IsBgraMasks , up to
+/// @see kMaxHeadersSize bytes are read for them. The palette of paletted
+/// files is located by @p palette_offset and @p colors but not read.
+BmpError ParseHeaders(const byte *header, size_t size, BmpInfo &info,
+                      uint32_t &palette_offset, uint32_t &colors) {
+  if (size < kHeadersSize) {
+    return BMP_INVALID_FILE;
+  }
+
+  const byte *info_header = header + kFileHeaderSize;
+  uint32_t info_size = ReadU32(info_header);
+  int32_t height = static_cast<int32_t>(ReadU32(info_header + 8));
+  uint32_t compression = ReadU32(info_header + 16);
+
+  // -INT32_MIN does not fit in the height.
+  if (info_size < kInfoHeaderSize || info_size > kV5InfoHeaderSize ||
+      height == INT32_MIN) {
+    return BMP_INVALID_FILE;
+  }
+
+  info = BmpInfo{};
+  info.width = static_cast<int32_t>(ReadU32(info_header + 4));
+  info.height = height < 0 ? -height : height;
+  info.bottom_up = height > 0;
+  info.bits_per_pixel = ReadU16(info_header + 14);
+  info.pixel_offset = ReadU32(header + 10);
+
+  int bits = info.bits_per_pixel;
+  if (ReadU16(header) != kBmpMagic || info.width <= 0 ||
+      (bits != 32 && bits != 24 && bits != 8 && bits != 4 && bits != 1)) {
+    return BMP_INVALID_FILE;
+  }
+
+  if (compression == kBitfields) {
+    bool has_alpha_mask = info_size >= kAlphaMaskInfoSize;
+    uint32_t masks_end = kMasksOffset + (has_alpha_mask ? 16 : 12);
+    if (bits != 32 || size < masks_end ||
+        (info_size == kInfoHeaderSize ? info.pixel_offset < masks_end
+                                      : info_size < kRgbMasksInfoSize) ||
+        !IsBgraMasks(header + kMasksOffset, has_alpha_mask)) {
+      return BMP_INVALID_FILE;
+    }
+  } else if (compression != kUncompressed) {
+    return BMP_INVALID_FILE;
+  }
+
+  info.row_bytes = PaddedRowBytes(info.width, bits);
+  palette_offset = kFileHeaderSize + info_size;
+  colors = bits <= 8 ? ReadU32(info_header + 32) : 0;
+  if (bits <= 8 && (colors == 0 || colors > (1u << bits))) {
+    colors = 1u << bits;
+  }
+
+  return BMP_OK;
+}
+
+/// @brief Fills the palette of @p info from the BGRA color table @p table .
+void ParsePalette(const byte *table, uint32_t colors, BmpInfo &info) {
+  info.palette.fill(RGBColor{});
+
+  for (uint32_t i = 0; i < colors && i < 256; i++) {
+    info.palette[i] = RGBColor{
+        .r = table[4 * i + 2], .g = table[4 * i + 1], .b = table[4 * i]};
+  }
+}
+
+/// @brief Whether the palette of @p info is the one of the files written for
+/// kGray8, so the indices of its 8bpp pixels are their samples.
+bool IsGrayRamp(const BmpInfo &info) {
+  if (info.bits_per_pixel != 8) {
+    return false;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    const RGBColor &color = info.palette[i];
+    if (color.r != i || color.g != i || color.b != i) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @brief Bits each pixel of @p format takes on a file written with
+/// @p packing .
+int BitsPerPixel(PixelFormat format,
+                 BilevelPacking packing = BilevelPacking::kNone) {
+  switch (packing) {
+    using enum BilevelPacking;
+
+  case k1bpp:
+    return 1;
+
+  case k4bpp:
+    return 4;
+
+  default:
+    return 8 * BytesPerPixel(format);
+  }
+}
+
+/// @brief Entries on the color table of those files.
+int PaletteColors(PixelFormat format,
+                  BilevelPacking packing = BilevelPacking::kNone) {
+  switch (packing) {
+    using enum BilevelPacking;
+
+  case k1bpp:
+    return 2;
+
+  case k4bpp:
+    return 8;
+
+  default:
+    return format == PixelFormat::kGray8 ? 256 : 0;
+  }
+}
+
+/// @brief The color @p index of those files: the gray ramp, black and white
+/// or the corners of the RGB cube, the bits of @p index being R, G and B.
+RGBColor PaletteColor(int index, BilevelPacking packing) {
+  switch (packing) {
+    using enum BilevelPacking;
+
+  case k1bpp: {
+    byte sample = index ? 255 : 0;
+    return RGBColor{.r = sample, .g = sample, .b = sample};
+  }
+
+  case k4bpp:
+    return RGBColor{.r = static_cast<byte>(index & 4 ? 255 : 0),
+                    .g = static_cast<byte>(index & 2 ? 255 : 0),
+                    .b = static_cast<byte>(index & 1 ? 255 : 0)};
+
+  default: {
+    byte sample = static_cast<byte>(index);
+    return RGBColor{.r = sample, .g = sample, .b = sample};
+  }
+  }
+}
+
+/// @brief Bytes before the pixel array of those files.
+uint32_t HeadersSize(PixelFormat format,
+                     BilevelPacking packing = BilevelPacking::kNone) {
+  return kHeadersSize + 4 * PaletteColors(format, packing);
+}
+
+/// @brief Writes the headers of a @p width x @p height BMP of @p format ,
+/// packed with @p packing , into the @see HeadersSize bytes of @p header ,
+/// the palette included.
+void WriteHeaders(byte *header, int width, int height, bool bottom_up,
+                  PixelFormat format,
+                  BilevelPacking packing = BilevelPacking::kNone) {
+  int bits_per_pixel = BitsPerPixel(format, packing);
+  int colors = PaletteColors(format, packing);
+  uint32_t headers_size = HeadersSize(format, packing);
+  size_t image_bytes = PaddedRowBytes(width, bits_per_pixel) * height;
+  byte *info_header = header + kFileHeaderSize;
+
+  memset(header, 0, headers_size);
+  WriteU16(header, kBmpMagic);
+  WriteU32(header + 2, static_cast<uint32_t>(headers_size + image_bytes));
+  WriteU32(header + 10, headers_size);
+  WriteU32(info_header, kInfoHeaderSize);
+  WriteU32(info_header + 4, width);
+  WriteU32(info_header + 8,
+           static_cast<uint32_t>(bottom_up ? height : -height));
+  WriteU16(info_header + 12, 1);
+  WriteU16(info_header + 14, static_cast<uint16_t>(bits_per_pixel));
+  WriteU32(info_header + 20, static_cast<uint32_t>(image_bytes));
+
+  WriteU32(info_header + 32, colors);
+  for (int i = 0; i < colors; i++) {
+    RGBColor color = PaletteColor(i, packing);
+    byte *entry = header + kHeadersSize + 4 * i;
+
+    entry[0] = color.b;
+    entry[1] = color.g;
+    entry[2] = color.r;
+  }
+}
+
+/// @brief Whether a BMP of those sizes stays under @see kMaxBmpFileSize .
+bool FitsBmp(int width, int height, PixelFormat format,
+             BilevelPacking packing = BilevelPacking::kNone) {
+  return HeadersSize(format, packing) +
+             PaddedRowBytes(width, BitsPerPixel(format, packing)) * height <=
+         kMaxBmpFileSize;
+}
+
+} // namespace
+
+PixelFormat FormatOf(const BmpInfo &info) {
+  if (info.bits_per_pixel == 32) {
+    return PixelFormat::kBGRA32;
+  }
+
+  if (info.bits_per_pixel > 8) {
+    return PixelFormat::kRGB24;
+  }
+
+  for (const RGBColor &color : info.palette) {
+    if (color.r != color.g || color.g != color.b) {
+      return PixelFormat::kRGB24;
+    }
+  }
+
+  return PixelFormat::kGray8;
+}
+
+BilevelPacking BilevelPackingOf(const Image &img) {
+  if (img.format() == PixelFormat::kBGRA32 ||
+      img.layout() != PixelLayout::kInterleaved) {
+    return BilevelPacking::kNone;
+  }
+
+  int width = img.width();
+  int step = img.pixel_step();
+  bool gray = img.format() == PixelFormat::kGray8;
+  bool black_and_white = true;
+
+  for (int y = 0; y < img.height(); y++) {
+    const byte *row = img.row(y);
+    if (!IsBilevelRow(row, width * step)) {
+      return BilevelPacking::kNone;
+    }
+
+    for (int x = 0; x < width && black_and_white && !gray; x++) {
+      const byte *pixel = row + 3 * x;
+      black_and_white = pixel[0] == pixel[1] && pixel[1] == pixel[2];
+    }
+  }
+
+  return black_and_white ? BilevelPacking::k1bpp : BilevelPacking::k4bpp;
+}
+
+BmpError BmpBandReader::Open(const std::string &filename) {
+  file_.open(filename, std::ios::binary);
+  if (!file_) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  // The masks may lie past the end of small files without them.
+  byte header[kMaxHeadersSize];
+  file_.read(reinterpret_cast<char *>(header), sizeof(header));
+  size_t size = static_cast<size_t>(file_.gcount());
+  file_.clear();
+
+  uint32_t palette_offset = 0;
+  uint32_t colors = 0;
+  BmpError error = ParseHeaders(header, size, info_, palette_offset, colors);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  if (colors > 0) {
+    std::vector<byte> table(4 * colors);
+    file_.seekg(palette_offset);
+    if (!file_.read(reinterpret_cast<char *>(table.data()), table.size())) {
+      return BMP_INVALID_FILE;
+    }
+
+    ParsePalette(table.data(), colors, info_);
+  }
+
+  file_.seekg(info_.pixel_offset);
+  next_row_ = 0;
+
+  return file_ ? BMP_OK : BMP_INVALID_FILE;
+}
+
+int BmpBandReader::ReadBand(Image &band, int rows) {
+  rows = std::min(rows, remaining_rows());
+  if (rows <= 0) {
+    return 0;
+  }
+
+  ProfileScope profile(ProfileStage::kRead);
+  PixelFormat format = FormatOf(info_);
+  if (band.width() != info_.width || band.height() != rows ||
+      band.format() != format) {
+    band = Image(info_.width, rows, format);
+  }
+
+  scratch_.resize(info_.row_bytes * rows);
+  if (!file_.read(reinterpret_cast<char *>(scratch_.data()),
+                  scratch_.size())) {
+    return 0;
+  }
+  profile.Count(static_cast<int64_t>(info_.width) * rows,
+                static_cast<int64_t>(scratch_.size()));
+
+  int width = info_.width;
+  int step = band.pixel_step();
+  bool paletted = info_.bits_per_pixel <= 8;
+  // BGRA bands and the gray ramp ones have the same bytes as the file.
+  bool same_bytes = paletted ? IsGrayRamp(info_)
+                             : format == PixelFormat::kBGRA32;
+
+  if (paletted) {
+    indices_.resize(width);
+  }
+
+  for (int y = 0; y < rows; y++) {
+    const byte *src = scratch_.data() + y * info_.row_bytes;
+
+    if (same_bytes) {
+      memcpy(band.row(y), src, static_cast<size_t>(width) * step);
+      continue;
+    }
+
+    byte *red = band.channel_row(kRed, y);
+    byte *green = band.channel_row(kGreen, y);
+    byte *blue = band.channel_row(kBlue, y);
+
+    if (paletted) {
+      UnpackIndices(src, width, info_.bits_per_pixel, indices_.data());
+
+      // The three channels of a gray band are the same sample.
+      for (int x = 0; x < width; x++) {
+        const RGBColor &color = info_.palette[indices_[x]];
+        red[x * step] = color.r;
+        green[x * step] = color.g;
+        blue[x * step] = color.b;
+      }
+    } else {
+      for (int x = 0; x < width; x++) {
+        red[x * step] = src[3 * x + 2];
+        green[x * step] = src[3 * x + 1];
+        blue[x * step] = src[3 * x];
+      }
+    }
+  }
+
+  next_row_ += rows;
+  return rows;
+}
+
+BmpError BmpBandReader::ReadImage(Image &img) {
+  int rows = remaining_rows();
+  if (rows <= 0) {
+    return BMP_INVALID_FILE;
+  }
+
+  // The rows of bottom-up files come last row first, so they are read into a
+  // view that walks @p img backwards.
+  Image view =
+      info_.bottom_up
+          ? Image::Wrap(img.row(rows - 1), img.width(), rows, -img.stride(),
+                        img.format())
+          : Image::Wrap(img.row(0), img.width(), rows, img.stride(),
+                        img.format());
+
+  return ReadBand(view, rows) == rows ? BMP_OK : BMP_INVALID_FILE;
+}
+
+BmpError BmpBandWriter::Open(const std::string &filename, int width,
+                             int height, bool bottom_up, PixelFormat format,
+                             BilevelPacking packing) {
+  if (!FitsBmp(width, height, format, packing)) {
+    return BMP_ERROR;
+  }
+
+  file_.open(filename, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  return Start(width, height, bottom_up, format, packing);
+}
+
+BmpError BmpBandWriter::Open(std::vector<byte> &bytes, int width, int height,
+                             bool bottom_up, PixelFormat format,
+                             BilevelPacking packing) {
+  if (!FitsBmp(width, height, format, packing)) {
+    return BMP_ERROR;
+  }
+
+  bytes_ = &bytes;
+  bytes.clear();
+
+  return Start(width, height, bottom_up, format, packing);
+}
+
+BmpError BmpBandWriter::Start(int width, int height, bool bottom_up,
+                              PixelFormat format, BilevelPacking packing) {
+  width_ = width;
+  format_ = format;
+  packing_ = packing;
+
+  std::vector<byte> header(HeadersSize(format, packing));
+  WriteHeaders(header.data(), width, height, bottom_up, format, packing);
+
+  return Emit(header.data(), header.size());
+}
+
+BmpError BmpBandWriter::Emit(const byte *data, size_t size) {
+  if (bytes_ != nullptr) {
+    bytes_->insert(bytes_->end(), data, data + size);
+    return BMP_OK;
+  }
+
+  file_.write(reinterpret_cast<const char *>(data), size);
+
+  return file_ ? BMP_OK : BMP_ERROR;
+}
+
+BmpError BmpBandWriter::WriteBand(const Image &band) {
+  ProfileScope profile(ProfileStage::kWrite);
+  int bytes = BytesPerPixel(format_);
+  size_t row_bytes = PaddedRowBytes(width_, BitsPerPixel(format_, packing_));
+  bool same_format = band.format() == format_ &&
+                     band.layout() == PixelLayout::kInterleaved &&
+                     format_ != PixelFormat::kRGB24;
+  int step = band.pixel_step();
+
+  scratch_.assign(row_bytes * band.height(), 0);
+  if (packing_ == BilevelPacking::k1bpp && step != 1) {
+    samples_.resize(width_);
+  }
+
+  for (int y = 0; y < band.height(); y++) {
+    byte *dst = scratch_.data() + y * row_bytes;
+    const byte *red = band.channel_row(kRed, y);
+    const byte *green = band.channel_row(kGreen, y);
+    const byte *blue = band.channel_row(kBlue, y);
+
+    if (packing_ == BilevelPacking::k1bpp) {
+      const byte *samples = red;
+      if (step != 1) {
+        for (int x = 0; x < width_; x++) {
+          samples_[x] = red[x * step];
+        }
+        samples = samples_.data();
+      }
+
+      PackBits(samples, width_, dst);
+      continue;
+    }
+
+    if (packing_ == BilevelPacking::k4bpp) {
+      // The index bits are R, G and B, see @see PaletteColor .
+      for (int x = 0; x < width_; x++) {
+        int index = (red[x * step] >> 7) << 2 | (green[x * step] >> 7) << 1 |
+                    blue[x * step] >> 7;
+        dst[x >> 1] |= static_cast<byte>(index << ((x & 1) ? 0 : 4));
+      }
+      continue;
+    }
+
+    if (same_format) {
+      memcpy(dst, band.row(y), static_cast<size_t>(width_) * bytes);
+      continue;
+    }
+
+    for (int x = 0; x < width_; x++) {
+      RGBColor color = {.r = red[x * step],
+                        .g = green[x * step],
+                        .b = blue[x * step]};
+
+      if (format_ == PixelFormat::kGray8) {
+        dst[x] = Luma(color);
+        continue;
+      }
+
+      dst[bytes * x] = color.b;
+      dst[bytes * x + 1] = color.g;
+      dst[bytes * x + 2] = color.r;
+      if (format_ == PixelFormat::kBGRA32) {
+        dst[bytes * x + BGRA32::kAlphaByte] = 255;
+      }
+    }
+  }
+
+  profile.Count(static_cast<int64_t>(width_) * band.height(),
+                static_cast<int64_t>(scratch_.size()));
+  return Emit(scratch_.data(), scratch_.size());
+}
+
+size_t BmpFileSize(int width, int height, PixelFormat format) {
+  return HeadersSize(format) +
+         PaddedRowBytes(width, BitsPerPixel(format)) * height;
+}
+
+BmpError ReadFileBytes(const std::string &filename, std::vector<byte> &bytes) {
+  ProfileScope profile(ProfileStage::kRead);
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  // Not ftell, whose long is 32 bits on Windows.
+  std::error_code error;
+  uintmax_t size = std::filesystem::file_size(filename, error);
+  bool read = !error && size <= SIZE_MAX;
+  if (read) {
+    bytes.resize(static_cast<size_t>(size));
+    read = fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    profile.Count(0, static_cast<int64_t>(size));
+  }
+  fclose(file);
+
+  return read ? BMP_OK : BMP_INVALID_FILE;
+}
+
+BmpError WriteFileBytes(const std::string &filename,
+                        const std::vector<byte> &bytes) {
+  ProfileScope profile(ProfileStage::kWrite);
+  profile.Count(0, static_cast<int64_t>(bytes.size()));
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  written = fclose(file) == 0 && written;
+
+  return written ? BMP_OK : BMP_ERROR;
+}
+
+BmpError MappedBmp::Open(const std::string &filename) {
+  if (!file_.Open(filename, MappedFile::Mode::kCopyOnWrite)) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  return Open(file_.data(), file_.size());
+}
+
+BmpError MappedBmp::Open(byte *data, size_t size) {
+  data_ = data;
+  size_ = size;
+
+  uint32_t palette_offset = 0;
+  uint32_t colors = 0;
+  if (size_ < kHeadersSize ||
+      ParseHeaders(data_, size_, info_, palette_offset, colors) != BMP_OK) {
+    return BMP_INVALID_FILE;
+  }
+
+  if (colors > 0) {
+    if (palette_offset + 4 * colors > size_) {
+      return BMP_INVALID_FILE;
+    }
+
+    ParsePalette(data_ + palette_offset, colors, info_);
+  }
+
+  // Only the indices of the gray ramp are the samples they stand for.
+  if (info_.bits_per_pixel <= 8 && !IsGrayRamp(info_)) {
+    return BMP_INVALID_FILE;
+  }
+
+  return WrapPixels();
+}
+
+BmpError MappedBmp::Create(const std::string &filename, int width,
+                           int height, PixelFormat format) {
+  if (!FitsBmp(width, height, format)) {
+    return BMP_ERROR;
+  }
+
+  if (!file_.Create(filename, BmpFileSize(width, height, format))) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  return Format(file_.data(), file_.size(), width, height, format);
+}
+
+BmpError MappedBmp::Create(std::vector<byte> &bytes, int width, int height,
+                           PixelFormat format) {
+  if (!FitsBmp(width, height, format)) {
+    return BMP_ERROR;
+  }
+
+  // Zeroed again when reused, the row padding is never written otherwise.
+  bytes.assign(BmpFileSize(width, height, format), 0);
+
+  return Format(bytes.data(), bytes.size(), width, height, format);
+}
+
+BmpError MappedBmp::Format(byte *data, size_t size, int width, int height,
+                           PixelFormat format) {
+  data_ = data;
+  size_ = size;
+
+  WriteHeaders(data_, width, height, true, format);
+
+  uint32_t palette_offset = 0;
+  uint32_t colors = 0;
+  ParseHeaders(data_, size_, info_, palette_offset, colors);
+  if (colors > 0) {
+    ParsePalette(data_ + palette_offset, colors, info_);
+  }
+
+  BmpError error = WrapPixels();
+  if (error != BMP_OK || format != PixelFormat::kBGRA32) {
+    return error;
+  }
+
+  // The new pixels start opaque, like the ones of a new BGRA32 image.
+  for (int y = 0; y < height; y++) {
+    byte *row = image_.row(y);
+    for (int x = 0; x < width; x++) {
+      row[4 * x + BGRA32::kAlphaByte] = 255;
+    }
+  }
+
+  return BMP_OK;
+}
+
+BmpError MappedBmp::WrapPixels() {
+  if (info_.pixel_offset + info_.row_bytes * info_.height > size_) {
+    return BMP_INVALID_FILE;
+  }
+
+  byte *pixels = data_ + info_.pixel_offset;
+  ptrdiff_t stride = static_cast<ptrdiff_t>(info_.row_bytes);
+
+  if (info_.bottom_up) {
+    pixels += (info_.height - 1) * info_.row_bytes;
+    stride = -stride;
+  }
+
+  PixelFormat format = FormatOf(info_);
+  if (format == PixelFormat::kRGB24) {
+    image_ = Image::WrapInterleaved(pixels, info_.width, info_.height, stride,
+                                    ChannelOrder::kBGR);
+  } else {
+    image_ = Image::Wrap(pixels, info_.width, info_.height, stride, format);
+  }
+
+  return BMP_OK;
+}
@@ -0,0 +1,230 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <array>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "libbmp.h"
+#include "mapped_file.h"
+
+/// Largest BMP file: the headers store the sizes in 32 bits, so bigger images
+/// go to tiled files, see tiled_image.h.
+const uint64_t kMaxBmpFileSize = UINT32_MAX;
+
+/// @brief Copies the pixels of a loaded bitmap @p bmp into an @see Image .
+/// This is meant to be done once, right after reading the file.
+/// @param bmp The bitmap read by libbmp
+/// @param layout The layout of the samples on the returned image
+/// @return A new @see Image with the same pixels of @p bmp
+Image ImageFromBmp(BmpImg &bmp,
+                   PixelLayout layout = PixelLayout::kInterleaved);
+
+/// @brief Copies the pixels of a loaded bitmap @p bmp into an existing
+/// @p img of the same size, like a view of a @see ScratchArena .
+/// @param bmp The bitmap read by libbmp
+/// @param img [out] An image with the same dimensions of @p bmp
+void CopyFromBmp(BmpImg &bmp, Image &img);
+
+/// @brief Copies the pixels of @p img back into an already sized bitmap
+/// @p bmp , keeping its headers.
+/// @param img The image to be copied
+/// @param bmp [out] A bitmap with the same dimensions of @p img
+void CopyToBmp(const Image &img, BmpImg &bmp);
+
+/// @brief Copies the pixels of @p img into a new bitmap, ready to be written.
+/// @param img The image to be converted
+/// @return A bitmap with the same size and pixels of @p img
+BmpImg BmpFromImage(const Image &img);
+
+/// @brief The layout of the pixel array of a BMP file, as described by its
+/// BITMAPFILEHEADER and BITMAPINFOHEADER.
+struct BmpInfo {
+  int width = 0;
+  int height = 0;
+  int bits_per_pixel = 0;
+  /// Rows are stored from the bottom of the image up to the top.
+  bool bottom_up = true;
+  /// Offset of the pixel array from the start of the file.
+  uint32_t pixel_offset = 0;
+  /// Bytes of one row on the file, padding to 4 bytes included.
+  size_t row_bytes = 0;
+  /// The color table of paletted (1, 4 and 8bpp) files, black past the colors
+  /// of the file. Kept inline so reading the headers never allocates.
+  std::array<RGBColor, 256> palette{};
+};
+
+/// @brief The format the pixels of a file described by @p info are kept in:
+/// kBGRA32 for 32bpp files, kGray8 for paletted files whose colors are all
+/// gray and kRGB24 for everything else.
+PixelFormat FormatOf(const BmpInfo &info);
+
+/// @brief How a writer packs images whose samples are all 0 or 255, like the
+/// results of the binarization methods.
+enum class BilevelPacking {
+  /// The pixels are written in the format of the image
+  kNone = 0,
+  /// 1bpp with a black and white palette
+  k1bpp,
+  /// 4bpp with a palette of the 8 colors whose channels are 0 or 255, for
+  /// images binarized on each channel
+  k4bpp
+};
+
+/// @brief The smallest @see BilevelPacking that keeps the pixels of @p img :
+/// k1bpp when every pixel is black or white, k4bpp when every sample is 0 or
+/// 255 and kNone otherwise (and for BGRA32 images, whose alpha would be
+/// lost). Stops reading at the first sample that is neither 0 nor 255.
+/// @param img An interleaved image
+BilevelPacking BilevelPackingOf(const Image &img);
+
+/// @brief Reads the pixel array of a BMP file of 32, 24, 8, 4 or 1bpp in bands
+/// of rows, so huge files can be processed without loading them whole. Bands
+/// come in file order, that is bottom-up for most files, which does not
+/// matter for point operations.
+class BmpBandReader {
+public:
+  /// @brief Opens @p filename and parses its headers.
+  /// @return BMP_OK or the reason the file can not be streamed
+  BmpError Open(const std::string &filename);
+
+  const BmpInfo &info() const { return info_; }
+
+  /// @brief The number of rows not read yet.
+  int remaining_rows() const { return info_.height - next_row_; }
+
+  /// @brief Reads the next @p rows rows of the file (less on the last band)
+  /// into @p band , reallocating it only when its size changes.
+  /// @param band [out] Receives the rows in the @see FormatOf the file,
+  /// paletted files are expanded to their colors
+  /// @param rows The maximum number of rows to read
+  /// @return The number of rows read, 0 once the file is over or on a read
+  /// error
+  int ReadBand(Image &band, int rows);
+
+  /// @brief Reads every row of the file, right after @see Open , into
+  /// @p img with the top row of the image first.
+  /// @param img [out] An interleaved image of the size and the @see FormatOf
+  /// the file, in RGB order for kRGB24
+  BmpError ReadImage(Image &img);
+
+private:
+  std::ifstream file_;
+  BmpInfo info_;
+  int next_row_ = 0;
+  std::vector<byte> scratch_;
+  /// The palette indices of one row of a paletted file.
+  std::vector<byte> indices_;
+};
+
+/// @brief Writes a BMP file one band of rows at a time. The bands must be
+/// given in file order, as produced by @see BmpBandReader .
+class BmpBandWriter {
+public:
+  /// @brief Creates @p filename and writes the headers of a @p width x
+  /// @p height image whose rows will come in the order given by
+  /// @p bottom_up .
+  /// @param format kRGB24 writes a 24bpp file, kGray8 an 8bpp file with a
+  /// gray palette and kBGRA32 a 32bpp file
+  /// @param packing When not kNone, the format of the file instead of
+  /// @p format . Every sample given to @see WriteBand must be 0 or 255 then
+  /// (and a single color for k1bpp, the red channel is the one written).
+  /// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_ERROR for files bigger than
+  /// @see kMaxBmpFileSize
+  BmpError Open(const std::string &filename, int width, int height,
+                bool bottom_up = true,
+                PixelFormat format = PixelFormat::kRGB24,
+                BilevelPacking packing = BilevelPacking::kNone);
+
+  /// @brief Like the other @see Open , appending the file to @p bytes
+  /// (cleared first) instead of writing it. @p bytes must outlive the writer.
+  BmpError Open(std::vector<byte> &bytes, int width, int height,
+                bool bottom_up = true,
+                PixelFormat format = PixelFormat::kRGB24,
+                BilevelPacking packing = BilevelPacking::kNone);
+
+  /// @brief Appends all the rows of @p band to the pixel array.
+  BmpError WriteBand(const Image &band);
+
+private:
+  BmpError Start(int width, int height, bool bottom_up, PixelFormat format,
+                 BilevelPacking packing);
+  BmpError Emit(const byte *data, size_t size);
+
+  std::ofstream file_;
+  /// Where the file goes instead of @see file_ , when set.
+  std::vector<byte> *bytes_ = nullptr;
+  int width_ = 0;
+  PixelFormat format_ = PixelFormat::kRGB24;
+  BilevelPacking packing_ = BilevelPacking::kNone;
+  std::vector<byte> scratch_;
+  /// The samples of one row gathered for @see PackBits .
+  std::vector<byte> samples_;
+};
+
+/// @brief The bytes of a BMP file of @p format as written by
+/// @see MappedBmp::Create .
+size_t BmpFileSize(int width, int height, PixelFormat format);
+
+/// @brief Reads the whole @p filename into @p bytes , reusing its capacity.
+/// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_INVALID_FILE if it could not be
+/// read
+BmpError ReadFileBytes(const std::string &filename, std::vector<byte> &bytes);
+
+/// @brief Writes @p bytes as the whole @p filename .
+/// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_ERROR if it could not be written
+BmpError WriteFileBytes(const std::string &filename,
+                        const std::vector<byte> &bytes);
+
+/// @brief A BMP file mapped in memory, or already loaded in a buffer. Its
+/// pixel array is exposed in place as an @see Image view (BGR for 24bpp
+/// files, gray for 8bpp files with a gray palette and BGRA for 32bpp files),
+/// with the row padding and the bottom-up order handled by the view stride,
+/// so nothing is copied on load.
+class MappedBmp {
+public:
+  /// @brief Maps @p filename copy-on-write: kernels may change @see image
+  /// without touching the file.
+  /// @return BMP_OK, or BMP_INVALID_FILE for files whose pixels can not be
+  /// viewed in place (paletted files other than 8bpp with the gray ramp)
+  BmpError Open(const std::string &filename);
+
+  /// @brief Views the BMP file held by the @p size bytes of @p data , which
+  /// must outlive this object. Kernels change @p data through @see image .
+  BmpError Open(byte *data, size_t size);
+
+  /// @brief Creates @p filename as a @p width x @p height BMP of @p format
+  /// (see @see BmpBandWriter::Open ) with its headers written and maps it for
+  /// writing. Whatever is stored on @see image is on the file once this
+  /// object is destroyed. Files bigger than @see kMaxBmpFileSize are refused
+  /// with BMP_ERROR.
+  BmpError Create(const std::string &filename, int width, int height,
+                  PixelFormat format = PixelFormat::kRGB24);
+
+  /// @brief Like the other @see Create , building the file in @p bytes
+  /// (resized to @see BmpFileSize ) instead. @p bytes must outlive this
+  /// object and not be resized while it is used.
+  BmpError Create(std::vector<byte> &bytes, int width, int height,
+                  PixelFormat format = PixelFormat::kRGB24);
+
+  const BmpInfo &info() const { return info_; }
+  Image &image() { return image_; }
+
+private:
+  /// @brief Writes the headers of a new file on @p data and views it.
+  BmpError Format(byte *data, size_t size, int width, int height,
+                  PixelFormat format);
+  BmpError WrapPixels();
+
+  MappedFile file_;
+  /// The file, in @see file_ or in a buffer of someone else.
+  byte *data_ = nullptr;
+  size_t size_ = 0;
+  BmpInfo info_;
+  Image image_;
+};
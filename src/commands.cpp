@@ -0,0 +1,1153 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "commands.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <numeric>
+#include <sstream>
+
+#include <fmt/format.h>
+
+#include "filter.h"
+#include "histogram_cache.h"
+#include "image_codec.h"
+#include "morphology.h"
+#include "processing.h"
+#include "profiler.h"
+#include "tiled_image.h"
+
+namespace {
+
+bool NeedsHistogram(Command command) {
+  return command == Command::kHistogram ||
+         command == Command::kEqualization || command == Command::kTwoPeaks ||
+         command == Command::kMultiOtsu;
+}
+
+/// @brief The morphology commands, see morphology.h
+bool IsMorphology(Command command) {
+  return command == Command::kErode || command == Command::kDilate ||
+         command == Command::kOpen || command == Command::kClose;
+}
+
+/// @brief The filter commands, see filter.h
+bool IsFilter(Command command) {
+  return command == Command::kBlur || command == Command::kBoxBlur ||
+         command == Command::kSharpen || command == Command::kConvolve;
+}
+
+/// @brief Commands that can not be written as a table of the histogram,
+/// either because they look at the neighbours of a pixel or because they mix
+/// its channels.
+bool IsPixelStage(Command command) {
+  return command == Command::kLocalEqualization ||
+         command == Command::kLumaEqualization ||
+         command == Command::kTwoPeaksLuma || command == Command::kOtsu ||
+         IsMorphology(command) || IsFilter(command) ||
+         command == Command::kComponents || command == Command::kLabels;
+}
+
+/// @brief How many morphology commands @p pipeline starts with.
+size_t MorphologyRun(PipelineSpan pipeline) {
+  return static_cast<size_t>(
+      std::find_if_not(pipeline.begin(), pipeline.end(), IsMorphology) -
+      pipeline.begin());
+}
+
+/// @brief A zeroed image of the size, format and layout of @p img , taken
+/// from @p arena when given and interleaved.
+Image BlankLike(const Image &img, ScratchArena *arena) {
+  if (img.layout() == PixelLayout::kPlanar) {
+    return Image(img.width(), img.height(), PixelLayout::kPlanar);
+  }
+
+  return arena != nullptr
+             ? arena->AllocateImage(img.width(), img.height(), img.format())
+             : Image(img.width(), img.height(), img.format());
+}
+
+/// @brief Gives @p img pixels of its own if they are @see Image::shared ,
+/// like @see Image::MakeWritable taking them from @p arena .
+void MakeWritable(Image &img, ScratchArena *arena) {
+  if (!img.shared()) {
+    return;
+  }
+
+  Image copy = BlankLike(img, arena);
+  CopyPixels(img, copy);
+  img = std::move(copy);
+}
+
+/// @brief Runs the filter @p command on @p img with the
+/// @see GetFilterSettings , replacing it by the filtered image.
+void RunFilter(Command command, Image &img, ScratchArena *arena) {
+  const FilterSettings &settings = GetFilterSettings();
+  Image result = BlankLike(img, arena);
+
+  switch (command) {
+    using enum Command;
+
+  case kBlur: {
+    SeparableFilter(img, result, GaussianKernel(settings.blur_sigma),
+                    settings.border);
+  } break;
+
+  case kBoxBlur: {
+    BoxFilter(img, result, settings.box_radius, settings.border);
+  } break;
+
+  case kSharpen: {
+    Convolve(img, result, SharpenKernel(), settings.border);
+  } break;
+
+  default: {
+    Convolve(img, result, settings.kernel, settings.border);
+  } break;
+  }
+
+  img = std::move(result);
+}
+
+/// @brief Runs a command for which @see IsPixelStage is true on @p img . The
+/// luma commands replace @p img by a gray image, the filters by the filtered
+/// one and the labels command by the painted components, taken from
+/// @p arena when given.
+void RunPixelStage(Command command, Image &img, ScratchArena *arena) {
+  if (RunsInPlace(command)) {
+    MakeWritable(img, arena);
+  }
+
+  switch (command) {
+    using enum Command;
+
+  case kLocalEqualization: {
+    EqualizeLocal(img);
+  } break;
+
+  case kLumaEqualization: {
+    EqualizeLuma(img);
+  } break;
+
+  case kTwoPeaksLuma: {
+    TwoPeaksLuma(img, arena);
+  } break;
+
+  case kOtsu: {
+    OtsuLuma(img, arena);
+  } break;
+
+  case kBlur:
+  case kBoxBlur:
+  case kSharpen:
+  case kConvolve: {
+    RunFilter(command, img, arena);
+  } break;
+
+  case kLabels: {
+    Image labeled;
+    LabelComponents(img, &labeled, arena);
+    img = std::move(labeled);
+  } break;
+
+  default:
+    break;
+  }
+}
+
+/// @brief The table @p command applies on an image with @p histogram .
+LUT3 CommandLUT(Command command, const RGBHistogram &histogram) {
+  switch (command) {
+    using enum Command;
+
+  case kEqualization:
+    return EqualizationLUT(histogram);
+
+  case kCutout:
+    return CutoutLUT();
+
+  case kTwoPeaks:
+    return TwoPeaksLUT(histogram);
+
+  case kMultiOtsu:
+    return MultiOtsuLUT(histogram);
+
+  default:
+    return IdentityLUT();
+  }
+}
+
+/// @brief @see SampleHistogram with the @see GetHistogramSampleStep , which
+/// counts every pixel unless --approx was given, profiled as
+/// @see ProfileStage::kHistogram . Goes through the histogram cache when it
+/// is open: hashing the pixels costs a fraction of counting them.
+RGBHistogram ProfiledHistogram(const Image &img) {
+  ProfileScope profile(ProfileStage::kHistogram);
+  profile.Count(static_cast<int64_t>(img.width()) * img.height(), 0);
+
+  RGBHistogram histogram{};
+  uint64_t key = 0;
+  if (HistogramCacheEnabled()) {
+    key = ImageHistogramKey(img);
+    if (LookupHistogram(key, histogram)) {
+      return histogram;
+    }
+  }
+
+  histogram = SampleHistogram(img, GetHistogramSampleStep());
+  if (HistogramCacheEnabled()) {
+    StoreHistogram(key, histogram);
+  }
+
+  return histogram;
+}
+
+/// @brief @see StreamHistogram through the histogram cache when it is open,
+/// keyed by the path, size and modification time of the file (see
+/// @see FileHistogramKey ).
+BmpError CachedStreamHistogram(const std::string &input_bmp, int band_rows,
+                               RGBHistogram &histogram,
+                               PipelineStats *stats = nullptr) {
+  uint64_t key = 0;
+  bool cached = HistogramCacheEnabled() && FileHistogramKey(input_bmp, key);
+  if (cached && LookupHistogram(key, histogram)) {
+    return BMP_OK;
+  }
+
+  BmpError error = StreamHistogram(input_bmp, band_rows, histogram, stats);
+  if (cached && error == BMP_OK) {
+    StoreHistogram(key, histogram);
+  }
+
+  return error;
+}
+
+/// @brief The histogram of the tiled @p tiled , the sum of the
+/// @see ProfiledHistogram of its tiles.
+RGBHistogram TiledHistogram(TiledImage &tiled) {
+  RGBHistogram histogram{};
+
+  for (int64_t t = 0; t < tiled.info().tiles(); t++) {
+    RGBHistogram counts = ProfiledHistogram(tiled.tile(t));
+    for (int i = 0; i < 256; i++) {
+      histogram.red[i] += counts.red[i];
+      histogram.green[i] += counts.green[i];
+      histogram.blue[i] += counts.blue[i];
+    }
+  }
+
+  return histogram;
+}
+
+/// @brief @see ApplyChannelLUT , profiled as @see ProfileStage::kApply . A
+/// @see Image::shared @p img is replaced by a new image of @p arena , written
+/// by the same pass that reads it.
+void ProfiledApply(Image &img, const LUT3 &lut,
+                   ScratchArena *arena = nullptr) {
+  ProfileScope profile(ProfileStage::kApply);
+  profile.Count(static_cast<int64_t>(img.width()) * img.height(), 0);
+
+  if (!img.shared()) {
+    ApplyChannelLUT(img, lut);
+    return;
+  }
+
+  Image result = BlankLike(img, arena);
+  ApplyChannelLUT(img, result, lut);
+  img = std::move(result);
+}
+
+/// @brief Runs the morphology commands of @p commands on @p img while its
+/// channels are packed, see @see Morphology . With @p lut , the bilevel
+/// tables pending on @p img are applied by the packing instead of a pass of
+/// their own. A @see Image::shared @p img is replaced by a new image of
+/// @p arena .
+void RunMorphology(Image &img, PipelineSpan commands, const LUT3 *lut,
+                   ScratchArena *arena) {
+  // Taken before the scope below, which gives back what it takes.
+  bool shared = img.shared();
+  Image result = shared ? BlankLike(img, arena) : Image();
+
+  ScratchScope scope(GetProcessingContext().arena());
+  MorphologyOp *ops = scope.arena().Allocate<MorphologyOp>(commands.size());
+
+  for (size_t i = 0; i < commands.size(); i++) {
+    switch (commands[i]) {
+      using enum Command;
+
+    case kErode: {
+      ops[i] = MorphologyOp::kErode;
+    } break;
+
+    case kDilate: {
+      ops[i] = MorphologyOp::kDilate;
+    } break;
+
+    case kOpen: {
+      ops[i] = MorphologyOp::kOpen;
+    } break;
+
+    default: {
+      ops[i] = MorphologyOp::kClose;
+    } break;
+    }
+  }
+
+  std::span<const MorphologyOp> run(ops, commands.size());
+  if (!shared) {
+    Morphology(img, img, run, GetStructuringElement(), lut);
+    return;
+  }
+
+  Morphology(img, result, run, GetStructuringElement(), lut);
+  img = std::move(result);
+}
+
+/// @brief The image a run in @p mode processes: @p img itself in place, or
+/// a copy-on-write @see Image::Share of it left on @p copy .
+Image &ProcessedImage(Image &img, Image &copy, ExecutionMode mode) {
+  if (mode == ExecutionMode::kInPlace) {
+    return img;
+  }
+
+  copy = img.Share();
+  return copy;
+}
+
+/// @brief Where a run leaves its result: the file @see path , or the buffer
+/// @see bytes when it is set, for someone else to store.
+struct Output {
+  const std::string &path;
+  std::vector<byte> *bytes = nullptr;
+  /// The type of the file built on @see bytes , paths go by their extension.
+  ImageFileType type = ImageFileType::kBmp;
+};
+
+/// @brief The type of the file @p output receives.
+ImageFileType OutputType(const Output &output) {
+  return output.bytes != nullptr ? output.type : ImageFileTypeOf(output.path);
+}
+
+/// @brief Whether @p output is a tiled file, see tiled_image.h.
+bool IsTiledOutput(const Output &output) {
+  return output.bytes == nullptr && IsTiledImageFile(output.path);
+}
+
+/// @brief Creates the BMP @p bmp of @p output , mapped or in its buffer.
+BmpError CreateOutput(MappedBmp &bmp, const Output &output, int width,
+                      int height, PixelFormat format) {
+  return output.bytes != nullptr
+             ? bmp.Create(*output.bytes, width, height, format)
+             : bmp.Create(output.path, width, height, format);
+}
+
+/// @brief Writes @p img on @p output in its own format through a mapping,
+/// which unlike a BmpImg needs no pixel buffer. With @p pack_bilevel ,
+/// images whose samples are all 0 or 255 are packed instead, see
+/// @see BilevelPackingOf .
+BmpError WriteImage(const Image &img, const Output &output,
+                    bool pack_bilevel) {
+  if (IsTiledOutput(output)) {
+    return WriteTiledImage(img, output.path);
+  }
+
+  ProfileScope profile(ProfileStage::kWrite);
+
+  ImageFileType type = OutputType(output);
+  if (type != ImageFileType::kBmp) {
+    std::vector<byte> encoded;
+    std::vector<byte> &bytes =
+        output.bytes != nullptr ? *output.bytes : encoded;
+    if (!EncodeImage(img, type, bytes)) {
+      return BMP_ERROR;
+    }
+
+    return output.bytes != nullptr ? BMP_OK
+                                   : WriteFileBytes(output.path, bytes);
+  }
+
+  BilevelPacking packing =
+      pack_bilevel ? BilevelPackingOf(img) : BilevelPacking::kNone;
+
+  if (packing != BilevelPacking::kNone) {
+    // The packed rows are a few bytes each, written top-down in one band.
+    BmpBandWriter writer;
+    BmpError error =
+        output.bytes != nullptr
+            ? writer.Open(*output.bytes, img.width(), img.height(), false,
+                          img.format(), packing)
+            : writer.Open(output.path, img.width(), img.height(), false,
+                          img.format(), packing);
+
+    return error == BMP_OK ? writer.WriteBand(img) : error;
+  }
+
+  if (BmpFileSize(img.width(), img.height(), img.format()) >
+      kMaxBmpFileSize) {
+    fmt::print("A {}x{} image does not fit in a BMP file, write it as a .pdt "
+               "file instead\n",
+               img.width(), img.height());
+    return BMP_ERROR;
+  }
+
+  MappedBmp bmp;
+
+  BmpError error =
+      CreateOutput(bmp, output, img.width(), img.height(), img.format());
+  if (error == BMP_OK) {
+    CopyPixels(img, bmp.image());
+    profile.Count(static_cast<int64_t>(img.width()) * img.height(),
+                  static_cast<int64_t>(BmpFileSize(img.width(), img.height(),
+                                                   img.format())));
+  }
+
+  return error;
+}
+
+/// @brief Writes the result of a chain that ended up rendering a histogram,
+/// either as a BMP of @see FoldedPipeline::image or as the counts, when the
+/// histogram was not rasterized, or of a chain that ended measuring its
+/// components, as their table.
+BmpError WriteRendered(const FoldedPipeline &folded, const Output &output,
+                       HistogramFormat format, bool pack_bilevel) {
+  if (folded.measured) {
+    ProfileScope profile(ProfileStage::kWrite);
+
+    if (output.bytes != nullptr) {
+      EncodeComponents(folded.components, format, *output.bytes);
+      return BMP_OK;
+    }
+
+    return WriteComponents(output.path, folded.components, format);
+  }
+
+  if (!folded.image.empty()) {
+    return WriteImage(folded.image, output, pack_bilevel);
+  }
+
+  ProfileScope profile(ProfileStage::kWrite);
+
+  if (output.bytes != nullptr) {
+    return EncodeHistogram(folded.histogram, format, *output.bytes)
+               ? BMP_OK
+               : BMP_ERROR;
+  }
+
+  return WriteHistogram(output.path, folded.histogram, format);
+}
+
+/// @brief Runs @p pipeline on the BMP @p input_bmp without loading it whole,
+/// reading and writing @p band_rows rows at a time. Chains that need a
+/// histogram do a streaming histogram pass before the streaming table pass.
+/// Both passes run on stages when @p stats is given, see streaming.h . A
+/// given @p histogram saves the histogram pass.
+BmpError RunStreaming(const Pipeline &pipeline, const std::string &input_bmp,
+                      const std::string &output_bmp, int band_rows,
+                      HistogramFormat format, bool pack_bilevel,
+                      const RGBHistogram *histogram, PipelineStats *stats) {
+  BmpError error = BMP_OK;
+
+  FoldedPipeline folded = FoldPipeline(
+      pipeline,
+      [&] {
+        if (histogram != nullptr) {
+          return *histogram;
+        }
+
+        RGBHistogram counted{};
+        error = CachedStreamHistogram(input_bmp, band_rows, counted, stats);
+        return counted;
+      },
+      format == HistogramFormat::kImage, &GetProcessingContext().arena());
+
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  if (folded.rendered) {
+    return WriteRendered(folded, Output{output_bmp}, format, pack_bilevel);
+  }
+
+  return StreamApplyLUT(input_bmp, output_bmp, folded.lut, band_rows,
+                        pack_bilevel, stats);
+}
+
+/// @brief Runs @p pipeline on the mapped BMP @p input , writing the result
+/// straight into a mapped @p output . The tables read the input mapping and
+/// write the output one in a single pass. Chains that need the pixels run on
+/// the input in @p mode .
+BmpError RunMapped(const Pipeline &pipeline, MappedBmp &input,
+                   const Output &output, HistogramFormat format,
+                   bool pack_bilevel, const RGBHistogram *histogram,
+                   ExecutionMode mode) {
+  MappedBmp result;
+  const BmpInfo &info = input.info();
+  ScratchArena &arena = GetProcessingContext().arena();
+  Image copy;
+
+  if (NeedsPixels(pipeline)) {
+    // The input is mapped copy-on-write, so it can be processed in place.
+    Image &img = ProcessedImage(input.image(), copy, mode);
+    FoldedPipeline folded =
+        RunPipeline(img, pipeline, format == HistogramFormat::kImage, &arena,
+                    histogram);
+    if (folded.rendered) {
+      return WriteRendered(folded, output, format, pack_bilevel);
+    }
+
+    // The luma commands leave a gray image, written in that format.
+    return WriteImage(img, output, pack_bilevel);
+  }
+
+  FoldedPipeline folded = FoldPipeline(
+      pipeline,
+      [&] {
+        return histogram != nullptr ? *histogram
+                                    : ProfiledHistogram(input.image());
+      },
+      format == HistogramFormat::kImage, &arena);
+
+  if (folded.rendered) {
+    return WriteRendered(folded, output, format, pack_bilevel);
+  }
+
+  // Packed and encoded files have no pixel array to map, the table is
+  // applied in place.
+  bool packed = pack_bilevel && IsBilevelLUT(folded.lut);
+  if (packed || OutputType(output) != ImageFileType::kBmp ||
+      IsTiledOutput(output)) {
+    Image &img = ProcessedImage(input.image(), copy, mode);
+    ProfiledApply(img, folded.lut, &arena);
+    return WriteImage(img, output, packed);
+  }
+
+  int64_t pixels = static_cast<int64_t>(info.width) * info.height;
+  {
+    ProfileScope profile(ProfileStage::kWrite);
+    BmpError error = CreateOutput(result, output, info.width, info.height,
+                                  input.image().format());
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    profile.Count(pixels, static_cast<int64_t>(BmpFileSize(
+                              info.width, info.height,
+                              input.image().format())));
+  }
+
+  ProfileScope profile(ProfileStage::kApply);
+  profile.Count(pixels, 0);
+
+  ApplyChannelLUT(input.image(), result.image(), folded.lut);
+  return BMP_OK;
+}
+
+/// @brief Reads the paletted file @p input_bmp , which libbmp does not
+/// handle, into an image of the arena of the thread context.
+/// @param image [out] Receives the pixels, in the @see FormatOf the file
+/// @return BMP_OK, or BMP_INVALID_FILE when the file is not paletted
+BmpError LoadPaletted(const std::string &input_bmp, Image &image) {
+  BmpBandReader reader;
+  BmpError error = reader.Open(input_bmp);
+  if (error != BMP_OK || reader.info().bits_per_pixel > 8) {
+    return error == BMP_OK ? BMP_INVALID_FILE : error;
+  }
+
+  const BmpInfo &info = reader.info();
+  image = GetProcessingContext().arena().AllocateImage(
+      info.width, info.height, FormatOf(info));
+
+  return reader.ReadImage(image);
+}
+
+/// @brief Runs @p pipeline on @p image , already loaded, in @p mode and
+/// writes the result on @p output in the format it ends up in.
+BmpError RunOnImage(const Pipeline &pipeline, Image &image,
+                    const Output &output, HistogramFormat format,
+                    bool pack_bilevel, const RGBHistogram *histogram,
+                    ExecutionMode mode) {
+  Image copy;
+  Image &img = ProcessedImage(image, copy, mode);
+  FoldedPipeline folded =
+      RunPipeline(img, pipeline, format == HistogramFormat::kImage,
+                  &GetProcessingContext().arena(), histogram);
+
+  if (folded.rendered) {
+    return WriteRendered(folded, output, format, pack_bilevel);
+  }
+
+  return WriteImage(img, output, pack_bilevel);
+}
+
+/// @brief Runs @p pipeline loading @p input_bmp whole with libbmp, into the
+/// BmpImg and the arena of the thread context. Paletted files are read by a
+/// @see BmpBandReader and PNG, JPEG and TGA files decoded by a
+/// @see DecodedImage instead.
+BmpError RunLoaded(const Pipeline &pipeline, const std::string &input_bmp,
+                   const std::string &output_bmp, HistogramFormat format,
+                   bool pack_bilevel, const RGBHistogram *histogram,
+                   ExecutionMode mode, int64_t &pixels) {
+  ProcessingContext &context = GetProcessingContext();
+  BmpImg &input_image = context.bmp();
+  Image image;
+
+  if (ImageFileTypeOf(input_bmp) != ImageFileType::kBmp) {
+    DecodedImage decoded;
+    BmpError error = decoded.Open(input_bmp);
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    pixels = static_cast<int64_t>(decoded.image().width()) *
+             decoded.image().height();
+    return RunOnImage(pipeline, decoded.image(), Output{output_bmp}, format,
+                      pack_bilevel, histogram, mode);
+  }
+
+  bool paletted = LoadPaletted(input_bmp, image) == BMP_OK;
+  if (!paletted) {
+    ProfileScope profile(ProfileStage::kRead);
+    BmpError error = input_image.read(input_bmp);
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    image = context.arena().AllocateImage(input_image.get_width(),
+                                          input_image.get_height());
+    CopyFromBmp(input_image, image);
+    profile.Count(static_cast<int64_t>(image.width()) * image.height(),
+                  static_cast<int64_t>(
+                      BmpFileSize(image.width(), image.height(),
+                                  PixelFormat::kRGB24)));
+  }
+  pixels = static_cast<int64_t>(image.width()) * image.height();
+
+  Image copy;
+  Image &img = ProcessedImage(image, copy, mode);
+  FoldedPipeline folded =
+      RunPipeline(img, pipeline, format == HistogramFormat::kImage,
+                  &context.arena(), histogram);
+
+  if (folded.rendered) {
+    return WriteRendered(folded, Output{output_bmp}, format, pack_bilevel);
+  }
+
+  // The BmpImg only holds the pixels of files libbmp read.
+  if (paletted || pack_bilevel || img.format() != PixelFormat::kRGB24 ||
+      ImageFileTypeOf(output_bmp) != ImageFileType::kBmp ||
+      IsTiledImageFile(output_bmp)) {
+    return WriteImage(img, Output{output_bmp}, pack_bilevel);
+  }
+
+  ProfileScope profile(ProfileStage::kWrite);
+  profile.Count(pixels, static_cast<int64_t>(BmpFileSize(
+                            img.width(), img.height(), img.format())));
+
+  CopyToBmp(img, input_image);
+  return input_image.write(output_bmp);
+}
+
+/// @brief Runs @p pipeline on the tiled file @p input_bmp a tile at a time.
+/// The histogram is the sum of the ones of the tiles, and the tables are
+/// applied from each tile of the input to the same tile of a tiled output, so
+/// neither file is ever held whole and the image may be bigger than the
+/// sizes of an @see Image . Chains that need the pixels, and outputs that
+/// are not tiled, load the image whole, when its sizes fit.
+BmpError RunTiled(const Pipeline &pipeline, const std::string &input_bmp,
+                  const std::string &output_bmp, HistogramFormat format,
+                  bool pack_bilevel, const RGBHistogram *histogram,
+                  int64_t &pixels) {
+  TiledImage input;
+  {
+    ProfileScope profile(ProfileStage::kRead);
+    BmpError error = input.Open(input_bmp);
+    if (error != BMP_OK) {
+      return error;
+    }
+  }
+
+  const TiledInfo &info = input.info();
+  ScratchArena &arena = GetProcessingContext().arena();
+  pixels = info.width * info.height;
+
+  FoldedPipeline folded;
+  if (!NeedsPixels(pipeline)) {
+    folded = FoldPipeline(
+        pipeline,
+        [&] {
+          return histogram != nullptr ? *histogram : TiledHistogram(input);
+        },
+        format == HistogramFormat::kImage, &arena);
+
+    if (folded.rendered) {
+      return WriteRendered(folded, Output{output_bmp}, format, pack_bilevel);
+    }
+  }
+
+  if (!NeedsPixels(pipeline) && IsTiledImageFile(output_bmp)) {
+    TiledImage result;
+    {
+      ProfileScope profile(ProfileStage::kWrite);
+      BmpError error =
+          result.Create(output_bmp, info.width, info.height, info.format,
+                        info.tile_width, info.tile_height);
+      if (error != BMP_OK) {
+        return error;
+      }
+    }
+
+    ProfileScope profile(ProfileStage::kApply);
+    profile.Count(pixels, 0);
+
+    for (int64_t t = 0; t < info.tiles(); t++) {
+      Image tile = result.tile(t);
+      ApplyChannelLUT(input.tile(t), tile, folded.lut);
+    }
+
+    return BMP_OK;
+  }
+
+  if (info.width > INT_MAX || info.height > INT_MAX) {
+    fmt::print("{} is too big to be loaded whole, only table chains with a "
+               ".pdt output run on it\n",
+               input_bmp);
+    return BMP_ERROR;
+  }
+
+  Image image = arena.AllocateImage(static_cast<int>(info.width),
+                                    static_cast<int>(info.height),
+                                    info.format);
+  CopyFromTiles(input, image);
+
+  if (NeedsPixels(pipeline)) {
+    return RunOnImage(pipeline, image, Output{output_bmp}, format,
+                      pack_bilevel, histogram, ExecutionMode::kInPlace);
+  }
+
+  ProfiledApply(image, folded.lut, &arena);
+  return WriteImage(image, Output{output_bmp}, pack_bilevel);
+}
+
+} // namespace
+
+Command CommandByMethod(const std::string &command) {
+  if (command == "histogram") {
+    return Command::kHistogram;
+  }
+
+  if (command == "equalize") {
+    return Command::kEqualization;
+  }
+
+  if (command == "cutout") {
+    return Command::kCutout;
+  }
+
+  if (command == "two_peaks") {
+    return Command::kTwoPeaks;
+  }
+
+  if (command == "equalize_local") {
+    return Command::kLocalEqualization;
+  }
+
+  if (command == "equalize_luma") {
+    return Command::kLumaEqualization;
+  }
+
+  if (command == "two_peaks_luma") {
+    return Command::kTwoPeaksLuma;
+  }
+
+  if (command == "otsu") {
+    return Command::kOtsu;
+  }
+
+  if (command == "multi_otsu") {
+    return Command::kMultiOtsu;
+  }
+
+  if (command == "erode") {
+    return Command::kErode;
+  }
+
+  if (command == "dilate") {
+    return Command::kDilate;
+  }
+
+  if (command == "open") {
+    return Command::kOpen;
+  }
+
+  if (command == "close") {
+    return Command::kClose;
+  }
+
+  if (command == "blur") {
+    return Command::kBlur;
+  }
+
+  if (command == "box_blur") {
+    return Command::kBoxBlur;
+  }
+
+  if (command == "sharpen") {
+    return Command::kSharpen;
+  }
+
+  if (command == "convolve") {
+    return Command::kConvolve;
+  }
+
+  if (command == "components") {
+    return Command::kComponents;
+  }
+
+  if (command == "labels") {
+    return Command::kLabels;
+  }
+
+  if (command == "copy") {
+    return Command::kCopy;
+  }
+
+  return Command::kUnkown;
+}
+
+bool PipelineByMethods(const std::string &methods, Pipeline &pipeline) {
+  std::stringstream stream(methods);
+  std::string method;
+
+  pipeline.clear();
+  while (std::getline(stream, method, ',')) {
+    Command command = CommandByMethod(method);
+    if (command == Command::kUnkown ||
+        (!pipeline.empty() && pipeline.back() == Command::kComponents)) {
+      return false;
+    }
+
+    pipeline.push_back(command);
+  }
+
+  return !pipeline.empty();
+}
+
+FoldedPipeline FoldPipeline(PipelineSpan pipeline,
+                            FunctionRef<RGBHistogram()> input_histogram,
+                            bool rasterize, ScratchArena *arena) {
+  FoldedPipeline folded;
+  folded.lut = IdentityLUT();
+
+  auto first_pixel_stage =
+      std::find_if(pipeline.begin(), pipeline.end(), IsPixelStage);
+  bool needs_histogram =
+      std::any_of(pipeline.begin(), first_pixel_stage, NeedsHistogram);
+
+  RGBHistogram histogram{};
+  if (needs_histogram) {
+    histogram = input_histogram();
+  }
+
+  for (size_t i = 0; i < pipeline.size(); i++) {
+    if (IsPixelStage(pipeline[i])) {
+      folded.stages = i;
+      return folded;
+    }
+
+    if (pipeline[i] != Command::kHistogram) {
+      ProfileScope profile(ProfileStage::kTable);
+      LUT3 lut = CommandLUT(pipeline[i], histogram);
+
+      folded.lut = ComposeLUT(folded.lut, lut);
+      histogram = RemapHistogram(histogram, lut);
+      continue;
+    }
+
+    // The pending tables only matter through the histogram they produced.
+    folded.rendered = true;
+    folded.histogram = histogram;
+    if (!rasterize && i + 1 == pipeline.size()) {
+      break;
+    }
+
+    {
+      ProfileScope profile(ProfileStage::kRender);
+      folded.image = CreateHistogramImage(histogram, arena);
+    }
+
+    FoldedPipeline result =
+        RunPipeline(folded.image, pipeline.subspan(i + 1), rasterize, arena);
+    if (result.rendered) {
+      folded.image = std::move(result.image);
+      folded.histogram = result.histogram;
+      folded.measured = result.measured;
+      folded.components = std::move(result.components);
+    }
+    break;
+  }
+
+  folded.stages = pipeline.size();
+  return folded;
+}
+
+bool RunsInPlace(Command command) {
+  return command != Command::kUnkown && command != Command::kHistogram &&
+         command != Command::kTwoPeaksLuma && command != Command::kOtsu &&
+         !IsFilter(command) && command != Command::kComponents &&
+         command != Command::kLabels;
+}
+
+bool NeedsPixels(PipelineSpan pipeline) {
+  return std::any_of(pipeline.begin(), pipeline.end(), IsPixelStage);
+}
+
+FoldedPipeline RunPipeline(Image &img, PipelineSpan pipeline, bool rasterize,
+                           ScratchArena *arena,
+                           const RGBHistogram *input_histogram) {
+  size_t next = 0;
+
+  while (true) {
+    // The given histogram only describes the pixels the chain started with.
+    const RGBHistogram *given = next == 0 ? input_histogram : nullptr;
+    FoldedPipeline folded = FoldPipeline(
+        pipeline.subspan(next),
+        [&] { return given != nullptr ? *given : ProfiledHistogram(img); },
+        rasterize, arena);
+
+    if (folded.rendered) {
+      return folded;
+    }
+
+    // Binarizing tables right before morphology commands are applied by
+    // its packing, which reads every sample anyway.
+    size_t morphology = MorphologyRun(pipeline.subspan(next + folded.stages));
+    bool fused = folded.stages > 0 && morphology > 0 &&
+                 IsBilevelLUT(folded.lut);
+    if (folded.stages > 0 && !fused) {
+      ProfiledApply(img, folded.lut, arena);
+    }
+
+    next += folded.stages;
+    if (next == pipeline.size()) {
+      return folded;
+    }
+
+    ProfileScope profile(ProfileStage::kApply);
+    profile.Count(static_cast<int64_t>(img.width()) * img.height(), 0);
+    if (morphology > 0) {
+      RunMorphology(img, pipeline.subspan(next, morphology),
+                    fused ? &folded.lut : nullptr, arena);
+      next += morphology;
+      continue;
+    }
+
+    if (pipeline[next] == Command::kComponents) {
+      folded.rendered = true;
+      folded.measured = true;
+      folded.components = LabelComponents(img);
+      return folded;
+    }
+
+    RunPixelStage(pipeline[next], img, arena);
+    next++;
+  }
+}
+
+FoldedPipeline RunPipeline(const Image &src, Image &dst,
+                           PipelineSpan pipeline, bool rasterize,
+                           ScratchArena *arena,
+                           const RGBHistogram *input_histogram) {
+  dst = src.Share();
+  return RunPipeline(dst, pipeline, rasterize, arena, input_histogram);
+}
+
+BmpError RunCommand(const Pipeline &pipeline, const std::string &input_bmp,
+                    const std::string &output_bmp, const RunOptions &options,
+                    int64_t *pixels, PipelineStats *stages) {
+  int64_t processed = 0;
+  BmpError error = BMP_OK;
+  // Gives back the images and tables of this file once it is written.
+  ScratchScope scope(GetProcessingContext().arena());
+
+  // Tiled files are read a tile at a time already.
+  bool tiled = IsTiledImageFile(input_bmp);
+  bool stream = options.stream && !tiled;
+  if (stream && NeedsPixels(pipeline)) {
+    fmt::print("The chain needs the whole image, reading {} instead of "
+               "streaming it\n",
+               input_bmp);
+    stream = false;
+  }
+
+  if (stream && (ImageFileTypeOf(input_bmp) != ImageFileType::kBmp ||
+                 ImageFileTypeOf(output_bmp) != ImageFileType::kBmp ||
+                 IsTiledImageFile(output_bmp))) {
+    fmt::print("Only bmp files are streamed, reading {} whole instead\n",
+               input_bmp);
+    stream = false;
+  }
+
+  if (tiled) {
+    error = RunTiled(pipeline, input_bmp, output_bmp, options.histogram_format,
+                     options.pack_bilevel, options.histogram, processed);
+  } else if (stream) {
+    BmpBandReader reader;
+    error = reader.Open(input_bmp);
+    if (error == BMP_OK) {
+      // The staged passes need somewhere to count, even if nobody asked.
+      PipelineStats unused;
+      PipelineStats *stats = stages != nullptr ? stages : &unused;
+
+      processed = static_cast<int64_t>(reader.info().width) *
+                  reader.info().height;
+      error = RunStreaming(pipeline, input_bmp, output_bmp,
+                           std::max(options.band_rows, 1),
+                           options.histogram_format, options.pack_bilevel,
+                           options.histogram,
+                           options.async_io ? stats : nullptr);
+    }
+  } else {
+    // libbmp expands every file to RGB, so gray and 32bpp files always go
+    // through the mapping to be processed in their own format.
+    MappedBmp input;
+    bool mapped = false;
+    if (ImageFileTypeOf(input_bmp) == ImageFileType::kBmp) {
+      // Only maps the file, its pages are read by the first pass over them.
+      ProfileScope profile(ProfileStage::kRead);
+      mapped = input.Open(input_bmp) == BMP_OK;
+    }
+    bool native = mapped && input.image().format() != PixelFormat::kRGB24;
+    mapped = mapped && (options.mmap || native);
+
+    if (options.mmap && !mapped) {
+      fmt::print("Could not map {}, reading it instead\n", input_bmp);
+    }
+
+    if (mapped) {
+      processed = static_cast<int64_t>(input.info().width) *
+                  input.info().height;
+      error = RunMapped(pipeline, input, Output{output_bmp},
+                        options.histogram_format, options.pack_bilevel,
+                        options.histogram, options.mode);
+    } else {
+      error = RunLoaded(pipeline, input_bmp, output_bmp,
+                        options.histogram_format, options.pack_bilevel,
+                        options.histogram, options.mode, processed);
+    }
+  }
+
+  int step = GetHistogramSampleStep();
+  if (error == BMP_OK && step > 1 && options.histogram == nullptr &&
+      std::any_of(pipeline.begin(), pipeline.end(), NeedsHistogram)) {
+    int64_t samples = std::max<int64_t>(processed / (int64_t(step) * step), 1);
+    double bound = HistogramErrorBound(samples);
+    fmt::print("{}: histogram estimated from ~{} of {} pixels, CDF within "
+               "{:.4f} ({:.1f} levels) at 95% confidence\n",
+               input_bmp, samples, processed, bound, 255.0 * bound);
+  }
+
+  if (pixels != nullptr) {
+    *pixels = processed;
+  }
+
+  return error;
+}
+
+BmpError RunCommandInMemory(const Pipeline &pipeline,
+                            std::vector<byte> &input,
+                            std::vector<byte> &output,
+                            ImageFileType output_type,
+                            const RunOptions &options, int64_t *pixels) {
+  ScratchScope scope(GetProcessingContext().arena());
+  const std::string no_path;
+  Output result{no_path, &output, output_type};
+
+  // Viewed in place when it is a BMP file, decoded otherwise.
+  MappedBmp bmp;
+  if (input.size() >= 2 && input[0] == 'B' && input[1] == 'M') {
+    BmpError error = bmp.Open(input.data(), input.size());
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    if (pixels != nullptr) {
+      *pixels = static_cast<int64_t>(bmp.info().width) * bmp.info().height;
+    }
+
+    return RunMapped(pipeline, bmp, result, options.histogram_format,
+                     options.pack_bilevel, options.histogram, options.mode);
+  }
+
+  DecodedImage decoded;
+  BmpError error = decoded.Open(input.data(), input.size());
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  if (pixels != nullptr) {
+    *pixels = static_cast<int64_t>(decoded.image().width()) *
+              decoded.image().height();
+  }
+
+  return RunOnImage(pipeline, decoded.image(), result,
+                    options.histogram_format, options.pack_bilevel,
+                    options.histogram, options.mode);
+}
+
+BmpError CountFileHistogram(const std::string &input_bmp,
+                            const RunOptions &options,
+                            RGBHistogram &histogram, int64_t *pixels) {
+  ScratchScope scope(GetProcessingContext().arena());
+  int64_t counted = 0;
+
+  if (IsTiledImageFile(input_bmp)) {
+    TiledImage tiled;
+    BmpError error = tiled.Open(input_bmp);
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    histogram = TiledHistogram(tiled);
+    counted = tiled.info().width * tiled.info().height;
+  } else if (ImageFileTypeOf(input_bmp) != ImageFileType::kBmp) {
+    DecodedImage decoded;
+    BmpError error = decoded.Open(input_bmp);
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    histogram = ProfiledHistogram(decoded.image());
+    counted = static_cast<int64_t>(decoded.image().width()) *
+              decoded.image().height();
+  } else {
+    // Mapped files are only read by the histogram pass itself, the others
+    // (and every file on --stream) a band at a time.
+    MappedBmp input;
+    bool mapped = false;
+    if (!options.stream) {
+      ProfileScope profile(ProfileStage::kRead);
+      mapped = input.Open(input_bmp) == BMP_OK;
+    }
+
+    if (mapped) {
+      histogram = ProfiledHistogram(input.image());
+      counted = static_cast<int64_t>(input.info().width) * input.info().height;
+    } else {
+      BmpError error = CachedStreamHistogram(
+          input_bmp, std::max(options.band_rows, 1), histogram);
+      if (error != BMP_OK) {
+        return error;
+      }
+
+      counted = static_cast<int64_t>(
+          std::accumulate(histogram.red, histogram.red + 256, uint64_t(0)));
+    }
+  }
+
+  if (pixels != nullptr) {
+    *pixels = counted;
+  }
+
+  return BMP_OK;
+}
@@ -0,0 +1,234 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <span>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "bmp_io.h"
+#include "components.h"
+#include "function_ref.h"
+#include "histogram.h"
+#include "histogram_io.h"
+#include "image_codec.h"
+#include "lut.h"
+#include "processing_context.h"
+#include "streaming.h"
+
+enum class Command {
+  kUnkown = 0,
+  kHistogram,
+  kEqualization,
+  kCutout,
+  kTwoPeaks,
+  kLocalEqualization,
+  kTwoPeaksLuma,
+  kOtsu,
+  kMultiOtsu,
+  kErode,
+  kDilate,
+  kOpen,
+  kClose,
+  kBlur,
+  kBoxBlur,
+  kSharpen,
+  kConvolve,
+  kComponents,
+  kLabels,
+  kLumaEqualization,
+  kCopy
+};
+
+/// @brief Where a run leaves its result
+enum class ExecutionMode {
+  /// Over the pixels of the input, which needs no buffer besides the input
+  kInPlace = 0,
+  /// On pixels of its own, leaving the input untouched. The input is shared
+  /// copy-on-write (see @see Image::Share ) until the first pass that writes
+  /// pixels, which reads it and writes a new buffer at once, so chains that
+  /// only read it (or whose commands do not run in place, see
+  /// @see RunsInPlace ) never copy it.
+  kOutOfPlace
+};
+
+/// @brief A chain of commands applied one after the other on the same image,
+/// like "equalize,two_peaks,histogram".
+using Pipeline = std::vector<Command>;
+
+/// @brief A @see Pipeline or the commands left on one, without copying them.
+using PipelineSpan = std::span<const Command>;
+
+/// @brief How @see RunCommand reads and writes the files
+struct RunOptions {
+  /// Process the file in bands of @see band_rows rows, see streaming.h
+  bool stream = false;
+  int band_rows = kDefaultBandRows;
+  /// Map 24bpp files in memory, see @see MappedBmp
+  bool mmap = false;
+  /// How a chain ending with the histogram command writes it
+  HistogramFormat histogram_format = HistogramFormat::kImage;
+  /// Write results whose samples are all 0 or 255 as 1bpp or 4bpp files, see
+  /// @see BilevelPacking
+  bool pack_bilevel = false;
+  /// Overlap reading, processing and writing on stages of their own (the
+  /// bands of @see stream and the files of a batch), see io_pipeline.h
+  bool async_io = false;
+  /// When set, the histogram the chain starts from instead of the one of
+  /// each file, like the histogram of a whole dataset, see
+  /// @see RunDatasetHistogram . Saves the histogram pass over the file.
+  const RGBHistogram *histogram = nullptr;
+  /// Whether the pixels read are processed in place (the input mapping, the
+  /// loaded file or the request bytes of a server) or kept as they are. The
+  /// bands of @see stream are always processed in place.
+  ExecutionMode mode = ExecutionMode::kInPlace;
+};
+
+/// @brief What is left to do after @see FoldPipeline
+struct FoldedPipeline {
+  /// How many commands were folded. Commands that are not a table, like
+  /// @see Command::kLocalEqualization , stop the folding and must run on the
+  /// pixels before the rest of the chain.
+  size_t stages = 0;
+  /// When false, the composed tables of the whole chain, to be applied to the
+  /// input pixels.
+  LUT3 lut;
+  /// When true, the chain rendered a histogram (or ended measuring its
+  /// components) and @see image holds the final result, so the input pixels
+  /// are not needed anymore.
+  bool rendered = false;
+  /// Empty when the chain ends with a histogram that was not rasterized, then
+  /// @see histogram holds the result.
+  Image image;
+  RGBHistogram histogram{};
+  /// When true, the chain ended with @see Command::kComponents and
+  /// @see components holds the result instead of @see image .
+  bool measured = false;
+  std::vector<ComponentStats> components;
+};
+
+/// @brief Parses the @p command string of the user in some @see Command
+/// enumaration
+/// @param command The command provide by the user
+/// @return Some @see Command enumeration
+Command CommandByMethod(const std::string &command);
+
+/// @brief Parses a comma separated list of methods in a @see Pipeline
+/// @param methods The methods provided by the user, like "equalize,cutout"
+/// @param pipeline [out] One command per method
+/// @return false if some method is unknown, or if "components", which
+/// writes a table instead of an image, is not the last one
+bool PipelineByMethods(const std::string &methods, Pipeline &pipeline);
+
+/// @brief Reduces @p pipeline to what has to be done with the input pixels.
+/// Most commands are a table built from a histogram, and the histogram after a
+/// table is known without looking at the pixels, so consecutive commands
+/// compose into a single @see LUT3 . A histogram command renders an image in
+/// memory and the rest of the chain runs on it. The folding stops on the first
+/// command that needs the pixels, see @see FoldedPipeline::stages .
+/// @param pipeline The commands to be applied
+/// @param input_histogram Computes the histogram of the input, only called
+/// when some command needs it
+/// @param rasterize If false, a histogram command ending the chain keeps only
+/// the counts instead of drawing them
+/// @param arena When given, a rendered histogram is taken from it, see
+/// @see CreateHistogramImage
+/// @return The tables to apply to the input, or the rendered result
+FoldedPipeline FoldPipeline(PipelineSpan pipeline,
+                            FunctionRef<RGBHistogram()> input_histogram,
+                            bool rasterize = true,
+                            ScratchArena *arena = nullptr);
+
+/// @brief Whether @p command writes its result over the pixels it reads: the
+/// table commands, @see Command::kLocalEqualization ,
+/// @see Command::kLumaEqualization and the morphology ones.
+/// The histogram command renders a new image, the luma commands make a gray
+/// one and the filters write a new image (they read the neighbours of the
+/// pixels they write), so they only read their input.
+bool RunsInPlace(Command command);
+
+/// @brief Returns true if @p pipeline has a command that can not be folded
+/// in a table, see @see FoldedPipeline::stages .
+bool NeedsPixels(PipelineSpan pipeline);
+
+/// @brief Applies @p pipeline on @p img in memory. Each run of table commands
+/// costs at most one histogram pass and one table pass over the pixels. If
+/// @p img is @see Image::shared , the first pass writing pixels writes them
+/// on a new image of @p arena (or of the heap) that replaces it.
+/// @param img [in | out] The image to be processed. The luma commands replace
+/// it by a gray image, see @see TwoPeaksLuma
+/// @param pipeline The commands to be applied, in order
+/// @param rasterize See @see FoldPipeline
+/// @param arena See @see FoldPipeline
+/// @param input_histogram If given, used instead of the histogram of @p img
+/// by the commands at the start of the chain
+/// @return If @see FoldedPipeline::rendered , the result of the chain is the
+/// rendered histogram and @p img holds an intermediate step. Otherwise the
+/// result is on @p img .
+FoldedPipeline RunPipeline(Image &img, PipelineSpan pipeline,
+                           bool rasterize = true,
+                           ScratchArena *arena = nullptr,
+                           const RGBHistogram *input_histogram = nullptr);
+
+/// @brief The out of place form of @see RunPipeline , see
+/// @see ExecutionMode::kOutOfPlace .
+/// @param src The image to be processed, left untouched
+/// @param dst [out] Receives the result, a view of @p src when the chain
+/// wrote no pixel
+FoldedPipeline RunPipeline(const Image &src, Image &dst,
+                           PipelineSpan pipeline, bool rasterize = true,
+                           ScratchArena *arena = nullptr,
+                           const RGBHistogram *input_histogram = nullptr);
+
+/// @brief Reads @p input_bmp , applies @p pipeline and writes the result on
+/// @p output_bmp . Either may be a tiled ".pdt" file (see tiled_image.h),
+/// which table chains process a tile at a time. The images and tables of the
+/// run come from the @see GetProcessingContext of the calling thread, so
+/// calling it again for files of the same size does not allocate them again.
+/// @param pipeline The commands to be applied, in order
+/// @param input_bmp The BMP to be read
+/// @param output_bmp The BMP to be written
+/// @param options How the files are read and written
+/// @param pixels [out] If not null, receives the number of pixels processed
+/// @param stages [out] If not null, the time of the read, compute and write
+/// stages is added to it when @see RunOptions::async_io streams the file
+/// @return BMP_OK or the first error found
+BmpError RunCommand(const Pipeline &pipeline, const std::string &input_bmp,
+                    const std::string &output_bmp, const RunOptions &options,
+                    int64_t *pixels = nullptr,
+                    PipelineStats *stages = nullptr);
+
+/// @brief Like @see RunCommand on a file already loaded in memory, the
+/// compute step of a pipeline whose reads and writes happen elsewhere. BMP
+/// inputs are viewed in place, like with @see RunOptions::mmap , and PNG,
+/// JPEG and TGA ones decoded.
+/// @param input [in | out] The bytes of the input file, processed in place
+/// @param output [out] Receives the bytes of the file to be written
+/// @param output_type The type of file built on @p output , unless the chain
+/// writes the histogram counts
+/// @return BMP_OK, or BMP_INVALID_FILE for files that can not be processed
+/// in memory (paletted files other than 8bpp gray, see
+/// @see MappedBmp::Open )
+BmpError RunCommandInMemory(const Pipeline &pipeline,
+                            std::vector<byte> &input,
+                            std::vector<byte> &output,
+                            ImageFileType output_type,
+                            const RunOptions &options,
+                            int64_t *pixels = nullptr);
+
+/// @brief Counts the histogram of the file @p input_bmp , reading it once:
+/// mapped when possible, a band at a time otherwise (or with
+/// @see RunOptions::stream ), decoded for PNG, JPEG and TGA files and a tile
+/// at a time for tiled files (see tiled_image.h). It follows the
+/// @see GetHistogramSampleStep like the commands do.
+/// @param options Only @see RunOptions::stream and
+/// @see RunOptions::band_rows are used
+/// @param histogram [out] The histogram of the file
+/// @param pixels [out] If not null, receives the number of pixels counted
+/// @return BMP_OK or the error found reading the file
+BmpError CountFileHistogram(const std::string &input_bmp,
+                            const RunOptions &options,
+                            RGBHistogram &histogram,
+                            int64_t *pixels = nullptr);
@@ -0,0 +1,504 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "components.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdio.h>
+#include <string.h>
+
+#include <fmt/format.h>
+
+#include "tile_scheduler.h"
+
+namespace {
+
+/// Block rows of a band of the first pass.
+const int kBandBlockRows = 64;
+
+/// The @see Luma from which a pixel is foreground.
+const int kForeground = 128;
+
+const uint32_t kTableVersion = 1;
+
+/// @brief What is known of a label: the measures of its blocks.
+struct Measure {
+  int64_t area = 0;
+  int64_t sum_x = 0;
+  int64_t sum_y = 0;
+  int min_x = 0;
+  int min_y = 0;
+  int max_x = 0;
+  int max_y = 0;
+
+  void Add(int x, int y) {
+    if (area == 0) {
+      min_x = max_x = x;
+      min_y = max_y = y;
+    }
+
+    area++;
+    sum_x += x;
+    sum_y += y;
+    min_x = std::min(min_x, x);
+    min_y = std::min(min_y, y);
+    max_x = std::max(max_x, x);
+    max_y = std::max(max_y, y);
+  }
+
+  void Add(const Measure &other) {
+    if (other.area == 0) {
+      return;
+    }
+
+    if (area == 0) {
+      *this = other;
+      return;
+    }
+
+    area += other.area;
+    sum_x += other.sum_x;
+    sum_y += other.sum_y;
+    min_x = std::min(min_x, other.min_x);
+    min_y = std::min(min_y, other.min_y);
+    max_x = std::max(max_x, other.max_x);
+    max_y = std::max(max_y, other.max_y);
+  }
+};
+
+/// @brief The labels of a band of block rows after the first pass. The
+/// labels count from 1 on each band, 0 is the background.
+struct Band {
+  /// The union-find forest of the labels
+  std::vector<uint32_t> parent;
+  std::vector<Measure> measures;
+  /// The labels of the first and of the last block row, which the merge
+  /// step joins with the bands around
+  std::vector<uint32_t> first_row;
+  std::vector<uint32_t> last_row;
+  /// The first label of the band once numbered across the image
+  uint32_t offset = 0;
+};
+
+/// @brief The root of @p label , halving the path to it on the way.
+uint32_t Find(std::vector<uint32_t> &parent, uint32_t label) {
+  while (parent[label] != label) {
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+
+  return label;
+}
+
+/// @brief Joins the sets of @p a and @p b under the smallest of their roots,
+/// so the root of a set is always its first label.
+/// @return The root of the joined set
+uint32_t Union(std::vector<uint32_t> &parent, uint32_t a, uint32_t b) {
+  a = Find(parent, a);
+  b = Find(parent, b);
+  if (a < b) {
+    parent[b] = a;
+    return a;
+  }
+
+  parent[a] = b;
+  return b;
+}
+
+/// @brief Sets @p flags [x + 1] to whether the pixel x of the row @p y of
+/// @p img is foreground. The flags before and past the row (and all of them
+/// for rows outside the image) are 0, so the blocks on the edges see
+/// background around them.
+/// @param flags @p img .width() + 3 flags
+void ForegroundRow(const Image &img, int y, byte *flags) {
+  int width = img.width();
+  memset(flags, 0, width + 3);
+  if (y < 0 || y >= img.height()) {
+    return;
+  }
+
+  int step = img.pixel_step();
+  const byte *red = img.channel_row(kRed, y);
+  const byte *green = img.channel_row(kGreen, y);
+  const byte *blue = img.channel_row(kBlue, y);
+
+  for (int x = 0; x < width; x++) {
+    RGBColor color{.r = red[x * step], .g = green[x * step],
+                   .b = blue[x * step]};
+    flags[x + 1] = static_cast<byte>(Luma(color) >= kForeground ? 1 : 0);
+  }
+}
+
+/// @brief The foreground flags of the 2x2 block whose top left pixel has
+/// the flag @p x on @p top .
+struct Block {
+  bool a, b, c, d;
+
+  Block(const byte *top, const byte *bottom, int x)
+      : a(top[x] != 0), b(top[x + 1] != 0), c(bottom[x] != 0),
+        d(bottom[x + 1] != 0) {}
+
+  bool empty() const { return !(a || b || c || d); }
+};
+
+/// @brief Whether the top row of @p block touches, 8-connected, the block
+/// row above it, whose bottom row of flags is @p above .
+/// @param neighbour -1, 0 or 1 for the block above on the left, right above
+/// or on the right
+bool TouchesAbove(const Block &block, const byte *above, int x,
+                  int neighbour) {
+  switch (neighbour) {
+  case -1:
+    return block.a && above[x - 1] != 0;
+
+  case 0:
+    return (block.a || block.b) && (above[x] != 0 || above[x + 1] != 0);
+
+  default:
+    return block.b && above[x + 2] != 0;
+  }
+}
+
+/// @brief The first pass over the block rows [ @p first , @p last ): labels
+/// each block with foreground pixels, joining the labels of the blocks it
+/// touches on its left and on the row above, and measures each label.
+/// @param blocks [out] If not null, receives the label of each block of the
+/// band, one row of blocks after the other from its first one
+void LabelBand(const Image &img, int first, int last, Band &band,
+               uint32_t *blocks) {
+  int width = img.width();
+  int columns = (width + 1) / 2;
+  ScratchScope scope(GetProcessingContext().arena());
+  byte *above = scope.arena().Allocate<byte>(width + 3);
+  byte *top = scope.arena().Allocate<byte>(width + 3);
+  byte *bottom = scope.arena().Allocate<byte>(width + 3);
+  uint32_t *previous = scope.arena().Allocate<uint32_t>(columns);
+  uint32_t *current = scope.arena().Allocate<uint32_t>(columns);
+
+  band.parent.assign(1, 0);
+  band.measures.assign(1, Measure{});
+
+  for (int by = first; by < last; by++) {
+    // The band's first row joins the rows above only on the merge step.
+    ForegroundRow(img, by > first ? 2 * by - 1 : -1, above);
+    ForegroundRow(img, 2 * by, top);
+    ForegroundRow(img, 2 * by + 1, bottom);
+
+    for (int bx = 0; bx < columns; bx++) {
+      int x = 2 * bx + 1;
+      Block block(top, bottom, x);
+      if (block.empty()) {
+        current[bx] = 0;
+        continue;
+      }
+
+      uint32_t label = 0;
+      auto join = [&](uint32_t neighbour) {
+        label = label == 0 ? neighbour : Union(band.parent, label, neighbour);
+      };
+
+      if (bx > 0 && (block.a || block.c) &&
+          (top[x - 1] != 0 || bottom[x - 1] != 0)) {
+        join(current[bx - 1]);
+      }
+      for (int neighbour = -1; neighbour <= 1; neighbour++) {
+        int column = bx + neighbour;
+        if (column >= 0 && column < columns &&
+            TouchesAbove(block, above, x, neighbour)) {
+          join(previous[column]);
+        }
+      }
+
+      if (label == 0) {
+        label = static_cast<uint32_t>(band.parent.size());
+        band.parent.push_back(label);
+        band.measures.emplace_back();
+      }
+      current[bx] = label;
+
+      Measure &measure = band.measures[label];
+      int px = 2 * bx;
+      int py = 2 * by;
+      if (block.a) {
+        measure.Add(px, py);
+      }
+      if (block.b) {
+        measure.Add(px + 1, py);
+      }
+      if (block.c) {
+        measure.Add(px, py + 1);
+      }
+      if (block.d) {
+        measure.Add(px + 1, py + 1);
+      }
+    }
+
+    if (blocks != nullptr) {
+      memcpy(blocks + static_cast<size_t>(by - first) * columns, current,
+             columns * sizeof(uint32_t));
+    }
+    if (by == first) {
+      band.first_row.assign(current, current + columns);
+    }
+    std::swap(previous, current);
+  }
+
+  band.last_row.assign(previous, previous + columns);
+}
+
+/// @brief The color of the component @p id on the label image, never
+/// close to the black of the background.
+RGBColor ComponentColor(uint32_t id) {
+  uint32_t hash = id * 0x9E3779B1u;
+  return RGBColor{.r = static_cast<byte>(64 + (hash >> 24) % 192),
+                  .g = static_cast<byte>(64 + (hash >> 16 & 0xFF) % 192),
+                  .b = static_cast<byte>(64 + (hash >> 8 & 0xFF) % 192)};
+}
+
+void PutU32(byte *to, uint32_t value) {
+  to[0] = static_cast<byte>(value);
+  to[1] = static_cast<byte>(value >> 8);
+  to[2] = static_cast<byte>(value >> 16);
+  to[3] = static_cast<byte>(value >> 24);
+}
+
+void PutU64(byte *to, uint64_t value) {
+  PutU32(to, static_cast<uint32_t>(value));
+  PutU32(to + 4, static_cast<uint32_t>(value >> 32));
+}
+
+} // namespace
+
+std::vector<ComponentStats> LabelComponents(const Image &img, Image *labels,
+                                            ScratchArena *arena) {
+  std::vector<ComponentStats> components;
+  if (img.empty()) {
+    return components;
+  }
+
+  int columns = (img.width() + 1) / 2;
+  int rows = (img.height() + 1) / 2;
+  int band_count = (rows + kBandBlockRows - 1) / kBandBlockRows;
+  std::vector<Band> bands(band_count);
+
+  // The labels of every block, only kept to paint the label image.
+  std::vector<uint32_t> blocks;
+  if (labels != nullptr) {
+    blocks.resize(static_cast<size_t>(columns) * rows);
+  }
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = columns, .height = rows}, columns,
+      kBandBlockRows, [&](const Rectangle &tile) {
+        uint32_t *band_blocks =
+            blocks.empty()
+                ? nullptr
+                : blocks.data() + static_cast<size_t>(tile.y) * columns;
+        LabelBand(img, tile.y, tile.y + tile.height,
+                  bands[tile.y / kBandBlockRows], band_blocks);
+      });
+
+  // Numbers the labels across the bands, keeping the roots each band found.
+  uint32_t total = 0;
+  for (Band &band : bands) {
+    band.offset = total;
+    total += static_cast<uint32_t>(band.parent.size() - 1);
+  }
+
+  std::vector<uint32_t> parent(total + 1);
+  for (Band &band : bands) {
+    for (uint32_t label = 1; label < band.parent.size(); label++) {
+      parent[band.offset + label] = band.offset + Find(band.parent, label);
+    }
+  }
+
+  // The merge step: joins the first block row of each band with the last
+  // one of the band above.
+  {
+    ScratchScope scope(GetProcessingContext().arena());
+    byte *above = scope.arena().Allocate<byte>(img.width() + 3);
+    byte *top = scope.arena().Allocate<byte>(img.width() + 3);
+    byte *bottom = scope.arena().Allocate<byte>(img.width() + 3);
+
+    for (int b = 1; b < band_count; b++) {
+      const Band &band = bands[b];
+      const Band &upper = bands[b - 1];
+      int by = b * kBandBlockRows;
+      ForegroundRow(img, 2 * by - 1, above);
+      ForegroundRow(img, 2 * by, top);
+      ForegroundRow(img, 2 * by + 1, bottom);
+
+      for (int bx = 0; bx < columns; bx++) {
+        uint32_t label = band.first_row[bx];
+        if (label == 0) {
+          continue;
+        }
+
+        int x = 2 * bx + 1;
+        Block block(top, bottom, x);
+        for (int neighbour = -1; neighbour <= 1; neighbour++) {
+          int column = bx + neighbour;
+          if (column >= 0 && column < columns &&
+              TouchesAbove(block, above, x, neighbour)) {
+            Union(parent, band.offset + label,
+                  upper.offset + upper.last_row[column]);
+          }
+        }
+      }
+    }
+  }
+
+  // The second pass: the roots, which are the first label of their set,
+  // number the components in order and every label adds its measures.
+  std::vector<uint32_t> ids(total + 1, 0);
+  std::vector<Measure> measures;
+  for (const Band &band : bands) {
+    for (uint32_t local = 1; local < band.parent.size(); local++) {
+      uint32_t label = band.offset + local;
+      uint32_t root = Find(parent, label);
+      if (root == label) {
+        measures.emplace_back();
+        ids[label] = static_cast<uint32_t>(measures.size());
+      } else {
+        ids[label] = ids[root];
+      }
+      measures[ids[label] - 1].Add(band.measures[local]);
+    }
+  }
+
+  components.reserve(measures.size());
+  for (const Measure &measure : measures) {
+    components.push_back(ComponentStats{
+        .area = measure.area,
+        .bounds = Rectangle{.x = measure.min_x,
+                            .y = measure.min_y,
+                            .width = measure.max_x - measure.min_x + 1,
+                            .height = measure.max_y - measure.min_y + 1},
+        .sum_x = measure.sum_x,
+        .sum_y = measure.sum_y});
+  }
+
+  if (labels == nullptr) {
+    return components;
+  }
+
+  *labels = arena != nullptr
+                ? arena->AllocateImage(img.width(), img.height())
+                : Image(img.width(), img.height(), PixelFormat::kRGB24);
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = columns, .height = rows}, columns,
+      kBandBlockRows, [&](const Rectangle &tile) {
+        const Band &band = bands[tile.y / kBandBlockRows];
+        ScratchScope scope(GetProcessingContext().arena());
+        byte *top = scope.arena().Allocate<byte>(img.width() + 3);
+        byte *bottom = scope.arena().Allocate<byte>(img.width() + 3);
+
+        for (int by = tile.y; by < tile.y + tile.height; by++) {
+          ForegroundRow(img, 2 * by, top);
+          ForegroundRow(img, 2 * by + 1, bottom);
+          const uint32_t *row =
+              blocks.data() + static_cast<size_t>(by) * columns;
+
+          for (int bx = 0; bx < columns; bx++) {
+            if (row[bx] == 0) {
+              continue;
+            }
+
+            RGBColor color = ComponentColor(ids[band.offset + row[bx]]);
+            int x = 2 * bx;
+            for (int dy = 0; dy < 2; dy++) {
+              const byte *flags = dy == 0 ? top : bottom;
+              for (int dx = 0; dx < 2; dx++) {
+                if (flags[x + dx + 1] != 0) {
+                  labels->set_pixel(x + dx, 2 * by + dy, color);
+                }
+              }
+            }
+          }
+        }
+      });
+
+  return components;
+}
+
+void EncodeComponents(const std::vector<ComponentStats> &components,
+                      HistogramFormat format, std::vector<byte> &bytes) {
+  bytes.clear();
+  auto out = std::back_inserter(bytes);
+
+  switch (format) {
+    using enum HistogramFormat;
+
+  case kJson: {
+    fmt::format_to(out, "[");
+    for (size_t i = 0; i < components.size(); i++) {
+      const ComponentStats &component = components[i];
+      const Rectangle &bounds = component.bounds;
+      fmt::format_to(out,
+                     "{}{{\"label\": {}, \"area\": {}, \"x\": {}, \"y\": {}, "
+                     "\"width\": {}, \"height\": {}, \"centroid_x\": {:.2f}, "
+                     "\"centroid_y\": {:.2f}}}",
+                     i == 0 ? "\n  " : ",\n  ", i + 1, component.area,
+                     bounds.x, bounds.y, bounds.width, bounds.height,
+                     component.centroid_x(), component.centroid_y());
+    }
+    fmt::format_to(out, "{}]\n", components.empty() ? "" : "\n");
+  } break;
+
+  case kBinary: {
+    size_t record = 8 + 4 * 4 + 2 * 8;
+    bytes.assign(16 + components.size() * record, 0);
+    bytes[0] = 'C';
+    bytes[1] = 'M';
+    bytes[2] = 'P';
+    bytes[3] = 'T';
+    PutU32(bytes.data() + 4, kTableVersion);
+    PutU64(bytes.data() + 8, components.size());
+
+    byte *to = bytes.data() + 16;
+    for (const ComponentStats &component : components) {
+      const Rectangle &bounds = component.bounds;
+      PutU64(to, static_cast<uint64_t>(component.area));
+      PutU32(to + 8, static_cast<uint32_t>(bounds.x));
+      PutU32(to + 12, static_cast<uint32_t>(bounds.y));
+      PutU32(to + 16, static_cast<uint32_t>(bounds.width));
+      PutU32(to + 20, static_cast<uint32_t>(bounds.height));
+      PutU64(to + 24, static_cast<uint64_t>(component.sum_x));
+      PutU64(to + 32, static_cast<uint64_t>(component.sum_y));
+      to += record;
+    }
+  } break;
+
+  default: {
+    fmt::format_to(out,
+                   "label,area,x,y,width,height,centroid_x,centroid_y\n");
+    for (size_t i = 0; i < components.size(); i++) {
+      const ComponentStats &component = components[i];
+      const Rectangle &bounds = component.bounds;
+      fmt::format_to(out, "{},{},{},{},{},{},{:.2f},{:.2f}\n", i + 1,
+                     component.area, bounds.x, bounds.y, bounds.width,
+                     bounds.height, component.centroid_x(),
+                     component.centroid_y());
+    }
+  } break;
+  }
+}
+
+BmpError WriteComponents(const std::string &filename,
+                         const std::vector<ComponentStats> &components,
+                         HistogramFormat format) {
+  std::vector<byte> bytes;
+  EncodeComponents(components, format, bytes);
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  written = fclose(file) == 0 && written;
+
+  return written ? BMP_OK : BMP_ERROR;
+}
@@ -0,0 +1,61 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "bmp_io.h"
+#include "histogram_io.h"
+#include "image.h"
+#include "processing_context.h"
+
+/// @brief The measures of a connected component of @see LabelComponents
+struct ComponentStats {
+  /// Pixels of the component
+  int64_t area = 0;
+  /// The smallest rectangle holding the component
+  Rectangle bounds{};
+  /// The sums of the coordinates of the pixels, the centroid times the area
+  int64_t sum_x = 0;
+  int64_t sum_y = 0;
+
+  double centroid_x() const { return static_cast<double>(sum_x) / area; }
+  double centroid_y() const { return static_cast<double>(sum_y) / area; }
+};
+
+/// @brief Finds the 8-connected components of the foreground of @p img , the
+/// pixels whose @see Luma is from 128 up (the set samples of a binarized
+/// image). Two passes of union-find over 2x2 blocks, whose foreground pixels
+/// are always connected: the first labels the blocks of bands of rows in
+/// parallel, keeping only the labels of the block row above, and measures
+/// each label as it goes; a merge step joins the labels meeting across the
+/// bands and the second pass gives each component its number. The blocks'
+/// labels are only kept for the second pass when @p labels is given.
+/// @param img The image to be labeled
+/// @param labels [out] If not null, receives an RGB image of the size of
+/// @p img with each component painted in a color of its own, on black
+/// @param arena Where @p labels is taken from, when given
+/// @return The components, in the raster order of their first block
+std::vector<ComponentStats> LabelComponents(const Image &img,
+                                            Image *labels = nullptr,
+                                            ScratchArena *arena = nullptr);
+
+/// @brief Encodes @p components as a table of one component per row:
+/// "label,area,x,y,width,height,centroid_x,centroid_y" lines for
+/// @see HistogramFormat::kCsv (and kImage), a JSON array of objects for
+/// kJson, or for kBinary "CMPT", a little endian uint32 version (1), the
+/// number of components as a little endian uint64 and per component its area
+/// as a little endian uint64, its bounds as 4 little endian uint32 (x, y,
+/// width and height) and its coordinate sums as 2 little endian uint64.
+/// @param bytes [out] Cleared and filled with the encoded table
+void EncodeComponents(const std::vector<ComponentStats> &components,
+                      HistogramFormat format, std::vector<byte> &bytes);
+
+/// @brief Writes @p components on @p filename , see @see EncodeComponents .
+/// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_ERROR if it could not be written
+BmpError WriteComponents(const std::string &filename,
+                         const std::vector<ComponentStats> &components,
+                         HistogramFormat format);
@@ -0,0 +1,194 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "content_hash.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+
+const uint64_t kPrime1 = 11400714785074694791ull;
+const uint64_t kPrime2 = 14029467366897019727ull;
+const uint64_t kPrime3 = 1609587929392839161ull;
+const uint64_t kPrime4 = 9650029242287828579ull;
+const uint64_t kPrime5 = 2870177450012600261ull;
+
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t Load64(const byte *from) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = value << 8 | from[i];
+  }
+  return value;
+}
+
+inline uint32_t Load32(const byte *from) {
+  return static_cast<uint32_t>(from[0]) |
+         static_cast<uint32_t>(from[1]) << 8 |
+         static_cast<uint32_t>(from[2]) << 16 |
+         static_cast<uint32_t>(from[3]) << 24;
+}
+
+/// Pixels of the BGR rows reordered to RGB at a time by @see HashImage .
+const int kReorderPixels = 256;
+
+inline uint64_t Round(uint64_t lane, uint64_t input) {
+  lane += input * kPrime2;
+  lane = RotateLeft(lane, 31);
+  return lane * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t hash, uint64_t lane) {
+  hash ^= Round(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+
+/// @brief Consumes one 32 byte stripe, 8 bytes per lane.
+inline void Stripe(uint64_t *lanes, const byte *from) {
+  for (int i = 0; i < 4; i++) {
+    lanes[i] = Round(lanes[i], Load64(from + 8 * i));
+  }
+}
+
+} // namespace
+
+ContentHasher::ContentHasher(uint64_t seed) : seed_(seed) {
+  lanes_[0] = seed + kPrime1 + kPrime2;
+  lanes_[1] = seed + kPrime2;
+  lanes_[2] = seed;
+  lanes_[3] = seed - kPrime1;
+}
+
+void ContentHasher::Update(const void *data, size_t size) {
+  const byte *from = static_cast<const byte *>(data);
+  total_ += size;
+
+  if (buffered_ + size < sizeof(buffer_)) {
+    memcpy(buffer_ + buffered_, from, size);
+    buffered_ += size;
+    return;
+  }
+
+  if (buffered_ > 0) {
+    size_t fill = sizeof(buffer_) - buffered_;
+    memcpy(buffer_ + buffered_, from, fill);
+    Stripe(lanes_, buffer_);
+    from += fill;
+    size -= fill;
+    buffered_ = 0;
+  }
+
+  for (; size >= sizeof(buffer_); from += 32, size -= 32) {
+    Stripe(lanes_, from);
+  }
+
+  memcpy(buffer_, from, size);
+  buffered_ = size;
+}
+
+void ContentHasher::UpdateValue(uint64_t value) {
+  byte bytes[8];
+  for (int i = 0; i < 8; i++) {
+    bytes[i] = static_cast<byte>(value >> (8 * i));
+  }
+
+  Update(bytes, sizeof(bytes));
+}
+
+uint64_t ContentHasher::Digest() const {
+  uint64_t hash = 0;
+
+  if (total_ >= sizeof(buffer_)) {
+    hash = RotateLeft(lanes_[0], 1) + RotateLeft(lanes_[1], 7) +
+           RotateLeft(lanes_[2], 12) + RotateLeft(lanes_[3], 18);
+    for (int i = 0; i < 4; i++) {
+      hash = MergeRound(hash, lanes_[i]);
+    }
+  } else {
+    hash = seed_ + kPrime5;
+  }
+
+  hash += total_;
+
+  const byte *from = buffer_;
+  size_t left = buffered_;
+
+  for (; left >= 8; from += 8, left -= 8) {
+    hash ^= Round(0, Load64(from));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+
+  if (left >= 4) {
+    hash ^= static_cast<uint64_t>(Load32(from)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    from += 4;
+    left -= 4;
+  }
+
+  for (; left > 0; from++, left--) {
+    hash ^= *from * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+uint64_t HashImage(const Image &img, uint64_t seed) {
+  ContentHasher hasher(seed);
+  hasher.UpdateValue(static_cast<uint64_t>(img.width()));
+  hasher.UpdateValue(static_cast<uint64_t>(img.height()));
+  hasher.UpdateValue(static_cast<uint64_t>(img.format()));
+  hasher.UpdateValue(static_cast<uint64_t>(img.layout()));
+
+  // Views in BGR order, like mapped 24bpp files, hash as the RGB image of
+  // the same colors, so an image and its copy with red and blue swapped
+  // never get the same hash.
+  if (img.layout() == PixelLayout::kInterleaved &&
+      img.format() == PixelFormat::kRGB24 && img.channel_offset(kRed) != 0) {
+    byte reordered[3 * kReorderPixels];
+    for (int y = 0; y < img.height(); y++) {
+      const byte *row = img.row(y);
+
+      for (int x = 0; x < img.width(); x += kReorderPixels) {
+        int count = std::min(kReorderPixels, img.width() - x);
+        for (int i = 0; i < count; i++) {
+          const byte *pixel = row + 3 * (x + i);
+          reordered[3 * i] = pixel[2];
+          reordered[3 * i + 1] = pixel[1];
+          reordered[3 * i + 2] = pixel[0];
+        }
+        hasher.Update(reordered, 3 * static_cast<size_t>(count));
+      }
+    }
+
+    return hasher.Digest();
+  }
+
+  if (img.layout() == PixelLayout::kInterleaved) {
+    size_t row_bytes =
+        static_cast<size_t>(img.width()) * BytesPerPixel(img.format());
+    for (int y = 0; y < img.height(); y++) {
+      hasher.Update(img.row(y), row_bytes);
+    }
+
+    return hasher.Digest();
+  }
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int y = 0; y < img.height(); y++) {
+      hasher.Update(img.channel_row(c, y), static_cast<size_t>(img.width()));
+    }
+  }
+
+  return hasher.Digest();
+}
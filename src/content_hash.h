@@ -0,0 +1,44 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "image.h"
+
+/// @brief The 64 bit xxHash (XXH64) of a stream of bytes, fed in pieces of
+/// any size. It runs at several bytes per cycle, so hashing an image costs a
+/// small fraction of a pass that looks at its samples.
+class ContentHasher {
+public:
+  explicit ContentHasher(uint64_t seed = 0);
+
+  /// @brief Adds the @p size bytes of @p data to the stream.
+  void Update(const void *data, size_t size);
+
+  /// @brief Adds @p value , as its 8 little endian bytes.
+  void UpdateValue(uint64_t value);
+
+  /// @brief The hash of everything added so far. More bytes can still be
+  /// added after it.
+  uint64_t Digest() const;
+
+private:
+  uint64_t seed_;
+  uint64_t lanes_[4];
+  byte buffer_[32];
+  size_t buffered_ = 0;
+  uint64_t total_ = 0;
+};
+
+/// @brief Hashes the pixels of @p img row by row, without the padding
+/// between rows, together with its size and format, so equal images give
+/// the same hash whatever their stride or where their pixels live. RGB
+/// pixels hash in R, G, B order whatever their @see ChannelOrder , and the
+/// planar layout hashes each plane in turn.
+/// @param img The image to be hashed
+/// @param seed Mixed into the hash, to tell apart what is derived from the
+/// same pixels in different ways
+uint64_t HashImage(const Image &img, uint64_t seed = 0);
@@ -0,0 +1,140 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "cpu_features.h"
+
+#include <stdint.h>
+
+#if defined(PDI_LI_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+#if defined(PDI_LI_X86) && !defined(__GNUC__)
+/// @brief Reads the cpuid bits of the instruction sets of @see CpuIsa , and
+/// the XCR0 register for whether the operating system saves the wide
+/// registers on a context switch.
+CpuIsa CpuidIsa() {
+  int info[4];
+  __cpuid(info, 0);
+  int leaves = info[0];
+
+  __cpuid(info, 1);
+  bool ssse3 = (info[2] & (1 << 9)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+
+  uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+  // SSE and AVX state, plus the opmask and both halves of the ZMM registers.
+  bool ymm = (xcr0 & 0x6) == 0x6;
+  bool zmm = (xcr0 & 0xE6) == 0xE6;
+
+  bool avx2 = false;
+  bool avx512 = false;
+  bool vbmi = false;
+  if (leaves >= 7) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+    avx512 = (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+    vbmi = (info[2] & (1 << 1)) != 0;
+  }
+
+  if (avx512 && avx2 && avx && zmm) {
+    return vbmi ? CpuIsa::kAVX512VBMI : CpuIsa::kAVX512;
+  }
+
+  if (avx2 && avx && ymm) {
+    return CpuIsa::kAVX2;
+  }
+
+  return ssse3 ? CpuIsa::kSSSE3 : CpuIsa::kBaseline;
+}
+#endif
+
+const CpuIsa detected_isa = DetectCpuIsa();
+
+CpuIsa cpu_isa = detected_isa;
+
+} // namespace
+
+CpuIsa DetectCpuIsa() {
+#if defined(PDI_LI_X86) && defined(__GNUC__)
+  // The checks of the runtime also look at XCR0 for the wide registers.
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512bw")) {
+    return __builtin_cpu_supports("avx512vbmi") ? CpuIsa::kAVX512VBMI
+                                                : CpuIsa::kAVX512;
+  }
+
+  if (__builtin_cpu_supports("avx2")) {
+    return CpuIsa::kAVX2;
+  }
+
+  return __builtin_cpu_supports("ssse3") ? CpuIsa::kSSSE3
+                                         : CpuIsa::kBaseline;
+#elif defined(PDI_LI_X86)
+  return CpuidIsa();
+#else
+  return CpuIsa::kBaseline;
+#endif
+}
+
+const char *CpuIsaName(CpuIsa isa) {
+  switch (isa) {
+    using enum CpuIsa;
+
+  case kSSSE3:
+    return "ssse3";
+
+  case kAVX2:
+    return "avx2";
+
+  case kAVX512:
+    return "avx512";
+
+  case kAVX512VBMI:
+    return "avx512vbmi";
+
+  default:
+    return "baseline";
+  }
+}
+
+const char *BaselineIsaName() {
+#if defined(__AVX2__)
+  return "avx2";
+#elif defined(__SSSE3__)
+  return "ssse3";
+#elif defined(__SSE2__) || defined(_M_X64)
+  return "sse2";
+#elif defined(__ARM_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+bool CpuIsaByName(const std::string &name, CpuIsa &isa) {
+  for (CpuIsa candidate : {CpuIsa::kBaseline, CpuIsa::kSSSE3, CpuIsa::kAVX2,
+                           CpuIsa::kAVX512, CpuIsa::kAVX512VBMI}) {
+    if (name == CpuIsaName(candidate)) {
+      isa = candidate;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool SetCpuIsa(CpuIsa isa) {
+  if (isa > detected_isa) {
+    return false;
+  }
+
+  cpu_isa = isa;
+  return true;
+}
+
+CpuIsa GetCpuIsa() { return cpu_isa; }
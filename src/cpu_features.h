@@ -0,0 +1,75 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||          \
+    defined(_M_IX86)
+#include <immintrin.h>
+#define PDI_LI_X86 1
+#endif
+
+// The kernels with variants for wider instruction sets than the build
+// targets mark each variant with the set it needs, so one binary carries all
+// of them and runs the best one the CPU has, see @see GetCpuIsa . MSVC takes
+// the intrinsics of any set without the marks.
+#if defined(PDI_LI_X86) && defined(__GNUC__)
+#define PDI_LI_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define PDI_LI_TARGET_AVX2 __attribute__((target("avx2")))
+#define PDI_LI_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define PDI_LI_TARGET_AVX512VBMI                                            \
+  __attribute__((target("avx512f,avx512bw,avx512vbmi")))
+#define PDI_LI_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(PDI_LI_X86)
+#define PDI_LI_TARGET_SSSE3
+#define PDI_LI_TARGET_AVX2
+#define PDI_LI_TARGET_AVX512
+#define PDI_LI_TARGET_AVX512VBMI
+#define PDI_LI_ALWAYS_INLINE __forceinline
+#else
+#define PDI_LI_ALWAYS_INLINE inline
+#endif
+
+/// @brief The instruction sets the kernels have variants for, each one
+/// holding the ones before it
+enum class CpuIsa {
+  /// What the build targets: SSE2 on x86-64, NEON on 64 bit ARM
+  kBaseline = 0,
+  /// The byte shuffles the pixel unpacking of the histograms uses, on every
+  /// x86 CPU with SSE4.2 too
+  kSSSE3,
+  /// 256 bit vectors
+  kAVX2,
+  /// 512 bit vectors with the byte and word operations (BW), from Skylake-X
+  /// on
+  kAVX512,
+  /// kAVX512 plus the byte permutes (VBMI) the table lookups use, from Ice
+  /// Lake and Zen 4 on
+  kAVX512VBMI
+};
+
+/// @brief The best @see CpuIsa this CPU and its operating system support,
+/// checked with cpuid once.
+CpuIsa DetectCpuIsa();
+
+/// @brief The name of @p isa : "baseline", "ssse3", "avx2", "avx512" or
+/// "avx512vbmi".
+const char *CpuIsaName(CpuIsa isa);
+
+/// @brief What @see CpuIsa::kBaseline stands for on this build, like "sse2".
+const char *BaselineIsaName();
+
+/// @brief Parses one of the names of @see CpuIsaName .
+/// @return false if @p name is none of them
+bool CpuIsaByName(const std::string &name, CpuIsa &isa);
+
+/// @brief Sets the instruction set the kernels run with, like a lower one
+/// than @see DetectCpuIsa to compare the variants.
+/// @return false, leaving it as it was, if the CPU does not support @p isa
+bool SetCpuIsa(CpuIsa isa);
+
+/// @brief The instruction set the kernels run with, @see DetectCpuIsa
+/// unless @see SetCpuIsa changed it.
+CpuIsa GetCpuIsa();
@@ -0,0 +1,777 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PDI_LI_FILTER_SSE2 1
+#endif
+
+#include "cpu_features.h"
+#include "processing_context.h"
+#include "tile_scheduler.h"
+
+namespace {
+
+/// Columns of a tile of the filters: a ring row of that many 16 bit lanes
+/// is 2 KB, so the rows of the vertical window stay in the L1 or L2 cache.
+const int kTileColumns = 1024;
+
+/// Rows of a tile. Each tile filters the 2 radius rows around it again, so
+/// tiles are made at least 4 windows high to keep that under a fourth.
+const int kTileRows = 128;
+
+/// Lanes of a block of the kernels, one SSE2 register of 16 bit samples.
+const int kBlockLanes = 8;
+
+/// Bits of the largest dividend of @see Divider : a box sums at most
+/// 255 * 65^2 samples (under 2^21), plus half the divisor.
+const int kDividendBits = 22;
+
+FilterSettings filter_settings;
+
+int RoundUpToBlock(int count) {
+  return (count + kBlockLanes - 1) / kBlockLanes * kBlockLanes;
+}
+
+/// @brief The index read for the index @p i of an axis of @p size samples
+/// with @p border , or -1 for a zero sample.
+int BorderIndex(int i, int size, BorderMode border) {
+  if (i >= 0 && i < size) {
+    return i;
+  }
+
+  switch (border) {
+    using enum BorderMode;
+
+  case kClamp: {
+    return std::clamp(i, 0, size - 1);
+  }
+
+  case kReflect: {
+    if (size == 1) {
+      return 0;
+    }
+
+    int period = 2 * (size - 1);
+    int folded = i % period;
+    folded = folded < 0 ? folded + period : folded;
+    return folded < size ? folded : period - folded;
+  }
+
+  case kWrap: {
+    int folded = i % size;
+    return folded < 0 ? folded + size : folded;
+  }
+
+  default:
+    return -1;
+  }
+}
+
+/// @brief Copies the samples [ @p x0 - @p pad , @p x0 + @p count + @p pad )
+/// of the channel row @p from , of @p width samples @p step bytes apart, on
+/// @p to . The samples outside the row are read with @p border .
+void GatherRow(const byte *from, int step, int width, int x0, int count,
+               int pad, BorderMode border, byte *to) {
+  int total = count + 2 * pad;
+  int first = x0 - pad;
+
+  auto outside = [&](int i) {
+    int inside = BorderIndex(first + i, width, border);
+    to[i] = inside >= 0 ? from[inside * step] : 0;
+  };
+
+  int i = 0;
+  for (; i < total && first + i < 0; i++) {
+    outside(i);
+  }
+
+  for (; i < total && first + i < width; i++) {
+    to[i] = from[(first + i) * step];
+  }
+
+  for (; i < total; i++) {
+    outside(i);
+  }
+}
+
+/// @brief Writes the @p count samples of @p from on the channel row @p to ,
+/// @p step bytes apart.
+void ScatterRow(const byte *from, int count, byte *to, int step) {
+  if (step == 1) {
+    memcpy(to, from, count);
+    return;
+  }
+
+  for (int x = 0; x < count; x++) {
+    to[x * step] = from[x];
+  }
+}
+
+#if defined(PDI_LI_X86)
+/// @brief @see HorizontalRow 16 lanes at a time.
+/// @return The first lane left for @see HorizontalRow
+PDI_LI_TARGET_AVX2 int HorizontalRowAVX2(const byte *padded,
+                                         const SeparableKernel &kernel,
+                                         int lanes, uint16_t *to) {
+  int span = 2 * kernel.radius + 1;
+  __m256i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm256_set1_epi16(static_cast<short>(kernel.horizontal[k]));
+  }
+
+  int x = 0;
+  for (; x + 16 <= lanes; x += 16) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = 0; k < span; k++) {
+      __m256i samples = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(padded + x + k)));
+      sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(samples, taps[k]));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(to + x), sum);
+  }
+
+  return x;
+}
+
+/// @brief @see HorizontalRow 32 lanes at a time.
+PDI_LI_TARGET_AVX512 int HorizontalRowAVX512(const byte *padded,
+                                             const SeparableKernel &kernel,
+                                             int lanes, uint16_t *to) {
+  int span = 2 * kernel.radius + 1;
+  __m512i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm512_set1_epi16(static_cast<short>(kernel.horizontal[k]));
+  }
+
+  int x = 0;
+  for (; x + 32 <= lanes; x += 32) {
+    __m512i sum = _mm512_setzero_si512();
+    for (int k = 0; k < span; k++) {
+      __m512i samples = _mm512_cvtepu8_epi16(_mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(padded + x + k)));
+      sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(samples, taps[k]));
+    }
+    _mm512_storeu_si512(to + x, sum);
+  }
+
+  return x;
+}
+
+/// @brief @see VerticalRow 16 lanes at a time.
+/// @return The first lane left for @see VerticalRow
+PDI_LI_TARGET_AVX2 int VerticalRowAVX2(const uint16_t *const *rows,
+                                       const SeparableKernel &kernel,
+                                       int lanes, int bias, byte *to) {
+  int span = 2 * kernel.radius + 1;
+  __m256i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm256_set1_epi16(static_cast<short>(kernel.vertical[k]));
+  }
+  const __m256i rounding = _mm256_set1_epi16(static_cast<short>(bias));
+
+  int x = 0;
+  for (; x + 16 <= lanes; x += 16) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int k = 0; k < span; k++) {
+      __m256i sums =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[k] + x));
+      sum = _mm256_add_epi16(sum, _mm256_mulhi_epu16(sums, taps[k]));
+    }
+    sum = _mm256_srli_epi16(_mm256_add_epi16(sum, rounding),
+                            kHorizontalTapBits);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x),
+                     _mm_packus_epi16(_mm256_castsi256_si128(sum),
+                                      _mm256_extracti128_si256(sum, 1)));
+  }
+
+  return x;
+}
+
+/// @brief @see VerticalRow 32 lanes at a time.
+PDI_LI_TARGET_AVX512 int VerticalRowAVX512(const uint16_t *const *rows,
+                                           const SeparableKernel &kernel,
+                                           int lanes, int bias, byte *to) {
+  int span = 2 * kernel.radius + 1;
+  __m512i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm512_set1_epi16(static_cast<short>(kernel.vertical[k]));
+  }
+  const __m512i rounding = _mm512_set1_epi16(static_cast<short>(bias));
+
+  int x = 0;
+  for (; x + 32 <= lanes; x += 32) {
+    __m512i sum = _mm512_setzero_si512();
+    for (int k = 0; k < span; k++) {
+      __m512i sums = _mm512_loadu_si512(rows[k] + x);
+      sum = _mm512_add_epi16(sum, _mm512_mulhi_epu16(sums, taps[k]));
+    }
+    sum = _mm512_srli_epi16(_mm512_add_epi16(sum, rounding),
+                            kHorizontalTapBits);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(to + x),
+                        _mm512_cvtusepi16_epi8(sum));
+  }
+
+  return x;
+}
+
+/// @brief @see KernelRow 16 lanes at a time, the products sign extended to
+/// 32 bits a half at a time.
+/// @return The first lane left for @see KernelRow
+PDI_LI_TARGET_AVX2 int KernelRowAVX2(const byte *const *rows,
+                                     const Kernel &kernel, int lanes,
+                                     int half, byte *to) {
+  int size = kernel.size;
+  const __m256i rounding = _mm256_set1_epi32(half);
+  const __m128i shift = _mm_cvtsi32_si128(kernel.shift);
+
+  int x = 0;
+  for (; x + 16 <= lanes; x += 16) {
+    __m256i low = rounding;
+    __m256i high = rounding;
+
+    for (int i = 0; i < size; i++) {
+      for (int j = 0; j < size; j++) {
+        int tap = kernel.taps[i * size + j];
+        if (tap == 0) {
+          continue;
+        }
+
+        __m256i samples = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(rows[i] + x + j)));
+        __m256i products = _mm256_mullo_epi16(
+            samples, _mm256_set1_epi16(static_cast<short>(tap)));
+        low = _mm256_add_epi32(
+            low, _mm256_cvtepi16_epi32(_mm256_castsi256_si128(products)));
+        high = _mm256_add_epi32(
+            high, _mm256_cvtepi16_epi32(_mm256_extracti128_si256(products, 1)));
+      }
+    }
+
+    // The pack works within each 128 bit half, the permute puts the lanes
+    // back in order.
+    __m256i sums = _mm256_permute4x64_epi64(
+        _mm256_packs_epi32(_mm256_sra_epi32(low, shift),
+                           _mm256_sra_epi32(high, shift)),
+        _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x),
+                     _mm_packus_epi16(_mm256_castsi256_si128(sums),
+                                      _mm256_extracti128_si256(sums, 1)));
+  }
+
+  return x;
+}
+
+/// @brief @see KernelRow 32 lanes at a time, the sums clamped by a
+/// saturating narrowing.
+PDI_LI_TARGET_AVX512 int KernelRowAVX512(const byte *const *rows,
+                                         const Kernel &kernel, int lanes,
+                                         int half, byte *to) {
+  int size = kernel.size;
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i rounding = _mm512_set1_epi32(half);
+  const __m128i shift = _mm_cvtsi32_si128(kernel.shift);
+
+  int x = 0;
+  for (; x + 32 <= lanes; x += 32) {
+    __m512i low = rounding;
+    __m512i high = rounding;
+
+    for (int i = 0; i < size; i++) {
+      for (int j = 0; j < size; j++) {
+        int tap = kernel.taps[i * size + j];
+        if (tap == 0) {
+          continue;
+        }
+
+        __m512i samples = _mm512_cvtepu8_epi16(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(rows[i] + x + j)));
+        __m512i products = _mm512_mullo_epi16(
+            samples, _mm512_set1_epi16(static_cast<short>(tap)));
+        low = _mm512_add_epi32(
+            low, _mm512_cvtepi16_epi32(_mm512_castsi512_si256(products)));
+        high = _mm512_add_epi32(
+            high,
+            _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(products, 1)));
+      }
+    }
+
+    low = _mm512_max_epi32(_mm512_sra_epi32(low, shift), zero);
+    high = _mm512_max_epi32(_mm512_sra_epi32(high, shift), zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x),
+                     _mm512_cvtusepi32_epi8(low));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x + 16),
+                     _mm512_cvtusepi32_epi8(high));
+  }
+
+  return x;
+}
+#endif
+
+/// @brief Filters the @p lanes samples starting on @p padded (which holds
+/// the 2 radius samples around them too) with the horizontal taps of
+/// @p kernel , in @see kHorizontalTapBits fixed point. The sums fit 16 bits:
+/// at most 255 times the 2^8 the taps add up to.
+void HorizontalRow(const byte *padded, const SeparableKernel &kernel,
+                   int lanes, uint16_t *to, CpuIsa isa) {
+  int span = 2 * kernel.radius + 1;
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512) {
+    x = HorizontalRowAVX512(padded, kernel, lanes, to);
+  } else if (isa >= CpuIsa::kAVX2) {
+    x = HorizontalRowAVX2(padded, kernel, lanes, to);
+  }
+#endif
+
+#if defined(PDI_LI_FILTER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm_set1_epi16(static_cast<short>(kernel.horizontal[k]));
+  }
+
+  for (; x + kBlockLanes <= lanes; x += kBlockLanes) {
+    __m128i sum = zero;
+    for (int k = 0; k < span; k++) {
+      __m128i samples = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(
+              reinterpret_cast<const __m128i *>(padded + x + k)),
+          zero);
+      sum = _mm_add_epi16(sum, _mm_mullo_epi16(samples, taps[k]));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x), sum);
+  }
+#endif
+
+  for (; x < lanes; x++) {
+    uint32_t sum = 0;
+    for (int k = 0; k < span; k++) {
+      sum += static_cast<uint32_t>(kernel.horizontal[k]) * padded[x + k];
+    }
+    to[x] = static_cast<uint16_t>(sum);
+  }
+}
+
+/// @brief Filters the @p lanes sums of each of the 2 radius + 1 @p rows with
+/// the vertical taps of @p kernel : each sum is scaled by the high half of
+/// its product with the tap, so the lanes stay 16 bits wide. Dropping the
+/// low half truncates every product, which the rounding makes up for on
+/// average with half a unit per tap.
+void VerticalRow(const uint16_t *const *rows, const SeparableKernel &kernel,
+                 int lanes, byte *to, CpuIsa isa) {
+  int span = 2 * kernel.radius + 1;
+  int bias = (1 << (kHorizontalTapBits - 1)) + span / 2;
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512) {
+    x = VerticalRowAVX512(rows, kernel, lanes, bias, to);
+  } else if (isa >= CpuIsa::kAVX2) {
+    x = VerticalRowAVX2(rows, kernel, lanes, bias, to);
+  }
+#endif
+
+#if defined(PDI_LI_FILTER_SSE2)
+  __m128i taps[2 * kMaxFilterRadius + 1];
+  for (int k = 0; k < span; k++) {
+    taps[k] = _mm_set1_epi16(static_cast<short>(kernel.vertical[k]));
+  }
+  const __m128i rounding = _mm_set1_epi16(static_cast<short>(bias));
+
+  for (; x + kBlockLanes <= lanes; x += kBlockLanes) {
+    __m128i sum = _mm_setzero_si128();
+    for (int k = 0; k < span; k++) {
+      __m128i sums =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + x));
+      sum = _mm_add_epi16(sum, _mm_mulhi_epu16(sums, taps[k]));
+    }
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), kHorizontalTapBits);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(to + x),
+                     _mm_packus_epi16(sum, sum));
+  }
+#endif
+
+  for (; x < lanes; x++) {
+    uint32_t sum = 0;
+    for (int k = 0; k < span; k++) {
+      sum += static_cast<uint32_t>(rows[k][x]) * kernel.vertical[k] >>
+             kVerticalTapBits;
+    }
+    to[x] = static_cast<byte>((sum + bias) >> kHorizontalTapBits);
+  }
+}
+
+/// @brief Convolves the @p lanes samples of the rows of @p kernel , each
+/// starting on its row of @p rows (which hold the samples around them too).
+/// The products of a tap and a sample fit 16 bits and are summed in 32.
+void KernelRow(const byte *const *rows, const Kernel &kernel, int lanes,
+               byte *to, CpuIsa isa) {
+  int size = kernel.size;
+  int half = kernel.shift > 0 ? 1 << (kernel.shift - 1) : 0;
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512) {
+    x = KernelRowAVX512(rows, kernel, lanes, half, to);
+  } else if (isa >= CpuIsa::kAVX2) {
+    x = KernelRowAVX2(rows, kernel, lanes, half, to);
+  }
+#endif
+
+#if defined(PDI_LI_FILTER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i rounding = _mm_set1_epi32(half);
+  const __m128i shift = _mm_cvtsi32_si128(kernel.shift);
+
+  for (; x + kBlockLanes <= lanes; x += kBlockLanes) {
+    __m128i low = rounding;
+    __m128i high = rounding;
+
+    for (int i = 0; i < size; i++) {
+      for (int j = 0; j < size; j++) {
+        int tap = kernel.taps[i * size + j];
+        if (tap == 0) {
+          continue;
+        }
+
+        __m128i samples = _mm_unpacklo_epi8(
+            _mm_loadl_epi64(
+                reinterpret_cast<const __m128i *>(rows[i] + x + j)),
+            zero);
+        __m128i products = _mm_mullo_epi16(
+            samples, _mm_set1_epi16(static_cast<short>(tap)));
+        // Pairing a lane with itself and shifting it back sign extends it.
+        low = _mm_add_epi32(
+            low, _mm_srai_epi32(_mm_unpacklo_epi16(products, products), 16));
+        high = _mm_add_epi32(
+            high, _mm_srai_epi32(_mm_unpackhi_epi16(products, products), 16));
+      }
+    }
+
+    __m128i sums = _mm_packs_epi32(_mm_sra_epi32(low, shift),
+                                   _mm_sra_epi32(high, shift));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(to + x),
+                     _mm_packus_epi16(sums, sums));
+  }
+#endif
+
+  for (; x < lanes; x++) {
+    int32_t sum = half;
+    for (int i = 0; i < size; i++) {
+      for (int j = 0; j < size; j++) {
+        sum += kernel.taps[i * size + j] * rows[i][x + j];
+      }
+    }
+    to[x] = static_cast<byte>(std::clamp(sum >> kernel.shift, 0, 255));
+  }
+}
+
+/// @brief Divides by a constant with a multiply and a shift, exactly for
+/// dividends under 2^ @see kDividendBits (Granlund and Montgomery).
+struct Divider {
+  uint64_t multiplier = 1;
+  int shift = 0;
+
+  explicit Divider(uint32_t divisor) {
+    int bits = 0;
+    while ((uint64_t(1) << bits) < divisor) {
+      bits++;
+    }
+
+    shift = kDividendBits + bits;
+    multiplier = ((uint64_t(1) << shift) + divisor - 1) / divisor;
+  }
+
+  uint32_t operator()(uint32_t dividend) const {
+    return static_cast<uint32_t>(dividend * multiplier >> shift);
+  }
+};
+
+/// @brief Writes on @p to the sum of each window of 2 @p radius + 1 samples
+/// of @p padded , updated as the window slides by one sample.
+void RowSums(const byte *padded, int count, int radius, uint16_t *to) {
+  int span = 2 * radius + 1;
+  uint32_t sum = 0;
+  for (int k = 0; k < span; k++) {
+    sum += padded[k];
+  }
+
+  to[0] = static_cast<uint16_t>(sum);
+  for (int x = 1; x < count; x++) {
+    sum += padded[x + span - 1];
+    sum -= padded[x - 1];
+    to[x] = static_cast<uint16_t>(sum);
+  }
+}
+
+/// @brief Copies the alpha of the @p tile of @p src on @p dst , since the
+/// filters only write the color samples.
+void CopyAlpha(const Image &src, Image &dst, const Rectangle &tile) {
+  for (int y = tile.y; y < tile.y + tile.height; y++) {
+    for (int x = tile.x; x < tile.x + tile.width; x++) {
+      dst.row(y)[4 * x + BGRA32::kAlphaByte] =
+          src.row(y)[4 * x + BGRA32::kAlphaByte];
+    }
+  }
+}
+
+/// @brief Runs @p fn on the tiles of @p src and on each of their color
+/// channels, with the arena of a scope open for the tile.
+/// @param radius How far from a pixel the filter reads, which sets the
+/// height of the tiles
+/// @param fn A callable with the signature
+/// void(int channel, const Rectangle &tile, ScratchArena &arena)
+template <typename Fn>
+void ForEachChannelTile(const Image &src, Image &dst, int radius, Fn &&fn) {
+  int tile_rows = std::max(kTileRows, 4 * (2 * radius + 1));
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = src.width(),
+                .height = src.height()},
+      kTileColumns, tile_rows, [&](const Rectangle &tile) {
+        ScratchScope tile_scope(GetProcessingContext().arena());
+        for (int c = 0; c < src.color_channels(); c++) {
+          fn(c, tile, tile_scope.arena());
+        }
+
+        if (src.format() == PixelFormat::kBGRA32) {
+          CopyAlpha(src, dst, tile);
+        }
+      });
+}
+
+/// @brief The @p 2 radius + 1 taps, in @p bits fixed point, closest to
+/// @p weights over @p total . The center tap takes the rounding error, so
+/// the taps always add up to 2^ @p bits .
+void QuantizeTaps(const double *weights, double total, int radius, int bits,
+                  uint16_t *taps) {
+  int64_t one = int64_t(1) << bits;
+  int64_t sides = 0;
+
+  for (int k = 0; k < 2 * radius + 1; k++) {
+    if (k == radius) {
+      continue;
+    }
+
+    taps[k] = static_cast<uint16_t>(std::llround(weights[k] / total * one));
+    sides += taps[k];
+  }
+
+  taps[radius] = static_cast<uint16_t>(one - sides);
+}
+
+} // namespace
+
+bool BorderModeByName(const std::string &name, BorderMode &mode) {
+  if (name == "clamp") {
+    mode = BorderMode::kClamp;
+  } else if (name == "reflect") {
+    mode = BorderMode::kReflect;
+  } else if (name == "wrap") {
+    mode = BorderMode::kWrap;
+  } else if (name == "zero") {
+    mode = BorderMode::kZero;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+SeparableKernel GaussianKernel(double sigma) {
+  sigma = std::clamp(sigma, kMinGaussianSigma, kMaxGaussianSigma);
+
+  SeparableKernel kernel;
+  kernel.radius = std::min(static_cast<int>(std::ceil(3 * sigma)),
+                           kMaxFilterRadius);
+
+  double weights[2 * kMaxFilterRadius + 1];
+  double total = 0;
+  for (int k = -kernel.radius; k <= kernel.radius; k++) {
+    weights[k + kernel.radius] = std::exp(-k * k / (2 * sigma * sigma));
+    total += weights[k + kernel.radius];
+  }
+
+  // The narrowest Gaussian still has side taps, so the center one of the
+  // vertical taps stays under 2^16.
+  QuantizeTaps(weights, total, kernel.radius, kHorizontalTapBits,
+               kernel.horizontal);
+  QuantizeTaps(weights, total, kernel.radius, kVerticalTapBits,
+               kernel.vertical);
+
+  return kernel;
+}
+
+bool IsValidKernel(const Kernel &kernel) {
+  if ((kernel.size != 3 && kernel.size != 5) || kernel.shift < 0 ||
+      kernel.shift > 16) {
+    return false;
+  }
+
+  return std::all_of(kernel.taps, kernel.taps + kernel.size * kernel.size,
+                     [](int tap) { return std::abs(tap) <= kMaxKernelTap; });
+}
+
+Kernel SharpenKernel() {
+  return Kernel{.size = 3,
+                .shift = 0,
+                .taps = {0, -1, 0, -1, 5, -1, 0, -1, 0}};
+}
+
+void SetFilterSettings(const FilterSettings &settings) {
+  filter_settings = settings;
+}
+
+const FilterSettings &GetFilterSettings() { return filter_settings; }
+
+void SeparableFilter(const Image &src, Image &dst,
+                     const SeparableKernel &kernel, BorderMode border) {
+  int radius = kernel.radius;
+  int span = 2 * radius + 1;
+  int step = src.pixel_step();
+  CpuIsa isa = GetCpuIsa();
+
+  ForEachChannelTile(src, dst, radius, [&](int c, const Rectangle &tile,
+                                           ScratchArena &arena) {
+    int lanes = RoundUpToBlock(tile.width);
+    byte *padded = arena.Allocate<byte>(lanes + 2 * radius);
+    uint16_t *ring =
+        arena.Allocate<uint16_t>(static_cast<size_t>(span) * lanes);
+    const uint16_t **window = arena.Allocate<const uint16_t *>(span);
+    byte *out = arena.Allocate<byte>(lanes);
+    int top = tile.y - radius;
+
+    // The row v of the window sits on the slot (v - top) % span of the
+    // ring, filtered once when it enters the window.
+    auto slot = [&](int v) {
+      return ring + static_cast<size_t>((v - top) % span) * lanes;
+    };
+
+    for (int v = top; v < tile.y + tile.height + radius; v++) {
+      int source = BorderIndex(v, src.height(), border);
+      if (source < 0) {
+        memset(slot(v), 0, lanes * sizeof(uint16_t));
+      } else {
+        GatherRow(src.channel_row(c, source), step, src.width(), tile.x,
+                  lanes, radius, border, padded);
+        HorizontalRow(padded, kernel, lanes, slot(v), isa);
+      }
+
+      int y = v - radius;
+      if (y < tile.y) {
+        continue;
+      }
+
+      for (int k = 0; k < span; k++) {
+        window[k] = slot(y - radius + k);
+      }
+      VerticalRow(window, kernel, lanes, out, isa);
+      ScatterRow(out, tile.width, dst.channel_row(c, y) + tile.x * step,
+                 step);
+    }
+  });
+}
+
+void BoxFilter(const Image &src, Image &dst, int radius, BorderMode border) {
+  radius = std::clamp(radius, 0, kMaxFilterRadius);
+  int span = 2 * radius + 1;
+  int step = src.pixel_step();
+  Divider mean(static_cast<uint32_t>(span * span));
+
+  ForEachChannelTile(src, dst, radius, [&](int c, const Rectangle &tile,
+                                           ScratchArena &arena) {
+    int width = tile.width;
+    byte *padded = arena.Allocate<byte>(width + 2 * radius);
+    // Zeroed, so the rows leaving the window before the first ones entered
+    // it subtract nothing.
+    uint16_t *ring =
+        arena.Allocate<uint16_t>(static_cast<size_t>(span) * width);
+    uint32_t *columns = arena.Allocate<uint32_t>(width);
+    byte *out = arena.Allocate<byte>(width);
+    int top = tile.y - radius;
+
+    for (int v = top; v < tile.y + tile.height + radius; v++) {
+      // The slot of v held the row v - span, which leaves the window now.
+      uint16_t *sums = ring + static_cast<size_t>((v - top) % span) * width;
+      for (int x = 0; x < width; x++) {
+        columns[x] -= sums[x];
+      }
+
+      int source = BorderIndex(v, src.height(), border);
+      if (source < 0) {
+        memset(sums, 0, width * sizeof(uint16_t));
+      } else {
+        GatherRow(src.channel_row(c, source), step, src.width(), tile.x,
+                  width, radius, border, padded);
+        RowSums(padded, width, radius, sums);
+      }
+
+      for (int x = 0; x < width; x++) {
+        columns[x] += sums[x];
+      }
+
+      int y = v - radius;
+      if (y < tile.y) {
+        continue;
+      }
+
+      for (int x = 0; x < width; x++) {
+        out[x] = static_cast<byte>(mean(columns[x] + span * span / 2));
+      }
+      ScatterRow(out, width, dst.channel_row(c, y) + tile.x * step, step);
+    }
+  });
+}
+
+void Convolve(const Image &src, Image &dst, const Kernel &kernel,
+              BorderMode border) {
+  int size = kernel.size;
+  int radius = size / 2;
+  int step = src.pixel_step();
+  CpuIsa isa = GetCpuIsa();
+
+  ForEachChannelTile(src, dst, radius, [&](int c, const Rectangle &tile,
+                                           ScratchArena &arena) {
+    int lanes = RoundUpToBlock(tile.width);
+    int padded_width = lanes + 2 * radius;
+    byte *ring =
+        arena.Allocate<byte>(static_cast<size_t>(size) * padded_width);
+    const byte **window = arena.Allocate<const byte *>(size);
+    byte *out = arena.Allocate<byte>(lanes);
+    int top = tile.y - radius;
+
+    auto slot = [&](int v) {
+      return ring + static_cast<size_t>((v - top) % size) * padded_width;
+    };
+
+    for (int v = top; v < tile.y + tile.height + radius; v++) {
+      int source = BorderIndex(v, src.height(), border);
+      if (source < 0) {
+        memset(slot(v), 0, padded_width);
+      } else {
+        GatherRow(src.channel_row(c, source), step, src.width(), tile.x,
+                  lanes, radius, border, slot(v));
+      }
+
+      int y = v - radius;
+      if (y < tile.y) {
+        continue;
+      }
+
+      for (int i = 0; i < size; i++) {
+        window[i] = slot(y - radius + i);
+      }
+      KernelRow(window, kernel, lanes, out, isa);
+      ScatterRow(out, tile.width, dst.channel_row(c, y) + tile.x * step,
+                 step);
+    }
+  });
+}
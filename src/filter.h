@@ -0,0 +1,122 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "image.h"
+
+/// @brief How the filters read the pixels outside the image
+enum class BorderMode {
+  /// The nearest pixel of the image (aaa|abcd|ddd)
+  kClamp = 0,
+  /// The image mirrored around its edge pixel (dcb|abcd|cba)
+  kReflect,
+  /// The opposite side of the image (bcd|abcd|abc)
+  kWrap,
+  /// Black (000|abcd|000)
+  kZero
+};
+
+/// @brief Parses "clamp", "reflect", "wrap" or "zero".
+/// @return false if @p name is none of them
+bool BorderModeByName(const std::string &name, BorderMode &mode);
+
+/// The largest radius of the separable and box filters.
+const int kMaxFilterRadius = 32;
+
+/// The largest |tap| of a @see Kernel , so a tap times a sample fits 16 bits.
+const int kMaxKernelTap = 128;
+
+/// Fraction bits of the horizontal taps of a @see SeparableKernel .
+const int kHorizontalTapBits = 8;
+
+/// Fraction bits of the vertical taps of a @see SeparableKernel .
+const int kVerticalTapBits = 16;
+
+/// @brief A kernel that is the product of a column and a row of taps, the same
+/// on both axes, in 16 bit fixed point: the horizontal taps sum to
+/// 2^ @see kHorizontalTapBits , so a filtered row of 8 bit samples fits 16 bit
+/// lanes exactly, and the vertical taps sum to 2^ @see kVerticalTapBits and
+/// scale those lanes with a high half multiply.
+struct SeparableKernel {
+  int radius = 0;
+  uint16_t horizontal[2 * kMaxFilterRadius + 1] = {};
+  uint16_t vertical[2 * kMaxFilterRadius + 1] = {};
+};
+
+/// The narrowest and widest @see GaussianKernel .
+const double kMinGaussianSigma = 0.25;
+const double kMaxGaussianSigma = 10.0;
+
+/// @brief The Gaussian of standard deviation @p sigma , cut at 3 sigma.
+/// @param sigma From @see kMinGaussianSigma to @see kMaxGaussianSigma
+SeparableKernel GaussianKernel(double sigma);
+
+/// @brief A general @p size x @p size kernel of integer taps: the result is
+/// the sum of the taps times the samples under them, divided by 2^ @p shift
+/// with rounding and clamped to [0, 255].
+struct Kernel {
+  int size = 3;
+  int shift = 0;
+  int16_t taps[25] = {};
+};
+
+/// @brief Whether @p kernel is 3x3 or 5x5 with taps up to
+/// @see kMaxKernelTap in magnitude and a shift from 0 to 16.
+bool IsValidKernel(const Kernel &kernel);
+
+/// @brief The 3x3 kernel adding the Laplacian of each pixel to it.
+Kernel SharpenKernel();
+
+/// @brief What the filter commands run with
+struct FilterSettings {
+  /// The standard deviation of the blur command
+  double blur_sigma = 1.0;
+  /// The radius of the box_blur command, which averages
+  /// (2 radius + 1)^2 pixels
+  int box_radius = 1;
+  /// The kernel of the convolve command
+  Kernel kernel = SharpenKernel();
+  BorderMode border = BorderMode::kReflect;
+};
+
+/// @brief Sets the settings used by the filter commands.
+void SetFilterSettings(const FilterSettings &settings);
+
+/// @brief The settings used by the filter commands, the defaults of
+/// @see FilterSettings if they were never set.
+const FilterSettings &GetFilterSettings();
+
+/// @brief Filters each color channel of @p src with the separable @p kernel ,
+/// a pass over the rows and one over the columns. The image is cut in tiles
+/// and each tile keeps its 2 radius + 1 last filtered rows on a ring, so the
+/// vertical pass reads rows still in the cache.
+/// @param src The image to be read
+/// @param dst [out] An image of the size, format and layout of @p src , other
+/// than @p src
+/// @param kernel The taps, see @see GaussianKernel
+/// @param border How the pixels outside @p src are read
+void SeparableFilter(const Image &src, Image &dst,
+                     const SeparableKernel &kernel, BorderMode border);
+
+/// @brief Replaces each sample of @p src by the mean of the (2 @p radius +
+/// 1)^2 samples around it. The sums run along the rows and down the columns,
+/// adding the sample entering the window and subtracting the one leaving it,
+/// so a pixel costs the same for any radius.
+/// @param src The image to be read
+/// @param dst [out] Like the one of @see SeparableFilter
+/// @param radius From 0 to @see kMaxFilterRadius
+/// @param border How the pixels outside @p src are read
+void BoxFilter(const Image &src, Image &dst, int radius, BorderMode border);
+
+/// @brief Convolves each color channel of @p src with the general @p kernel ,
+/// see @see Kernel .
+/// @param src The image to be read
+/// @param dst [out] Like the one of @see SeparableFilter
+/// @param kernel A kernel for which @see IsValidKernel is true
+/// @param border How the pixels outside @p src are read
+void Convolve(const Image &src, Image &dst, const Kernel &kernel,
+              BorderMode border);
@@ -0,0 +1,37 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature> class FunctionRef;
+
+/// @brief A non owning reference to a callable, like the std::function it
+/// replaces on the parallel loops but never allocating: it only keeps a
+/// pointer to the callable, which must outlive it. Meant for parameters, the
+/// lambda given at the call site lives until the call returns.
+template <typename R, typename... Args> class FunctionRef<R(Args...)> {
+public:
+  template <typename Fn,
+            typename = std::enable_if_t<
+                !std::is_same_v<std::remove_cvref_t<Fn>, FunctionRef> &&
+                std::is_invocable_r_v<R, Fn &, Args...>>>
+  FunctionRef(Fn &&fn)
+      : callable_(const_cast<void *>(
+            static_cast<const void *>(std::addressof(fn)))),
+        call_([](void *callable, Args... args) -> R {
+          return (*static_cast<std::remove_reference_t<Fn> *>(callable))(
+              std::forward<Args>(args)...);
+        }) {}
+
+  R operator()(Args... args) const {
+    return call_(callable_, std::forward<Args>(args)...);
+  }
+
+private:
+  void *callable_;
+  R (*call_)(void *, Args...);
+};
@@ -0,0 +1,566 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "gpu_backend.h"
+
+#if defined(PDI_LI_ENABLE_OPENCL)
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#if defined(__APPLE__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+namespace {
+
+#if defined(PDI_LI_ENABLE_OPENCL)
+bool offload = true;
+#else
+bool offload = false;
+#endif
+
+int64_t min_pixels = kDefaultGpuMinPixels;
+
+} // namespace
+
+void SetGpuOffload(bool enabled) { offload = enabled; }
+
+void SetGpuMinPixels(int64_t pixels) { min_pixels = pixels; }
+
+bool ShouldOffload(const Image &img) {
+  return offload && img.layout() == PixelLayout::kInterleaved &&
+         static_cast<int64_t>(img.width()) * img.height() >= min_pixels &&
+         GpuAvailable();
+}
+
+#if defined(PDI_LI_ENABLE_OPENCL)
+
+namespace {
+
+/// Chunks in flight: one being packed or unpacked by the host while the
+/// other one goes through the device.
+const int kSlots = 2;
+
+/// Bytes of pixels sent to the device at a time.
+const size_t kChunkBytes = size_t(8) << 20;
+
+/// Work items of a histogram work group, each group counts on its own bins.
+const size_t kGroupSize = 256;
+
+/// Upper bound on the histogram work groups, their bins are merged with
+/// global atomics at the end.
+const size_t kMaxGroups = 1024;
+
+/// The channels of gray pixels all point to their single sample, whose table
+/// is the red one like on @see ApplyChannelLUT .
+const char *kKernelSource = R"(
+__kernel void count_histogram(__global const uchar *pixels, uint count,
+                              uint pixel_bytes, uint red, uint green,
+                              uint blue, uint channels,
+                              __global uint *bins) {
+  __local uint local_bins[3 * 256];
+
+  for (uint i = get_local_id(0); i < 3 * 256; i += get_local_size(0)) {
+    local_bins[i] = 0;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (uint p = get_global_id(0); p < count; p += get_global_size(0)) {
+    __global const uchar *pixel = pixels + p * pixel_bytes;
+    atomic_inc(&local_bins[pixel[red]]);
+    atomic_inc(&local_bins[256 + pixel[green]]);
+    atomic_inc(&local_bins[512 + pixel[blue]]);
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  for (uint i = get_local_id(0); i < 3 * 256; i += get_local_size(0)) {
+    if (local_bins[i] != 0) {
+      atomic_add(&bins[i], local_bins[i]);
+    }
+  }
+}
+
+__kernel void apply_lut(__global uchar *pixels, uint count, uint pixel_bytes,
+                        uint red, uint green, uint blue, uint channels,
+                        __constant uchar *tables) {
+  uint p = get_global_id(0);
+  if (p >= count) {
+    return;
+  }
+
+  __global uchar *pixel = pixels + p * pixel_bytes;
+  pixel[red] = tables[pixel[red]];
+  if (channels > 1) {
+    pixel[green] = tables[256 + pixel[green]];
+    pixel[blue] = tables[512 + pixel[blue]];
+  }
+}
+)";
+
+/// @brief The OpenCL objects of the device, set up once and kept for the
+/// whole run. The host side of the chunks are pinned buffers
+/// (CL_MEM_ALLOC_HOST_PTR) mapped for good, so the transfers run at the
+/// full bus speed and without blocking the host.
+struct GpuDevice {
+  bool ready = false;
+  std::string name;
+  std::mutex mutex;
+
+  cl_context context = nullptr;
+  cl_command_queue queue = nullptr;
+  cl_program program = nullptr;
+  cl_kernel histogram = nullptr;
+  cl_kernel apply = nullptr;
+  cl_mem bins = nullptr;
+  cl_mem tables = nullptr;
+  cl_mem pinned[kSlots] = {nullptr, nullptr};
+  byte *staging[kSlots] = {nullptr, nullptr};
+  cl_mem chunks[kSlots] = {nullptr, nullptr};
+
+  ~GpuDevice();
+};
+
+GpuDevice::~GpuDevice() {
+  if (queue != nullptr) {
+    clFinish(queue);
+  }
+
+  for (int slot = 0; slot < kSlots; slot++) {
+    if (staging[slot] != nullptr) {
+      clEnqueueUnmapMemObject(queue, pinned[slot], staging[slot], 0, nullptr,
+                              nullptr);
+    }
+    if (pinned[slot] != nullptr) {
+      clReleaseMemObject(pinned[slot]);
+    }
+    if (chunks[slot] != nullptr) {
+      clReleaseMemObject(chunks[slot]);
+    }
+  }
+
+  if (queue != nullptr) {
+    clFinish(queue);
+  }
+
+  if (tables != nullptr) {
+    clReleaseMemObject(tables);
+  }
+  if (bins != nullptr) {
+    clReleaseMemObject(bins);
+  }
+  if (apply != nullptr) {
+    clReleaseKernel(apply);
+  }
+  if (histogram != nullptr) {
+    clReleaseKernel(histogram);
+  }
+  if (program != nullptr) {
+    clReleaseProgram(program);
+  }
+  if (queue != nullptr) {
+    clReleaseCommandQueue(queue);
+  }
+  if (context != nullptr) {
+    clReleaseContext(context);
+  }
+}
+
+GpuDevice gpu;
+
+/// @brief Finds the first GPU of any platform and builds the kernels on it.
+/// @return false if there is no GPU or something could not be created
+bool SetUp(GpuDevice &device) {
+  cl_uint platform_count = 0;
+  if (clGetPlatformIDs(0, nullptr, &platform_count) != CL_SUCCESS ||
+      platform_count == 0) {
+    return false;
+  }
+
+  std::vector<cl_platform_id> platforms(platform_count);
+  if (clGetPlatformIDs(platform_count, platforms.data(), nullptr) !=
+      CL_SUCCESS) {
+    return false;
+  }
+
+  cl_device_id id = nullptr;
+  for (cl_platform_id platform : platforms) {
+    if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &id, nullptr) ==
+        CL_SUCCESS) {
+      break;
+    }
+    id = nullptr;
+  }
+
+  if (id == nullptr) {
+    return false;
+  }
+
+  char name[256] = {};
+  clGetDeviceInfo(id, CL_DEVICE_NAME, sizeof(name) - 1, name, nullptr);
+  device.name = name;
+
+  cl_int error = CL_SUCCESS;
+  device.context = clCreateContext(nullptr, 1, &id, nullptr, nullptr, &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  device.queue = clCreateCommandQueue(device.context, id, 0, &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  device.program = clCreateProgramWithSource(device.context, 1,
+                                             &kKernelSource, nullptr, &error);
+  if (error != CL_SUCCESS ||
+      clBuildProgram(device.program, 1, &id, nullptr, nullptr, nullptr) !=
+          CL_SUCCESS) {
+    return false;
+  }
+
+  device.histogram = clCreateKernel(device.program, "count_histogram", &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  device.apply = clCreateKernel(device.program, "apply_lut", &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  device.bins = clCreateBuffer(device.context, CL_MEM_READ_WRITE,
+                               sizeof(cl_uint) * 3 * 256, nullptr, &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  device.tables = clCreateBuffer(device.context, CL_MEM_READ_ONLY,
+                                 sizeof(LUT3::table), nullptr, &error);
+  if (error != CL_SUCCESS) {
+    return false;
+  }
+
+  for (int slot = 0; slot < kSlots; slot++) {
+    device.pinned[slot] =
+        clCreateBuffer(device.context,
+                       CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, kChunkBytes,
+                       nullptr, &error);
+    if (error != CL_SUCCESS) {
+      return false;
+    }
+
+    device.staging[slot] = static_cast<byte *>(clEnqueueMapBuffer(
+        device.queue, device.pinned[slot], CL_TRUE,
+        CL_MAP_READ | CL_MAP_WRITE, 0, kChunkBytes, 0, nullptr, nullptr,
+        &error));
+    if (error != CL_SUCCESS) {
+      device.staging[slot] = nullptr;
+      return false;
+    }
+
+    device.chunks[slot] = clCreateBuffer(device.context, CL_MEM_READ_WRITE,
+                                         kChunkBytes, nullptr, &error);
+    if (error != CL_SUCCESS) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @brief Waits for @p event and releases it, if there is one.
+/// @return false if the command behind it failed
+bool WaitFor(cl_event &event) {
+  if (event == nullptr) {
+    return true;
+  }
+
+  bool done = clWaitForEvents(1, &event) == CL_SUCCESS;
+  clReleaseEvent(event);
+  event = nullptr;
+
+  return done;
+}
+
+/// @brief Waits for every command in flight, so none touches the staging
+/// buffers later, and releases @p events .
+void Drain(cl_event *events) {
+  clFinish(gpu.queue);
+
+  for (int slot = 0; slot < kSlots; slot++) {
+    WaitFor(events[slot]);
+  }
+}
+
+/// @brief Rows of @p img packed into a chunk.
+int ChunkRows(const Image &img) {
+  size_t row_bytes =
+      static_cast<size_t>(img.width()) * BytesPerPixel(img.format());
+  return static_cast<int>(
+      std::min<size_t>(kChunkBytes / row_bytes, img.height()));
+}
+
+/// @brief Copies the rows [ @p begin , @p end ) of @p img to @p chunk ,
+/// without the padding between them.
+void PackRows(const Image &img, int begin, int end, byte *chunk) {
+  size_t row_bytes =
+      static_cast<size_t>(img.width()) * BytesPerPixel(img.format());
+
+  for (int y = begin; y < end; y++) {
+    memcpy(chunk + (y - begin) * row_bytes, img.row(y), row_bytes);
+  }
+}
+
+/// @brief Copies @p chunk back to the rows [ @p begin , @p end ) of @p img .
+void UnpackRows(const byte *chunk, int begin, int end, Image &img) {
+  size_t row_bytes =
+      static_cast<size_t>(img.width()) * BytesPerPixel(img.format());
+
+  for (int y = begin; y < end; y++) {
+    memcpy(img.row(y), chunk + (y - begin) * row_bytes, row_bytes);
+  }
+}
+
+/// @brief Sets the arguments both kernels share: the chunk, its pixel count
+/// and where the channels of @p img are on a pixel.
+bool SetPixelArgs(cl_kernel kernel, cl_mem chunk, cl_uint count,
+                  const Image &img) {
+  cl_uint pixel_bytes = BytesPerPixel(img.format());
+  cl_uint channels = img.color_channels();
+  cl_uint offsets[Image::kChannels];
+  for (int c = 0; c < Image::kChannels; c++) {
+    offsets[c] =
+        channels == 1 ? 0 : static_cast<cl_uint>(img.channel_offset(c));
+  }
+
+  return clSetKernelArg(kernel, 0, sizeof(cl_mem), &chunk) == CL_SUCCESS &&
+         clSetKernelArg(kernel, 1, sizeof(cl_uint), &count) == CL_SUCCESS &&
+         clSetKernelArg(kernel, 2, sizeof(cl_uint), &pixel_bytes) ==
+             CL_SUCCESS &&
+         clSetKernelArg(kernel, 3, sizeof(cl_uint), &offsets[kRed]) ==
+             CL_SUCCESS &&
+         clSetKernelArg(kernel, 4, sizeof(cl_uint), &offsets[kGreen]) ==
+             CL_SUCCESS &&
+         clSetKernelArg(kernel, 5, sizeof(cl_uint), &offsets[kBlue]) ==
+             CL_SUCCESS &&
+         clSetKernelArg(kernel, 6, sizeof(cl_uint), &channels) == CL_SUCCESS;
+}
+
+/// @brief Queues the histogram of the @p count pixels of the chunk @p slot ,
+/// added to the bins on the device.
+bool EnqueueHistogram(int slot, cl_uint count, const Image &img) {
+  size_t groups = std::clamp<size_t>(count / (kGroupSize * 16), 1, kMaxGroups);
+  size_t global_size = groups * kGroupSize;
+
+  return SetPixelArgs(gpu.histogram, gpu.chunks[slot], count, img) &&
+         clSetKernelArg(gpu.histogram, 7, sizeof(cl_mem), &gpu.bins) ==
+             CL_SUCCESS &&
+         clEnqueueNDRangeKernel(gpu.queue, gpu.histogram, 1, nullptr,
+                                &global_size, &kGroupSize, 0, nullptr,
+                                nullptr) == CL_SUCCESS;
+}
+
+/// @brief Queues the tables on the @p count pixels of the chunk @p slot .
+bool EnqueueApply(int slot, cl_uint count, const Image &img) {
+  size_t global_size = count;
+
+  return SetPixelArgs(gpu.apply, gpu.chunks[slot], count, img) &&
+         clSetKernelArg(gpu.apply, 7, sizeof(cl_mem), &gpu.tables) ==
+             CL_SUCCESS &&
+         clEnqueueNDRangeKernel(gpu.queue, gpu.apply, 1, nullptr,
+                                &global_size, nullptr, 0, nullptr,
+                                nullptr) == CL_SUCCESS;
+}
+
+/// @brief A view of the rows [ @p begin , @p end ) of @p img .
+Image RowsOf(Image &img, int begin, int end) {
+  if (img.format() == PixelFormat::kRGB24) {
+    ChannelOrder order = img.channel_offset(kRed) == 0 ? ChannelOrder::kRGB
+                                                       : ChannelOrder::kBGR;
+    return Image::WrapInterleaved(img.row(begin), img.width(), end - begin,
+                                  img.stride(), order);
+  }
+
+  return Image::Wrap(img.row(begin), img.width(), end - begin, img.stride(),
+                     img.format());
+}
+
+} // namespace
+
+bool GpuAvailable() {
+  static std::once_flag once;
+  std::call_once(once, [] { gpu.ready = SetUp(gpu); });
+
+  return gpu.ready;
+}
+
+const char *GpuDeviceName() {
+  return GpuAvailable() ? gpu.name.c_str() : "";
+}
+
+bool GpuHistogram(const Image &img, RGBHistogram &histogram) {
+  // A busy device leaves the image to the CPU instead of queueing on it.
+  std::unique_lock lock(gpu.mutex, std::try_to_lock);
+  int chunk_rows = ChunkRows(img);
+  if (!lock || !gpu.ready || chunk_rows == 0) {
+    return false;
+  }
+
+  // The counters of the device are 32 bits, too few for the biggest images.
+  if (static_cast<int64_t>(img.width()) * img.height() > UINT32_MAX) {
+    return false;
+  }
+
+  const cl_uint zero = 0;
+  if (clEnqueueFillBuffer(gpu.queue, gpu.bins, &zero, sizeof(zero), 0,
+                          sizeof(cl_uint) * 3 * 256, 0, nullptr,
+                          nullptr) != CL_SUCCESS) {
+    return false;
+  }
+
+  size_t pixel_bytes = BytesPerPixel(img.format());
+  cl_event sent[kSlots] = {nullptr, nullptr};
+  int chunk = 0;
+
+  for (int begin = 0; begin < img.height(); begin += chunk_rows, chunk++) {
+    int slot = chunk % kSlots;
+    int end = std::min(begin + chunk_rows, img.height());
+    cl_uint count = static_cast<cl_uint>(end - begin) * img.width();
+
+    // The staging buffer is refilled once its last chunk left for the
+    // device, while the chunk of the other slot is being counted.
+    if (!WaitFor(sent[slot])) {
+      Drain(sent);
+      return false;
+    }
+
+    PackRows(img, begin, end, gpu.staging[slot]);
+
+    if (clEnqueueWriteBuffer(gpu.queue, gpu.chunks[slot], CL_FALSE, 0,
+                             count * pixel_bytes, gpu.staging[slot], 0,
+                             nullptr, &sent[slot]) != CL_SUCCESS ||
+        !EnqueueHistogram(slot, count, img)) {
+      Drain(sent);
+      return false;
+    }
+  }
+
+  cl_uint bins[3 * 256];
+  bool counted = clEnqueueReadBuffer(gpu.queue, gpu.bins, CL_TRUE, 0,
+                                     sizeof(bins), bins, 0, nullptr,
+                                     nullptr) == CL_SUCCESS;
+  Drain(sent);
+  if (!counted) {
+    return false;
+  }
+
+  for (int i = 0; i < 256; i++) {
+    histogram.red[i] = bins[i];
+    histogram.green[i] = bins[256 + i];
+    histogram.blue[i] = bins[512 + i];
+  }
+
+  return true;
+}
+
+bool GpuApplyLUT(Image &img, const LUT3 &lut) {
+  std::unique_lock lock(gpu.mutex, std::try_to_lock);
+  int chunk_rows = ChunkRows(img);
+  if (!lock || !gpu.ready || chunk_rows == 0) {
+    return false;
+  }
+
+  if (clEnqueueWriteBuffer(gpu.queue, gpu.tables, CL_TRUE, 0,
+                           sizeof(lut.table), lut.table, 0, nullptr,
+                           nullptr) != CL_SUCCESS) {
+    return false;
+  }
+
+  size_t pixel_bytes = BytesPerPixel(img.format());
+  cl_event received[kSlots] = {nullptr, nullptr};
+  int rows[kSlots] = {0, 0};
+  // The rows before it are done; chunks go back in order, so they are a
+  // prefix of the image.
+  int applied = 0;
+  bool failed = false;
+
+  for (int begin = 0, chunk = 0; begin < img.height() && !failed;
+       begin += chunk_rows, chunk++) {
+    int slot = chunk % kSlots;
+    int end = std::min(begin + chunk_rows, img.height());
+    cl_uint count = static_cast<cl_uint>(end - begin) * img.width();
+
+    // Unpacks the chunk that used the slot before, while the one of the
+    // other slot is on the device.
+    if (received[slot] != nullptr) {
+      if (!WaitFor(received[slot])) {
+        failed = true;
+        break;
+      }
+      UnpackRows(gpu.staging[slot], applied, applied + rows[slot], img);
+      applied += rows[slot];
+    }
+
+    PackRows(img, begin, end, gpu.staging[slot]);
+    rows[slot] = end - begin;
+
+    failed = clEnqueueWriteBuffer(gpu.queue, gpu.chunks[slot], CL_FALSE, 0,
+                                  count * pixel_bytes, gpu.staging[slot], 0,
+                                  nullptr, nullptr) != CL_SUCCESS ||
+             !EnqueueApply(slot, count, img) ||
+             clEnqueueReadBuffer(gpu.queue, gpu.chunks[slot], CL_FALSE, 0,
+                                 count * pixel_bytes, gpu.staging[slot], 0,
+                                 nullptr, &received[slot]) != CL_SUCCESS;
+  }
+
+  // The last chunks, in the order they were sent.
+  for (int k = 0; k < kSlots && !failed; k++) {
+    int slot = (applied / chunk_rows + k) % kSlots;
+    if (received[slot] == nullptr) {
+      continue;
+    }
+
+    if (!WaitFor(received[slot])) {
+      failed = true;
+      break;
+    }
+    UnpackRows(gpu.staging[slot], applied, applied + rows[slot], img);
+    applied += rows[slot];
+  }
+
+  if (!failed) {
+    return true;
+  }
+
+  // Not trusted anymore: this and the next images stay on the CPU.
+  Drain(received);
+  gpu.ready = false;
+  lock.unlock();
+
+  if (applied == 0) {
+    return false;
+  }
+
+  Image rest = RowsOf(img, applied, img.height());
+  ApplyChannelLUT(rest, lut);
+  return true;
+}
+
+#else
+
+bool GpuAvailable() { return false; }
+
+const char *GpuDeviceName() { return ""; }
+
+bool GpuHistogram(const Image &, RGBHistogram &) { return false; }
+
+bool GpuApplyLUT(Image &, const LUT3 &) { return false; }
+
+#endif
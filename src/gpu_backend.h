@@ -0,0 +1,53 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+
+#include "histogram.h"
+#include "image.h"
+#include "lut.h"
+
+/// Images below this many pixels stay on the CPU, where the transfers to
+/// the device would cost more than the counting they save.
+const int64_t kDefaultGpuMinPixels = int64_t(4) << 20;
+
+/// @brief Allows (or forbids) @see GetHistogram and @see ApplyChannelLUT to
+/// run on the GPU. Offloading is on by default when the build has a backend
+/// (PDI_LI_ENABLE_OPENCL), and always off otherwise.
+void SetGpuOffload(bool enabled);
+
+/// @brief Sets the pixels an image needs to be offloaded, see
+/// @see kDefaultGpuMinPixels
+void SetGpuMinPixels(int64_t pixels);
+
+/// @brief Whether the build has a GPU backend and it found a device. The
+/// device is set up on the first call.
+bool GpuAvailable();
+
+/// @brief The name of the device found by @see GpuAvailable , or an empty
+/// string.
+const char *GpuDeviceName();
+
+/// @brief Whether the kernels on @p img should be offloaded: offloading is
+/// on, @p img has at least the @see SetGpuMinPixels and is interleaved, and
+/// there is a device.
+bool ShouldOffload(const Image &img);
+
+/// @brief Counts the histogram of @p img on the device, with the bins of
+/// each work group kept in local memory and merged at the end. The rows are
+/// sent in chunks through two pinned buffers, so the next chunk is packed
+/// while the previous one is sent and counted.
+/// @param img An interleaved image
+/// @param histogram [out] The histogram of @p img
+/// @return false if it could not run, @p histogram must be counted on the
+/// CPU then
+bool GpuHistogram(const Image &img, RGBHistogram &histogram);
+
+/// @brief Applies @p lut to @p img on the device, like
+/// @see ApplyChannelLUT , with the chunks of @see GpuHistogram going back
+/// the same way.
+/// @param img [in | out] An interleaved image
+/// @return false if it could not run, before touching @p img
+bool GpuApplyLUT(Image &img, const LUT3 &lut);
@@ -0,0 +1,433 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "histogram.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cpu_features.h"
+#include "gpu_backend.h"
+#include "pixel_unpack.h"
+#include "processing_context.h"
+#include "thread_pool.h"
+#include "traversal.h"
+
+namespace {
+
+/// Number of interleaved sub-histograms kept per channel. Consecutive samples
+/// go to different tables, so a run of equal values does not serialize on the
+/// same counter (store-to-load forwarding stalls).
+const int kSubHistograms = 4;
+
+/// Rows below which splitting the image between threads is not worth it.
+const int kMinBandRows = 32;
+
+/// Cell rows below which splitting the sampling between threads is not worth
+/// it.
+const int kMinSampledBandCells = 8;
+
+/// Side of the cells the histograms of the commands are sampled from.
+int sample_step = 1;
+
+/// Pixels counted on the sub-histograms before they are added to the 64 bit
+/// counts, so none of their 32 bit bins can overflow.
+const int64_t kMaxSubHistogramPixels = UINT32_MAX;
+
+struct SubHistograms {
+  uint32_t bins[Image::kChannels][kSubHistograms][256];
+};
+
+/// @brief Adds the counts of @p sub to @p histogram . The counts of a gray
+/// image are on the red tables only, see @see CountGrayRow .
+void AddSubHistograms(const SubHistograms &sub, bool gray,
+                      RGBHistogram &histogram) {
+  uint64_t *outputs[Image::kChannels] = {histogram.red, histogram.green,
+                                         histogram.blue};
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    int from = gray ? kRed : c;
+    for (int i = 0; i < 256; i++) {
+      uint64_t total = 0;
+      for (int k = 0; k < kSubHistograms; k++) {
+        total += sub.bins[from][k][i];
+      }
+      outputs[c][i] += total;
+    }
+  }
+}
+
+inline void CountBlock(SubHistograms &sub, const byte *red, const byte *green,
+                       const byte *blue, int count) {
+  int x = 0;
+
+  for (; x + kSubHistograms <= count; x += kSubHistograms) {
+    for (int k = 0; k < kSubHistograms; k++) {
+      sub.bins[kRed][k][red[x + k]]++;
+      sub.bins[kGreen][k][green[x + k]]++;
+      sub.bins[kBlue][k][blue[x + k]]++;
+    }
+  }
+
+  for (; x < count; x++) {
+    sub.bins[kRed][0][red[x]]++;
+    sub.bins[kGreen][0][green[x]]++;
+    sub.bins[kBlue][0][blue[x]]++;
+  }
+}
+
+/// @brief Unpacks the blocks of @see CountPackedRow with @see UnpackBlock
+/// and @see UnpackBlock4 , as the build targets.
+struct BaselineUnpack {
+  static void Three(const byte *src, byte *planes[4]) {
+    UnpackBlock(src, planes[0], planes[1], planes[2]);
+  }
+
+  static void Four(const byte *src, byte *planes[4]) {
+    UnpackBlock4(src, planes);
+  }
+};
+
+#if defined(PDI_LI_X86)
+/// @brief Like @see BaselineUnpack with the SSSE3 shuffles.
+struct SSSE3Unpack {
+  PDI_LI_TARGET_SSSE3 static void Three(const byte *src, byte *planes[4]) {
+    UnpackBlockSSSE3(src, planes[0], planes[1], planes[2]);
+  }
+
+  PDI_LI_TARGET_SSSE3 static void Four(const byte *src, byte *planes[4]) {
+    UnpackBlock4SSSE3(src, planes);
+  }
+};
+#endif
+
+/// @brief Counts a row of @p Format pixels (RGB24 or BGRA32) where the
+/// channel c of each pixel is at the byte @p offsets [c], split in planes a
+/// block at a time by @p Unpack . Always inlined, so the block unpacking is
+/// inlined in turn in each variant of @see CountPackedRow .
+template <typename Format, typename Unpack>
+PDI_LI_ALWAYS_INLINE void CountPackedBlocks(SubHistograms &sub,
+                                            const byte *row, int width,
+                                            const size_t *offsets) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  alignas(16) byte planes[4][kBlockPixels];
+  byte *outputs[4] = {planes[0], planes[1], planes[2], planes[3]};
+  const byte *red = planes[offsets[kRed]];
+  const byte *green = planes[offsets[kGreen]];
+  const byte *blue = planes[offsets[kBlue]];
+  int x = 0;
+
+  for (; x + kBlockPixels <= width; x += kBlockPixels) {
+    if constexpr (kBytes == 4) {
+      Unpack::Four(row + kBytes * x, outputs);
+    } else {
+      Unpack::Three(row + kBytes * x, outputs);
+    }
+    CountBlock(sub, red, green, blue, kBlockPixels);
+  }
+
+  for (; x < width; x++) {
+    sub.bins[kRed][0][row[kBytes * x + offsets[kRed]]]++;
+    sub.bins[kGreen][0][row[kBytes * x + offsets[kGreen]]]++;
+    sub.bins[kBlue][0][row[kBytes * x + offsets[kBlue]]]++;
+  }
+}
+
+template <typename Format>
+void CountPackedRow(SubHistograms &sub, const byte *row, int width,
+                    const size_t *offsets) {
+  CountPackedBlocks<Format, BaselineUnpack>(sub, row, width, offsets);
+}
+
+#if defined(PDI_LI_X86)
+template <typename Format>
+PDI_LI_TARGET_SSSE3 void CountPackedRowSSSE3(SubHistograms &sub,
+                                             const byte *row, int width,
+                                             const size_t *offsets) {
+  CountPackedBlocks<Format, SSSE3Unpack>(sub, row, width, offsets);
+}
+#endif
+
+/// @brief @see CountPackedRow with the best variant for @see GetCpuIsa .
+template <typename Format>
+void CountPackedRow(SubHistograms &sub, const byte *row, int width,
+                    const size_t *offsets, CpuIsa isa) {
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kSSSE3) {
+    CountPackedRowSSSE3<Format>(sub, row, width, offsets);
+    return;
+  }
+#endif
+
+  CountPackedRow<Format>(sub, row, width, offsets);
+}
+
+/// @brief Counts a gray row on the red tables only, a third of the work of a
+/// color row. The caller copies the counts to the other channels.
+void CountGrayRow(SubHistograms &sub, const byte *row, int width) {
+  int x = 0;
+
+  for (; x + kSubHistograms <= width; x += kSubHistograms) {
+    for (int k = 0; k < kSubHistograms; k++) {
+      sub.bins[kRed][k][row[x + k]]++;
+    }
+  }
+
+  for (; x < width; x++) {
+    sub.bins[kRed][0][row[x]]++;
+  }
+}
+
+/// @brief Mixes the coordinates of a cell of @see SampleHistogram into the
+/// position of its sample: the low half for x and the high half for y.
+uint32_t CellHash(uint32_t x, uint32_t y) {
+  uint32_t hash = x * 0x9E3779B1u ^ (y + 0x7F4A7C15u) * 0x85EBCA77u;
+
+  hash ^= hash >> 16;
+  hash *= 0x7FEB352Du;
+  hash ^= hash >> 15;
+  hash *= 0x846CA68Bu;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+/// @brief Counts the samples of the cells of @p step x @p step pixels that
+/// fall on the rows [ @p begin , @p end ) of @p img , whose row 0 is the row
+/// @p first_row of the whole image. A cell crossing the edges of the image
+/// keeps its sample only when it falls inside, so every pixel has the same
+/// chance of being sampled.
+int64_t CountSamples(const Image &img, int begin, int end, int first_row,
+                     int step, RGBHistogram &histogram) {
+  uint64_t *outputs[Image::kChannels] = {histogram.red, histogram.green,
+                                         histogram.blue};
+  int pixel_step = img.pixel_step();
+  int width = img.width();
+  int top = first_row + begin;
+  int bottom = first_row + end;
+  int64_t samples = 0;
+
+  for (int cell_y = top / step; cell_y * step < bottom; cell_y++) {
+    for (int cell_x = 0; cell_x * step < width; cell_x++) {
+      uint32_t hash = CellHash(cell_x, cell_y);
+      int x = cell_x * step + static_cast<int>((hash & 0xFFFF) % step);
+      int y = cell_y * step + static_cast<int>((hash >> 16) % step);
+      if (x >= width || y < top || y >= bottom) {
+        continue;
+      }
+
+      // The channels of a gray image all point to its single sample.
+      for (int c = 0; c < Image::kChannels; c++) {
+        outputs[c][img.channel_row(c, y - first_row)[x * pixel_step]]++;
+      }
+      samples++;
+    }
+  }
+
+  return samples;
+}
+
+} // namespace
+
+RGBHistogram GetHistogram(const Image &img) {
+  RGBHistogram histogram{};
+  memset(&histogram, 0, sizeof(RGBHistogram));
+
+  // Large images go to the GPU when there is one, the CPU counts the rest.
+  if (ShouldOffload(img) && GpuHistogram(img, histogram)) {
+    return histogram;
+  }
+
+  ThreadPool &pool = GetThreadPool();
+  int bands = std::clamp(img.height() / kMinBandRows, 1, pool.size());
+
+  if (bands == 1) {
+    AccumulateHistogram(img, 0, img.height(), histogram);
+    return histogram;
+  }
+
+  ScratchScope scope(GetProcessingContext().arena());
+  RGBHistogram *partials = scope.arena().Allocate<RGBHistogram>(bands);
+
+  pool.ParallelFor(bands, [&](int band) {
+    RowBand rows = SplitRows(0, img.height(), band, bands);
+    AccumulateHistogram(img, rows.begin, rows.end, partials[band]);
+  });
+
+  for (int band = 0; band < bands; band++) {
+    const RGBHistogram &partial = partials[band];
+    for (int i = 0; i < 256; i++) {
+      histogram.red[i] += partial.red[i];
+      histogram.green[i] += partial.green[i];
+      histogram.blue[i] += partial.blue[i];
+    }
+  }
+
+  return histogram;
+}
+
+void AccumulateHistogram(const Image &img, int begin, int end,
+                         RGBHistogram &histogram) {
+  Rectangle rows = {
+      .x = 0, .y = begin, .width = img.width(), .height = end - begin};
+
+  AccumulateHistogram(img, rows, histogram);
+}
+
+void AccumulateHistogram(const Image &img, const Rectangle &area,
+                         RGBHistogram &histogram) {
+  SubHistograms sub;
+  int x = area.x;
+  int width = area.width;
+  PixelFormat format = img.format();
+  bool interleaved = img.layout() == PixelLayout::kInterleaved;
+  const size_t offsets[Image::kChannels] = {img.channel_offset(kRed),
+                                            img.channel_offset(kGreen),
+                                            img.channel_offset(kBlue)};
+
+  CpuIsa isa = GetCpuIsa();
+  int bottom = area.y + area.height;
+  int flush_rows = static_cast<int>(
+      std::clamp<int64_t>(kMaxSubHistogramPixels / std::max(width, 1), 1,
+                          std::max(area.height, 1)));
+
+  for (int top = area.y; top < bottom; top += flush_rows) {
+    memset(&sub, 0, sizeof(SubHistograms));
+    ForEachRow(top, std::min(top + flush_rows, bottom), [&](int y) {
+      if (!interleaved) {
+        CountBlock(sub, img.channel_row(kRed, y) + x,
+                   img.channel_row(kGreen, y) + x,
+                   img.channel_row(kBlue, y) + x, width);
+      } else if (format == PixelFormat::kGray8) {
+        CountGrayRow(sub, img.row(y) + x, width);
+      } else if (format == PixelFormat::kBGRA32) {
+        CountPackedRow<BGRA32>(sub, img.row(y) + BGRA32::kBytesPerPixel * x,
+                               width, offsets, isa);
+      } else {
+        CountPackedRow<RGB24>(sub, img.row(y) + RGB24::kBytesPerPixel * x,
+                              width, offsets, isa);
+      }
+    });
+
+    AddSubHistograms(sub, format == PixelFormat::kGray8, histogram);
+  }
+}
+
+int SampleStepOfRate(double rate) {
+  if (!(rate > 0.0) || rate >= 1.0) {
+    return 1;
+  }
+
+  long step = lround(1.0 / sqrt(rate));
+  return static_cast<int>(std::clamp(step, 1L, long(kMaxSampleStep)));
+}
+
+void SetHistogramSampleStep(int step) {
+  sample_step = std::clamp(step, 1, kMaxSampleStep);
+}
+
+int GetHistogramSampleStep() { return sample_step; }
+
+RGBHistogram SampleHistogram(const Image &img, int step) {
+  if (step <= 1) {
+    return GetHistogram(img);
+  }
+
+  RGBHistogram histogram{};
+  memset(&histogram, 0, sizeof(RGBHistogram));
+
+  ThreadPool &pool = GetThreadPool();
+  int cell_rows = (img.height() + step - 1) / step;
+  int bands = std::clamp(cell_rows / kMinSampledBandCells, 1, pool.size());
+  int64_t samples = 0;
+
+  if (bands == 1) {
+    samples = CountSamples(img, 0, img.height(), 0, step, histogram);
+  } else {
+    ScratchScope scope(GetProcessingContext().arena());
+    RGBHistogram *partials = scope.arena().Allocate<RGBHistogram>(bands);
+    int64_t *counts = scope.arena().Allocate<int64_t>(bands);
+
+    pool.ParallelFor(bands, [&](int band) {
+      RowBand rows = SplitRows(0, img.height(), band, bands);
+      counts[band] =
+          CountSamples(img, rows.begin, rows.end, 0, step, partials[band]);
+    });
+
+    for (int band = 0; band < bands; band++) {
+      const RGBHistogram &partial = partials[band];
+      for (int i = 0; i < 256; i++) {
+        histogram.red[i] += partial.red[i];
+        histogram.green[i] += partial.green[i];
+        histogram.blue[i] += partial.blue[i];
+      }
+      samples += counts[band];
+    }
+  }
+
+  ScaleHistogram(histogram, samples,
+                 static_cast<int64_t>(img.width()) * img.height());
+  return histogram;
+}
+
+int64_t AccumulateSampledHistogram(const Image &band, int first_row, int step,
+                                   RGBHistogram &histogram) {
+  return CountSamples(band, 0, band.height(), first_row, std::max(step, 1),
+                      histogram);
+}
+
+void ScaleHistogram(RGBHistogram &histogram, int64_t samples, int64_t pixels) {
+  if (samples <= 0 || samples == pixels) {
+    return;
+  }
+
+  double scale = static_cast<double>(pixels) / samples;
+  uint64_t *channels[Image::kChannels] = {histogram.red, histogram.green,
+                                          histogram.blue};
+
+  for (uint64_t *channel : channels) {
+    for (int i = 0; i < 256; i++) {
+      channel[i] = static_cast<uint64_t>(llround(channel[i] * scale));
+    }
+  }
+}
+
+double HistogramErrorBound(int64_t samples) {
+  // P(sup |F_n - F| > e) <= 2 exp(-2 n e^2), solved for a 5% chance.
+  const double kConfidenceLog = log(2.0 / 0.05);
+
+  return samples > 0 ? sqrt(kConfidenceLog / (2.0 * samples)) : 1.0;
+}
+
+void AddToDataset(const RGBHistogram &histogram, DatasetHistogram &dataset) {
+  for (int i = 0; i < 256; i++) {
+    dataset.red[i] += histogram.red[i];
+    dataset.green[i] += histogram.green[i];
+    dataset.blue[i] += histogram.blue[i];
+  }
+
+  dataset.images++;
+}
+
+void MergeDatasets(const DatasetHistogram &other, DatasetHistogram &dataset) {
+  for (int i = 0; i < 256; i++) {
+    dataset.red[i] += other.red[i];
+    dataset.green[i] += other.green[i];
+    dataset.blue[i] += other.blue[i];
+  }
+
+  dataset.images += other.images;
+}
+
+RGBHistogram DatasetToHistogram(const DatasetHistogram &dataset) {
+  RGBHistogram histogram{};
+
+  for (int i = 0; i < 256; i++) {
+    histogram.red[i] = dataset.red[i];
+    histogram.green[i] = dataset.green[i];
+    histogram.blue[i] = dataset.blue[i];
+  }
+
+  return histogram;
+}
@@ -0,0 +1,112 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+
+#include "image.h"
+
+/// @brief The histogram of an image. The counts are 64 bits wide, so they
+/// hold any image the tiled files of tiled_image.h can describe.
+struct RGBHistogram {
+  uint64_t red[256];
+  uint64_t blue[256];
+  uint64_t green[256];
+};
+
+/// @brief The histogram of a whole set of images, with 64 bit counts so it
+/// does not overflow however many files are added to it.
+struct DatasetHistogram {
+  /// How many image histograms were added
+  uint64_t images = 0;
+  uint64_t red[256];
+  uint64_t green[256];
+  uint64_t blue[256];
+};
+
+/// @brief Retrieves the histogram of some bitmap @p img . The rows are split
+/// in bands counted in parallel on @see GetThreadPool and reduced at the end.
+/// @param img The image to retrieve the histogram
+/// @return A @see RGBHistogram struct with the histogram of the red, green and
+/// blue channel of the image.
+RGBHistogram GetHistogram(const Image &img);
+
+/// @brief Adds the samples of the rows [ @p begin , @p end ) of @p img into
+/// @p histogram .
+/// @param img The image to retrieve the samples
+/// @param begin The first row to be counted
+/// @param end One past the last row to be counted
+/// @param histogram [in | out] The histogram that receives the counts
+void AccumulateHistogram(const Image &img, int begin, int end,
+                         RGBHistogram &histogram);
+
+/// @brief Adds the samples of @p area of @p img into @p histogram . @p area
+/// must be inside the image.
+/// @param img The image to retrieve the samples
+/// @param area The pixels to be counted
+/// @param histogram [in | out] The histogram that receives the counts
+void AccumulateHistogram(const Image &img, const Rectangle &area,
+                         RGBHistogram &histogram);
+
+/// Largest side of the cells @see SampleHistogram takes one pixel from.
+const int kMaxSampleStep = 4096;
+
+/// Default share of the pixels sampled by --approx, one in 8x8.
+const double kDefaultSampleRate = 1.0 / 64;
+
+/// @brief The side of the cells sampling about @p rate of the pixels, one
+/// pixel per cell.
+/// @param rate The share of the pixels to be sampled, in (0, 1]
+/// @return The side, between 1 and @see kMaxSampleStep
+int SampleStepOfRate(double rate);
+
+/// @brief Sets the side of the cells the histograms of the commands are
+/// estimated from, see @see SampleHistogram . 1, the default, counts every
+/// pixel.
+void SetHistogramSampleStep(int step);
+
+/// @brief The side set by @see SetHistogramSampleStep .
+int GetHistogramSampleStep();
+
+/// @brief Estimates the histogram of @p img from a deterministic stratified
+/// sample: the image is split in cells of @p step x @p step pixels and one
+/// pixel at a position hashed from the cell is counted on each, so the
+/// samples cover the whole image evenly without the aliasing of a regular
+/// grid. The counts are scaled to the pixel count of the image.
+/// @param img The image to retrieve the histogram
+/// @param step The side of the cells, 1 counts every pixel like
+/// @see GetHistogram
+/// @return The estimated histogram
+RGBHistogram SampleHistogram(const Image &img, int step);
+
+/// @brief Adds the samples of @see SampleHistogram that fall on @p band into
+/// @p histogram , unscaled, so a file can be sampled a band at a time.
+/// @param band Some rows of an image
+/// @param first_row The row of the image that is the row 0 of @p band
+/// @param step The side of the cells
+/// @param histogram [in | out] The histogram that receives the counts
+/// @return The number of pixels sampled
+int64_t AccumulateSampledHistogram(const Image &band, int first_row, int step,
+                                   RGBHistogram &histogram);
+
+/// @brief Scales the counts of @p samples pixels in @p histogram to
+/// @p pixels pixels.
+void ScaleHistogram(RGBHistogram &histogram, int64_t samples, int64_t pixels);
+
+/// @brief Bound on the error of the cumulative distribution of a histogram
+/// sampled from @p samples pixels, at 95% confidence (the
+/// Dvoretzky-Kiefer-Wolfowitz inequality). An equalization table built from it
+/// is off by at most 255 times the bound.
+double HistogramErrorBound(int64_t samples);
+
+/// @brief Adds the counts of the image histogram @p histogram to @p dataset .
+void AddToDataset(const RGBHistogram &histogram, DatasetHistogram &dataset);
+
+/// @brief Adds the counts of @p other , the histogram of another set of
+/// images, to @p dataset .
+void MergeDatasets(const DatasetHistogram &other, DatasetHistogram &dataset);
+
+/// @brief The counts of @p dataset as an image histogram, for the commands
+/// to build their tables from.
+RGBHistogram DatasetToHistogram(const DatasetHistogram &dataset);
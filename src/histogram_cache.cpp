@@ -0,0 +1,231 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "histogram_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "content_hash.h"
+#include "histogram_io.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+/// Seeds telling the two kinds of keys apart.
+const uint64_t kImageKeySeed = 0x494d47;
+const uint64_t kFileKeySeed = 0x46494c45;
+
+const char *kEntryExtension = ".rgbh";
+
+struct CacheEntry {
+  uint64_t key;
+  int64_t bytes;
+};
+
+/// @brief The entries of the cache directory, most recently used first.
+struct DiskCache {
+  std::mutex mutex;
+  bool open = false;
+  fs::path directory;
+  int64_t max_bytes = 0;
+  std::list<CacheEntry> recent;
+  std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> index;
+  HistogramCacheStats stats;
+};
+
+DiskCache cache;
+
+fs::path EntryPath(uint64_t key) {
+  return cache.directory / fmt::format("{:016x}{}", key, kEntryExtension);
+}
+
+/// @brief Parses the key out of the name of an entry.
+/// @return false if @p path is not an entry of the cache
+bool KeyOfEntry(const fs::path &path, uint64_t &key) {
+  std::string stem = path.stem().string();
+  if (path.extension() != kEntryExtension || stem.size() != 16) {
+    return false;
+  }
+
+  char *end = nullptr;
+  key = strtoull(stem.c_str(), &end, 16);
+  return end == stem.c_str() + stem.size();
+}
+
+void Forget(std::list<CacheEntry>::iterator entry) {
+  cache.stats.bytes -= entry->bytes;
+  cache.stats.entries--;
+  cache.index.erase(entry->key);
+  cache.recent.erase(entry);
+}
+
+/// @brief Deletes the least recently used entries until the cache fits.
+void Evict() {
+  while (cache.stats.bytes > cache.max_bytes && !cache.recent.empty()) {
+    auto oldest = std::prev(cache.recent.end());
+    std::error_code error;
+    fs::remove(EntryPath(oldest->key), error);
+
+    Forget(oldest);
+    cache.stats.evictions++;
+  }
+}
+
+} // namespace
+
+bool OpenHistogramCache(const std::string &directory, int64_t max_bytes) {
+  std::lock_guard lock(cache.mutex);
+  std::error_code error;
+
+  fs::create_directories(directory, error);
+  fs::directory_iterator it(directory, error);
+  if (error) {
+    return false;
+  }
+
+  struct Found {
+    fs::file_time_type used;
+    CacheEntry entry;
+  };
+  std::vector<Found> found;
+
+  for (const fs::directory_entry &file : it) {
+    uint64_t key = 0;
+    if (!file.is_regular_file(error) || !KeyOfEntry(file.path(), key)) {
+      continue;
+    }
+
+    int64_t bytes = static_cast<int64_t>(file.file_size(error));
+    fs::file_time_type used = file.last_write_time(error);
+    if (!error) {
+      found.push_back(Found{used, CacheEntry{key, bytes}});
+    }
+  }
+
+  std::sort(found.begin(), found.end(),
+            [](const Found &a, const Found &b) { return a.used > b.used; });
+
+  cache.directory = directory;
+  cache.max_bytes = max_bytes;
+  cache.recent.clear();
+  cache.index.clear();
+  cache.stats = HistogramCacheStats{};
+
+  for (const Found &file : found) {
+    cache.recent.push_back(file.entry);
+    cache.index[file.entry.key] = std::prev(cache.recent.end());
+    cache.stats.bytes += file.entry.bytes;
+    cache.stats.entries++;
+  }
+
+  cache.open = true;
+  Evict();
+  return true;
+}
+
+bool HistogramCacheEnabled() { return cache.open; }
+
+uint64_t ImageHistogramKey(const Image &img) {
+  return HashImage(img, kImageKeySeed ^
+                            static_cast<uint64_t>(GetHistogramSampleStep())
+                                << 32);
+}
+
+bool FileHistogramKey(const std::string &filename, uint64_t &key) {
+  std::error_code error;
+  fs::path path = fs::absolute(filename, error);
+  uintmax_t size = fs::file_size(path, error);
+  if (error) {
+    return false;
+  }
+
+  fs::file_time_type modified = fs::last_write_time(path, error);
+  if (error) {
+    return false;
+  }
+
+  std::string name = path.string();
+  ContentHasher hasher(kFileKeySeed);
+  hasher.Update(name.data(), name.size());
+  hasher.UpdateValue(static_cast<uint64_t>(size));
+  hasher.UpdateValue(
+      static_cast<uint64_t>(modified.time_since_epoch().count()));
+  hasher.UpdateValue(static_cast<uint64_t>(GetHistogramSampleStep()));
+
+  key = hasher.Digest();
+  return true;
+}
+
+bool LookupHistogram(uint64_t key, RGBHistogram &histogram) {
+  std::lock_guard lock(cache.mutex);
+
+  auto found = cache.index.find(key);
+  if (found == cache.index.end()) {
+    cache.stats.misses++;
+    return false;
+  }
+
+  // Another run may have evicted or rewritten it in the meantime.
+  std::vector<byte> bytes;
+  if (ReadFileBytes(EntryPath(key).string(), bytes) != BMP_OK ||
+      !DecodeHistogram(bytes, histogram)) {
+    Forget(found->second);
+    cache.stats.misses++;
+    return false;
+  }
+
+  cache.recent.splice(cache.recent.begin(), cache.recent, found->second);
+
+  std::error_code error;
+  fs::last_write_time(EntryPath(key), fs::file_time_type::clock::now(),
+                      error);
+
+  cache.stats.hits++;
+  return true;
+}
+
+void StoreHistogram(uint64_t key, const RGBHistogram &histogram) {
+  std::vector<byte> bytes;
+  EncodeHistogram(histogram, HistogramFormat::kBinary, bytes);
+
+  std::lock_guard lock(cache.mutex);
+  if (!cache.open || cache.index.count(key) > 0) {
+    return;
+  }
+
+  // Renamed into place, so other runs never read half an entry.
+  fs::path path = EntryPath(key);
+  fs::path partial = path;
+  partial += ".partial";
+  if (WriteFileBytes(partial.string(), bytes) != BMP_OK) {
+    return;
+  }
+
+  std::error_code error;
+  fs::rename(partial, path, error);
+  if (error) {
+    fs::remove(partial, error);
+    return;
+  }
+
+  cache.recent.push_front(CacheEntry{key, static_cast<int64_t>(bytes.size())});
+  cache.index[key] = cache.recent.begin();
+  cache.stats.bytes += static_cast<int64_t>(bytes.size());
+  cache.stats.entries++;
+
+  Evict();
+}
+
+HistogramCacheStats GetHistogramCacheStats() {
+  std::lock_guard lock(cache.mutex);
+  return cache.stats;
+}
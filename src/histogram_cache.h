@@ -0,0 +1,63 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "histogram.h"
+#include "image.h"
+
+/// Bytes the entries of the histogram cache may take on disk by default,
+/// about 20000 histograms.
+const int64_t kDefaultHistogramCacheBytes = int64_t(64) << 20;
+
+/// @brief What the histogram cache did since it was opened.
+struct HistogramCacheStats {
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t evictions = 0;
+  /// Entries on disk and the bytes they take.
+  int64_t entries = 0;
+  int64_t bytes = 0;
+};
+
+/// @brief Keeps the histograms the commands count on @p directory , one
+/// small "RGBH" file (see @see HistogramFormat::kBinary ) per key, so runs
+/// over the same inputs skip the histogram pass. Once the entries take more
+/// than @p max_bytes the least recently used ones are deleted; a hit renews
+/// the modification time of its entry, so the order survives between runs.
+/// Every function below is safe to call from any thread.
+/// @param directory Created if it does not exist
+/// @param max_bytes The limit on the size of the entries
+/// @return false if @p directory could not be created or listed
+bool OpenHistogramCache(const std::string &directory, int64_t max_bytes);
+
+/// @brief Whether @see OpenHistogramCache was called and succeeded.
+bool HistogramCacheEnabled();
+
+/// @brief The key of the histogram of @p img : the xxHash of its pixels,
+/// size and format (see @see HashImage ) and of the
+/// @see GetHistogramSampleStep .
+uint64_t ImageHistogramKey(const Image &img);
+
+/// @brief The key of the histogram of the file @p filename , hashed from its
+/// absolute path, size and modification time and the
+/// @see GetHistogramSampleStep instead of its pixels, for files that are
+/// streamed: hashing them would cost the read the cache saves.
+/// @param key [out] The key of the file
+/// @return false if the file could not be inspected
+bool FileHistogramKey(const std::string &filename, uint64_t &key);
+
+/// @brief Looks @p key up on the cache.
+/// @param histogram [out] The histogram of @p key , on a hit
+/// @return true on a hit
+bool LookupHistogram(uint64_t key, RGBHistogram &histogram);
+
+/// @brief Stores @p histogram as the histogram of @p key , evicting the
+/// least recently used entries if the cache grows over its limit.
+void StoreHistogram(uint64_t key, const RGBHistogram &histogram);
+
+/// @brief The counters of the cache.
+HistogramCacheStats GetHistogramCacheStats();
@@ -0,0 +1,222 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "histogram_index.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tile_scheduler.h"
+
+namespace {
+
+uint64_t *ChannelBins(RGBHistogram &histogram, int c) {
+  uint64_t *bins[Image::kChannels] = {histogram.red, histogram.green,
+                                      histogram.blue};
+  return bins[c];
+}
+
+/// @brief @p area clipped to the pixels of @p img , with no negative sizes.
+Rectangle Clip(const Rectangle &area, const Image &img) {
+  int x = std::clamp(area.x, 0, img.width());
+  int y = std::clamp(area.y, 0, img.height());
+  int x2 = std::clamp(area.x + std::max(area.width, 0), x, img.width());
+  int y2 = std::clamp(area.y + std::max(area.height, 0), y, img.height());
+
+  return Rectangle{.x = x, .y = y, .width = x2 - x, .height = y2 - y};
+}
+
+bool IsEmpty(const Rectangle &area) {
+  return area.width <= 0 || area.height <= 0;
+}
+
+Rectangle Intersect(const Rectangle &a, const Rectangle &b) {
+  int x = std::max(a.x, b.x);
+  int y = std::max(a.y, b.y);
+  int x2 = std::min(a.x + a.width, b.x + b.width);
+  int y2 = std::min(a.y + a.height, b.y + b.height);
+
+  return Rectangle{.x = x,
+                   .y = y,
+                   .width = std::max(x2 - x, 0),
+                   .height = std::max(y2 - y, 0)};
+}
+
+/// @brief Calls @p fn with up to four rectangles covering @p outer minus
+/// @p inner , which must be inside @p outer : the rows above and below
+/// @p inner , then the columns to its left and right.
+template <typename Fn>
+void ForEachStrip(const Rectangle &outer, const Rectangle &inner, Fn &&fn) {
+  int outer_x2 = outer.x + outer.width;
+  int outer_y2 = outer.y + outer.height;
+  int inner_x2 = inner.x + inner.width;
+  int inner_y2 = inner.y + inner.height;
+
+  const Rectangle strips[] = {
+      {.x = outer.x,
+       .y = outer.y,
+       .width = outer.width,
+       .height = inner.y - outer.y},
+      {.x = outer.x,
+       .y = inner_y2,
+       .width = outer.width,
+       .height = outer_y2 - inner_y2},
+      {.x = outer.x,
+       .y = inner.y,
+       .width = inner.x - outer.x,
+       .height = inner.height},
+      {.x = inner_x2,
+       .y = inner.y,
+       .width = outer_x2 - inner_x2,
+       .height = inner.height}};
+
+  for (const Rectangle &strip : strips) {
+    if (!IsEmpty(strip)) {
+      fn(strip);
+    }
+  }
+}
+
+} // namespace
+
+HistogramIndex::HistogramIndex(const Image &img, int tile)
+    : img_(&img), tile_(std::max(tile, 1)) {
+  columns_ = (img.width() + tile_ - 1) / tile_;
+  rows_ = (img.height() + tile_ - 1) / tile_;
+  integral_.assign(static_cast<size_t>(columns_ + 1) * (rows_ + 1) *
+                       Image::kChannels * 256,
+                   0);
+
+  // Count every tile on the corner after it, then turn the counts in sums.
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = img.width(), .height = img.height()},
+      tile_, tile_, [&](const Rectangle &area) {
+        RGBHistogram counts{};
+        memset(&counts, 0, sizeof(RGBHistogram));
+        AccumulateHistogram(img, area, counts);
+
+        int tx = area.x / tile_ + 1;
+        int ty = area.y / tile_ + 1;
+        for (int c = 0; c < Image::kChannels; c++) {
+          std::copy_n(ChannelBins(counts, c), 256, Corner(tx, ty, c));
+        }
+      });
+
+  for (int ty = 1; ty <= rows_; ty++) {
+    for (int tx = 1; tx <= columns_; tx++) {
+      for (int c = 0; c < Image::kChannels; c++) {
+        uint64_t *sum = Corner(tx, ty, c);
+        const uint64_t *left = Corner(tx - 1, ty, c);
+        const uint64_t *up = Corner(tx, ty - 1, c);
+        const uint64_t *diagonal = Corner(tx - 1, ty - 1, c);
+
+        for (int i = 0; i < 256; i++) {
+          sum[i] += left[i] + up[i] - diagonal[i];
+        }
+      }
+    }
+  }
+}
+
+RGBHistogram HistogramIndex::Query(const Rectangle &area) const {
+  RGBHistogram histogram{};
+  memset(&histogram, 0, sizeof(RGBHistogram));
+
+  if (img_ == nullptr) {
+    return histogram;
+  }
+
+  Rectangle clipped = Clip(area, *img_);
+  if (IsEmpty(clipped)) {
+    return histogram;
+  }
+
+  int x2 = clipped.x + clipped.width;
+  int y2 = clipped.y + clipped.height;
+
+  // The tiles fully inside, the last partial tile of the image counts as
+  // inside when the area reaches the image border.
+  int tx0 = (clipped.x + tile_ - 1) / tile_;
+  int ty0 = (clipped.y + tile_ - 1) / tile_;
+  int tx1 = x2 == img_->width() ? columns_ : x2 / tile_;
+  int ty1 = y2 == img_->height() ? rows_ : y2 / tile_;
+
+  if (tx0 >= tx1 || ty0 >= ty1) {
+    AccumulateHistogram(*img_, clipped, histogram);
+    return histogram;
+  }
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    const uint64_t *a = Corner(tx1, ty1, c);
+    const uint64_t *b = Corner(tx0, ty1, c);
+    const uint64_t *d = Corner(tx1, ty0, c);
+    const uint64_t *e = Corner(tx0, ty0, c);
+    uint64_t *bins = ChannelBins(histogram, c);
+
+    for (int i = 0; i < 256; i++) {
+      bins[i] = a[i] - b[i] - d[i] + e[i];
+    }
+  }
+
+  int inner_x2 = std::min(tx1 * tile_, img_->width());
+  int inner_y2 = std::min(ty1 * tile_, img_->height());
+  Rectangle inner = {.x = tx0 * tile_,
+                     .y = ty0 * tile_,
+                     .width = inner_x2 - tx0 * tile_,
+                     .height = inner_y2 - ty0 * tile_};
+
+  ForEachStrip(clipped, inner, [&](const Rectangle &strip) {
+    AccumulateHistogram(*img_, strip, histogram);
+  });
+
+  return histogram;
+}
+
+SlidingHistogram::SlidingHistogram(const Image &img, const Rectangle &window)
+    : img_(&img), window_(window) {
+  memset(&histogram_, 0, sizeof(RGBHistogram));
+  Count(window_, 1);
+}
+
+void SlidingHistogram::Slide(int dx, int dy) {
+  Rectangle from = Clip(window_, *img_);
+
+  window_.x += dx;
+  window_.y += dy;
+
+  Rectangle to = Clip(window_, *img_);
+  Rectangle kept = Intersect(from, to);
+
+  if (IsEmpty(kept) || abs(dx) >= window_.width ||
+      abs(dy) >= window_.height) {
+    memset(&histogram_, 0, sizeof(RGBHistogram));
+    Count(to, 1);
+    return;
+  }
+
+  ForEachStrip(from, kept, [&](const Rectangle &strip) { Count(strip, -1); });
+  ForEachStrip(to, kept, [&](const Rectangle &strip) { Count(strip, 1); });
+}
+
+void SlidingHistogram::Count(const Rectangle &area, int sign) {
+  Rectangle clipped = Clip(area, *img_);
+  if (IsEmpty(clipped)) {
+    return;
+  }
+
+  if (sign > 0) {
+    AccumulateHistogram(*img_, clipped, histogram_);
+    return;
+  }
+
+  RGBHistogram removed{};
+  memset(&removed, 0, sizeof(RGBHistogram));
+  AccumulateHistogram(*img_, clipped, removed);
+
+  for (int i = 0; i < 256; i++) {
+    histogram_.red[i] -= removed.red[i];
+    histogram_.green[i] -= removed.green[i];
+    histogram_.blue[i] -= removed.blue[i];
+  }
+}
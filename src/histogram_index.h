@@ -0,0 +1,87 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "histogram.h"
+#include "image.h"
+
+/// Side of the tiles summarized by a @see HistogramIndex by default.
+const int kDefaultIndexTile = 64;
+
+/// @brief Answers the histogram of any rectangle of an image without walking
+/// its whole area. The image is cut in square tiles and the index keeps, for
+/// every tile corner, the histogram of everything above and to the left of it
+/// (an integral histogram over tiles). A query adds the four corners of the
+/// tiles fully inside the rectangle and counts only the pixels of the partial
+/// tiles on its borders, so it costs O(256 + perimeter * tile) instead of
+/// O(area).
+class HistogramIndex {
+public:
+  HistogramIndex() = default;
+
+  /// @brief Builds the index of @p img . The image must outlive the index and
+  /// not change while it is in use, the border pixels are read on queries.
+  /// @param img The image to be indexed
+  /// @param tile The side of the tiles, smaller tiles make queries cheaper
+  /// and the index bigger (6 KB per tile)
+  explicit HistogramIndex(const Image &img, int tile = kDefaultIndexTile);
+
+  /// @brief The histogram of the pixels of @p area . The parts of @p area
+  /// outside of the image are ignored.
+  RGBHistogram Query(const Rectangle &area) const;
+
+  int tile() const { return tile_; }
+
+private:
+  /// @brief The histogram of channel @p c of the tiles [0, tx) x [0, ty).
+  const uint64_t *Corner(int tx, int ty, int c) const {
+    return &integral_[((static_cast<size_t>(ty) * (columns_ + 1) + tx) *
+                           Image::kChannels +
+                       c) *
+                      256];
+  }
+
+  uint64_t *Corner(int tx, int ty, int c) {
+    return const_cast<uint64_t *>(
+        static_cast<const HistogramIndex *>(this)->Corner(tx, ty, c));
+  }
+
+  const Image *img_ = nullptr;
+  int tile_ = kDefaultIndexTile;
+  int columns_ = 0;
+  int rows_ = 0;
+  std::vector<uint64_t> integral_;
+};
+
+/// @brief The histogram of a window moving over an image, updated with only
+/// the columns or rows that enter and leave it. Moving by one pixel costs
+/// O(window side) instead of O(window area).
+class SlidingHistogram {
+public:
+  /// @brief Starts with the histogram of @p window on @p img , which must
+  /// outlive this object. The parts of @p window outside the image are clipped.
+  SlidingHistogram(const Image &img, const Rectangle &window);
+
+  /// @brief Moves the window by @p dx columns and @p dy rows. Moves as large
+  /// as the window itself are recounted from scratch.
+  void Slide(int dx, int dy);
+
+  /// @brief Moves the window to @p x , @p y .
+  void MoveTo(int x, int y) { Slide(x - window_.x, y - window_.y); }
+
+  const Rectangle &window() const { return window_; }
+  const RGBHistogram &histogram() const { return histogram_; }
+
+private:
+  /// @brief Adds ( @p sign = 1) or removes ( @p sign = -1) the pixels of
+  /// @p area , clipped to the image.
+  void Count(const Rectangle &area, int sign);
+
+  const Image *img_;
+  Rectangle window_;
+  RGBHistogram histogram_{};
+};
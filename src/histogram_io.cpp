@@ -0,0 +1,259 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "histogram_io.h"
+
+#include <iterator>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+namespace {
+
+/// Version 1 held the counts as uint32, version 2 as uint64.
+const uint32_t kBinaryVersion = 2;
+
+const uint32_t kDatasetVersion = 1;
+
+void PutU32(byte *to, uint32_t value) {
+  to[0] = static_cast<byte>(value);
+  to[1] = static_cast<byte>(value >> 8);
+  to[2] = static_cast<byte>(value >> 16);
+  to[3] = static_cast<byte>(value >> 24);
+}
+
+void PutU64(byte *to, uint64_t value) {
+  PutU32(to, static_cast<uint32_t>(value));
+  PutU32(to + 4, static_cast<uint32_t>(value >> 32));
+}
+
+uint32_t GetU32(const byte *from) {
+  return static_cast<uint32_t>(from[0]) |
+         static_cast<uint32_t>(from[1]) << 8 |
+         static_cast<uint32_t>(from[2]) << 16 |
+         static_cast<uint32_t>(from[3]) << 24;
+}
+
+uint64_t GetU64(const byte *from) {
+  return static_cast<uint64_t>(GetU32(from)) |
+         static_cast<uint64_t>(GetU32(from + 4)) << 32;
+}
+
+/// Bytes of an encoded @see HistogramFormat::kBinary file of each version
+const size_t kBinaryV1FileSize = 8 + 3 * 256 * 4;
+const size_t kBinaryFileSize = 8 + 3 * 256 * 8;
+
+/// Bytes of an encoded @see DatasetHistogram
+const size_t kDatasetFileSize = 16 + 3 * 256 * 8;
+
+void AppendCsv(const RGBHistogram &histogram, std::vector<byte> &bytes) {
+  auto out = std::back_inserter(bytes);
+
+  fmt::format_to(out, "value,red,green,blue\n");
+  for (int i = 0; i < 256; i++) {
+    fmt::format_to(out, "{},{},{},{}\n", i, histogram.red[i],
+                   histogram.green[i], histogram.blue[i]);
+  }
+}
+
+void AppendJson(const RGBHistogram &histogram, std::vector<byte> &bytes) {
+  const uint64_t *channels[] = {histogram.red, histogram.green,
+                               histogram.blue};
+  const char *names[] = {"red", "green", "blue"};
+  auto out = std::back_inserter(bytes);
+
+  fmt::format_to(out, "{{");
+  for (int c = 0; c < 3; c++) {
+    fmt::format_to(out, "{}\"{}\": [{}]", c == 0 ? "" : ", ", names[c],
+                   fmt::join(channels[c], channels[c] + 256, ", "));
+  }
+  fmt::format_to(out, "}}\n");
+}
+
+void AppendBinary(const RGBHistogram &histogram, std::vector<byte> &bytes) {
+  const uint64_t *channels[] = {histogram.red, histogram.green,
+                               histogram.blue};
+  byte buffer[kBinaryFileSize];
+
+  buffer[0] = 'R';
+  buffer[1] = 'G';
+  buffer[2] = 'B';
+  buffer[3] = 'H';
+  PutU32(buffer + 4, kBinaryVersion);
+
+  byte *to = buffer + 8;
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++, to += 8) {
+      PutU64(to, channels[c][i]);
+    }
+  }
+
+  bytes.insert(bytes.end(), buffer, buffer + sizeof(buffer));
+}
+
+} // namespace
+
+bool HistogramFormatByName(const std::string &name, HistogramFormat &format) {
+  if (name == "bmp") {
+    format = HistogramFormat::kImage;
+  } else if (name == "csv") {
+    format = HistogramFormat::kCsv;
+  } else if (name == "json") {
+    format = HistogramFormat::kJson;
+  } else if (name == "bin") {
+    format = HistogramFormat::kBinary;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+const char *HistogramExtension(HistogramFormat format) {
+  switch (format) {
+    using enum HistogramFormat;
+
+  case kCsv:
+    return ".csv";
+
+  case kJson:
+    return ".json";
+
+  case kBinary:
+    return ".bin";
+
+  default:
+    return ".bmp";
+  }
+}
+
+bool EncodeHistogram(const RGBHistogram &histogram, HistogramFormat format,
+                     std::vector<byte> &bytes) {
+  bytes.clear();
+
+  switch (format) {
+    using enum HistogramFormat;
+
+  case kCsv: {
+    AppendCsv(histogram, bytes);
+  } break;
+
+  case kJson: {
+    AppendJson(histogram, bytes);
+  } break;
+
+  case kBinary: {
+    AppendBinary(histogram, bytes);
+  } break;
+
+  default:
+    return false;
+  }
+
+  return true;
+}
+
+bool DecodeHistogram(const std::vector<byte> &bytes, RGBHistogram &histogram) {
+  if (bytes.size() < 8 || bytes[0] != 'R' || bytes[1] != 'G' ||
+      bytes[2] != 'B' || bytes[3] != 'H') {
+    return false;
+  }
+
+  // The files of version 1 are still read, their counts are the same.
+  uint32_t version = GetU32(bytes.data() + 4);
+  bool wide = version == kBinaryVersion;
+  if (!(wide && bytes.size() == kBinaryFileSize) &&
+      !(version == 1 && bytes.size() == kBinaryV1FileSize)) {
+    return false;
+  }
+
+  uint64_t *channels[] = {histogram.red, histogram.green, histogram.blue};
+  const byte *from = bytes.data() + 8;
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++, from += wide ? 8 : 4) {
+      channels[c][i] = wide ? GetU64(from) : GetU32(from);
+    }
+  }
+
+  return true;
+}
+
+BmpError WriteHistogram(const std::string &filename,
+                        const RGBHistogram &histogram, HistogramFormat format) {
+  std::vector<byte> bytes;
+  if (!EncodeHistogram(histogram, format, bytes)) {
+    return BMP_ERROR;
+  }
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  written = fclose(file) == 0 && written;
+
+  return written ? BMP_OK : BMP_ERROR;
+}
+
+void EncodeDatasetHistogram(const DatasetHistogram &dataset,
+                            std::vector<byte> &bytes) {
+  const uint64_t *channels[] = {dataset.red, dataset.green, dataset.blue};
+  bytes.assign(kDatasetFileSize, 0);
+
+  bytes[0] = 'R';
+  bytes[1] = 'G';
+  bytes[2] = 'B';
+  bytes[3] = 'D';
+  PutU32(bytes.data() + 4, kDatasetVersion);
+  PutU64(bytes.data() + 8, dataset.images);
+
+  byte *to = bytes.data() + 16;
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++, to += 8) {
+      PutU64(to, channels[c][i]);
+    }
+  }
+}
+
+bool DecodeDatasetHistogram(const std::vector<byte> &bytes,
+                            DatasetHistogram &dataset) {
+  if (bytes.size() != kDatasetFileSize || bytes[0] != 'R' ||
+      bytes[1] != 'G' || bytes[2] != 'B' || bytes[3] != 'D' ||
+      GetU32(bytes.data() + 4) != kDatasetVersion) {
+    return false;
+  }
+
+  uint64_t *channels[] = {dataset.red, dataset.green, dataset.blue};
+  dataset.images = GetU64(bytes.data() + 8);
+
+  const byte *from = bytes.data() + 16;
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < 256; i++, from += 8) {
+      channels[c][i] = GetU64(from);
+    }
+  }
+
+  return true;
+}
+
+BmpError WriteDatasetHistogram(const std::string &filename,
+                               const DatasetHistogram &dataset) {
+  std::vector<byte> bytes;
+  EncodeDatasetHistogram(dataset, bytes);
+
+  return WriteFileBytes(filename, bytes);
+}
+
+BmpError ReadDatasetHistogram(const std::string &filename,
+                              DatasetHistogram &dataset) {
+  std::vector<byte> bytes;
+  BmpError error = ReadFileBytes(filename, bytes);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  return DecodeDatasetHistogram(bytes, dataset) ? BMP_OK : BMP_INVALID_FILE;
+}
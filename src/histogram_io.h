@@ -0,0 +1,79 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bmp_io.h"
+#include "histogram.h"
+
+/// @brief How the histogram command writes its result
+enum class HistogramFormat {
+  /// The bar chart of @see CreateHistogramImage , as a BMP
+  kImage = 0,
+  /// One "value,red,green,blue" line per value
+  kCsv,
+  /// {"red": [...], "green": [...], "blue": [...]}
+  kJson,
+  /// "RGBH", a little endian uint32 version (2) and the 256 red, 256 green
+  /// and 256 blue counts as little endian uint64. The uint32 counts of
+  /// version 1 are still read.
+  kBinary
+};
+
+/// @brief Parses "bmp", "csv", "json" or "bin".
+/// @param name The name provided by the user
+/// @param format [out] The format of @p name
+/// @return false if @p name is unknown
+bool HistogramFormatByName(const std::string &name, HistogramFormat &format);
+
+/// @brief The file extension of @p format , like ".csv"
+const char *HistogramExtension(HistogramFormat format);
+
+/// @brief Encodes the counts of @p histogram in one of the data formats,
+/// like @see WriteHistogram does, into @p bytes .
+/// @param bytes [out] Cleared and filled with the encoded file
+/// @return false if @p format is not a data format
+bool EncodeHistogram(const RGBHistogram &histogram, HistogramFormat format,
+                     std::vector<byte> &bytes);
+
+/// @brief Decodes a @see HistogramFormat::kBinary file.
+/// @param histogram [out] The decoded histogram
+/// @return false if @p bytes is not such a file
+bool DecodeHistogram(const std::vector<byte> &bytes, RGBHistogram &histogram);
+
+/// @brief Writes the counts of @p histogram on @p filename , without drawing
+/// them.
+/// @param filename The file to be written
+/// @param histogram The histogram to be written
+/// @param format One of the data formats, @see HistogramFormat
+/// @return BMP_OK, or BMP_FILE_NOT_OPENED if @p filename could not be written
+BmpError WriteHistogram(const std::string &filename,
+                        const RGBHistogram &histogram, HistogramFormat format);
+
+/// @brief Encodes @p dataset as "RGBD", a little endian uint32 version (1),
+/// the number of images as a little endian uint64 and the 256 red, 256 green
+/// and 256 blue counts as little endian uint64.
+/// @param bytes [out] Cleared and filled with the encoded file
+void EncodeDatasetHistogram(const DatasetHistogram &dataset,
+                            std::vector<byte> &bytes);
+
+/// @brief Decodes a file made by @see EncodeDatasetHistogram .
+/// @param dataset [out] The decoded histogram
+/// @return false if @p bytes is not such a file
+bool DecodeDatasetHistogram(const std::vector<byte> &bytes,
+                            DatasetHistogram &dataset);
+
+/// @brief Writes @p dataset on @p filename , see
+/// @see EncodeDatasetHistogram .
+/// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_ERROR if it could not be written
+BmpError WriteDatasetHistogram(const std::string &filename,
+                               const DatasetHistogram &dataset);
+
+/// @brief Reads a file written by @see WriteDatasetHistogram .
+/// @param dataset [out] The histogram on the file
+/// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_INVALID_FILE
+BmpError ReadDatasetHistogram(const std::string &filename,
+                              DatasetHistogram &dataset);
@@ -0,0 +1,261 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace {
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+void Image::AlignedDeleter::operator()(byte *ptr) const {
+  ::operator delete[](ptr, std::align_val_t(kRowAlignment));
+}
+
+void Image::Allocate(size_t total_bytes) {
+  storage_ = std::shared_ptr<byte[]>(
+      static_cast<byte *>(
+          ::operator new[](total_bytes, std::align_val_t(kRowAlignment))),
+      AlignedDeleter());
+  data_ = storage_.get();
+  memset(data_, 0, total_bytes);
+}
+
+Image::Image(int width, int height, PixelLayout layout)
+    : width_(width), height_(height), layout_(layout) {
+  size_t total_bytes = 0;
+
+  if (layout == PixelLayout::kInterleaved) {
+    size_t row_bytes =
+        AlignUp(static_cast<size_t>(width) * kChannels, kRowAlignment);
+    pixel_step_ = kChannels;
+    stride_ = static_cast<ptrdiff_t>(row_bytes);
+    channel_offset_[kRed] = 0;
+    channel_offset_[kGreen] = 1;
+    channel_offset_[kBlue] = 2;
+    total_bytes = row_bytes * height;
+  } else {
+    size_t row_bytes = AlignUp(static_cast<size_t>(width), kRowAlignment);
+    pixel_step_ = 1;
+    stride_ = static_cast<ptrdiff_t>(row_bytes);
+    size_t plane_size = row_bytes * height;
+    channel_offset_[kRed] = 0;
+    channel_offset_[kGreen] = plane_size;
+    channel_offset_[kBlue] = 2 * plane_size;
+    total_bytes = kChannels * plane_size;
+  }
+
+  if (total_bytes == 0) {
+    return;
+  }
+
+  Allocate(total_bytes);
+}
+
+Image::Image(int width, int height, PixelFormat format)
+    : width_(width), height_(height), format_(format) {
+  if (format == PixelFormat::kRGB24) {
+    *this = Image(width, height, PixelLayout::kInterleaved);
+    return;
+  }
+
+  int bytes = BytesPerPixel(format);
+  size_t row_bytes =
+      AlignUp(static_cast<size_t>(width) * bytes, kRowAlignment);
+  bool gray = format == PixelFormat::kGray8;
+
+  pixel_step_ = bytes;
+  stride_ = static_cast<ptrdiff_t>(row_bytes);
+  channel_offset_[kRed] = gray ? 0 : 2;
+  channel_offset_[kGreen] = gray ? 0 : 1;
+  channel_offset_[kBlue] = 0;
+
+  size_t total_bytes = row_bytes * height;
+  if (total_bytes == 0) {
+    return;
+  }
+
+  Allocate(total_bytes);
+
+  if (format == PixelFormat::kBGRA32) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        row(y)[4 * x + BGRA32::kAlphaByte] = 255;
+      }
+    }
+  }
+}
+
+Image Image::Wrap(byte *top_row, int width, int height, ptrdiff_t stride,
+                  PixelFormat format) {
+  Image view = WrapInterleaved(top_row, width, height, stride,
+                               format == PixelFormat::kRGB24
+                                   ? ChannelOrder::kRGB
+                                   : ChannelOrder::kBGR);
+
+  view.format_ = format;
+  view.pixel_step_ = BytesPerPixel(format);
+  if (format == PixelFormat::kGray8) {
+    view.channel_offset_[kRed] = 0;
+    view.channel_offset_[kGreen] = 0;
+    view.channel_offset_[kBlue] = 0;
+  }
+
+  return view;
+}
+
+Image Image::WrapInterleaved(byte *top_row, int width, int height,
+                             ptrdiff_t stride, ChannelOrder order) {
+  Image view;
+
+  view.width_ = width;
+  view.height_ = height;
+  view.layout_ = PixelLayout::kInterleaved;
+  view.stride_ = stride;
+  view.pixel_step_ = kChannels;
+  view.channel_offset_[kRed] = order == ChannelOrder::kRGB ? 0 : 2;
+  view.channel_offset_[kGreen] = 1;
+  view.channel_offset_[kBlue] = order == ChannelOrder::kRGB ? 2 : 0;
+  view.data_ = top_row;
+
+  return view;
+}
+
+Image::Image(Image &&other) noexcept { *this = std::move(other); }
+
+Image &Image::operator=(Image &&other) noexcept {
+  if (this == &other) {
+    return *this;
+  }
+
+  width_ = std::exchange(other.width_, 0);
+  height_ = std::exchange(other.height_, 0);
+  layout_ = other.layout_;
+  format_ = std::exchange(other.format_, PixelFormat::kRGB24);
+  stride_ = std::exchange(other.stride_, 0);
+  pixel_step_ = std::exchange(other.pixel_step_, 0);
+  for (int c = 0; c < kChannels; c++) {
+    channel_offset_[c] = std::exchange(other.channel_offset_[c], 0);
+  }
+  storage_ = std::move(other.storage_);
+  data_ = std::exchange(other.data_, nullptr);
+  shared_view_ = std::exchange(other.shared_view_, false);
+
+  return *this;
+}
+
+Image Image::Clone() const {
+  if (format_ == PixelFormat::kRGB24) {
+    return ToLayout(layout_);
+  }
+
+  Image copy(width_, height_, format_);
+  CopyPixels(*this, copy);
+
+  return copy;
+}
+
+Image Image::Share() const {
+  Image view;
+
+  view.width_ = width_;
+  view.height_ = height_;
+  view.layout_ = layout_;
+  view.format_ = format_;
+  view.stride_ = stride_;
+  view.pixel_step_ = pixel_step_;
+  for (int c = 0; c < kChannels; c++) {
+    view.channel_offset_[c] = channel_offset_[c];
+  }
+  view.storage_ = storage_;
+  view.data_ = data_;
+  view.shared_view_ = true;
+
+  return view;
+}
+
+void Image::MakeWritable() {
+  if (shared()) {
+    *this = Clone();
+  }
+}
+
+Image Image::ToLayout(PixelLayout layout) const {
+  Image copy(width_, height_, layout);
+
+  CopyPixels(*this, copy);
+
+  return copy;
+}
+
+RGBColor Image::pixel(int x, int y) const {
+  return RGBColor{.r = channel_row(kRed, y)[x * pixel_step_],
+                  .g = channel_row(kGreen, y)[x * pixel_step_],
+                  .b = channel_row(kBlue, y)[x * pixel_step_]};
+}
+
+void Image::set_pixel(int x, int y, const RGBColor &color) {
+  if (format_ == PixelFormat::kGray8) {
+    channel_row(kRed, y)[x] = Luma(color);
+    return;
+  }
+
+  channel_row(kRed, y)[x * pixel_step_] = color.r;
+  channel_row(kGreen, y)[x * pixel_step_] = color.g;
+  channel_row(kBlue, y)[x * pixel_step_] = color.b;
+}
+
+void CopyPixels(const Image &src, Image &dst) {
+  int width = std::min(src.width(), dst.width());
+  int height = std::min(src.height(), dst.height());
+  int src_step = src.pixel_step();
+  int dst_step = dst.pixel_step();
+
+  bool same_format =
+      src.layout() == dst.layout() && src.format() == dst.format();
+  for (int c = 0; c < Image::kChannels; c++) {
+    same_format =
+        same_format && src.channel_offset(c) == dst.channel_offset(c);
+  }
+
+  if (dst.format() == PixelFormat::kGray8 && !same_format) {
+    for (int y = 0; y < height; y++) {
+      byte *to = dst.row(y);
+      for (int x = 0; x < width; x++) {
+        to[x] = Luma(src.pixel(x, y));
+      }
+    }
+    return;
+  }
+
+  if (same_format && src.layout() == PixelLayout::kInterleaved) {
+    for (int y = 0; y < height; y++) {
+      memcpy(dst.row(y), src.row(y), static_cast<size_t>(width) * src_step);
+    }
+    return;
+  }
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int y = 0; y < height; y++) {
+      const byte *from = src.channel_row(c, y);
+      byte *to = dst.channel_row(c, y);
+
+      if (same_format) {
+        memcpy(to, from, width);
+        continue;
+      }
+
+      for (int x = 0; x < width; x++) {
+        to[x * dst_step] = from[x * src_step];
+      }
+    }
+  }
+}
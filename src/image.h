@@ -0,0 +1,183 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "pixel_format.h"
+
+using byte = unsigned char;
+
+struct Rectangle {
+  int x, y;
+  int width, height;
+};
+
+struct RGBColor {
+  byte r, g, b;
+};
+
+/// @brief The BT.601 luma of @p color , in integer arithmetic.
+inline byte Luma(const RGBColor &color) {
+  int weighted = 77 * color.r + 150 * color.g + 29 * color.b;
+  return static_cast<byte>((weighted + 128) >> 8);
+}
+
+/// @brief Index of each color channel inside an @see Image
+enum Channel : int { kRed = 0, kGreen = 1, kBlue = 2 };
+
+/// @brief How the samples of an @see Image are placed in memory
+enum class PixelLayout {
+  /// RGBRGBRGB... on each row
+  kInterleaved = 0,
+  /// One full R plane, followed by the G plane and the B plane
+  kPlanar
+};
+
+/// @brief Order of the samples inside an interleaved pixel
+enum class ChannelOrder { kRGB = 0, kBGR };
+
+/// @brief A RGB image backed by one contiguous buffer. Every row (or every
+/// plane row on the planar layout) starts at a @see kRowAlignment aligned
+/// address, so kernels can walk raw row pointers instead of calling per pixel
+/// accessors. An image can also be a view over memory it does not own, see
+/// @see WrapInterleaved . Besides RGB, interleaved images may hold 8 bit gray
+/// or 32 bit BGRA pixels, see @see PixelFormat .
+///
+/// Images are move-only: the only ways to get a second image of the same
+/// pixels are the deep @see Clone and the copy-on-write @see Share , so no
+/// copy is ever made behind the back of the caller.
+class Image {
+public:
+  static constexpr int kChannels = 3;
+  static constexpr size_t kRowAlignment = 64;
+
+  Image() = default;
+  Image(int width, int height,
+        PixelLayout layout = PixelLayout::kInterleaved);
+
+  /// @brief Creates an interleaved image of @p format . The alpha of BGRA32
+  /// images starts opaque.
+  Image(int width, int height, PixelFormat format);
+
+  Image(Image &&other) noexcept;
+  Image &operator=(Image &&other) noexcept;
+
+  Image(const Image &) = delete;
+  Image &operator=(const Image &) = delete;
+
+  /// @brief Makes an interleaved view over pixels owned by someone else, like
+  /// the pixel array of a mapped BMP. The memory must outlive the view.
+  /// @param top_row Pointer to the first pixel of the row y = 0
+  /// @param width The number of pixels on each row
+  /// @param height The number of rows
+  /// @param stride Bytes from a row to the next one, negative for bottom-up
+  /// buffers
+  /// @param order The order of the samples inside each pixel
+  static Image WrapInterleaved(byte *top_row, int width, int height,
+                               ptrdiff_t stride, ChannelOrder order);
+
+  /// @brief Like @see WrapInterleaved , for pixels of any @p format (RGB24
+  /// in RGB order).
+  static Image Wrap(byte *top_row, int width, int height, ptrdiff_t stride,
+                    PixelFormat format);
+
+  /// @brief Makes a deep copy of this image, in the same format and layout.
+  Image Clone() const;
+
+  /// @brief Makes a copy-on-write view of this image: it reads the same
+  /// pixels, keeping them alive when this image owns them, and is
+  /// @see shared until @see MakeWritable gives it pixels of its own. The
+  /// owner is @see shared too while the view lives. Views over memory no
+  /// image owns (see @see Wrap ) can not tell they were shared, so writing
+  /// on them writes on every view taken from them.
+  Image Share() const;
+
+  /// @brief Whether the pixels are read by other images too, see
+  /// @see Share . Writers must call @see MakeWritable first.
+  bool shared() const {
+    return storage_ != nullptr ? storage_.use_count() > 1 : shared_view_;
+  }
+
+  /// @brief Copies the pixels (see @see Clone ) if they are @see shared , so
+  /// they can be written without changing other images. A no-op otherwise.
+  void MakeWritable();
+
+  /// @brief Makes an RGB copy of this image with the samples placed on
+  /// @p layout
+  Image ToLayout(PixelLayout layout) const;
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  PixelLayout layout() const { return layout_; }
+  PixelFormat format() const { return format_; }
+  bool empty() const { return data_ == nullptr; }
+  bool owns_data() const { return storage_ != nullptr; }
+
+  /// @brief Bytes between the start of two consecutive rows of a channel.
+  ptrdiff_t stride() const { return stride_; }
+
+  /// @brief Bytes between two consecutive samples of the same channel on a
+  /// row. The bytes of a pixel for the interleaved layout and 1 for the
+  /// planar one.
+  int pixel_step() const { return pixel_step_; }
+
+  /// @brief Distinct color samples on each pixel: 1 for gray images, whose
+  /// three channels share the same sample, and 3 otherwise.
+  int color_channels() const {
+    return format_ == PixelFormat::kGray8 ? 1 : kChannels;
+  }
+
+  /// @brief Pointer to the first sample of @p channel on the row @p y. The
+  /// next sample of the same channel is @see pixel_step bytes ahead.
+  byte *channel_row(int channel, int y) {
+    return data_ + channel_offset_[channel] + y * stride_;
+  }
+  const byte *channel_row(int channel, int y) const {
+    return data_ + channel_offset_[channel] + y * stride_;
+  }
+
+  /// @brief Offset of the samples of @p channel from the start of a pixel on
+  /// the interleaved layout (or from the start of the buffer on the planar).
+  size_t channel_offset(int channel) const { return channel_offset_[channel]; }
+
+  /// @brief Pointer to the start of row @p y on the interleaved layout.
+  byte *row(int y) { return data_ + y * stride_; }
+  const byte *row(int y) const { return data_ + y * stride_; }
+
+  /// @brief Slow per pixel access, meant for tooling and not for kernels.
+  /// Gray images store the @see Luma of the colors they are given.
+  RGBColor pixel(int x, int y) const;
+  void set_pixel(int x, int y, const RGBColor &color);
+
+private:
+  struct AlignedDeleter {
+    void operator()(byte *ptr) const;
+  };
+
+  void Allocate(size_t total_bytes);
+
+  int width_ = 0;
+  int height_ = 0;
+  PixelLayout layout_ = PixelLayout::kInterleaved;
+  PixelFormat format_ = PixelFormat::kRGB24;
+  ptrdiff_t stride_ = 0;
+  int pixel_step_ = 0;
+  size_t channel_offset_[kChannels] = {0, 0, 0};
+
+  /// Shared with the views made by @see Share .
+  std::shared_ptr<byte[]> storage_;
+  byte *data_ = nullptr;
+  /// Set on the views made by @see Share , for the ones of pixels no image
+  /// owns.
+  bool shared_view_ = false;
+};
+
+/// @brief Copies the pixels of @p src into @p dst , converting between their
+/// layouts, formats and channel orders (colors become their @see Luma on gray
+/// images). Only the area both images cover is copied.
+/// @param src The image to be read
+/// @param dst [out] The image to be written
+void CopyPixels(const Image &src, Image &dst);
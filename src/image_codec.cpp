@@ -0,0 +1,207 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "image_codec.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits.h>
+#include <stdio.h>
+#include <utility>
+
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_TGA
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "profiler.h"
+
+namespace {
+
+/// @brief Swaps the red and blue samples of @p count four byte pixels,
+/// turning RGBA into BGRA and back.
+void SwapRedBlue(byte *pixels, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    std::swap(pixels[4 * i], pixels[4 * i + 2]);
+  }
+}
+
+/// @brief The stb_image_write callback, appending to a std::vector<byte> .
+void AppendBytes(void *context, void *data, int size) {
+  auto *bytes = static_cast<std::vector<byte> *>(context);
+  const byte *begin = static_cast<const byte *>(data);
+
+  bytes->insert(bytes->end(), begin, begin + size);
+}
+
+} // namespace
+
+bool ImageFileTypeByExtension(const std::string &filename,
+                              ImageFileType &type) {
+  size_t dot = filename.find_last_of('.');
+  std::string extension =
+      dot == std::string::npos ? std::string() : filename.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  if (extension == ".bmp") {
+    type = ImageFileType::kBmp;
+  } else if (extension == ".png") {
+    type = ImageFileType::kPng;
+  } else if (extension == ".jpg" || extension == ".jpeg") {
+    type = ImageFileType::kJpeg;
+  } else if (extension == ".tga") {
+    type = ImageFileType::kTga;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+ImageFileType ImageFileTypeOf(const std::string &filename) {
+  ImageFileType type = ImageFileType::kBmp;
+  ImageFileTypeByExtension(filename, type);
+
+  return type;
+}
+
+DecodedImage::~DecodedImage() { Close(); }
+
+BmpError DecodedImage::Open(const std::string &filename) {
+  Close();
+
+  ProfileScope profile(ProfileStage::kRead);
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  int gray = stbi_info_from_file(file, &width, &height, &channels) &&
+             channels <= 2;
+  byte *pixels =
+      stbi_load_from_file(file, &width, &height, &channels, gray ? 1 : 0);
+  fclose(file);
+
+  profile.Count(static_cast<int64_t>(width) * height, 0);
+  return Wrap(pixels, width, height, gray ? 1 : channels);
+}
+
+BmpError DecodedImage::Open(const byte *data, size_t size) {
+  Close();
+
+  if (size > static_cast<size_t>(INT_MAX)) {
+    return BMP_INVALID_FILE;
+  }
+
+  ProfileScope profile(ProfileStage::kRead);
+  int length = static_cast<int>(size);
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  int gray = stbi_info_from_memory(data, length, &width, &height, &channels) &&
+             channels <= 2;
+  byte *pixels = stbi_load_from_memory(data, length, &width, &height,
+                                       &channels, gray ? 1 : 0);
+
+  profile.Count(static_cast<int64_t>(width) * height,
+                static_cast<int64_t>(size));
+  return Wrap(pixels, width, height, gray ? 1 : channels);
+}
+
+BmpError DecodedImage::Wrap(byte *pixels, int width, int height,
+                            int channels) {
+  pixels_ = pixels;
+  if (pixels == nullptr) {
+    return BMP_INVALID_FILE;
+  }
+
+  ptrdiff_t stride = static_cast<ptrdiff_t>(width) * channels;
+
+  switch (channels) {
+  case 1: {
+    image_ = Image::Wrap(pixels, width, height, stride, PixelFormat::kGray8);
+  } break;
+
+  case 3: {
+    image_ = Image::Wrap(pixels, width, height, stride, PixelFormat::kRGB24);
+  } break;
+
+  case 4: {
+    SwapRedBlue(pixels, static_cast<size_t>(width) * height);
+    image_ = Image::Wrap(pixels, width, height, stride, PixelFormat::kBGRA32);
+  } break;
+
+  default: {
+    Close();
+    return BMP_INVALID_FILE;
+  }
+  }
+
+  return BMP_OK;
+}
+
+void DecodedImage::Close() {
+  if (pixels_ != nullptr) {
+    stbi_image_free(pixels_);
+    pixels_ = nullptr;
+  }
+
+  image_ = Image();
+}
+
+bool EncodeImage(const Image &img, ImageFileType type,
+                 std::vector<byte> &bytes) {
+  ProfileScope profile(ProfileStage::kWrite);
+
+  // The encoders take packed rows with the samples in RGB(A) order.
+  PixelFormat format = img.format();
+  int channels = BytesPerPixel(format);
+  int width = img.width();
+  int height = img.height();
+  int stride = width * channels;
+
+  std::vector<byte> pixels(static_cast<size_t>(stride) * height);
+  Image packed = Image::Wrap(pixels.data(), width, height, stride, format);
+  CopyPixels(img, packed);
+  if (format == PixelFormat::kBGRA32) {
+    SwapRedBlue(pixels.data(), static_cast<size_t>(width) * height);
+  }
+
+  bytes.clear();
+  int written = 0;
+
+  switch (type) {
+    using enum ImageFileType;
+
+  case kPng: {
+    written = stbi_write_png_to_func(AppendBytes, &bytes, width, height,
+                                     channels, pixels.data(), stride);
+  } break;
+
+  case kJpeg: {
+    written = stbi_write_jpg_to_func(AppendBytes, &bytes, width, height,
+                                     channels, pixels.data(),
+                                     kDefaultJpegQuality);
+  } break;
+
+  case kTga: {
+    written = stbi_write_tga_to_func(AppendBytes, &bytes, width, height,
+                                     channels, pixels.data());
+  } break;
+
+  default:
+    break;
+  }
+
+  profile.Count(static_cast<int64_t>(width) * height,
+                static_cast<int64_t>(bytes.size()));
+  return written != 0;
+}
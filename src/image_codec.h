@@ -0,0 +1,70 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "image.h"
+#include "libbmp.h"
+
+/// Quality of the JPEG files written by @see EncodeImage , from 1 to 100.
+const int kDefaultJpegQuality = 90;
+
+/// @brief The file formats images are read from and written to. BMP files go
+/// through bmp_io.h, the others through stb_image.
+enum class ImageFileType { kBmp = 0, kPng, kJpeg, kTga };
+
+/// @brief Finds the type of @p filename by its extension: ".bmp", ".png",
+/// ".jpg", ".jpeg" or ".tga", in any case.
+/// @param filename The name of the file
+/// @param type [out] The type of @p filename
+/// @return false if the extension is none of them
+bool ImageFileTypeByExtension(const std::string &filename,
+                              ImageFileType &type);
+
+/// @brief Like @see ImageFileTypeByExtension , taking unknown extensions as
+/// BMP, like the files were always taken.
+ImageFileType ImageFileTypeOf(const std::string &filename);
+
+/// @brief An image decoded by stb_image: PNG, JPEG or TGA. The decoded
+/// pixels are exposed in place by @see image , gray for files with a single
+/// channel (their alpha is dropped), RGB for color files and BGRA for color
+/// files with alpha, so nothing is copied after the decode.
+class DecodedImage {
+public:
+  DecodedImage() = default;
+  ~DecodedImage();
+
+  DecodedImage(const DecodedImage &) = delete;
+  DecodedImage &operator=(const DecodedImage &) = delete;
+
+  /// @brief Decodes the file @p filename whole.
+  /// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_INVALID_FILE if it could not
+  /// be decoded
+  BmpError Open(const std::string &filename);
+
+  /// @brief Decodes the file held by the @p size bytes of @p data .
+  /// @return BMP_OK, or BMP_INVALID_FILE if it could not be decoded
+  BmpError Open(const byte *data, size_t size);
+
+  Image &image() { return image_; }
+
+private:
+  BmpError Wrap(byte *pixels, int width, int height, int channels);
+  void Close();
+
+  byte *pixels_ = nullptr;
+  Image image_;
+};
+
+/// @brief Encodes @p img as a file of @p type , in its own format: gray
+/// images as gray files and BGRA images with their alpha (JPEG files drop
+/// it).
+/// @param img The image to be encoded
+/// @param type Any type but @see ImageFileType::kBmp
+/// @param bytes [out] Receives the encoded file
+/// @return false if the image could not be encoded
+bool EncodeImage(const Image &img, ImageFileType type,
+                 std::vector<byte> &bytes);
@@ -0,0 +1,47 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "io_pipeline.h"
+
+#include <fmt/format.h>
+
+void StageStats::Merge(const StageStats &other) {
+  busy_seconds += other.busy_seconds;
+  starved_seconds += other.starved_seconds;
+  blocked_seconds += other.blocked_seconds;
+  items += other.items;
+}
+
+double StageStats::Occupancy(double wall_seconds) const {
+  double available = wall_seconds * threads;
+  return available > 0.0 ? busy_seconds / available : 0.0;
+}
+
+void PrintPipelineStats(const PipelineStats &stats) {
+  struct Stage {
+    const char *name;
+    const StageStats &stats;
+  };
+  const Stage stages[] = {{"read", stats.read},
+                          {"compute", stats.compute},
+                          {"write", stats.write}};
+
+  const Stage *busiest = &stages[0];
+  for (const Stage &stage : stages) {
+    double occupancy = stage.stats.Occupancy(stats.wall_seconds);
+
+    fmt::print("{:>7}: {:5.1f}% busy on {} thread(s), {} items, waited "
+               "{:.1f} ms for input and {:.1f} ms for room\n",
+               stage.name, 100.0 * occupancy, stage.stats.threads,
+               stage.stats.items, 1e3 * stage.stats.starved_seconds,
+               1e3 * stage.stats.blocked_seconds);
+
+    if (occupancy > busiest->stats.Occupancy(stats.wall_seconds)) {
+      busiest = &stage;
+    }
+  }
+
+  bool compute_bound = busiest == &stages[1];
+  fmt::print("{} bound (the {} stage is the busiest)\n",
+             compute_bound ? "Compute" : "I/O", busiest->name);
+}
@@ -0,0 +1,145 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/// Items each queue between two stages holds by default.
+const int kDefaultQueueDepth = 4;
+
+/// @brief Where the time of the threads of one stage went.
+struct StageStats {
+  /// Time spent doing the work of the stage.
+  double busy_seconds = 0.0;
+  /// Time spent waiting for the previous stage to hand an item.
+  double starved_seconds = 0.0;
+  /// Time spent waiting for room on the queue of the next stage.
+  double blocked_seconds = 0.0;
+  int64_t items = 0;
+  int threads = 1;
+
+  /// @brief Adds the time of another thread of the same stage.
+  void Merge(const StageStats &other);
+
+  /// @brief The fraction of the @p wall_seconds of its threads the stage was
+  /// busy.
+  double Occupancy(double wall_seconds) const;
+};
+
+/// @brief The stages of a read, compute and write pipeline.
+struct PipelineStats {
+  StageStats read;
+  StageStats compute;
+  StageStats write;
+  double wall_seconds = 0.0;
+};
+
+/// @brief Prints the occupancy of each stage of @p stats and which one bounds
+/// the run: the busiest stage, I/O when it is the reader or the writer.
+void PrintPipelineStats(const PipelineStats &stats);
+
+/// @brief Measures the time since its creation or its last @see Lap .
+class StageClock {
+public:
+  StageClock() : start_(Clock::now()) {}
+
+  /// @brief The seconds since the last lap, starting a new one.
+  double Lap() {
+    Clock::time_point now = Clock::now();
+    double seconds = std::chrono::duration<double>(now - start_).count();
+    start_ = now;
+    return seconds;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start_;
+};
+
+/// @brief A fixed capacity queue handing items from a stage to the next one.
+/// Producers block while it is full, so a slow consumer throttles them and
+/// the memory in flight stays bounded. The ring never allocates after the
+/// construction.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(int capacity = kDefaultQueueDepth)
+      : items_(capacity > 0 ? capacity : 1) {}
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  /// @brief Appends @p item , waiting for room first.
+  /// @param blocked [out] Receives the seconds spent waiting added to it
+  void Push(T item, double &blocked) {
+    std::unique_lock lock(mutex_);
+    StageClock clock;
+
+    not_full_.wait(lock, [this] { return count_ < items_.size(); });
+    blocked += clock.Lap();
+
+    items_[(head_ + count_) % items_.size()] = std::move(item);
+    count_++;
+    not_empty_.notify_one();
+  }
+
+  /// @brief Takes the oldest item, waiting for one first.
+  /// @param item [out] The item taken
+  /// @param starved [out] Receives the seconds spent waiting added to it
+  /// @return false once the queue is closed and drained
+  bool Pop(T &item, double &starved) {
+    std::unique_lock lock(mutex_);
+    StageClock clock;
+
+    not_empty_.wait(lock, [this] { return count_ > 0 || closed_; });
+    starved += clock.Lap();
+    if (count_ == 0) {
+      return false;
+    }
+
+    item = std::move(items_[head_]);
+    head_ = (head_ + 1) % items_.size();
+    count_--;
+    not_full_.notify_one();
+
+    return true;
+  }
+
+  /// @brief Takes the oldest item if there is one, without waiting.
+  /// @param item [out] The item taken
+  /// @return false if the queue was empty
+  bool TryPop(T &item) {
+    std::lock_guard lock(mutex_);
+    if (count_ == 0) {
+      return false;
+    }
+
+    item = std::move(items_[head_]);
+    head_ = (head_ + 1) % items_.size();
+    count_--;
+    not_full_.notify_one();
+
+    return true;
+  }
+
+  /// @brief Tells the consumers no item will come after the queued ones.
+  void Close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+  }
+
+private:
+  std::vector<T> items_;
+  size_t head_ = 0;
+  size_t count_ = 0;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+};
@@ -0,0 +1,291 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "luma.h"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PDI_LI_LUMA_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PDI_LI_LUMA_NEON 1
+#endif
+
+#include "pixel_unpack.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
+#include "traversal.h"
+
+namespace {
+
+/// Fewest rows of a band of @see CountLuma .
+const int kMinLumaBandRows = 32;
+
+/// Copies of the histogram each band of @see CountLuma counts on.
+const int kLumaSubHistograms = 4;
+
+/// @brief The @see Luma of @p kBlockPixels pixels given as three planes.
+/// The weighted sum of a pixel is at most 255 * 256 + 128, so it fits the 16
+/// bit lanes.
+inline void LumaBlock(const byte *red, const byte *green, const byte *blue,
+                      byte *luma) {
+#if defined(PDI_LI_LUMA_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i red_weight = _mm_set1_epi16(77);
+  const __m128i green_weight = _mm_set1_epi16(150);
+  const __m128i blue_weight = _mm_set1_epi16(29);
+  const __m128i half = _mm_set1_epi16(128);
+
+  __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(red));
+  __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(green));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blue));
+
+  auto weigh = [&](__m128i r16, __m128i g16, __m128i b16) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r16, red_weight),
+                                _mm_mullo_epi16(g16, green_weight));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b16, blue_weight));
+    return _mm_srli_epi16(_mm_add_epi16(sum, half), 8);
+  };
+
+  __m128i low = weigh(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero),
+                      _mm_unpacklo_epi8(b, zero));
+  __m128i high = weigh(_mm_unpackhi_epi8(r, zero),
+                       _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(luma),
+                   _mm_packus_epi16(low, high));
+#elif defined(PDI_LI_LUMA_NEON)
+  uint8x16_t r = vld1q_u8(red);
+  uint8x16_t g = vld1q_u8(green);
+  uint8x16_t b = vld1q_u8(blue);
+
+  uint16x8_t low = vmull_u8(vget_low_u8(r), vdup_n_u8(77));
+  low = vmlal_u8(low, vget_low_u8(g), vdup_n_u8(150));
+  low = vmlal_u8(low, vget_low_u8(b), vdup_n_u8(29));
+  uint16x8_t high = vmull_u8(vget_high_u8(r), vdup_n_u8(77));
+  high = vmlal_u8(high, vget_high_u8(g), vdup_n_u8(150));
+  high = vmlal_u8(high, vget_high_u8(b), vdup_n_u8(29));
+
+  // The rounding narrow shift adds the 128 of @see Luma .
+  vst1q_u8(luma, vcombine_u8(vrshrn_n_u16(low, 8), vrshrn_n_u16(high, 8)));
+#else
+  for (int x = 0; x < kBlockPixels; x++) {
+    luma[x] = Luma(RGBColor{.r = red[x], .g = green[x], .b = blue[x]});
+  }
+#endif
+}
+
+/// @brief Converts the row @p y of an interleaved @p src of @p Bytes bytes per
+/// pixel, unpacking each block of pixels into planes first.
+template <int Bytes>
+void LumaPackedRow(const Image &src, int y, byte *luma) {
+  const byte *row = src.row(y);
+  alignas(16) byte planes[4][kBlockPixels];
+  const byte *red = planes[src.channel_offset(kRed)];
+  const byte *green = planes[src.channel_offset(kGreen)];
+  const byte *blue = planes[src.channel_offset(kBlue)];
+  int width = src.width();
+  int x = 0;
+
+  for (; x + kBlockPixels <= width; x += kBlockPixels) {
+    if constexpr (Bytes == 4) {
+      byte *outputs[4] = {planes[0], planes[1], planes[2], planes[3]};
+      UnpackBlock4(row + Bytes * x, outputs);
+    } else {
+      UnpackBlock(row + Bytes * x, planes[0], planes[1], planes[2]);
+    }
+    LumaBlock(red, green, blue, luma + x);
+  }
+
+  for (; x < width; x++) {
+    luma[x] = Luma(src.pixel(x, y));
+  }
+}
+
+/// @brief Converts the row @p y of a planar @p src , whose planes already are
+/// the inputs of @see LumaBlock .
+void LumaPlanarRow(const Image &src, int y, byte *luma) {
+  const byte *red = src.channel_row(kRed, y);
+  const byte *green = src.channel_row(kGreen, y);
+  const byte *blue = src.channel_row(kBlue, y);
+  int width = src.width();
+  int x = 0;
+
+  for (; x + kBlockPixels <= width; x += kBlockPixels) {
+    LumaBlock(red + x, green + x, blue + x, luma + x);
+  }
+
+  for (; x < width; x++) {
+    luma[x] = Luma(RGBColor{.r = red[x], .g = green[x], .b = blue[x]});
+  }
+}
+
+/// @brief Writes the @see Luma of the row @p y of @p src on @p luma .
+void LumaRow(const Image &src, int y, byte *luma) {
+  if (src.format() == PixelFormat::kGray8) {
+    memcpy(luma, src.row(y), src.width());
+  } else if (src.layout() == PixelLayout::kPlanar) {
+    LumaPlanarRow(src, y, luma);
+  } else if (src.pixel_step() == 4) {
+    LumaPackedRow<4>(src, y, luma);
+  } else {
+    LumaPackedRow<3>(src, y, luma);
+  }
+}
+
+/// @brief Moves the @p kBlockPixels samples of @p samples by @p target minus
+/// @p luma , clamped to [0, 255].
+inline void ShiftBlock(byte *samples, const byte *luma, const byte *target) {
+#if defined(PDI_LI_LUMA_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+  __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(luma));
+  __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i *>(target));
+
+  __m128i low = _mm_sub_epi16(
+      _mm_add_epi16(_mm_unpacklo_epi8(v, zero), _mm_unpacklo_epi8(t, zero)),
+      _mm_unpacklo_epi8(l, zero));
+  __m128i high = _mm_sub_epi16(
+      _mm_add_epi16(_mm_unpackhi_epi8(v, zero), _mm_unpackhi_epi8(t, zero)),
+      _mm_unpackhi_epi8(l, zero));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(samples),
+                   _mm_packus_epi16(low, high));
+#elif defined(PDI_LI_LUMA_NEON)
+  uint8x16_t v = vld1q_u8(samples);
+  int16x8_t low = vreinterpretq_s16_u16(
+      vsubl_u8(vget_low_u8(vld1q_u8(target)), vget_low_u8(vld1q_u8(luma))));
+  int16x8_t high = vreinterpretq_s16_u16(
+      vsubl_u8(vget_high_u8(vld1q_u8(target)), vget_high_u8(vld1q_u8(luma))));
+  low = vaddq_s16(low, vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v))));
+  high = vaddq_s16(high, vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v))));
+
+  vst1q_u8(samples, vcombine_u8(vqmovun_s16(low), vqmovun_s16(high)));
+#else
+  for (int x = 0; x < kBlockPixels; x++) {
+    samples[x] = static_cast<byte>(
+        std::clamp(samples[x] + target[x] - luma[x], 0, 255));
+  }
+#endif
+}
+
+/// @brief Moves each color sample of the row @p y of @p img by the change
+/// of the luma of its pixel, from @p luma to @p target .
+void ShiftRow(Image &img, int y, const byte *luma, const byte *target) {
+  int width = img.width();
+  int step = img.pixel_step();
+
+  for (int c = 0; c < img.color_channels(); c++) {
+    byte *row = img.channel_row(c, y);
+    int x = 0;
+
+    // Only the planes are contiguous, the packed samples go one at a time.
+    if (step == 1) {
+      for (; x + kBlockPixels <= width; x += kBlockPixels) {
+        ShiftBlock(row + x, luma + x, target + x);
+      }
+    }
+
+    for (; x < width; x++) {
+      row[x * step] = static_cast<byte>(
+          std::clamp(row[x * step] + target[x] - luma[x], 0, 255));
+    }
+  }
+}
+
+} // namespace
+
+void ConvertToLuma(const Image &src, Image &gray) {
+  ParallelForEachTile(src, [&](const Rectangle &band) {
+    ForEachRow(band.y, band.y + band.height,
+               [&](int y) { LumaRow(src, y, gray.row(y)); });
+  });
+}
+
+void CountLuma(const Image &img, uint64_t *bins) {
+  ThreadPool &pool = GetThreadPool();
+  int bands = std::clamp(img.height() / kMinLumaBandRows, 1, pool.size());
+
+  ScratchScope scope(GetProcessingContext().arena());
+  uint64_t *partials = scope.arena().Allocate<uint64_t>(
+      static_cast<size_t>(bands) * kLumaSubHistograms * 256);
+  memset(partials, 0,
+         static_cast<size_t>(bands) * kLumaSubHistograms * 256 *
+             sizeof(uint64_t));
+
+  pool.ParallelFor(bands, [&](int band) {
+    RowBand rows = SplitRows(0, img.height(), band, bands);
+    uint64_t *sub = partials + static_cast<size_t>(band) *
+                                   kLumaSubHistograms * 256;
+    ScratchScope band_scope(GetProcessingContext().arena());
+    byte *luma = band_scope.arena().Allocate<byte>(img.width());
+    int width = img.width();
+
+    ForEachRow(rows.begin, rows.end, [&](int y) {
+      LumaRow(img, y, luma);
+
+      // Consecutive pixels count on different copies of the histogram, so
+      // runs of the same luma do not wait on each other's increments.
+      int x = 0;
+      for (; x + kLumaSubHistograms <= width; x += kLumaSubHistograms) {
+        for (int k = 0; k < kLumaSubHistograms; k++) {
+          sub[k * 256 + luma[x + k]]++;
+        }
+      }
+      for (; x < width; x++) {
+        sub[luma[x]]++;
+      }
+    });
+  });
+
+  memset(bins, 0, 256 * sizeof(uint64_t));
+  for (int k = 0; k < bands * kLumaSubHistograms; k++) {
+    for (int i = 0; i < 256; i++) {
+      bins[i] += partials[static_cast<size_t>(k) * 256 + i];
+    }
+  }
+}
+
+void MapLuma(Image &img, const byte *table) {
+  ParallelForEachTile(img, [&](const Rectangle &band) {
+    int width = img.width();
+
+    if (img.format() == PixelFormat::kGray8) {
+      // The luma of a gray pixel is its sample, which goes to its target.
+      ForEachRow(band.y, band.y + band.height, [&](int y) {
+        byte *row = img.row(y);
+        for (int x = 0; x < width; x++) {
+          row[x] = table[row[x]];
+        }
+      });
+      return;
+    }
+
+    ScratchScope scope(GetProcessingContext().arena());
+    byte *luma = scope.arena().Allocate<byte>(width);
+    byte *target = scope.arena().Allocate<byte>(width);
+
+    ForEachRow(band.y, band.y + band.height, [&](int y) {
+      LumaRow(img, y, luma);
+      for (int x = 0; x < width; x++) {
+        target[x] = table[luma[x]];
+      }
+      ShiftRow(img, y, luma, target);
+    });
+  });
+}
+
+Image LumaImage(const Image &img, ScratchArena *arena) {
+  Image gray = arena != nullptr ? arena->AllocateImage(img.width(),
+                                                       img.height(),
+                                                       PixelFormat::kGray8)
+                                : Image(img.width(), img.height(),
+                                        PixelFormat::kGray8);
+
+  ConvertToLuma(img, gray);
+
+  return gray;
+}
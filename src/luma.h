@@ -0,0 +1,41 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+
+#include "image.h"
+#include "processing_context.h"
+
+/// @brief Writes the @see Luma of every pixel of @p src on @p gray , in a
+/// single fixed point pass that converts 16 pixels at once. The rows run in
+/// tiles on the shared pool (see tile_scheduler.h).
+/// @param src The image to be read, in any format and layout
+/// @param gray [out] A @see PixelFormat::kGray8 image of the size of @p src
+void ConvertToLuma(const Image &src, Image &gray);
+
+/// @brief Makes a gray image with the @see Luma of the pixels of @p img .
+/// @param img The image to be converted
+/// @param arena When given, the image is a view taken from it instead of a
+/// new buffer, see @see ScratchArena::AllocateImage
+Image LumaImage(const Image &img, ScratchArena *arena = nullptr);
+
+/// @brief Counts the @see Luma of the pixels of @p img without making a gray
+/// image: each band of rows converts a row at a time on a buffer of its own.
+/// @param img The image to be counted, in any format and layout
+/// @param bins [out] The 256 counts of the luma
+void CountLuma(const Image &img, uint64_t *bins);
+
+/// @brief Sends the @see Luma of each pixel of @p img through @p table and
+/// moves its color samples by the change, clamped to [0, 255]. That is a
+/// conversion to YCbCr, the table on Y and the conversion back with Cb and
+/// Cr kept as they were, without the rounding of the chroma in between: the
+/// inverse conversion adds Y to multiples of Cb and Cr that give back the
+/// distance of each channel to the old Y. Gray pixels just go through
+/// @p table . The luma of a row is converted on a buffer and used at once, so
+/// no full plane is ever written.
+/// @param img [in | out] The image to be mapped, in any format and layout.
+/// The alpha of @see PixelFormat::kBGRA32 pixels is kept.
+/// @param table The 256 targets of the luma
+void MapLuma(Image &img, const byte *table);
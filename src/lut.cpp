@@ -0,0 +1,561 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "lut.h"
+
+#include <array>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PDI_LI_LUT_SSE2 1
+#endif
+
+#include "cpu_features.h"
+#include "gpu_backend.h"
+#include "tile_scheduler.h"
+#include "traversal.h"
+
+namespace {
+
+/// Value returned by @see ThresholdOf when the table is not a 0/255 step.
+const int kNotThreshold = -1;
+
+/// @brief Returns the first sample mapped to 255 if @p table is 0 before it
+/// and 255 from it onwards, or @see kNotThreshold otherwise.
+int ThresholdOf(const byte *table) {
+  int cut = 0;
+  while (cut < 256 && table[cut] == 0) {
+    cut++;
+  }
+
+  for (int i = cut; i < 256; i++) {
+    if (table[i] != 255) {
+      return kNotThreshold;
+    }
+  }
+
+  // A table sending everything to 0 can not be written as a >= compare.
+  return cut < 256 ? cut : kNotThreshold;
+}
+
+/// @brief Applies the tables to a row of @p Format pixels read from @p from
+/// and written on @p to , which may be the same row. @p tables [k] is the
+/// table of the byte k of each pixel. The alpha byte is copied as it is.
+template <typename Format>
+void LookupPackedRow(const byte *from, byte *to, int width,
+                     const byte *const *tables) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  int x = 0;
+
+  // Constant trip counts, so each format gets its own unrolled body.
+  for (; x + 4 <= width; x += 4) {
+    const byte *p = from + kBytes * x;
+    byte *q = to + kBytes * x;
+    for (int k = 0; k < 4 * kBytes; k++) {
+      q[k] = k % kBytes != Format::kAlphaByte ? tables[k % kBytes][p[k]]
+                                               : p[k];
+    }
+  }
+
+  for (; x < width; x++) {
+    const byte *p = from + kBytes * x;
+    byte *q = to + kBytes * x;
+    for (int k = 0; k < kBytes; k++) {
+      q[k] = k != Format::kAlphaByte ? tables[k][p[k]] : p[k];
+    }
+  }
+}
+
+#if defined(PDI_LI_X86)
+/// @brief Loads a 256 byte table in the four vectors @see Lookup512 takes.
+PDI_LI_TARGET_AVX512VBMI inline void LoadTable512(const byte *table,
+                                                  __m512i *vectors) {
+  for (int i = 0; i < 4; i++) {
+    vectors[i] = _mm512_loadu_si512(table + 64 * i);
+  }
+}
+
+/// @brief Looks the 64 bytes of @p v up in the table loaded by
+/// @see LoadTable512 : each permute picks from 128 bytes by the low 7 bits,
+/// the high bit chooses between the two halves.
+PDI_LI_TARGET_AVX512VBMI inline __m512i Lookup512(const __m512i *table,
+                                                  __m512i v) {
+  __m512i low = _mm512_permutex2var_epi8(table[0], v, table[1]);
+  __m512i high = _mm512_permutex2var_epi8(table[2], v, table[3]);
+  return _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), low, high);
+}
+
+/// @brief The bytes of the vector @p v of a block of 64 pixels of @p bytes
+/// bytes that are the byte @p k of their pixel, one bit per byte.
+constexpr uint64_t PositionMask(int v, int k, int bytes) {
+  uint64_t mask = 0;
+  for (int j = 0; j < 64; j++) {
+    if ((64 * v + j) % bytes == k) {
+      mask |= uint64_t(1) << j;
+    }
+  }
+
+  return mask;
+}
+
+/// @brief @see PositionMask of every vector v and byte k of a block of
+/// pixels of @p kBytes bytes, at v * @p kBytes + k, so the kernels load them
+/// instead of building them on each vector.
+template <int kBytes>
+constexpr std::array<uint64_t, kBytes * kBytes> kPositionMasks = [] {
+  std::array<uint64_t, kBytes * kBytes> masks{};
+  for (int v = 0; v < kBytes; v++) {
+    for (int k = 0; k < kBytes; k++) {
+      masks[v * kBytes + k] = PositionMask(v, k, kBytes);
+    }
+  }
+
+  return masks;
+}();
+
+/// @brief @see LookupPackedRow 64 pixels at a time. Each vector is looked
+/// up in the table of every byte position, and the lookups blended by the
+/// positions of its bytes.
+/// @return The first pixel left for @see LookupPackedRow
+template <typename Format>
+PDI_LI_TARGET_AVX512VBMI int
+LookupPackedRowAVX512VBMI(const byte *from, byte *to, int width,
+                          const byte *const *tables) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  __m512i vectors[kBytes][4];
+  for (int k = 0; k < kBytes; k++) {
+    if (k != Format::kAlphaByte) {
+      LoadTable512(tables[k], vectors[k]);
+    }
+  }
+
+  int x = 0;
+  for (; x + 64 <= width; x += 64) {
+    for (int v = 0; v < kBytes; v++) {
+      const byte *p = from + kBytes * x + 64 * v;
+      __m512i value = _mm512_loadu_si512(p);
+      __m512i result = value;
+      for (int k = 0; k < kBytes; k++) {
+        if (k != Format::kAlphaByte) {
+          __m512i looked_up = Lookup512(vectors[k], value);
+          result = _mm512_mask_blend_epi8(
+              kPositionMasks<kBytes>[v * kBytes + k], result, looked_up);
+        }
+      }
+      _mm512_storeu_si512(to + kBytes * x + 64 * v, result);
+    }
+  }
+
+  return x;
+}
+
+/// @brief @see LookupPlaneRow 64 samples at a time.
+/// @return The first sample left for @see LookupPlaneRow
+PDI_LI_TARGET_AVX512VBMI int LookupPlaneRowAVX512VBMI(const byte *from,
+                                                      byte *to, int width,
+                                                      const byte *table) {
+  __m512i vectors[4];
+  LoadTable512(table, vectors);
+
+  int x = 0;
+  for (; x + 64 <= width; x += 64) {
+    __m512i v = _mm512_loadu_si512(from + x);
+    _mm512_storeu_si512(to + x, Lookup512(vectors, v));
+  }
+
+  return x;
+}
+#endif
+
+/// @brief @see LookupPackedRow with the widest variant @p isa has.
+template <typename Format>
+void LookupPackedRow(const byte *from, byte *to, int width,
+                     const byte *const *tables, CpuIsa isa) {
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512VBMI) {
+    x = LookupPackedRowAVX512VBMI<Format>(from, to, width, tables);
+  }
+#endif
+
+  constexpr int kBytes = Format::kBytesPerPixel;
+  LookupPackedRow<Format>(from + kBytes * x, to + kBytes * x, width - x,
+                          tables);
+}
+
+void LookupPlaneRow(const byte *from, byte *to, int width, const byte *table,
+                    CpuIsa isa) {
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512VBMI) {
+    x = LookupPlaneRowAVX512VBMI(from, to, width, table);
+  }
+#endif
+
+  for (; x + 4 <= width; x += 4) {
+    to[x] = table[from[x]];
+    to[x + 1] = table[from[x + 1]];
+    to[x + 2] = table[from[x + 2]];
+    to[x + 3] = table[from[x + 3]];
+  }
+
+  for (; x < width; x++) {
+    to[x] = table[from[x]];
+  }
+}
+
+#if defined(PDI_LI_X86)
+/// @brief @see ThresholdPackedRow 32 pixels at a time.
+/// @return The first byte left for @see ThresholdPackedRow
+template <typename Format>
+PDI_LI_TARGET_AVX2 int ThresholdPackedRowAVX2(const byte *from, byte *to,
+                                              int count, const int *cuts) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  constexpr int kBlock = 32 * kBytes;
+  alignas(32) byte pattern[kBlock];
+  alignas(32) byte keep[kBlock];
+  for (int k = 0; k < kBlock; k++) {
+    bool alpha = k % kBytes == Format::kAlphaByte;
+    pattern[k] = static_cast<byte>(alpha ? 0 : cuts[k % kBytes]);
+    keep[k] = static_cast<byte>(alpha ? 0xFF : 0);
+  }
+
+  __m256i cut[kBytes];
+  __m256i kept[kBytes];
+  for (int v = 0; v < kBytes; v++) {
+    cut[v] =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(pattern + 32 * v));
+    kept[v] =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(keep + 32 * v));
+  }
+
+  int i = 0;
+  for (; i + kBlock <= count; i += kBlock) {
+    for (int v = 0; v < kBytes; v++) {
+      const byte *p = from + i + 32 * v;
+      __m256i value =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      __m256i mask =
+          _mm256_cmpeq_epi8(_mm256_max_epu8(value, cut[v]), value);
+      if constexpr (Format::kAlphaByte >= 0) {
+        mask = _mm256_blendv_epi8(mask, value, kept[v]);
+      }
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(to + i + 32 * v), mask);
+    }
+  }
+
+  return i;
+}
+
+/// @brief @see ThresholdPackedRow 64 pixels at a time, the compares giving
+/// masks and the alpha bytes blended back by mask.
+/// @return The first byte left for @see ThresholdPackedRow
+template <typename Format>
+PDI_LI_TARGET_AVX512 int ThresholdPackedRowAVX512(const byte *from, byte *to,
+                                                  int count,
+                                                  const int *cuts) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  constexpr int kBlock = 64 * kBytes;
+  alignas(64) byte pattern[kBlock];
+  for (int k = 0; k < kBlock; k++) {
+    bool alpha = k % kBytes == Format::kAlphaByte;
+    pattern[k] = static_cast<byte>(alpha ? 0 : cuts[k % kBytes]);
+  }
+
+  __m512i cut[kBytes];
+  for (int v = 0; v < kBytes; v++) {
+    cut[v] = _mm512_load_si512(pattern + 64 * v);
+  }
+
+  int i = 0;
+  for (; i + kBlock <= count; i += kBlock) {
+    for (int v = 0; v < kBytes; v++) {
+      __m512i value = _mm512_loadu_si512(from + i + 64 * v);
+      __m512i mask = _mm512_movm_epi8(_mm512_cmpge_epu8_mask(value, cut[v]));
+      if constexpr (Format::kAlphaByte >= 0) {
+        mask = _mm512_mask_blend_epi8(
+            kPositionMasks<kBytes>[v * kBytes + Format::kAlphaByte], mask,
+            value);
+      }
+      _mm512_storeu_si512(to + i + 64 * v, mask);
+    }
+  }
+
+  return i;
+}
+
+/// @brief @see ThresholdPlaneRow 32 samples at a time.
+/// @return The first sample left for @see ThresholdPlaneRow
+PDI_LI_TARGET_AVX2 int ThresholdPlaneRowAVX2(const byte *from, byte *to,
+                                             int width, int cut) {
+  __m256i cuts = _mm256_set1_epi8(static_cast<char>(cut));
+
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(from + x));
+    __m256i mask = _mm256_cmpeq_epi8(_mm256_max_epu8(v, cuts), v);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(to + x), mask);
+  }
+
+  return x;
+}
+
+/// @brief @see ThresholdPlaneRow 64 samples at a time.
+/// @return The first sample left for @see ThresholdPlaneRow
+PDI_LI_TARGET_AVX512 int ThresholdPlaneRowAVX512(const byte *from, byte *to,
+                                                 int width, int cut) {
+  __m512i cuts = _mm512_set1_epi8(static_cast<char>(cut));
+
+  int x = 0;
+  for (; x + 64 <= width; x += 64) {
+    __m512i v = _mm512_loadu_si512(from + x);
+    _mm512_storeu_si512(to + x,
+                        _mm512_movm_epi8(_mm512_cmpge_epu8_mask(v, cuts)));
+  }
+
+  return x;
+}
+#endif
+
+/// @brief Binarizes @p count bytes of a row of @p Format pixels read from
+/// @p from and written on @p to , which may be the same row, where the byte k
+/// of each pixel uses the cut point @p cuts [k]. The alpha byte is copied as
+/// it is. The widest variant @p isa has goes first, and the rest of the row
+/// falls to the narrower ones.
+template <typename Format>
+void ThresholdPackedRow(const byte *from, byte *to, int count,
+                        const int *cuts, CpuIsa isa) {
+  constexpr int kBytes = Format::kBytesPerPixel;
+  int i = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512) {
+    i = ThresholdPackedRowAVX512<Format>(from, to, count, cuts);
+  } else if (isa >= CpuIsa::kAVX2) {
+    i = ThresholdPackedRowAVX2<Format>(from, to, count, cuts);
+  }
+#endif
+
+#if defined(PDI_LI_LUT_SSE2)
+  // 16 pixels, so every vector starts at the same byte of the pattern.
+  constexpr int kBlock = 16 * kBytes;
+  alignas(16) byte pattern[kBlock];
+  alignas(16) byte keep[kBlock];
+  for (int k = 0; k < kBlock; k++) {
+    bool alpha = k % kBytes == Format::kAlphaByte;
+    pattern[k] = static_cast<byte>(alpha ? 0 : cuts[k % kBytes]);
+    keep[k] = static_cast<byte>(alpha ? 0xFF : 0);
+  }
+
+  __m128i cut[kBytes];
+  __m128i kept[kBytes];
+  for (int v = 0; v < kBytes; v++) {
+    cut[v] =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(pattern + 16 * v));
+    kept[v] = _mm_load_si128(reinterpret_cast<const __m128i *>(keep + 16 * v));
+  }
+
+  for (; i + kBlock <= count; i += kBlock) {
+    for (int v = 0; v < kBytes; v++) {
+      const byte *p = from + i + 16 * v;
+      __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      // v >= cut exactly when max(v, cut) == v.
+      __m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(value, cut[v]), value);
+      if constexpr (Format::kAlphaByte >= 0) {
+        mask = _mm_or_si128(_mm_and_si128(kept[v], value),
+                            _mm_andnot_si128(kept[v], mask));
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(to + i + 16 * v), mask);
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    int k = i % kBytes;
+    to[i] = k != Format::kAlphaByte
+                ? static_cast<byte>(from[i] < cuts[k] ? 0 : 255)
+                : from[i];
+  }
+}
+
+void ThresholdPlaneRow(const byte *from, byte *to, int width, int cut,
+                       CpuIsa isa) {
+  int x = 0;
+
+#if defined(PDI_LI_X86)
+  if (isa >= CpuIsa::kAVX512) {
+    x = ThresholdPlaneRowAVX512(from, to, width, cut);
+  } else if (isa >= CpuIsa::kAVX2) {
+    x = ThresholdPlaneRowAVX2(from, to, width, cut);
+  }
+#endif
+
+#if defined(PDI_LI_LUT_SSE2)
+  __m128i cuts = _mm_set1_epi8(static_cast<char>(cut));
+
+  for (; x + 16 <= width; x += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(from + x));
+    __m128i mask = _mm_cmpeq_epi8(_mm_max_epu8(v, cuts), v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(to + x), mask);
+  }
+#endif
+
+  for (; x < width; x++) {
+    to[x] = static_cast<byte>(from[x] < cut ? 0 : 255);
+  }
+}
+
+/// @brief Whether the samples of @p a and @p b are placed the same way, so a
+/// row of one can be written on the same row of the other.
+bool SamePlacement(const Image &a, const Image &b) {
+  bool same = a.width() == b.width() && a.height() == b.height() &&
+              a.layout() == b.layout() && a.format() == b.format();
+  for (int c = 0; c < Image::kChannels; c++) {
+    same = same && a.channel_offset(c) == b.channel_offset(c);
+  }
+
+  return same;
+}
+
+} // namespace
+
+LUT3 IdentityLUT() {
+  LUT3 lut;
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int i = 0; i < 256; i++) {
+      lut.table[c][i] = static_cast<byte>(i);
+    }
+  }
+
+  return lut;
+}
+
+LUT3 BinarizeLUT(byte red_cut_point, byte green_cut_point,
+                 byte blue_cut_point) {
+  const byte cut_points[Image::kChannels] = {red_cut_point, green_cut_point,
+                                             blue_cut_point};
+  LUT3 lut;
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int i = 0; i < 256; i++) {
+      lut.table[c][i] = static_cast<byte>((i < cut_points[c]) ? 0 : 255);
+    }
+  }
+
+  return lut;
+}
+
+bool IsBilevelLUT(const LUT3 &lut) {
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int i = 0; i < 256; i++) {
+      if (lut.table[c][i] != 0 && lut.table[c][i] != 255) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+LUT3 ComposeLUT(const LUT3 &first, const LUT3 &second) {
+  LUT3 lut;
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    for (int i = 0; i < 256; i++) {
+      lut.table[c][i] = second.table[c][first.table[c][i]];
+    }
+  }
+
+  return lut;
+}
+
+RGBHistogram RemapHistogram(const RGBHistogram &histogram, const LUT3 &lut) {
+  RGBHistogram remapped{};
+  memset(&remapped, 0, sizeof(RGBHistogram));
+
+  for (int i = 0; i < 256; i++) {
+    remapped.red[lut.table[kRed][i]] += histogram.red[i];
+    remapped.green[lut.table[kGreen][i]] += histogram.green[i];
+    remapped.blue[lut.table[kBlue][i]] += histogram.blue[i];
+  }
+
+  return remapped;
+}
+
+void ApplyChannelLUT(Image &img, const LUT3 &lut) {
+  ApplyChannelLUT(img, img, lut);
+}
+
+void ApplyChannelLUT(const Image &src, Image &dst, const LUT3 &lut) {
+  // The device only works in place, as do images placed differently.
+  bool in_place = src.row(0) == dst.row(0);
+  if (!in_place && (ShouldOffload(dst) || !SamePlacement(src, dst))) {
+    CopyPixels(src, dst);
+    ApplyChannelLUT(dst, lut);
+    return;
+  }
+
+  if (ShouldOffload(dst) && GpuApplyLUT(dst, lut)) {
+    return;
+  }
+
+  int cuts[Image::kChannels];
+  bool threshold = true;
+  CpuIsa isa = GetCpuIsa();
+
+  for (int c = 0; c < src.color_channels(); c++) {
+    cuts[c] = ThresholdOf(lut.table[c]);
+    threshold = threshold && cuts[c] != kNotThreshold;
+  }
+
+  if (src.layout() == PixelLayout::kInterleaved) {
+    VisitPixelFormat(src.format(), [&](auto format) {
+      using Format = decltype(format);
+
+      // Reorder the tables by byte position, for views like BGR bitmaps. The
+      // single sample of a gray pixel uses the red table.
+      const byte *tables[4] = {nullptr, nullptr, nullptr, nullptr};
+      int position_cuts[4] = {0, 0, 0, 0};
+      for (int c = src.color_channels() - 1; c >= 0; c--) {
+        tables[src.channel_offset(c)] = lut.table[c];
+        position_cuts[src.channel_offset(c)] = cuts[c];
+      }
+
+      ParallelForEachTile(dst, [&](const Rectangle &tile) {
+        ForEachRow(tile.y, tile.y + tile.height, [&](int y) {
+          size_t offset = Format::kBytesPerPixel * tile.x;
+          const byte *from = src.row(y) + offset;
+          byte *to = dst.row(y) + offset;
+
+          if (threshold) {
+            ThresholdPackedRow<Format>(
+                from, to, Format::kBytesPerPixel * tile.width, position_cuts,
+                isa);
+          } else {
+            LookupPackedRow<Format>(from, to, tile.width, tables, isa);
+          }
+        });
+      });
+    });
+    return;
+  }
+
+  ParallelForEachTile(dst, [&](const Rectangle &tile) {
+    ForEachRow(tile.y, tile.y + tile.height, [&](int y) {
+      for (int c = 0; c < Image::kChannels; c++) {
+        const byte *from = src.channel_row(c, y) + tile.x;
+        byte *to = dst.channel_row(c, y) + tile.x;
+
+        if (threshold) {
+          ThresholdPlaneRow(from, to, tile.width, cuts[c], isa);
+        } else {
+          LookupPlaneRow(from, to, tile.width, lut.table[c], isa);
+        }
+      }
+    });
+  });
+}
@@ -0,0 +1,53 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include "histogram.h"
+#include "image.h"
+
+/// @brief One 256 entry lookup table per channel. The new value of a sample
+/// s of the channel c is table[c][s].
+struct LUT3 {
+  byte table[Image::kChannels][256];
+};
+
+/// @brief A @see LUT3 that keeps every sample as it is.
+LUT3 IdentityLUT();
+
+/// @brief A @see LUT3 that sends every sample below the cut point of its
+/// channel to 0 and the others to 255.
+/// @param red_cut_point The point of cut for the red channel.
+/// @param green_cut_point The point of cut for the green channel.
+/// @param blue_cut_point The point of cut for the blue channel.
+LUT3 BinarizeLUT(byte red_cut_point, byte green_cut_point,
+                 byte blue_cut_point);
+
+/// @brief Whether every entry of @p lut is 0 or 255, so an image it is
+/// applied to can be packed, see @see BilevelPacking .
+bool IsBilevelLUT(const LUT3 &lut);
+
+/// @brief Composes two tables into one that has the effect of applying
+/// @p first and then @p second .
+LUT3 ComposeLUT(const LUT3 &first, const LUT3 &second);
+
+/// @brief Computes, without touching any pixel, the histogram an image with
+/// @p histogram would have after @p lut is applied to it.
+RGBHistogram RemapHistogram(const RGBHistogram &histogram, const LUT3 &lut);
+
+/// @brief Replaces every sample of @p img by its entry on @p lut . Tables that
+/// are a single step from 0 to 255 (see @see BinarizeLUT ) run on a vector
+/// compare kernel, the others on an unrolled table lookup.
+/// @param img [in | out] The image to be transformed
+/// @param lut The tables to be applied
+void ApplyChannelLUT(Image &img, const LUT3 &lut);
+
+/// @brief Like @see ApplyChannelLUT , reading the samples of @p src and
+/// writing the results on @p dst , in the same pass: the out of place form,
+/// which saves copying @p src before applying the tables on the copy.
+/// @param src The image to be read, which may view the pixels of @p dst
+/// @param dst [out] An image of the size of @p src , best in its format,
+/// layout and channel order (others are copied first and transformed in
+/// place)
+/// @param lut The tables to be applied
+void ApplyChannelLUT(const Image &src, Image &dst, const LUT3 &lut);
@@ -2,401 +2,551 @@
 /// Github: mhco0
 
 #include <algorithm>
-#include <ctype.h>
-#include <functional>
-#include <iterator>
-#include <numeric>
-#include <stdint.h>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
 #include <string>
-#include <vcruntime_string.h>
 #include <vector>
 
 #include <cxxopts.hpp>
 #include <fmt/format.h>
 
-#include "libbmp.h"
+#include "batch.h"
+#include "commands.h"
+#include "cpu_features.h"
+#include "filter.h"
+#include "gpu_backend.h"
+#include "histogram_cache.h"
+#include "morphology.h"
+#include "profiler.h"
+#include "server.h"
+#include "thread_pool.h"
+#include "tile_scheduler.h"
 
-using byte = unsigned char;
+namespace {
 
-enum class Command {
-  kUnkown = 0,
-  kHistogram,
-  kEqualization,
-  kCutout,
-  kTwoPeaks
-};
+/// @brief Prints what the histogram cache did, the profile of the run, and
+/// writes its trace when asked to.
+/// @return false if the trace could not be written
+bool ReportRun(const cxxopts::ParseResult &result) {
+  if (HistogramCacheEnabled()) {
+    HistogramCacheStats stats = GetHistogramCacheStats();
+    fmt::print("Histogram cache: {} hits, {} misses, {} evictions, {} "
+               "entries in {} KB\n",
+               stats.hits, stats.misses, stats.evictions, stats.entries,
+               stats.bytes / 1024);
+  }
 
-struct RGBHistogram {
-  int red[256];
-  int blue[256];
-  int green[256];
-};
+  if (!IsProfiling()) {
+    return true;
+  }
 
-struct Rectangle {
-  int x, y;
-  int width, height;
-};
+  PrintProfile();
 
-struct RGBColor {
-  byte r, g, b;
-};
+  fmt::print("Kernels: {} (the CPU has {}, the baseline is {})\n",
+             CpuIsaName(GetCpuIsa()), CpuIsaName(DetectCpuIsa()),
+             BaselineIsaName());
 
-namespace {
+  AllocationStats heap = ProcessHeapStats();
+  fmt::print("Ran {}: peak RSS {:.1f} MB, {} heap allocations of {:.1f} MB\n",
+             result["out-of-place"].as<bool>() ? "out of place" : "in place",
+             PeakResidentBytes() / 1048576.0, heap.allocations,
+             heap.bytes / 1048576.0);
+  if (!result.count("profile-trace")) {
+    return true;
+  }
+
+  std::string trace = result["profile-trace"].as<std::string>();
+  if (!WriteChromeTrace(trace)) {
+    fmt::print("Could not write {}\n", trace);
+    return false;
+  }
 
-void ClearImage(BmpImg &img) {
-  int height = img.get_height();
-  int width = img.get_width();
+  return true;
+}
 
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      img.set_pixel(x, y, 0, 0, 0);
+/// @brief Parses a structuring element given as "5" (5x5) or "5x3" (5 wide
+/// and 3 high).
+/// @return false if @p text is not one of those, with sides from 1 up
+bool ParseStructuringElement(const std::string &text,
+                             StructuringElement &element) {
+  size_t separator = text.find('x');
+  std::string width = text.substr(0, separator);
+  std::string height =
+      separator == std::string::npos ? width : text.substr(separator + 1);
+
+  auto side = [](const std::string &digits, int &value) {
+    if (digits.empty() || digits.size() > 5 ||
+        !std::all_of(digits.begin(), digits.end(), ::isdigit)) {
+      return false;
     }
-  }
+
+    value = std::stoi(digits);
+    return value >= 1;
+  };
+
+  return side(width, element.width) && side(height, element.height);
 }
 
-void FillRectangle(BmpImg &img, const Rectangle &rect, const RGBColor &color) {
-  for (int x = rect.x; x < rect.x + rect.width; x++) {
-    for (int y = rect.y; y < rect.y + rect.height; y++) {
-      img.set_pixel(x, y, color.r, color.g, color.b);
+/// @brief Parses the taps of a general kernel, 9 or 25 comma separated
+/// integers in row-major order.
+/// @return false if @p text is not like that or the kernel is not
+/// @see IsValidKernel
+bool ParseKernel(const std::string &text, int shift, Kernel &kernel) {
+  std::vector<int> taps;
+  size_t start = 0;
+
+  while (start <= text.size()) {
+    size_t comma = std::min(text.find(',', start), text.size());
+    std::string tap = text.substr(start, comma - start);
+    size_t digits = !tap.empty() && tap[0] == '-' ? 1 : 0;
+    if (tap.size() == digits || tap.size() > digits + 3 ||
+        !std::all_of(tap.begin() + digits, tap.end(), ::isdigit)) {
+      return false;
     }
+
+    taps.push_back(std::stoi(tap));
+    start = comma + 1;
+  }
+
+  if (taps.size() != 9 && taps.size() != 25) {
+    return false;
   }
+
+  kernel.size = taps.size() == 9 ? 3 : 5;
+  kernel.shift = shift;
+  std::copy(taps.begin(), taps.end(), kernel.taps);
+
+  return IsValidKernel(kernel);
 }
 
-void DrawRectangle(BmpImg &img, const Rectangle &rect, const RGBColor &color) {
-  for (int x = rect.x; x < rect.x + rect.width; x++) {
-    for (int y = rect.y; y < rect.y + rect.height; y++) {
-      bool should_draw = x == rect.x || y == rect.y ||
-                         x == (rect.x + rect.width - 1) ||
-                         y == (rect.y + rect.height - 1);
-      if (should_draw) {
-        img.set_pixel(x, y, color.r, color.g, color.b);
+/// @brief Builds the histogram shared by the files of a dataset run: merges
+/// the --dataset-histograms files, or counts the @p jobs when there are none,
+/// and saves it on --save-dataset-histogram .
+/// @return false if a file could not be read or written
+bool BuildDataset(const cxxopts::ParseResult &result,
+                  const std::vector<BatchJob> &jobs, const RunOptions &options,
+                  DatasetHistogram &dataset) {
+  if (result.count("dataset-histograms")) {
+    for (const std::string &filename :
+         result["dataset-histograms"].as<std::vector<std::string>>()) {
+      DatasetHistogram part{};
+      if (ReadDatasetHistogram(filename, part) != BMP_OK) {
+        fmt::print("Could not read the dataset histogram {}\n", filename);
+        return false;
       }
+
+      MergeDatasets(part, dataset);
+    }
+  } else {
+    BatchReport report = RunDatasetHistogram(jobs, options, dataset);
+    if (PrintBatchReport(report) != 0) {
+      return false;
     }
   }
-}
 
-void DrawLine(BmpImg &img, int x, int y, int xf, int yf,
-              const RGBColor &color) {
-  for (int i = x; i <= xf; i++) {
-    for (int j = y; j <= yf; j++) {
-      img.set_pixel(i, j, color.r, color.g, color.b);
+  fmt::print("Dataset histogram of {} images\n", dataset.images);
+
+  if (result.count("save-dataset-histogram")) {
+    std::string filename = result["save-dataset-histogram"].as<std::string>();
+    if (WriteDatasetHistogram(filename, dataset) != BMP_OK) {
+      fmt::print("Could not write {}\n", filename);
+      return false;
     }
   }
+
+  return true;
 }
 
 } // namespace
 
-/// @brief Parses the @p command string of the user in some @see Command
-/// enumaration
-/// @param command The command provide by the user
-/// @return Some @see Command enumeration
-Command CommandByMethod(const std::string &command) {
-  if (command == "histogram") {
-    return Command::kHistogram;
-  }
+int main(int argc, char **argv) {
+  cxxopts::Options options("PDI_LI", "Process some method of image processing");
+  options.add_options()("i,input", "The input bmp",
+                        cxxopts::value<std::string>());
+  options.add_options()("m,method",
+                        "The processing method, or a comma separated chain "
+                        "of methods",
+                        cxxopts::value<std::string>());
+  options.add_options()("o,output", "The output bmp",
+                        cxxopts::value<std::string>());
+  options.add_options()("t,threads",
+                        "The number of threads used by the kernels, 0 uses "
+                        "every hardware thread",
+                        cxxopts::value<int>()->default_value("0"));
+  options.add_options()("deterministic",
+                        "Give every thread a fixed band of tiles instead of "
+                        "letting them steal work",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("cpu-features",
+                        "The widest instruction set the kernels use: auto "
+                        "(the best the CPU has), baseline, ssse3, avx2, "
+                        "avx512 or avx512vbmi",
+                        cxxopts::value<std::string>()->default_value("auto"));
+  options.add_options()("cpu-only",
+                        "Keep every kernel on the CPU, even on builds with "
+                        "the GPU backend",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("gpu-min-pixels",
+                        "The pixels an image needs to be offloaded to the GPU",
+                        cxxopts::value<int64_t>()->default_value(
+                            std::to_string(kDefaultGpuMinPixels)));
+  options.add_options()("stream",
+                        "Process the bmp in bands of rows instead of loading "
+                        "it whole",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("mmap",
+                        "Map the bmp files in memory instead of reading them "
+                        "(24bpp files only)",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("out-of-place",
+                        "Keep the pixels read as they are and write the "
+                        "results on buffers of their own",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("pack-bilevel",
+                        "Write results whose samples are all 0 or 255 as 1bpp "
+                        "bmps (4bpp when the channels differ)",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("async-io",
+                        "Overlap reading, processing and writing on stages "
+                        "of their own (--stream bands and batch files)",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("band-rows", "The height of the bands on --stream",
+                        cxxopts::value<int>()->default_value(
+                            std::to_string(kDefaultBandRows)));
+  options.add_options()("histogram-format",
+                        "How the histogram method writes its result: bmp, "
+                        "csv, json or bin",
+                        cxxopts::value<std::string>()->default_value("bmp"));
+  options.add_options()("approx",
+                        "Build the tables from a histogram estimated from a "
+                        "sample of the pixels, applied to all of them",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("sample-rate",
+                        "The share of the pixels --approx samples, in (0, 1]",
+                        cxxopts::value<double>()->default_value(
+                            fmt::format("{}", kDefaultSampleRate)));
+  options.add_options()("morph-size",
+                        "The structuring element of erode, dilate, open and "
+                        "close, like 3 or 5x3 (width x height)",
+                        cxxopts::value<std::string>()->default_value("3"));
+  options.add_options()("blur-sigma",
+                        "The standard deviation of the blur method, from "
+                        "0.25 to 10",
+                        cxxopts::value<double>()->default_value("1"));
+  options.add_options()("box-radius",
+                        "The radius of the box_blur method, from 0 to 32",
+                        cxxopts::value<int>()->default_value("1"));
+  options.add_options()("kernel",
+                        "The taps of the convolve method, 9 or 25 comma "
+                        "separated integers from -128 to 128 (the sharpen "
+                        "kernel by default)",
+                        cxxopts::value<std::string>());
+  options.add_options()("kernel-shift",
+                        "The convolve method divides its sums by 2 to this "
+                        "power, from 0 to 16",
+                        cxxopts::value<int>()->default_value("0"));
+  options.add_options()("border",
+                        "How the filters read the pixels outside the image: "
+                        "clamp, reflect, wrap or zero",
+                        cxxopts::value<std::string>()->default_value(
+                            "reflect"));
+  options.add_options()("histogram-cache",
+                        "A directory keeping the histograms counted, reused "
+                        "by later runs over the same pixels",
+                        cxxopts::value<std::string>());
+  options.add_options()("histogram-cache-mb",
+                        "How many MB the --histogram-cache may take before "
+                        "the least recently used entries are deleted",
+                        cxxopts::value<int64_t>()->default_value(
+                            std::to_string(kDefaultHistogramCacheBytes >> 20)));
+  options.add_options()("batch",
+                        "A file with one input bmp per line, processed in a "
+                        "single run",
+                        cxxopts::value<std::string>());
+  options.add_options()("input-dir",
+                        "A directory whose bmp files are processed in a "
+                        "single run",
+                        cxxopts::value<std::string>());
+  options.add_options()("dataset",
+                        "Build the tables of --batch or --input-dir from the "
+                        "histogram of all the files, shared by every file",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("dataset-histograms",
+                        "Comma separated dataset histograms merged for "
+                        "--dataset instead of counting the files",
+                        cxxopts::value<std::vector<std::string>>());
+  options.add_options()("save-dataset-histogram",
+                        "Where --dataset saves its histogram, without "
+                        "--output-dir only the histogram is built",
+                        cxxopts::value<std::string>());
+  options.add_options()("output-dir",
+                        "Where the outputs of --batch or --input-dir go",
+                        cxxopts::value<std::string>());
+  options.add_options()("profile",
+                        "Print the time and throughput of the read, "
+                        "histogram, table, apply, render and write stages",
+                        cxxopts::value<bool>()->default_value("false"));
+  options.add_options()("profile-trace",
+                        "Also write the stages as a Chrome trace event file "
+                        "(implies --profile)",
+                        cxxopts::value<std::string>());
+  options.add_options()("serve",
+                        "Serve requests on this unix socket until SIGINT or "
+                        "SIGTERM, keeping the workers warm",
+                        cxxopts::value<std::string>());
+  options.add_options()("connect",
+                        "Send the input to the server on this unix socket "
+                        "instead of processing it here",
+                        cxxopts::value<std::string>());
+  options.add_options()("repeat",
+                        "How many times --connect sends the input, printing "
+                        "the latency percentiles",
+                        cxxopts::value<int>()->default_value("1"));
 
-  if (command == "equalize") {
-    return Command::kEqualization;
+  auto result = options.parse(argc, argv);
+
+  SetThreadCount(result["threads"].as<int>());
+  SetTileSchedule(result["deterministic"].as<bool>()
+                      ? TileSchedule::kDeterministic
+                      : TileSchedule::kWorkStealing);
+  SetProfiling(result["profile"].as<bool>() ||
+               result.count("profile-trace") > 0);
+  std::string cpu_features = result["cpu-features"].as<std::string>();
+  CpuIsa isa = DetectCpuIsa();
+  if (cpu_features != "auto" &&
+      (!CpuIsaByName(cpu_features, isa) || !SetCpuIsa(isa))) {
+    fmt::print("--cpu-features must be auto, baseline, ssse3, avx2, avx512 "
+               "or avx512vbmi, up to {} on this CPU\n",
+               CpuIsaName(DetectCpuIsa()));
+    return 1;
   }
 
-  if (command == "cutout") {
-    return Command::kCutout;
+  SetGpuOffload(!result["cpu-only"].as<bool>());
+  SetGpuMinPixels(result["gpu-min-pixels"].as<int64_t>());
+  if (!result["cpu-only"].as<bool>() && GpuAvailable()) {
+    fmt::print("Offloading images of {} pixels or more to {}\n",
+               result["gpu-min-pixels"].as<int64_t>(), GpuDeviceName());
   }
 
-  if (command == "two_peaks") {
-    return Command::kTwoPeaks;
+  StructuringElement element;
+  if (!ParseStructuringElement(result["morph-size"].as<std::string>(),
+                               element)) {
+    fmt::print("--morph-size must be like 3 or 5x3\n");
+    return 1;
+  }
+  SetStructuringElement(element);
+
+  FilterSettings filters;
+  filters.blur_sigma = result["blur-sigma"].as<double>();
+  filters.box_radius = result["box-radius"].as<int>();
+  if (!(filters.blur_sigma >= kMinGaussianSigma &&
+        filters.blur_sigma <= kMaxGaussianSigma) ||
+      filters.box_radius < 0 || filters.box_radius > kMaxFilterRadius) {
+    fmt::print("--blur-sigma must be in [0.25, 10] and --box-radius in "
+               "[0, 32]\n");
+    return 1;
   }
 
-  return Command::kUnkown;
-}
+  if (result.count("kernel") &&
+      !ParseKernel(result["kernel"].as<std::string>(),
+                   result["kernel-shift"].as<int>(), filters.kernel)) {
+    fmt::print("--kernel must be 9 or 25 integers in [-128, 128] and "
+               "--kernel-shift in [0, 16]\n");
+    return 1;
+  }
 
-/// @brief Retrieves the histogram of some bitmap @p img
-/// @param img The image to retrieve the histogram
-/// @return A @see RGBHistogram struct with the histogram of the red, green and
-/// blue channel of the image.
-RGBHistogram GetHistogram(BmpImg &img) {
-  RGBHistogram histogram{};
-  memset(&histogram, 0, sizeof(RGBHistogram));
-
-  int height = img.get_height();
-  int width = img.get_width();
-
-  for (int x = 0; x < width; x++) {
-    for (int y = 0; y < height; y++) {
-      histogram.red[img.red_at(x, y)]++;
-      histogram.green[img.green_at(x, y)]++;
-      histogram.blue[img.blue_at(x, y)]++;
-    }
+  if (!BorderModeByName(result["border"].as<std::string>(), filters.border)) {
+    fmt::print("--border must be clamp, reflect, wrap or zero\n");
+    return 1;
   }
+  SetFilterSettings(filters);
 
-  return histogram;
-}
+  if (result["approx"].as<bool>()) {
+    double rate = result["sample-rate"].as<double>();
+    if (!(rate > 0.0 && rate <= 1.0)) {
+      fmt::print("--sample-rate must be in (0, 1]\n");
+      return 1;
+    }
 
-/// @brief Creates a interpolated image with the visual information about the
-/// histogram of some image
-/// @param histogram The histogram information about each channel of the image
-/// @return A bitmap image with the histogram drawed upside down.
-BmpImg CreateHistogramImage(RGBHistogram &histogram) {
-  const int lr_borders = 30;
-  const int tb_borders = 10;
-  const int in_between_borders = 30;
-
-  const int graph_width = 256;
-  const int graph_height = 256;
-
-  const RGBColor white = {.r = 255, .g = 255, .b = 255};
-  const RGBColor red = {.r = 255, .g = 0, .b = 0};
-  const RGBColor green = {.r = 0, .g = 255, .b = 0};
-  const RGBColor blue = {.r = 0, .g = 0, .b = 255};
-
-  const Rectangle red_rect = {.x = lr_borders,
-                              .y = tb_borders,
-                              .width = graph_width,
-                              .height = graph_height};
-
-  const Rectangle green_rect = {.x = lr_borders,
-                                .y = tb_borders + graph_height +
-                                     in_between_borders,
-                                .width = graph_width,
-                                .height = graph_height};
-
-  const Rectangle blue_rect = {.x = lr_borders,
-                               .y = tb_borders +
-                                    2 * (graph_height + in_between_borders),
-                               .width = graph_width,
-                               .height = graph_height};
-  int width = 2 * lr_borders + graph_width;
-  int height = 2 * tb_borders + 2 * in_between_borders + 3 * graph_height;
-
-  BmpImg graph(width, height);
-
-  ClearImage(graph);
-
-  DrawRectangle(graph, red_rect, white);
-  DrawRectangle(graph, green_rect, white);
-  DrawRectangle(graph, blue_rect, white);
-
-  int max_red = *std::max_element(histogram.red, histogram.red + 256);
-  int max_green = *std::max_element(histogram.green, histogram.green + 256);
-  int max_blue = *std::max_element(histogram.blue, histogram.blue + 256);
-
-  for (int i = 0; i < 256; i++) {
-    DrawLine(graph, red_rect.x + i, red_rect.y, red_rect.x + i,
-             red_rect.y + graph_height * (histogram.red[i] / (1.0 * max_red)),
-             red);
-  }
-  for (int i = 0; i < 256; i++) {
-    DrawLine(graph, green_rect.x + i, green_rect.y, green_rect.x + i,
-             green_rect.y +
-                 graph_height * (histogram.green[i] / (1.0 * max_green)),
-             green);
+    int step = SampleStepOfRate(rate);
+    SetHistogramSampleStep(step);
+    fmt::print("Estimating the histograms from 1 in {} pixels\n",
+               step * step);
   }
-  for (int i = 0; i < 256; i++) {
-    DrawLine(graph, blue_rect.x + i, blue_rect.y, blue_rect.x + i,
-             blue_rect.y +
-                 graph_height * (histogram.blue[i] / (1.0 * max_blue)),
-             blue);
-  }
-
-  return graph;
-}
 
-/// @brief Converts some bitmap @p img in only true black and white value on
-/// each matrix.
-/// @param img [in | out] The image to be binarized.
-/// @param red_cut_point The point of cut for the red channel.
-/// @param green_cut_point The point of cut for the green channel.
-/// @param blue_cut_point The point of cut for the blue channel.
-void Binarize(BmpImg &img, byte red_cut_point, byte green_cut_point,
-              byte blue_cut_point) {
-  int width = img.get_width();
-  int height = img.get_height();
-
-  for (int x = 0; x < width; ++x) {
-    for (int y = 0; y < height; ++y) {
-      RGBColor value{.r = img.red_at(x, y),
-                     .g = img.green_at(x, y),
-                     .b = img.blue_at(x, y)};
-      RGBColor grey_value{};
-
-      grey_value.r = static_cast<byte>((value.r < red_cut_point) ? 0 : 255);
-      grey_value.g = static_cast<byte>((value.g < green_cut_point) ? 0 : 255);
-      grey_value.b = static_cast<byte>((value.b < blue_cut_point) ? 0 : 255);
-
-      img.set_pixel(x, y, grey_value.r, grey_value.g, grey_value.b);
+  if (result.count("histogram-cache")) {
+    std::string directory = result["histogram-cache"].as<std::string>();
+    int64_t max_bytes = result["histogram-cache-mb"].as<int64_t>() << 20;
+    if (max_bytes < 0 || !OpenHistogramCache(directory, max_bytes)) {
+      fmt::print("Could not open the histogram cache {}\n", directory);
+      return 1;
     }
   }
-}
 
-/// @brief Applys the equalization algorithm on the @p img .
-/// @param img The image to have the histogram equalizated.
-void Equalize(BmpImg &img) {
-  RGBHistogram histogram = GetHistogram(img);
+  if (result.count("serve")) {
+    std::string socket_path = result["serve"].as<std::string>();
+    if (!RunServer(socket_path)) {
+      fmt::print("Could not listen on {}\n", socket_path);
+      return 1;
+    }
 
-  int height = img.get_height();
-  int width = img.get_width();
-  int total_pixels = width * height;
-  int red_cdf[256];
-  int green_cdf[256];
-  int blue_cdf[256];
+    return ReportRun(result) ? 0 : 1;
+  }
 
-  memset(red_cdf, 0, sizeof(red_cdf));
-  memset(green_cdf, 0, sizeof(green_cdf));
-  memset(blue_cdf, 0, sizeof(blue_cdf));
+  std::string method = result["method"].as<std::string>();
 
-  auto set_cdf = [](int size, int *input, int *output) -> void {
-    output[0] = input[0];
+  RunOptions run_options;
+  run_options.stream = result["stream"].as<bool>();
+  run_options.band_rows = result["band-rows"].as<int>();
+  run_options.mmap = result["mmap"].as<bool>();
+  run_options.mode = result["out-of-place"].as<bool>()
+                         ? ExecutionMode::kOutOfPlace
+                         : ExecutionMode::kInPlace;
+  run_options.pack_bilevel = result["pack-bilevel"].as<bool>();
+  run_options.async_io = result["async-io"].as<bool>();
 
-    for (int i = 1; i < size; i++) {
-      output[i] = input[i] + output[i - 1];
-    }
-  };
+  Pipeline pipeline;
 
-  auto get_min_on_cdf = [](int *cdf, int size) -> int {
-    for (int i = 0; i < size; i++) {
-      if (cdf[i]) {
-        return cdf[i];
-      }
-    }
-    return 0;
-  };
+  if (!PipelineByMethods(method, pipeline)) {
+    fmt::print("Unkown command (components must end the chain)\n");
+    return 1;
+  }
 
-  auto equalized_value = [](int *cdf, int value, int min_value,
-                            int total) -> byte {
-    return static_cast<int>(
-        255 * ((cdf[value] - min_value) / (1.0 * (total - min_value))));
-  };
+  if (!HistogramFormatByName(result["histogram-format"].as<std::string>(),
+                             run_options.histogram_format)) {
+    fmt::print("Unkown histogram format\n");
+    return 1;
+  }
 
-  set_cdf(256, histogram.red, red_cdf);
-  set_cdf(256, histogram.green, green_cdf);
-  set_cdf(256, histogram.blue, blue_cdf);
+  bool writes_histogram = pipeline.back() == Command::kHistogram;
+  bool writes_components = pipeline.back() == Command::kComponents;
+  if (run_options.histogram_format != HistogramFormat::kImage &&
+      !writes_histogram && !writes_components) {
+    fmt::print("--histogram-format needs a chain ending with histogram or "
+               "components\n");
+    return 1;
+  }
 
-  int min_red_cdf = get_min_on_cdf(red_cdf, 256);
-  int min_green_cdf = get_min_on_cdf(green_cdf, 256);
-  int min_blue_cdf = get_min_on_cdf(blue_cdf, 256);
+  if (result.count("batch") || result.count("input-dir")) {
+    bool dataset_run =
+        result["dataset"].as<bool>() || result.count("dataset-histograms");
+    bool count_only = dataset_run && !result.count("output-dir") &&
+                      result.count("save-dataset-histogram");
+    if (!result.count("output-dir") && !count_only) {
+      fmt::print("--output-dir is required on batch mode\n");
+      return 1;
+    }
 
-  for (int x = 0; x < width; ++x) {
-    for (int y = 0; y < height; ++y) {
-      byte red_value = img.red_at(x, y);
-      byte green_value = img.green_at(x, y);
-      byte blue_value = img.blue_at(x, y);
+    std::string output_dir =
+        count_only ? std::string() : result["output-dir"].as<std::string>();
+    std::vector<BatchJob> jobs;
+
+    bool listed =
+        result.count("batch")
+            ? JobsFromList(result["batch"].as<std::string>(), output_dir, jobs)
+            : JobsFromDirectory(result["input-dir"].as<std::string>(),
+                                output_dir, jobs);
+    if (!listed) {
+      fmt::print("Could not list the input files\n");
+      return 1;
+    }
 
-      byte equalized_red =
-          equalized_value(red_cdf, red_value, min_red_cdf, total_pixels);
-      byte equalized_green =
-          equalized_value(green_cdf, green_value, min_green_cdf, total_pixels);
-      byte equalized_blue =
-          equalized_value(blue_cdf, blue_value, min_blue_cdf, total_pixels);
+    // The components table is written as csv unless another format is
+    // asked for.
+    HistogramFormat table_format =
+        writes_components &&
+                run_options.histogram_format == HistogramFormat::kImage
+            ? HistogramFormat::kCsv
+            : run_options.histogram_format;
+    for (BatchJob &job : jobs) {
+      if (table_format == HistogramFormat::kImage) {
+        break;
+      }
 
-      img.set_pixel(x, y, equalized_red, equalized_green, equalized_blue);
+      job.output_bmp = std::filesystem::path(job.output_bmp)
+                           .replace_extension(HistogramExtension(table_format))
+                           .string();
     }
-  }
-}
 
-/// @brief Applies the cutout algorithm on the @p img .
-/// @param img [in | out] The image to be binarized.
-void Cutout(BmpImg &img) { Binarize(img, 128, 128, 128); }
+    std::error_code error;
+    std::filesystem::create_directories(output_dir, error);
 
-/// @brief Applies the Two Peaks algorithm on the @p img .
-/// @param img [in | out]The image to be binarized.
-void TwoPeaks(BmpImg &img) {
-  RGBHistogram histogram = GetHistogram(img);
+    fmt::print("Using args: {} files {} {}\n", jobs.size(), method,
+               output_dir);
 
-  auto get_index_of_max_value = [](auto *input, int size) -> byte {
-    return static_cast<byte>(
-        std::distance(input, std::max_element(input, input + size)));
-  };
-
-  byte first_peaks[3] = {get_index_of_max_value(histogram.red, 256),
-                         get_index_of_max_value(histogram.green, 256),
-                         get_index_of_max_value(histogram.blue, 256)};
-
-  int64_t red_sparse_distances[256];
-  int64_t green_sparse_distances[256];
-  int64_t blue_sparse_distances[256];
-
-  memset(red_sparse_distances, 0, sizeof(red_sparse_distances));
-  memset(green_sparse_distances, 0, sizeof(green_sparse_distances));
-  memset(blue_sparse_distances, 0, sizeof(blue_sparse_distances));
-
-  for (int i = 0; i < 256; i++) {
-    red_sparse_distances[i] =
-        (i - first_peaks[0]) * (i - first_peaks[0]) * histogram.red[i];
-    green_sparse_distances[i] =
-        (i - first_peaks[1]) * (i - first_peaks[1]) * histogram.green[i];
-    blue_sparse_distances[i] =
-        (i - first_peaks[2]) * (i - first_peaks[2]) * histogram.blue[i];
-  }
+    // Shared by every file of the second pass.
+    RGBHistogram shared{};
+    if (dataset_run) {
+      DatasetHistogram dataset{};
+      if (!BuildDataset(result, jobs, run_options, dataset)) {
+        return 1;
+      }
 
-  byte second_peaks[3] = {get_index_of_max_value(red_sparse_distances, 256),
-                          get_index_of_max_value(green_sparse_distances, 256),
-                          get_index_of_max_value(blue_sparse_distances, 256)};
-  byte cut_points[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++) {
-    cut_points[i] = (first_peaks[i] + second_peaks[i]) >> 1;
-  }
+      if (count_only) {
+        return ReportRun(result) ? 0 : 1;
+      }
 
-  Binarize(img, cut_points[0], cut_points[1], cut_points[2]);
-}
+      shared = DatasetToHistogram(dataset);
+      run_options.histogram = &shared;
+    }
 
-int main(int argc, char **argv) {
-  cxxopts::Options options("PDI_LI", "Process some method of image processing");
-  options.add_options()("i,input", "The input bmp",
-                        cxxopts::value<std::string>());
-  options.add_options()("m,method", "The processing method",
-                        cxxopts::value<std::string>());
-  options.add_options()("o,output", "The output bmp",
-                        cxxopts::value<std::string>());
+    BatchReport report = RunBatch(pipeline, jobs, run_options);
+    bool succeeded = PrintBatchReport(report) == 0;
+    return ReportRun(result) && succeeded ? 0 : 1;
+  }
 
-  auto result = options.parse(argc, argv);
   std::string input_bmp = result["input"].as<std::string>();
-  std::string method = result["method"].as<std::string>();
   std::string output_bmp = result["output"].as<std::string>();
 
   fmt::print("Using args: {} {} {}\n", input_bmp, method, output_bmp);
 
-  BmpImg input_image;
-
-  input_image.read(input_bmp);
-
-  switch (CommandByMethod(method)) {
-    using enum Command;
-
-  case kUnkown: {
-    fmt::print("Unkown command\n");
-    return 1;
-  } break;
-
-  case kHistogram: {
-
-    RGBHistogram histogram = GetHistogram(input_image);
-
-    BmpImg histogram_image = CreateHistogramImage(histogram);
-
-    histogram_image.write(output_bmp);
-  } break;
+  if (result.count("connect")) {
+    std::string socket_path = result["connect"].as<std::string>();
+    ServerClient client;
+    if (!client.Connect(socket_path)) {
+      fmt::print("Could not connect to {}\n", socket_path);
+      return 1;
+    }
 
-  case kEqualization: {
-    Equalize(input_image);
+    std::vector<byte> input;
+    std::vector<byte> output;
+    if (ReadFileBytes(input_bmp, input) != BMP_OK) {
+      fmt::print("Could not read {}\n", input_bmp);
+      return 1;
+    }
 
-    input_image.write(output_bmp);
-  } break;
+    int repeat = std::max(result["repeat"].as<int>(), 1);
+    std::vector<double> latencies;
 
-  case kCutout: {
-    Cutout(input_image);
+    for (int i = 0; i < repeat; i++) {
+      auto start = std::chrono::steady_clock::now();
+      if (client.Process(method, input, run_options, output) != BMP_OK) {
+        fmt::print("Could not process {}\n", input_bmp);
+        return 1;
+      }
+      latencies.push_back(std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+    }
 
-    input_image.write(output_bmp);
-  } break;
+    if (repeat > 1) {
+      PrintLatencyPercentiles(latencies);
+    }
 
-  case kTwoPeaks: {
-    TwoPeaks(input_image);
+    return WriteFileBytes(output_bmp, output) == BMP_OK ? 0 : 1;
+  }
 
-    input_image.write(output_bmp);
-  } break;
+  PipelineStats stages;
+  if (RunCommand(pipeline, input_bmp, output_bmp, run_options, nullptr,
+                 &stages) != BMP_OK) {
+    fmt::print("Could not process {}\n", input_bmp);
+    return 1;
+  }
 
-  default:
-    break;
+  if (run_options.async_io && run_options.stream) {
+    PrintPipelineStats(stages);
   }
 
-  return 0;
-}
\ No newline at end of file
+  return ReportRun(result) ? 0 : 1;
+}
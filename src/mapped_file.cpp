@@ -0,0 +1,171 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { Close(); }
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::string &filename, Mode mode) {
+  Close();
+
+  DWORD access = GENERIC_READ | (mode == Mode::kReadWrite ? GENERIC_WRITE : 0);
+  file_ = CreateFileA(filename.c_str(), access, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_, &size)) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(size.QuadPart);
+
+  return Map(mode);
+}
+
+bool MappedFile::Create(const std::string &filename, size_t size) {
+  Close();
+
+  file_ = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0,
+                      nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    return false;
+  }
+
+  LARGE_INTEGER end;
+  end.QuadPart = static_cast<LONGLONG>(size);
+  if (!SetFilePointerEx(file_, end, nullptr, FILE_BEGIN) ||
+      !SetEndOfFile(file_)) {
+    Close();
+    return false;
+  }
+  size_ = size;
+
+  return Map(Mode::kReadWrite);
+}
+
+bool MappedFile::Map(Mode mode) {
+  if (size_ == 0) {
+    return true;
+  }
+
+  DWORD protect = mode == Mode::kReadWrite ? PAGE_READWRITE : PAGE_WRITECOPY;
+  DWORD access = mode == Mode::kReadWrite ? FILE_MAP_WRITE : FILE_MAP_COPY;
+
+  mapping_ = CreateFileMappingA(file_, nullptr, protect, 0, 0, nullptr);
+  if (mapping_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<byte *>(MapViewOfFile(mapping_, access, 0, 0, 0));
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+  }
+
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::string &filename, Mode mode) {
+  Close();
+
+  fd_ = open(filename.c_str(), mode == Mode::kReadWrite ? O_RDWR : O_RDONLY);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd_, &info) != 0) {
+    Close();
+    return false;
+  }
+  size_ = static_cast<size_t>(info.st_size);
+
+  return Map(mode);
+}
+
+bool MappedFile::Create(const std::string &filename, size_t size) {
+  Close();
+
+  fd_ = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+    Close();
+    return false;
+  }
+  size_ = size;
+
+  return Map(Mode::kReadWrite);
+}
+
+bool MappedFile::Map(Mode mode) {
+  if (size_ == 0) {
+    return true;
+  }
+
+  int flags = mode == Mode::kReadWrite ? MAP_SHARED : MAP_PRIVATE;
+  void *address =
+      mmap(nullptr, size_, PROT_READ | PROT_WRITE, flags, fd_, 0);
+  if (address == MAP_FAILED) {
+    Close();
+    return false;
+  }
+
+  data_ = static_cast<byte *>(address);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_ != nullptr) {
+    munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+
+  data_ = nullptr;
+  fd_ = -1;
+  size_ = 0;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "image.h"
+
+/// @brief A whole file mapped in memory, with mmap on POSIX systems and
+/// CreateFileMapping on Windows.
+class MappedFile {
+public:
+  enum class Mode {
+    /// Writes go to private pages and never reach the file.
+    kCopyOnWrite = 0,
+    /// Writes are stored on the file.
+    kReadWrite
+  };
+
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// @brief Maps the existing file @p filename .
+  /// @return false if the file could not be opened or mapped
+  bool Open(const std::string &filename, Mode mode);
+
+  /// @brief Creates (or truncates) @p filename with @p size bytes and maps
+  /// it for writing.
+  /// @return false if the file could not be created or mapped
+  bool Create(const std::string &filename, size_t size);
+
+  /// @brief Unmaps the file, flushing the writes of a @see Mode::kReadWrite
+  /// mapping.
+  void Close();
+
+  byte *data() { return data_; }
+  const byte *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  bool Map(Mode mode);
+
+  byte *data_ = nullptr;
+  size_t size_ = 0;
+#if defined(_WIN32)
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#else
+  int fd_ = -1;
+#endif
+};
@@ -0,0 +1,360 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "morphology.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+#include "processing_context.h"
+#include "tile_scheduler.h"
+#include "traversal.h"
+
+namespace {
+
+const int kWordBits = 64;
+
+/// Rows given to a single task of the horizontal passes.
+const int kRowsPerTask = 64;
+
+/// Words of each row given to a single task of the vertical passes.
+const int kWordsPerTask = 4;
+
+/// Element heights up to which the columns combine the rows one by one,
+/// which costs less than the three passes of van Herk/Gil-Werman.
+const int kDirectColumnSpan = 4;
+
+StructuringElement structuring_element;
+
+/// @brief One channel of an image, one bit per pixel: the pixel x of a row
+/// is the bit x % 64 of its word x / 64. The bits past the width are kept
+/// equal to the padding of the operation running, see @see PadTail .
+struct BitPlane {
+  uint64_t *words = nullptr;
+  int stride = 0;
+  int width = 0;
+  int height = 0;
+
+  uint64_t *row(int y) { return words + static_cast<size_t>(y) * stride; }
+};
+
+/// @brief What the pixels outside the image are taken to be: set for an
+/// erosion and clear for a dilation, so they never change the ones inside.
+uint64_t PaddingOf(bool erode) { return erode ? ~uint64_t(0) : 0; }
+
+template <bool kErode> uint64_t Combine(uint64_t a, uint64_t b) {
+  return kErode ? a & b : a | b;
+}
+
+/// @brief Sets the bits past @p width on the last of the @p words of @p row
+/// to @p padding .
+void PadTail(uint64_t *row, int words, int width, uint64_t padding) {
+  int used = width % kWordBits;
+  if (used == 0) {
+    return;
+  }
+
+  uint64_t valid = (uint64_t(1) << used) - 1;
+  row[words - 1] = (row[words - 1] & valid) | (padding & ~valid);
+}
+
+/// @brief Writes on the bit x of the @p out_words words of @p out the bit
+/// x + @p offset of the @p in_words words of @p in , or @p padding past
+/// either end of @p in .
+void ShiftRow(const uint64_t *in, int in_words, uint64_t *out, int out_words,
+              int offset, uint64_t padding) {
+  int skip = offset >= 0 ? offset / kWordBits
+                         : -((-offset + kWordBits - 1) / kWordBits);
+  int bits = offset - skip * kWordBits;
+
+  auto word = [&](int64_t i) {
+    return i >= 0 && i < in_words ? in[i] : padding;
+  };
+
+  for (int w = 0; w < out_words; w++) {
+    uint64_t low = word(static_cast<int64_t>(w) + skip);
+    if (bits == 0) {
+      out[w] = low;
+      continue;
+    }
+
+    uint64_t high = word(static_cast<int64_t>(w) + skip + 1);
+    out[w] = low >> bits | high << (kWordBits - bits);
+  }
+}
+
+/// @brief Words of the scratch rows of @see RunRow for rows of @p words
+/// words and elements reaching @p before pixels to the left.
+int RowScratchWords(int words, int before) {
+  return words + before / kWordBits + 1;
+}
+
+/// @brief Erodes (or dilates) @p row over the pixels [x - @p before ,
+/// x + @p after ] of each x. Combining a row with itself shifted by the
+/// span it already covers doubles the span, so a span of n pixels takes
+/// about log2 n steps over the words.
+/// @param covered Scratch of @see RowScratchWords words
+/// @param shifted Scratch of @see RowScratchWords words
+template <bool kErode>
+void RunRow(uint64_t *row, int words, int width, int before, int after,
+            uint64_t *covered, uint64_t *shifted) {
+  uint64_t padding = PaddingOf(kErode);
+  int span = before + after + 1;
+  int scratch = RowScratchWords(words, before);
+
+  // The bit x of covered is the pixel x - before, so the spans only ever
+  // grow to the right, where everything past the row is padding.
+  ShiftRow(row, words, covered, scratch, -before, padding);
+
+  // The bit x of covered combines the pixels [x - before, x - before + reach).
+  int reach = 1;
+  while (reach < span) {
+    int step = std::min(reach, span - reach);
+    ShiftRow(covered, scratch, shifted, scratch, step, padding);
+    for (int w = 0; w < scratch; w++) {
+      covered[w] = Combine<kErode>(covered[w], shifted[w]);
+    }
+    reach += step;
+  }
+
+  memcpy(row, covered, words * sizeof(uint64_t));
+  PadTail(row, words, width, padding);
+}
+
+/// @brief Erodes (or dilates) the words [ @p first , @p last ) of every row
+/// of @p plane over the rows [y - @p above , y + @p below ] of each y.
+template <bool kErode>
+void RunColumns(BitPlane &plane, int first, int last, int above, int below,
+                ScratchArena &arena) {
+  uint64_t padding = PaddingOf(kErode);
+  int span = above + below + 1;
+  int columns = last - first;
+  int height = plane.height;
+
+  // The rows of the image with the padding around them, so the window of
+  // the row y is always [y, y + span) on it.
+  int padded = height + span - 1;
+  auto padded_row = [&](int i, int w) {
+    int y = i - above;
+    return y >= 0 && y < height ? plane.row(y)[w] : padding;
+  };
+
+  if (span <= kDirectColumnSpan) {
+    uint64_t *result =
+        arena.Allocate<uint64_t>(static_cast<size_t>(height) * columns);
+    for (int y = 0; y < height; y++) {
+      for (int w = first; w < last; w++) {
+        uint64_t value = padded_row(y, w);
+        for (int k = 1; k < span; k++) {
+          value = Combine<kErode>(value, padded_row(y + k, w));
+        }
+        result[static_cast<size_t>(y) * columns + (w - first)] = value;
+      }
+    }
+
+    for (int y = 0; y < height; y++) {
+      memcpy(plane.row(y) + first, result + static_cast<size_t>(y) * columns,
+             columns * sizeof(uint64_t));
+    }
+    return;
+  }
+
+  // van Herk/Gil-Werman: cut the padded rows in blocks of span rows and
+  // combine each block from its start (prefix) and from its end (suffix).
+  // A window either starts a block or covers the end of one and the start
+  // of the next, so it is a single combine of a suffix and a prefix.
+  uint64_t *prefix =
+      arena.Allocate<uint64_t>(static_cast<size_t>(padded) * columns);
+  uint64_t *suffix =
+      arena.Allocate<uint64_t>(static_cast<size_t>(padded) * columns);
+  auto at = [&](uint64_t *rows, int i, int w) -> uint64_t & {
+    return rows[static_cast<size_t>(i) * columns + (w - first)];
+  };
+
+  for (int i = 0; i < padded; i++) {
+    for (int w = first; w < last; w++) {
+      uint64_t value = padded_row(i, w);
+      at(prefix, i, w) =
+          i % span == 0 ? value : Combine<kErode>(at(prefix, i - 1, w), value);
+    }
+  }
+
+  for (int i = padded - 1; i >= 0; i--) {
+    for (int w = first; w < last; w++) {
+      uint64_t value = padded_row(i, w);
+      bool block_end = i == padded - 1 || i % span == span - 1;
+      at(suffix, i, w) =
+          block_end ? value : Combine<kErode>(value, at(suffix, i + 1, w));
+    }
+  }
+
+  for (int y = 0; y < height; y++) {
+    uint64_t *row = plane.row(y);
+    for (int w = first; w < last; w++) {
+      uint64_t end = at(prefix, y + span - 1, w);
+      row[w] = y % span == 0 ? end : Combine<kErode>(at(suffix, y, w), end);
+    }
+  }
+}
+
+/// @brief Erodes (or dilates) @p plane by the rectangle @p element : a
+/// pass over the rows and then one over the columns.
+template <bool kErode>
+void RunOp(BitPlane &plane, const StructuringElement &element) {
+  uint64_t padding = PaddingOf(kErode);
+  int left = (element.width - 1) / 2;
+  int right = element.width / 2;
+  int above = (element.height - 1) / 2;
+  int below = element.height / 2;
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = plane.stride,
+                .height = plane.height},
+      plane.stride, kRowsPerTask, [&](const Rectangle &band) {
+        ScratchScope band_scope(GetProcessingContext().arena());
+        int scratch = RowScratchWords(plane.stride, left);
+        uint64_t *covered = band_scope.arena().Allocate<uint64_t>(scratch);
+        uint64_t *shifted = band_scope.arena().Allocate<uint64_t>(scratch);
+
+        ForEachRow(band.y, band.y + band.height, [&](int y) {
+          uint64_t *row = plane.row(y);
+          PadTail(row, plane.stride, plane.width, padding);
+          if (left + right > 0) {
+            RunRow<kErode>(row, plane.stride, plane.width, left, right,
+                           covered, shifted);
+          }
+        });
+      });
+
+  if (above + below == 0) {
+    return;
+  }
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = plane.stride,
+                .height = plane.height},
+      kWordsPerTask, plane.height, [&](const Rectangle &columns) {
+        ScratchScope columns_scope(GetProcessingContext().arena());
+        RunColumns<kErode>(plane, columns.x, columns.x + columns.width,
+                           above, below, columns_scope.arena());
+      });
+}
+
+/// @brief Packs the channel @p channel of @p src on @p plane , the bit of a
+/// sample s being @p bit_of [s].
+void PackChannel(const Image &src, int channel, const byte *bit_of,
+                 BitPlane &plane) {
+  int step = src.pixel_step();
+
+  ParallelForEachTile(src, [&](const Rectangle &band) {
+    ForEachRow(band.y, band.y + band.height, [&](int y) {
+      const byte *from = src.channel_row(channel, y);
+      uint64_t *to = plane.row(y);
+
+      for (int w = 0; w < plane.stride; w++) {
+        int begin = w * kWordBits;
+        int count = std::min(kWordBits, plane.width - begin);
+        uint64_t word = 0;
+
+        for (int b = 0; b < count; b++) {
+          word |= static_cast<uint64_t>(bit_of[from[(begin + b) * step]])
+                  << b;
+        }
+        to[w] = word;
+      }
+    });
+  });
+}
+
+/// @brief Writes the bits of @p plane on the channel @p channel of @p dst ,
+/// as 0 or 255.
+void UnpackChannel(BitPlane &plane, int channel, Image &dst) {
+  int step = dst.pixel_step();
+
+  ParallelForEachTile(dst, [&](const Rectangle &band) {
+    ForEachRow(band.y, band.y + band.height, [&](int y) {
+      const uint64_t *from = plane.row(y);
+      byte *to = dst.channel_row(channel, y);
+
+      for (int x = 0; x < plane.width; x++) {
+        uint64_t bit = from[x / kWordBits] >> (x % kWordBits) & 1;
+        to[x * step] = static_cast<byte>(bit != 0 ? 255 : 0);
+      }
+    });
+  });
+}
+
+} // namespace
+
+void SetStructuringElement(const StructuringElement &element) {
+  structuring_element.width = std::max(element.width, 1);
+  structuring_element.height = std::max(element.height, 1);
+}
+
+StructuringElement GetStructuringElement() { return structuring_element; }
+
+void Morphology(const Image &src, Image &dst,
+                std::span<const MorphologyOp> ops,
+                const StructuringElement &element, const LUT3 *lut) {
+  if (src.empty()) {
+    return;
+  }
+
+  StructuringElement rectangle{.width = std::max(element.width, 1),
+                               .height = std::max(element.height, 1)};
+  ScratchScope scope(GetProcessingContext().arena());
+
+  for (int c = 0; c < src.color_channels(); c++) {
+    byte bit_of[256];
+    for (int s = 0; s < 256; s++) {
+      int value = lut != nullptr ? lut->table[c][s] : s;
+      bit_of[s] = static_cast<byte>(value >= 128 ? 1 : 0);
+    }
+
+    BitPlane plane;
+    plane.width = src.width();
+    plane.height = src.height();
+    plane.stride = (plane.width + kWordBits - 1) / kWordBits;
+    plane.words = scope.arena().Allocate<uint64_t>(
+        static_cast<size_t>(plane.stride) * plane.height);
+
+    PackChannel(src, c, bit_of, plane);
+
+    for (MorphologyOp op : ops) {
+      switch (op) {
+        using enum MorphologyOp;
+
+      case kErode: {
+        RunOp<true>(plane, rectangle);
+      } break;
+
+      case kDilate: {
+        RunOp<false>(plane, rectangle);
+      } break;
+
+      case kOpen: {
+        RunOp<true>(plane, rectangle);
+        RunOp<false>(plane, rectangle);
+      } break;
+
+      case kClose: {
+        RunOp<false>(plane, rectangle);
+        RunOp<true>(plane, rectangle);
+      } break;
+      }
+    }
+
+    UnpackChannel(plane, c, dst);
+  }
+
+  // Only the color samples were written.
+  if (src.format() == PixelFormat::kBGRA32 && src.row(0) != dst.row(0)) {
+    for (int y = 0; y < src.height(); y++) {
+      for (int x = 0; x < src.width(); x++) {
+        dst.row(y)[4 * x + BGRA32::kAlphaByte] =
+            src.row(y)[4 * x + BGRA32::kAlphaByte];
+      }
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <span>
+
+#include "image.h"
+#include "lut.h"
+
+/// @brief The binary morphology operations of @see Morphology
+enum class MorphologyOp {
+  /// Keeps the pixels whose whole neighbourhood is set
+  kErode = 0,
+  /// Sets the pixels with any neighbour set
+  kDilate,
+  /// An erosion followed by a dilation, which removes specks smaller than
+  /// the structuring element
+  kOpen,
+  /// A dilation followed by an erosion, which fills holes smaller than the
+  /// structuring element
+  kClose
+};
+
+/// @brief A rectangular structuring element centered on each pixel (even
+/// sides reach one pixel further to the right and to the bottom).
+struct StructuringElement {
+  int width = 3;
+  int height = 3;
+};
+
+/// @brief Sets the element used by the morphology commands.
+void SetStructuringElement(const StructuringElement &element);
+
+/// @brief The element used by the morphology commands, 3x3 if it was never
+/// set.
+StructuringElement GetStructuringElement();
+
+/// @brief Applies @p ops in order on the binary channels of @p src , writing
+/// the result on @p dst . Each channel is packed 64 pixels per word, a
+/// sample being set from 128 up, and the ops run on the packed words: the
+/// element is separable, so rows are eroded or dilated with shifts that
+/// double the covered span on each step (log2 of the width in word ops per
+/// word) and columns with the van Herk/Gil-Werman running min or max (3 word
+/// ops per word, whatever the height). The pixels outside the image never
+/// erode or dilate the ones inside. The results are written as 0 or 255.
+/// @param src The image to be read
+/// @param dst [out] An image of the size, format and layout of @p src ,
+/// which may be @p src itself
+/// @param ops The operations to be applied, in order
+/// @param element The structuring element
+/// @param lut When given, tables still to be applied on @p src , read while
+/// packing instead of in a pass of their own: a sample s is set when
+/// lut[s] is from 128 up. Only the same as applying them first when they
+/// are bilevel, see @see IsBilevelLUT
+void Morphology(const Image &src, Image &dst,
+                std::span<const MorphologyOp> ops,
+                const StructuringElement &element,
+                const LUT3 *lut = nullptr);
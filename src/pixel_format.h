@@ -0,0 +1,66 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+/// @brief How the samples of an interleaved pixel are stored
+enum class PixelFormat {
+  /// Three bytes per pixel, one per color channel (in RGB or BGR order)
+  kRGB24 = 0,
+  /// One byte per pixel, the red, green and blue channels are the same sample
+  kGray8,
+  /// Four bytes per pixel in B, G, R, A order. Kernels leave the alpha alone.
+  kBGRA32
+};
+
+/// @brief Compile time description of @see PixelFormat::kGray8 , kernels are
+/// templated on these traits so each format gets its own unrolled loops.
+struct Gray8 {
+  static constexpr PixelFormat kFormat = PixelFormat::kGray8;
+  static constexpr int kBytesPerPixel = 1;
+  /// Distinct color samples on each pixel.
+  static constexpr int kColorChannels = 1;
+  /// Byte of the pixel left untouched by the kernels, -1 for none.
+  static constexpr int kAlphaByte = -1;
+};
+
+/// @brief Compile time description of @see PixelFormat::kRGB24
+struct RGB24 {
+  static constexpr PixelFormat kFormat = PixelFormat::kRGB24;
+  static constexpr int kBytesPerPixel = 3;
+  static constexpr int kColorChannels = 3;
+  static constexpr int kAlphaByte = -1;
+};
+
+/// @brief Compile time description of @see PixelFormat::kBGRA32
+struct BGRA32 {
+  static constexpr PixelFormat kFormat = PixelFormat::kBGRA32;
+  static constexpr int kBytesPerPixel = 4;
+  static constexpr int kColorChannels = 3;
+  static constexpr int kAlphaByte = 3;
+};
+
+/// @brief Calls @p fn with the traits of @p format , like Gray8{} , so a
+/// runtime format picks its compile time specialized kernel.
+template <typename Fn> decltype(auto) VisitPixelFormat(PixelFormat format,
+                                                       Fn &&fn) {
+  switch (format) {
+    using enum PixelFormat;
+
+  case kGray8:
+    return fn(Gray8{});
+
+  case kBGRA32:
+    return fn(BGRA32{});
+
+  default:
+    return fn(RGB24{});
+  }
+}
+
+/// @brief The bytes of a pixel of @p format .
+constexpr int BytesPerPixel(PixelFormat format) {
+  return format == PixelFormat::kGray8    ? Gray8::kBytesPerPixel
+         : format == PixelFormat::kBGRA32 ? BGRA32::kBytesPerPixel
+                                          : RGB24::kBytesPerPixel;
+}
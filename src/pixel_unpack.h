@@ -0,0 +1,128 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include "cpu_features.h"
+#include "image.h"
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#define PDI_LI_UNPACK_SSSE3 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PDI_LI_UNPACK_NEON 1
+#endif
+
+/// Number of pixels unpacked at once by @see UnpackBlock and
+/// @see UnpackBlock4 .
+const int kBlockPixels = 16;
+
+#if defined(PDI_LI_X86)
+/// @brief The SSSE3 form of @see UnpackBlock , for the kernels marked with
+/// @see PDI_LI_TARGET_SSSE3 when the build targets less (see cpu_features.h).
+PDI_LI_TARGET_SSSE3 inline void UnpackBlockSSSE3(const byte *src, byte *red,
+                                                 byte *green, byte *blue) {
+  const char z = -1;
+  __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16));
+  __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 32));
+
+  __m128i r = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, z, z, z, z, z,
+                                            z, z, z, z, z)),
+          _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, z, 2, 5, 8, 11, 14,
+                                            z, z, z, z, z))),
+      _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 1, 4,
+                                        7, 10, 13)));
+  __m128i g = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, z, z, z, z, z, z,
+                                            z, z, z, z, z)),
+          _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, 0, 3, 6, 9, 12, 15,
+                                            z, z, z, z, z))),
+      _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, z, 2, 5,
+                                        8, 11, 14)));
+  __m128i bl = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, z, z, z, z, z, z,
+                                            z, z, z, z, z)),
+          _mm_shuffle_epi8(b, _mm_setr_epi8(z, z, z, z, z, 1, 4, 7, 10, 13, z,
+                                            z, z, z, z, z))),
+      _mm_shuffle_epi8(c, _mm_setr_epi8(z, z, z, z, z, z, z, z, z, z, 0, 3, 6,
+                                        9, 12, 15)));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(red), r);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(green), g);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(blue), bl);
+}
+
+/// @brief The SSSE3 form of @see UnpackBlock4 , see @see UnpackBlockSSSE3 .
+PDI_LI_TARGET_SSSE3 inline void UnpackBlock4SSSE3(const byte *src,
+                                                  byte *planes[4]) {
+  // Gathers the bytes 0, 1, 2 and 3 of the four pixels of each vector in its
+  // four 32 bit lanes, then transposes the lanes of the four vectors.
+  const __m128i gather =
+      _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  __m128i v[4];
+  for (int i = 0; i < 4; i++) {
+    v[i] = _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 16 * i)),
+        gather);
+  }
+
+  __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+  __m128i t1 = _mm_unpacklo_epi32(v[2], v[3]);
+  __m128i t2 = _mm_unpackhi_epi32(v[0], v[1]);
+  __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[0]),
+                   _mm_unpacklo_epi64(t0, t1));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[1]),
+                   _mm_unpackhi_epi64(t0, t1));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[2]),
+                   _mm_unpacklo_epi64(t2, t3));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(planes[3]),
+                   _mm_unpackhi_epi64(t2, t3));
+}
+#endif
+
+/// @brief Splits @p kBlockPixels interleaved pixels on @p src into three
+/// planes, one per byte position. The names assume RGB order.
+inline void UnpackBlock(const byte *src, byte *red, byte *green, byte *blue) {
+#if defined(PDI_LI_UNPACK_SSSE3)
+  UnpackBlockSSSE3(src, red, green, blue);
+#elif defined(PDI_LI_UNPACK_NEON)
+  uint8x16x3_t pixels = vld3q_u8(src);
+
+  vst1q_u8(red, pixels.val[0]);
+  vst1q_u8(green, pixels.val[1]);
+  vst1q_u8(blue, pixels.val[2]);
+#else
+  for (int x = 0; x < kBlockPixels; x++) {
+    red[x] = src[3 * x];
+    green[x] = src[3 * x + 1];
+    blue[x] = src[3 * x + 2];
+  }
+#endif
+}
+
+/// @brief Splits @p kBlockPixels four byte pixels on @p src into four planes,
+/// one per byte position.
+inline void UnpackBlock4(const byte *src, byte *planes[4]) {
+#if defined(PDI_LI_UNPACK_SSSE3)
+  UnpackBlock4SSSE3(src, planes);
+#elif defined(PDI_LI_UNPACK_NEON)
+  uint8x16x4_t pixels = vld4q_u8(src);
+
+  for (int i = 0; i < 4; i++) {
+    vst1q_u8(planes[i], pixels.val[i]);
+  }
+#else
+  for (int x = 0; x < kBlockPixels; x++) {
+    for (int i = 0; i < 4; i++) {
+      planes[i][x] = src[4 * x + i];
+    }
+  }
+#endif
+}
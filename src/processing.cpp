@@ -0,0 +1,366 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "processing.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdint.h>
+#include <string.h>
+
+#include "lut.h"
+#include "luma.h"
+#include "processing_context.h"
+#include "raster.h"
+#include "threshold.h"
+#include "tile_scheduler.h"
+#include "traversal.h"
+
+namespace {
+
+/// @brief Draws the bars of @p counts inside @p rect , one column per value
+/// with a height proportional to the count.
+void DrawBars(Image &img, const Rectangle &rect, const uint64_t *counts,
+              const RGBColor &color) {
+  uint64_t max_count = *std::max_element(counts, counts + 256);
+
+  for (int i = 0; i < 256; i++) {
+    int bar = static_cast<int>(rect.height * (counts[i] / (1.0 * max_count)));
+    FillVerticalSpan(img, rect.x + i, rect.y, bar + 1, color);
+  }
+}
+
+/// @brief Where a coordinate sits between the centers of two tiles: the
+/// tables of @see low and @see high are blended with @see weight / 256 of
+/// @see high .
+struct TileBlend {
+  int low, high;
+  int weight;
+};
+
+/// @brief The @see TileBlend of every coordinate of an axis of @p size
+/// pixels cut in @p tiles tiles of @p tile pixels. Computed once per axis and
+/// shared by the three channels.
+TileBlend *BlendAxis(ScratchArena &arena, int size, int tile, int tiles) {
+  TileBlend *blends = arena.Allocate<TileBlend>(size);
+
+  // The center of the pixel i sits (2 i + 1 - tile) / (2 tile) tiles past
+  // the center of the first tile, kept as an exact fraction.
+  int64_t denominator = 2 * static_cast<int64_t>(tile);
+
+  for (int i = 0; i < size; i++) {
+    int64_t numerator = 2 * static_cast<int64_t>(i) + 1 - tile;
+    int64_t low = numerator >= 0
+                      ? numerator / denominator
+                      : -((-numerator + denominator - 1) / denominator);
+    int64_t above = numerator - low * denominator;
+    int weight = static_cast<int>((256 * above + denominator / 2) /
+                                  denominator);
+
+    if (low < 0) {
+      low = 0;
+      weight = 0;
+    } else if (low >= tiles - 1) {
+      low = tiles - 1;
+      weight = 0;
+    }
+
+    int start = static_cast<int>(low);
+    blends[i] = TileBlend{.low = start, .high = std::min(start + 1, tiles - 1),
+                          .weight = weight};
+  }
+
+  return blends;
+}
+
+/// @brief Caps every bin of @p bins at @p limit and spreads the excess
+/// evenly over all the bins, so the total count does not change.
+void ClipBins(uint64_t *bins, uint64_t limit) {
+  uint64_t excess = 0;
+
+  for (int i = 0; i < 256; i++) {
+    if (bins[i] > limit) {
+      excess += bins[i] - limit;
+      bins[i] = limit;
+    }
+  }
+
+  uint64_t extra = excess % 256;
+  for (int i = 0; i < 256; i++) {
+    bins[i] += excess / 256 + (static_cast<uint64_t>(i) < extra ? 1 : 0);
+  }
+}
+
+/// @brief Replaces @p img by its luma binarized at the cut @p cut_point
+/// finds on the luma histogram.
+void BinarizeLuma(Image &img, ScratchArena *arena,
+                  byte (*cut_point)(const uint64_t *)) {
+  img = LumaImage(img, arena);
+
+  byte cut = cut_point(GetHistogram(img).red);
+  ApplyChannelLUT(img, BinarizeLUT(cut, cut, cut));
+}
+
+} // namespace
+
+Image CreateHistogramImage(RGBHistogram &histogram, ScratchArena *arena) {
+  const int lr_borders = 30;
+  const int tb_borders = 10;
+  const int in_between_borders = 30;
+
+  const int graph_width = 256;
+  const int graph_height = 256;
+
+  const RGBColor white = {.r = 255, .g = 255, .b = 255};
+  const RGBColor red = {.r = 255, .g = 0, .b = 0};
+  const RGBColor green = {.r = 0, .g = 255, .b = 0};
+  const RGBColor blue = {.r = 0, .g = 0, .b = 255};
+
+  const Rectangle red_rect = {.x = lr_borders,
+                              .y = tb_borders,
+                              .width = graph_width,
+                              .height = graph_height};
+
+  const Rectangle green_rect = {.x = lr_borders,
+                                .y = tb_borders + graph_height +
+                                     in_between_borders,
+                                .width = graph_width,
+                                .height = graph_height};
+
+  const Rectangle blue_rect = {.x = lr_borders,
+                               .y = tb_borders +
+                                    2 * (graph_height + in_between_borders),
+                               .width = graph_width,
+                               .height = graph_height};
+  int width = 2 * lr_borders + graph_width;
+  int height = 2 * tb_borders + 2 * in_between_borders + 3 * graph_height;
+
+  Image graph = arena != nullptr ? arena->AllocateImage(width, height)
+                                : Image(width, height);
+
+  // New images start black, so only the frames and the bars are drawn.
+  DrawRectangleOutline(graph, red_rect, white);
+  DrawRectangleOutline(graph, green_rect, white);
+  DrawRectangleOutline(graph, blue_rect, white);
+
+  DrawBars(graph, red_rect, histogram.red, red);
+  DrawBars(graph, green_rect, histogram.green, green);
+  DrawBars(graph, blue_rect, histogram.blue, blue);
+
+  return graph;
+}
+
+void Binarize(Image &img, byte red_cut_point, byte green_cut_point,
+              byte blue_cut_point) {
+  ApplyChannelLUT(img,
+                  BinarizeLUT(red_cut_point, green_cut_point, blue_cut_point));
+}
+
+void EqualizationTable(const uint64_t *bins, byte *table) {
+  uint64_t cdf[256];
+  uint64_t total = 0;
+  for (int i = 0; i < 256; i++) {
+    total += bins[i];
+    cdf[i] = total;
+  }
+
+  uint64_t min_cdf = 0;
+  for (int i = 0; i < 256 && min_cdf == 0; i++) {
+    min_cdf = cdf[i];
+  }
+
+  // A single valued channel has nothing to spread.
+  uint64_t span = total - min_cdf;
+  if (span == 0) {
+    for (int i = 0; i < 256; i++) {
+      table[i] = static_cast<byte>(i);
+    }
+    return;
+  }
+
+  // 255 times the span fits in 64 bits up to 2^56 pixels, beyond it both
+  // sides of the ratio drop the same low bits.
+  int shift = 0;
+  while ((span >> shift) > kMaxExactEqualizationSpan) {
+    shift++;
+  }
+  span >>= shift;
+
+  for (int i = 0; i < 256; i++) {
+    uint64_t above = cdf[i] > min_cdf ? (cdf[i] - min_cdf) >> shift : 0;
+    table[i] = static_cast<byte>(255 * above / span);
+  }
+}
+
+LUT3 EqualizationLUT(const RGBHistogram &histogram) {
+  const uint64_t *inputs[Image::kChannels] = {histogram.red, histogram.green,
+                                              histogram.blue};
+  LUT3 lut;
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    EqualizationTable(inputs[c], lut.table[c]);
+  }
+
+  return lut;
+}
+
+void Equalize(Image &img) {
+  ApplyChannelLUT(img, EqualizationLUT(GetHistogram(img)));
+}
+
+void EqualizeLuma(Image &img) {
+  uint64_t bins[256];
+  CountLuma(img, bins);
+
+  byte table[256];
+  EqualizationTable(bins, table);
+  MapLuma(img, table);
+}
+
+void EqualizeLocal(Image &img, int grid, double clip_limit) {
+  if (img.empty()) {
+    return;
+  }
+
+  grid = std::max(grid, 1);
+  int tile_width = std::max((img.width() + grid - 1) / grid, 1);
+  int tile_height = std::max((img.height() + grid - 1) / grid, 1);
+  int columns = (img.width() + tile_width - 1) / tile_width;
+  int rows = (img.height() + tile_height - 1) / tile_height;
+
+  ScratchScope scope(GetProcessingContext().arena());
+  LUT3 *luts =
+      scope.arena().Allocate<LUT3>(static_cast<size_t>(columns) * rows);
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = img.width(), .height = img.height()},
+      tile_width, tile_height, [&](const Rectangle &tile) {
+        RGBHistogram histogram{};
+        memset(&histogram, 0, sizeof(RGBHistogram));
+        AccumulateHistogram(img, tile, histogram);
+
+        if (clip_limit > 0) {
+          uint64_t limit = std::max<uint64_t>(
+              static_cast<uint64_t>(clip_limit * tile.width * tile.height /
+                                    256),
+              1);
+          ClipBins(histogram.red, limit);
+          ClipBins(histogram.green, limit);
+          ClipBins(histogram.blue, limit);
+        }
+
+        int index = tile.y / tile_height * columns + tile.x / tile_width;
+        luts[index] = EqualizationLUT(histogram);
+      });
+
+  const TileBlend *xs =
+      BlendAxis(scope.arena(), img.width(), tile_width, columns);
+  const TileBlend *ys =
+      BlendAxis(scope.arena(), img.height(), tile_height, rows);
+  int step = img.pixel_step();
+
+  // Each pixel only reads its own sample, so the rows can be done in place.
+  // The vertical blend only changes from row to row, so it is done once per
+  // row on the tables (times 256) and each pixel only blends horizontally.
+  ParallelForEachTile(img, [&](const Rectangle &band) {
+    // Taken from the arena of the thread running the band.
+    ScratchScope band_scope(GetProcessingContext().arena());
+    uint16_t *blended = band_scope.arena().Allocate<uint16_t>(
+        static_cast<size_t>(columns) * Image::kChannels * 256);
+    TileBlend blended_row = {.low = -1, .high = -1, .weight = -1};
+
+    ForEachRow(band.y, band.y + band.height, [&](int y) {
+      const TileBlend &by = ys[y];
+
+      if (by.low != blended_row.low || by.weight != blended_row.weight) {
+        for (int k = 0; k < columns; k++) {
+          const LUT3 &top = luts[static_cast<size_t>(by.low) * columns + k];
+          const LUT3 &bottom =
+              luts[static_cast<size_t>(by.high) * columns + k];
+          uint16_t *to = &blended[static_cast<size_t>(k) * 3 * 256];
+
+          for (int c = 0; c < Image::kChannels; c++) {
+            for (int i = 0; i < 256; i++) {
+              to[c * 256 + i] = static_cast<uint16_t>(
+                  top.table[c][i] * (256 - by.weight) +
+                  bottom.table[c][i] * by.weight);
+            }
+          }
+        }
+        blended_row = by;
+      }
+
+      for (int c = 0; c < img.color_channels(); c++) {
+        byte *row = img.channel_row(c, y);
+        const uint16_t *tables = &blended[static_cast<size_t>(c) * 256];
+
+        for (int x = 0; x < img.width(); x++) {
+          const TileBlend &bx = xs[x];
+          byte value = row[x * step];
+
+          int low = tables[static_cast<size_t>(bx.low) * 3 * 256 + value];
+          int high = tables[static_cast<size_t>(bx.high) * 3 * 256 + value];
+
+          row[x * step] = static_cast<byte>(
+              (low * (256 - bx.weight) + high * bx.weight + 32768) >> 16);
+        }
+      }
+    });
+  });
+}
+
+LUT3 CutoutLUT() { return BinarizeLUT(128, 128, 128); }
+
+void Cutout(Image &img) { ApplyChannelLUT(img, CutoutLUT()); }
+
+byte TwoPeaksCut(const uint64_t *bins) {
+  return ThresholdEngine(bins).TwoPeaks();
+}
+
+byte OtsuCut(const uint64_t *bins) { return ThresholdEngine(bins).Otsu(); }
+
+LUT3 MultiOtsuLUT(const RGBHistogram &histogram, int classes) {
+  classes = std::clamp(classes, 2, kMaxThresholdClasses);
+  const uint64_t *bins[Image::kChannels] = {histogram.red, histogram.green,
+                                            histogram.blue};
+  LUT3 lut;
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    byte cuts[kMaxThresholdClasses - 1];
+    ThresholdEngine(bins[c]).MultiOtsu(classes, cuts);
+
+    // The classes get evenly spaced levels, the darkest one 0 and the
+    // brightest 255.
+    int k = 0;
+    for (int i = 0; i < 256; i++) {
+      while (k < classes - 1 && i >= cuts[k]) {
+        k++;
+      }
+      lut.table[c][i] = static_cast<byte>((255 * k + (classes - 1) / 2) /
+                                          (classes - 1));
+    }
+  }
+
+  return lut;
+}
+
+void MultiOtsu(Image &img, int classes) {
+  ApplyChannelLUT(img, MultiOtsuLUT(GetHistogram(img), classes));
+}
+
+LUT3 TwoPeaksLUT(const RGBHistogram &histogram) {
+  return BinarizeLUT(TwoPeaksCut(histogram.red), TwoPeaksCut(histogram.green),
+                     TwoPeaksCut(histogram.blue));
+}
+
+void TwoPeaks(Image &img) {
+  ApplyChannelLUT(img, TwoPeaksLUT(GetHistogram(img)));
+}
+
+void TwoPeaksLuma(Image &img, ScratchArena *arena) {
+  BinarizeLuma(img, arena, TwoPeaksCut);
+}
+
+void OtsuLuma(Image &img, ScratchArena *arena) {
+  BinarizeLuma(img, arena, OtsuCut);
+}
@@ -0,0 +1,137 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+
+#include "histogram.h"
+#include "image.h"
+#include "lut.h"
+#include "processing_context.h"
+
+/// @brief Creates a interpolated image with the visual information about the
+/// histogram of some image
+/// @param histogram The histogram information about each channel of the image
+/// @param arena When given, the image is a view taken from it instead of a
+/// new buffer, see @see ScratchArena::AllocateImage
+/// @return An image with the histogram drawed upside down.
+Image CreateHistogramImage(RGBHistogram &histogram,
+                           ScratchArena *arena = nullptr);
+
+/// @brief Converts some bitmap @p img in only true black and white value on
+/// each matrix.
+/// @param img [in | out] The image to be binarized.
+/// @param red_cut_point The point of cut for the red channel.
+/// @param green_cut_point The point of cut for the green channel.
+/// @param blue_cut_point The point of cut for the blue channel.
+void Binarize(Image &img, byte red_cut_point, byte green_cut_point,
+              byte blue_cut_point);
+
+/// The largest count above the first non zero bin for which
+/// @see EqualizationTable is exact, 2^56 pixels.
+const uint64_t kMaxExactEqualizationSpan = uint64_t(1) << 56;
+
+/// @brief The equalization table of one channel: the sample v goes to
+/// floor(255 * (cdf(v) - cdf_min) / (total - cdf_min)), where cdf_min is the
+/// first non zero value of the cumulative counts. Computed in 64 bit integers
+/// only, so the tables are the same on every compiler and platform.
+/// @param bins The 256 counts of the channel
+/// @param table [out] The 256 entries of the table
+void EqualizationTable(const uint64_t *bins, byte *table);
+
+/// @brief Builds the tables that equalize an image with the @p histogram ,
+/// see @see EqualizationTable .
+/// @param histogram The histogram of the image to be equalized
+/// @return The @see LUT3 mapping each sample to its equalized value
+LUT3 EqualizationLUT(const RGBHistogram &histogram);
+
+/// @brief Applys the equalization algorithm on the @p img .
+/// @param img The image to have the histogram equalizated.
+void Equalize(Image &img);
+
+/// @brief Equalizes the luma of @p img alone, leaving its chroma as it was:
+/// the @see EqualizationTable of the histogram of the @see Luma goes through
+/// @see MapLuma . Equalizing each channel on its own shifts the hues, and
+/// this counts a single histogram instead of three. Two passes over the
+/// pixels, one counting and one mapping, neither writing a luma plane.
+/// @param img [in | out] The image to be equalized
+void EqualizeLuma(Image &img);
+
+/// Number of tiles on each axis used by @see EqualizeLocal by default.
+const int kDefaultLocalGrid = 8;
+
+/// Default clip limit of @see EqualizeLocal , as a multiple of the mean count
+/// of a bin.
+const double kDefaultClipLimit = 2.0;
+
+/// @brief Applies a contrast limited adaptive equalization (CLAHE) on
+/// @p img . The image is cut in @p grid x @p grid tiles, each one gets the
+/// @see EqualizationLUT of its clipped histogram and every pixel blends the
+/// tables of the four tiles around it with bilinear weights.
+/// @param img [in | out] The image to be equalized
+/// @param grid The number of tiles on each axis
+/// @param clip_limit The count a bin may reach before the excess is spread on
+/// the whole histogram, as a multiple of the mean count of a bin. 0 disables
+/// the clipping.
+void EqualizeLocal(Image &img, int grid = kDefaultLocalGrid,
+                   double clip_limit = kDefaultClipLimit);
+
+/// @brief The tables applied by the cutout algorithm.
+LUT3 CutoutLUT();
+
+/// @brief Applies the cutout algorithm on the @p img .
+/// @param img [in | out] The image to be binarized.
+void Cutout(Image &img);
+
+/// @brief The Two Peaks cut point of one channel: halfway between the
+/// highest bin of @p bins and the bin that maximizes its count times its
+/// squared distance to the first one.
+/// @param bins The 256 counts of the channel
+byte TwoPeaksCut(const uint64_t *bins);
+
+/// @brief The cut point that splits @p bins in the two classes with the
+/// largest between-class variance (Otsu's method). Samples below it belong
+/// to the dark class.
+/// @param bins The 256 counts of the channel
+byte OtsuCut(const uint64_t *bins);
+
+/// Number of classes @see MultiOtsu splits each channel in by default.
+const int kDefaultOtsuClasses = 3;
+
+/// @brief The tables of @see MultiOtsu : each channel is split in @p classes
+/// classes by the cut points of @see ThresholdEngine::MultiOtsu and every
+/// class is sent to one of @p classes levels evenly spaced from 0 to 255.
+/// @param histogram The histogram of the image to be posterized
+/// @param classes The number of classes, from 2 to @see kMaxThresholdClasses
+LUT3 MultiOtsuLUT(const RGBHistogram &histogram,
+                  int classes = kDefaultOtsuClasses);
+
+/// @brief Posterizes each channel of @p img in the @p classes levels with
+/// the largest between-class variance (multi-level Otsu).
+/// @param img [in | out] The image to be posterized
+/// @param classes The number of classes, from 2 to @see kMaxThresholdClasses
+void MultiOtsu(Image &img, int classes = kDefaultOtsuClasses);
+
+/// @brief Finds the cut points of the Two Peaks algorithm on @p histogram .
+/// @param histogram The histogram of the image to be binarized
+/// @return The @see BinarizeLUT for the cut point of each channel
+LUT3 TwoPeaksLUT(const RGBHistogram &histogram);
+
+/// @brief Applies the Two Peaks algorithm on the @p img .
+/// @param img [in | out]The image to be binarized.
+void TwoPeaks(Image &img);
+
+/// @brief Binarizes the luma of @p img with the @see TwoPeaksCut of its luma
+/// histogram, instead of a cut per channel. @p img becomes a gray image, see
+/// @see LumaImage , so the histogram and the table pass only touch a third of
+/// the bytes.
+/// @param img [in | out] The image to be binarized
+/// @param arena Where the gray image is taken from, see @see LumaImage
+void TwoPeaksLuma(Image &img, ScratchArena *arena = nullptr);
+
+/// @brief Like @see TwoPeaksLuma , with the @see OtsuCut of the luma
+/// histogram.
+/// @param img [in | out] The image to be binarized
+/// @param arena Where the gray image is taken from, see @see LumaImage
+void OtsuLuma(Image &img, ScratchArena *arena = nullptr);
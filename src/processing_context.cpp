@@ -0,0 +1,245 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "processing_context.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+/// Smallest block asked to the heap, so small tables do not each get one.
+const size_t kMinBlockSize = 64 * 1024;
+
+thread_local AllocationStats thread_heap_stats;
+// Relaxed counters: the kernels take their memory from arenas, so the heap is
+// seldom hit while the threads run.
+std::atomic<int64_t> process_allocations{0};
+std::atomic<int64_t> process_bytes{0};
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void *CountedAllocation(size_t size, size_t alignment) {
+  size = std::max<size_t>(size, 1);
+  thread_heap_stats.allocations++;
+  thread_heap_stats.bytes += static_cast<int64_t>(size);
+  process_allocations.fetch_add(1, std::memory_order_relaxed);
+  process_bytes.fetch_add(static_cast<int64_t>(size),
+                          std::memory_order_relaxed);
+
+  void *ptr = nullptr;
+#if defined(_WIN32)
+  ptr = alignment > alignof(std::max_align_t) ? _aligned_malloc(size, alignment)
+                                              : malloc(size);
+#else
+  if (alignment <= alignof(std::max_align_t)) {
+    ptr = malloc(size);
+  } else if (posix_memalign(&ptr, alignment, size) != 0) {
+    ptr = nullptr;
+  }
+#endif
+
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void AlignedFree(void *ptr, size_t alignment) {
+#if defined(_WIN32)
+  if (alignment > alignof(std::max_align_t)) {
+    _aligned_free(ptr);
+    return;
+  }
+#endif
+  (void)alignment;
+  free(ptr);
+}
+
+} // namespace
+
+// The replaceable allocation functions, counting every heap block of the
+// program for @see ThreadHeapStats . The array forms call these ones.
+void *operator new(std::size_t size) {
+  return CountedAllocation(size, alignof(std::max_align_t));
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return CountedAllocation(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { free(ptr); }
+
+void operator delete(void *ptr, std::align_val_t alignment) noexcept {
+  AlignedFree(ptr, static_cast<size_t>(alignment));
+}
+
+void operator delete(void *ptr, std::size_t,
+                     std::align_val_t alignment) noexcept {
+  AlignedFree(ptr, static_cast<size_t>(alignment));
+}
+
+AllocationStats ThreadHeapStats() { return thread_heap_stats; }
+
+AllocationStats ProcessHeapStats() {
+  return AllocationStats{
+      .allocations = process_allocations.load(std::memory_order_relaxed),
+      .bytes = process_bytes.load(std::memory_order_relaxed)};
+}
+
+int64_t PeakResidentBytes() {
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                            sizeof(counters))) {
+    return 0;
+  }
+
+  return static_cast<int64_t>(counters.PeakWorkingSetSize);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+
+#if defined(__APPLE__)
+  return static_cast<int64_t>(usage.ru_maxrss);
+#else
+  // Linux and the BSDs report it in KB.
+  return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void ScratchArena::AlignedDeleter::operator()(byte *ptr) const {
+  ::operator delete[](ptr, std::align_val_t(Image::kRowAlignment));
+}
+
+void *ScratchArena::Allocate(size_t bytes, size_t alignment) {
+  while (true) {
+    if (current_ < blocks_.size()) {
+      Block &block = blocks_[current_];
+      size_t offset = AlignUp(block.used, alignment);
+
+      if (offset + bytes <= block.size) {
+        block.used = offset + bytes;
+        return block.data.get() + offset;
+      }
+    }
+
+    // The blocks after the current one are empty, the last one is the
+    // biggest so far.
+    if (current_ + 1 < blocks_.size()) {
+      current_++;
+      continue;
+    }
+
+    size_t last = blocks_.empty() ? 0 : blocks_.back().size;
+    AddBlock(std::max({bytes, 2 * last, kMinBlockSize}));
+    current_ = blocks_.size() - 1;
+  }
+}
+
+Image ScratchArena::AllocateImage(int width, int height, PixelFormat format) {
+  size_t row_bytes =
+      AlignUp(static_cast<size_t>(width) * BytesPerPixel(format),
+              Image::kRowAlignment);
+  size_t total_bytes = row_bytes * height;
+
+  byte *pixels =
+      static_cast<byte *>(Allocate(total_bytes, Image::kRowAlignment));
+  memset(pixels, 0, total_bytes);
+
+  Image img = Image::Wrap(pixels, width, height,
+                          static_cast<ptrdiff_t>(row_bytes), format);
+
+  if (format == PixelFormat::kBGRA32) {
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        img.row(y)[4 * x + BGRA32::kAlphaByte] = 255;
+      }
+    }
+  }
+
+  return img;
+}
+
+size_t ScratchArena::capacity() const {
+  size_t total = 0;
+
+  for (const Block &block : blocks_) {
+    total += block.size;
+  }
+
+  return total;
+}
+
+void ScratchArena::AddBlock(size_t size) {
+  size = AlignUp(size, Image::kRowAlignment);
+
+  Block block;
+  block.data.reset(static_cast<byte *>(
+      ::operator new[](size, std::align_val_t(Image::kRowAlignment))));
+  block.size = size;
+
+  stats_.allocations++;
+  stats_.bytes += static_cast<int64_t>(size);
+  blocks_.push_back(std::move(block));
+}
+
+void ScratchArena::Release(size_t block, size_t used) {
+  if (blocks_.empty()) {
+    return;
+  }
+
+  for (size_t i = block + 1; i <= current_ && i < blocks_.size(); i++) {
+    blocks_[i].used = 0;
+  }
+  blocks_[block].used = used;
+  current_ = block;
+
+  if (open_scopes_ > 0 || blocks_.size() == 1) {
+    return;
+  }
+
+  // Nothing is in use now, so the blocks can be swapped by a single one that
+  // fits all the memory the work needed.
+  size_t total = capacity();
+  blocks_.clear();
+  AddBlock(total);
+  current_ = 0;
+}
+
+ScratchScope::ScratchScope(ScratchArena &arena) : arena_(arena) {
+  block_ = arena.current_;
+  used_ = block_ < arena.blocks_.size() ? arena.blocks_[block_].used : 0;
+  arena.open_scopes_++;
+}
+
+ScratchScope::~ScratchScope() {
+  arena_.open_scopes_--;
+  arena_.Release(block_, used_);
+}
+
+ProcessingContext &GetProcessingContext() {
+  thread_local ProcessingContext context;
+  return context;
+}
@@ -0,0 +1,135 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+#include "image.h"
+#include "libbmp.h"
+
+/// @brief Counters of the heap blocks asked by someone
+struct AllocationStats {
+  int64_t allocations = 0;
+  int64_t bytes = 0;
+};
+
+/// @brief The heap allocations made by the calling thread since it started,
+/// through any form of the global operator new.
+AllocationStats ThreadHeapStats();
+
+/// @brief The heap allocations made by every thread since the program
+/// started.
+AllocationStats ProcessHeapStats();
+
+/// @brief The largest resident set the process had so far, in bytes, or 0
+/// where the system does not tell.
+int64_t PeakResidentBytes();
+
+/// @brief A stack of scratch memory carved from a few big heap blocks.
+/// Memory is taken with @see Allocate and given back, in reverse order, by
+/// the @see ScratchScope that was open when it was taken. Once the outermost
+/// scope closes, the blocks are merged into a single one big enough for all
+/// of them, so repeating a workload keeps reusing that block instead of
+/// going to the heap.
+class ScratchArena {
+public:
+  ScratchArena() = default;
+
+  ScratchArena(const ScratchArena &) = delete;
+  ScratchArena &operator=(const ScratchArena &) = delete;
+
+  /// @brief @p bytes of uninitialized memory aligned to @p alignment , which
+  /// must be a power of two up to @see Image::kRowAlignment . Must be called
+  /// with a @see ScratchScope open.
+  void *Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  /// @brief @p count value initialized (that is zeroed, for plain structs)
+  /// objects of @p T . The destructors are never run.
+  template <typename T> T *Allocate(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+
+    T *objects = static_cast<T *>(Allocate(count * sizeof(T), alignof(T)));
+    std::uninitialized_value_construct_n(objects, count);
+
+    return objects;
+  }
+
+  /// @brief A zeroed @p width x @p height image of @p format viewing memory
+  /// of this arena (the alpha of BGRA32 images starts opaque, like the ones
+  /// of the @see Image constructor). The view is valid until the scope that
+  /// was open when it was taken closes.
+  Image AllocateImage(int width, int height,
+                      PixelFormat format = PixelFormat::kRGB24);
+
+  /// @brief The heap blocks this arena asked for so far.
+  const AllocationStats &stats() const { return stats_; }
+
+  /// @brief Bytes held by the arena, in use or not.
+  size_t capacity() const;
+
+private:
+  friend class ScratchScope;
+
+  struct AlignedDeleter {
+    void operator()(byte *ptr) const;
+  };
+
+  struct Block {
+    std::unique_ptr<byte[], AlignedDeleter> data;
+    size_t size = 0;
+    size_t used = 0;
+  };
+
+  void AddBlock(size_t size);
+
+  /// @brief Frees everything taken after the mark ( @p block , @p used ),
+  /// merging the blocks when the outermost scope closes.
+  void Release(size_t block, size_t used);
+
+  std::vector<Block> blocks_;
+  /// The block memory is taken from, the ones after it are empty.
+  size_t current_ = 0;
+  int open_scopes_ = 0;
+  AllocationStats stats_;
+};
+
+/// @brief Marks the top of an arena and gives back everything taken after
+/// the mark when destroyed.
+class ScratchScope {
+public:
+  explicit ScratchScope(ScratchArena &arena);
+  ~ScratchScope();
+
+  ScratchScope(const ScratchScope &) = delete;
+  ScratchScope &operator=(const ScratchScope &) = delete;
+
+  ScratchArena &arena() { return arena_; }
+
+private:
+  ScratchArena &arena_;
+  size_t block_ = 0;
+  size_t used_ = 0;
+};
+
+/// @brief The buffers one thread reuses from call to call: the arena the
+/// kernels take their tables and images from, and the libbmp image the
+/// loaded path reads files into.
+class ProcessingContext {
+public:
+  ScratchArena &arena() { return arena_; }
+  BmpImg &bmp() { return bmp_; }
+
+private:
+  ScratchArena arena_;
+  BmpImg bmp_;
+};
+
+/// @brief The context of the calling thread, created on its first use. Each
+/// worker of a batch run keeps its own, so once the first file is done the
+/// next ones of the same size find all their buffers in place.
+ProcessingContext &GetProcessingContext();
@@ -0,0 +1,210 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "profiler.h"
+
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int kStageCount = static_cast<int>(ProfileStage::kCount);
+
+struct ProfileEvent {
+  ProfileStage stage;
+  int64_t start_ns;
+  int64_t duration_ns;
+  int64_t pixels;
+  int64_t bytes;
+};
+
+/// @brief The scopes recorded by one thread, only ever touched by it while
+/// the work runs.
+struct ThreadProfile {
+  int id = 0;
+  /// The outermost scope open on the thread, see @see ProfileScope .
+  ProfileScope *open = nullptr;
+  std::vector<ProfileEvent> events;
+};
+
+bool profiling = false;
+Clock::time_point epoch;
+
+// Owned here so the events of the threads that already exited are kept.
+std::mutex profiles_mutex;
+std::vector<std::unique_ptr<ThreadProfile>> profiles;
+
+ThreadProfile &CurrentThreadProfile() {
+  thread_local ThreadProfile *profile = nullptr;
+
+  if (profile == nullptr) {
+    std::lock_guard lock(profiles_mutex);
+    profiles.push_back(std::make_unique<ThreadProfile>());
+    profile = profiles.back().get();
+    profile->id = static_cast<int>(profiles.size());
+  }
+
+  return *profile;
+}
+
+int64_t NanosecondsSinceEpoch() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                              epoch)
+      .count();
+}
+
+} // namespace
+
+const char *ProfileStageName(ProfileStage stage) {
+  switch (stage) {
+    using enum ProfileStage;
+
+  case kRead:
+    return "read";
+
+  case kHistogram:
+    return "histogram";
+
+  case kTable:
+    return "table";
+
+  case kApply:
+    return "apply";
+
+  case kRender:
+    return "render";
+
+  case kWrite:
+    return "write";
+
+  default:
+    return "unknown";
+  }
+}
+
+void SetProfiling(bool enabled) {
+  if (enabled && !profiling) {
+    epoch = Clock::now();
+  }
+
+  profiling = enabled;
+}
+
+bool IsProfiling() { return profiling; }
+
+void ProfileScope::Begin() {
+  ThreadProfile &profile = CurrentThreadProfile();
+  recording_ = true;
+
+  if (profile.open != nullptr) {
+    outer_ = profile.open;
+    return;
+  }
+
+  profile.open = this;
+  start_ns_ = NanosecondsSinceEpoch();
+}
+
+void ProfileScope::End() {
+  if (outer_ != nullptr) {
+    if (outer_->stage_ == stage_) {
+      outer_->Count(pixels_, bytes_);
+    }
+    return;
+  }
+
+  ThreadProfile &profile = CurrentThreadProfile();
+  profile.open = nullptr;
+  profile.events.push_back(ProfileEvent{stage_, start_ns_,
+                                        NanosecondsSinceEpoch() - start_ns_,
+                                        pixels_, bytes_});
+}
+
+void PrintProfile() {
+  struct Total {
+    int64_t calls = 0;
+    int64_t nanoseconds = 0;
+    int64_t pixels = 0;
+    int64_t bytes = 0;
+  };
+  Total totals[kStageCount];
+  int64_t all_nanoseconds = 0;
+
+  std::lock_guard lock(profiles_mutex);
+  for (const auto &profile : profiles) {
+    for (const ProfileEvent &event : profile->events) {
+      Total &total = totals[static_cast<int>(event.stage)];
+      total.calls++;
+      total.nanoseconds += event.duration_ns;
+      total.pixels += event.pixels;
+      total.bytes += event.bytes;
+      all_nanoseconds += event.duration_ns;
+    }
+  }
+
+  fmt::print("Profile on {} thread(s), {:.2f} ms in stages:\n",
+             profiles.size(), 1e-6 * all_nanoseconds);
+
+  for (int i = 0; i < kStageCount; i++) {
+    const Total &total = totals[i];
+    if (total.calls == 0) {
+      continue;
+    }
+
+    double seconds = 1e-9 * total.nanoseconds;
+    double share =
+        all_nanoseconds > 0 ? 100.0 * total.nanoseconds / all_nanoseconds : 0;
+
+    fmt::print("{:>9}: {:6} calls {:9.2f} ms {:5.1f}%",
+               ProfileStageName(static_cast<ProfileStage>(i)), total.calls,
+               1e3 * seconds, share);
+    if (total.pixels > 0 && seconds > 0.0) {
+      fmt::print(", {:.1f} MP/s", total.pixels / seconds / 1e6);
+    }
+    if (total.bytes > 0 && seconds > 0.0) {
+      fmt::print(", {:.1f} MB/s", total.bytes / seconds / 1e6);
+    }
+    fmt::print("\n");
+  }
+}
+
+bool WriteChromeTrace(const std::string &filename) {
+  std::string text;
+  auto out = std::back_inserter(text);
+
+  fmt::format_to(out, "{{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  std::lock_guard lock(profiles_mutex);
+  bool first = true;
+  for (const auto &profile : profiles) {
+    for (const ProfileEvent &event : profile->events) {
+      // Trace event times are microseconds.
+      fmt::format_to(out,
+                     "{}\n{{\"name\": \"{}\", \"cat\": \"stage\", \"ph\": "
+                     "\"X\", \"pid\": 1, \"tid\": {}, \"ts\": {:.3f}, "
+                     "\"dur\": {:.3f}, \"args\": {{\"pixels\": {}, "
+                     "\"bytes\": {}}}}}",
+                     first ? "" : ",", ProfileStageName(event.stage),
+                     profile->id, 1e-3 * event.start_ns,
+                     1e-3 * event.duration_ns, event.pixels, event.bytes);
+      first = false;
+    }
+  }
+  fmt::format_to(out, "\n]}}\n");
+
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+
+  bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+  return fclose(file) == 0 && written;
+}
@@ -0,0 +1,87 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/// @brief The steps a run is split in by the profile, see @see ProfileScope
+enum class ProfileStage {
+  /// Decoding the input file, whole or a band at a time
+  kRead = 0,
+  /// Counting the histogram of the pixels
+  kHistogram,
+  /// Building the tables of the commands: CDFs, thresholds and their
+  /// composition
+  kTable,
+  /// Applying the tables, or the commands that work on the pixels
+  kApply,
+  /// Rasterizing the histogram chart
+  kRender,
+  /// Encoding and writing the output file
+  kWrite,
+  kCount
+};
+
+/// @brief The name of @p stage on the reports, like "histogram".
+const char *ProfileStageName(ProfileStage stage);
+
+/// @brief Starts (or stops) recording every @see ProfileScope . Must be
+/// called before the work to be profiled starts.
+void SetProfiling(bool enabled);
+
+/// @brief Whether the scopes are being recorded.
+bool IsProfiling();
+
+/// @brief Records the time one @see ProfileStage took from its construction
+/// to its destruction, on the thread that created it. While profiling is off
+/// it only checks @see IsProfiling . Scopes inside another one of the same
+/// thread are not recorded, so the stages of a thread never overlap and their
+/// times add up; what they @see Count goes to the outer scope when both are
+/// of the same stage.
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileStage stage) : stage_(stage) {
+    if (IsProfiling()) {
+      Begin();
+    }
+  }
+
+  ~ProfileScope() {
+    if (recording_) {
+      End();
+    }
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+  /// @brief Adds @p pixels and @p bytes to what the stage handled.
+  void Count(int64_t pixels, int64_t bytes) {
+    pixels_ += pixels;
+    bytes_ += bytes;
+  }
+
+private:
+  void Begin();
+  void End();
+
+  ProfileStage stage_;
+  bool recording_ = false;
+  /// The outermost scope open on the thread when this one began, if any.
+  ProfileScope *outer_ = nullptr;
+  int64_t start_ns_ = 0;
+  int64_t pixels_ = 0;
+  int64_t bytes_ = 0;
+};
+
+/// @brief Prints, for every stage recorded since @see SetProfiling , how many
+/// times it ran, its total time and share and its pixel and byte throughput.
+void PrintProfile();
+
+/// @brief Writes every recorded scope as a Chrome trace event file (the JSON
+/// "traceEvents" format of chrome://tracing and Perfetto), one track per
+/// thread.
+/// @return false if @p filename could not be written
+bool WriteChromeTrace(const std::string &filename);
@@ -0,0 +1,141 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "raster.h"
+
+#include <string.h>
+
+#include "traversal.h"
+
+namespace {
+
+/// @brief The bytes of one interleaved pixel of @p img painted with
+/// @p color , opaque on BGRA images.
+void PixelPattern(const Image &img, const RGBColor &color, byte *pattern) {
+  const byte values[Image::kChannels] = {color.r, color.g, color.b};
+
+  if (img.format() == PixelFormat::kGray8) {
+    pattern[0] = Luma(color);
+    return;
+  }
+
+  pattern[BGRA32::kAlphaByte] = 255;
+  for (int c = 0; c < Image::kChannels; c++) {
+    pattern[img.channel_offset(c)] = values[c];
+  }
+}
+
+} // namespace
+
+void ClearImage(Image &img, const RGBColor &color) {
+  bool gray = color.r == color.g && color.g == color.b;
+
+  if (gray && img.layout() == PixelLayout::kPlanar) {
+    size_t row_bytes = static_cast<size_t>(img.width());
+
+    ForEachRow(img, [&](int y) {
+      for (int c = 0; c < Image::kChannels; c++) {
+        memset(img.channel_row(c, y), color.r, row_bytes);
+      }
+    });
+    return;
+  }
+
+  if (gray && img.format() != PixelFormat::kBGRA32) {
+    size_t row_bytes = static_cast<size_t>(img.width()) * img.pixel_step();
+    ForEachRow(img, [&](int y) { memset(img.row(y), color.r, row_bytes); });
+    return;
+  }
+
+  FillRectangle(img,
+                Rectangle{.x = 0,
+                          .y = 0,
+                          .width = img.width(),
+                          .height = img.height()},
+                color);
+}
+
+void FillHorizontalSpan(Image &img, int x, int y, int length,
+                        const RGBColor &color) {
+  const byte values[Image::kChannels] = {color.r, color.g, color.b};
+
+  if (length <= 0) {
+    return;
+  }
+
+  if (img.layout() == PixelLayout::kInterleaved) {
+    int step = img.pixel_step();
+    byte pattern[4];
+    PixelPattern(img, color, pattern);
+
+    byte *to = img.row(y) + x * step;
+    if (step == 1) {
+      memset(to, pattern[0], length);
+      return;
+    }
+
+    for (int i = 0; i < length; i++, to += step) {
+      for (int k = 0; k < step; k++) {
+        to[k] = pattern[k];
+      }
+    }
+    return;
+  }
+
+  for (int c = 0; c < Image::kChannels; c++) {
+    memset(img.channel_row(c, y) + x, values[c], length);
+  }
+}
+
+void FillVerticalSpan(Image &img, int x, int y, int length,
+                      const RGBColor &color) {
+  ptrdiff_t stride = img.stride();
+
+  if (length <= 0) {
+    return;
+  }
+
+  if (img.layout() == PixelLayout::kInterleaved) {
+    int step = img.pixel_step();
+    byte pattern[4];
+    PixelPattern(img, color, pattern);
+
+    byte *to = img.row(y) + x * step;
+    for (int i = 0; i < length; i++, to += stride) {
+      for (int k = 0; k < step; k++) {
+        to[k] = pattern[k];
+      }
+    }
+    return;
+  }
+
+  const byte values[Image::kChannels] = {color.r, color.g, color.b};
+  for (int c = 0; c < Image::kChannels; c++) {
+    byte *to = img.channel_row(c, y) + x;
+
+    for (int i = 0; i < length; i++) {
+      to[i * stride] = values[c];
+    }
+  }
+}
+
+void FillRectangle(Image &img, const Rectangle &rect, const RGBColor &color) {
+  ForEachRow(rect.y, rect.y + rect.height, [&](int y) {
+    FillHorizontalSpan(img, rect.x, y, rect.width, color);
+  });
+}
+
+void DrawRectangleOutline(Image &img, const Rectangle &rect,
+                          const RGBColor &color) {
+  if (rect.width <= 0 || rect.height <= 0) {
+    return;
+  }
+
+  int right = rect.x + rect.width - 1;
+  int bottom = rect.y + rect.height - 1;
+
+  FillHorizontalSpan(img, rect.x, rect.y, rect.width, color);
+  FillHorizontalSpan(img, rect.x, bottom, rect.width, color);
+  FillVerticalSpan(img, rect.x, rect.y, rect.height, color);
+  FillVerticalSpan(img, right, rect.y, rect.height, color);
+}
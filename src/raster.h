@@ -0,0 +1,37 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include "image.h"
+
+/// @brief Fills the whole @p img with @p color , one memset per plane row
+/// when the samples are all the same.
+/// @param img [out] The image to be cleared
+/// @param color The color of every pixel
+void ClearImage(Image &img, const RGBColor &color);
+
+/// @brief Fills @p length pixels of the row @p y starting at @p x .
+/// @param img [out] The image to be drawn
+/// @param x The first column of the span
+/// @param y The row of the span
+/// @param length The number of pixels, nothing is drawn if not positive
+/// @param color The color of the span
+void FillHorizontalSpan(Image &img, int x, int y, int length,
+                        const RGBColor &color);
+
+/// @brief Fills @p length pixels of the column @p x starting at @p y .
+/// @param img [out] The image to be drawn
+/// @param x The column of the span
+/// @param y The first row of the span
+/// @param length The number of pixels, nothing is drawn if not positive
+/// @param color The color of the span
+void FillVerticalSpan(Image &img, int x, int y, int length,
+                      const RGBColor &color);
+
+/// @brief Fills the area of @p rect on @p img with @p color .
+void FillRectangle(Image &img, const Rectangle &rect, const RGBColor &color);
+
+/// @brief Draws the one pixel wide border of @p rect on @p img .
+void DrawRectangleOutline(Image &img, const Rectangle &rect,
+                          const RGBColor &color);
@@ -0,0 +1,477 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "io_pipeline.h"
+#include "thread_pool.h"
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if !defined(_WIN32)
+
+using Clock = std::chrono::steady_clock;
+
+/// Latencies of the last requests kept for the report of @see RunServer .
+const size_t kLatencySamples = 1 << 16;
+/// How often the accept loop looks for a stop signal.
+const int kPollMilliseconds = 100;
+
+volatile sig_atomic_t stop_requested = 0;
+
+void RequestStop(int) { stop_requested = 1; }
+
+bool ReadAll(int fd, void *data, size_t size) {
+  byte *bytes = static_cast<byte *>(data);
+
+  while (size > 0) {
+    ssize_t read = recv(fd, bytes, size, 0);
+    if (read < 0 && errno == EINTR) {
+      continue;
+    }
+    if (read <= 0) {
+      return false;
+    }
+
+    bytes += read;
+    size -= static_cast<size_t>(read);
+  }
+
+  return true;
+}
+
+bool WriteAll(int fd, const void *data, size_t size) {
+  const byte *bytes = static_cast<const byte *>(data);
+
+  while (size > 0) {
+    ssize_t written = send(fd, bytes, size, 0);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+
+    bytes += written;
+    size -= static_cast<size_t>(written);
+  }
+
+  return true;
+}
+
+/// @brief A client socket, closed once its reader and its last request are
+/// done with it.
+struct Connection {
+  int fd = -1;
+  std::atomic<bool> done = false;
+
+  ~Connection() { close(fd); }
+};
+
+/// @brief A request on its way from the reader of its connection to the
+/// dispatcher.
+struct Request {
+  std::shared_ptr<Connection> connection;
+  Pipeline pipeline;
+  RunOptions options;
+  /// Set when the request was rejected before being processed.
+  BmpError error = BMP_OK;
+  std::vector<byte> input;
+  std::vector<byte> output;
+  Clock::time_point received;
+};
+
+/// @brief A thread reading the requests of one connection.
+struct Reader {
+  std::shared_ptr<Connection> connection;
+  std::thread thread;
+};
+
+class Server {
+public:
+  Server() : pending_(kServerQueueDepth) {}
+
+  bool Listen(const std::string &socket_path);
+
+  /// @brief Accepts connections until a stop is requested, then answers the
+  /// requests already received and returns.
+  void Run();
+
+private:
+  void ReadRequests(std::shared_ptr<Connection> connection);
+  bool ParseRequest(int fd, Request &request);
+  void Dispatch();
+  void Respond(Request &request);
+
+  std::vector<byte> TakeBuffer();
+  void GiveBuffer(std::vector<byte> buffer);
+
+  void PrintReport() const;
+
+  int listen_fd_ = -1;
+  std::string socket_path_;
+  BoundedQueue<Request> pending_;
+
+  std::mutex buffers_mutex_;
+  std::vector<std::vector<byte>> buffers_;
+
+  // Only touched by the dispatcher.
+  int64_t requests_ = 0;
+  int64_t failed_ = 0;
+  int64_t batches_ = 0;
+  std::vector<double> latencies_;
+};
+
+bool Server::Listen(const std::string &socket_path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    return false;
+  }
+
+  unlink(socket_path.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd_, SOMAXCONN) != 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    return false;
+  }
+
+  socket_path_ = socket_path;
+  return true;
+}
+
+void Server::Run() {
+  std::thread dispatcher([this] { Dispatch(); });
+  std::vector<Reader> readers;
+
+  while (!stop_requested) {
+    pollfd listening = {listen_fd_, POLLIN, 0};
+
+    if (poll(&listening, 1, kPollMilliseconds) > 0) {
+      int fd = accept(listen_fd_, nullptr, nullptr);
+
+      if (fd >= 0) {
+        auto connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        readers.push_back(Reader{
+            connection, std::thread([this, connection] {
+              ReadRequests(connection);
+            })});
+      }
+    }
+
+    // Joins the readers of the connections the clients closed.
+    for (size_t i = 0; i < readers.size();) {
+      if (!readers[i].connection->done) {
+        i++;
+        continue;
+      }
+
+      readers[i].thread.join();
+      readers[i] = std::move(readers.back());
+      readers.pop_back();
+    }
+  }
+
+  close(listen_fd_);
+  unlink(socket_path_.c_str());
+
+  // The readers stop at their next read, the requests they queued are still
+  // answered.
+  for (Reader &reader : readers) {
+    shutdown(reader.connection->fd, SHUT_RD);
+    reader.thread.join();
+  }
+
+  pending_.Close();
+  dispatcher.join();
+
+  PrintReport();
+}
+
+void Server::ReadRequests(std::shared_ptr<Connection> connection) {
+  double blocked = 0.0;
+
+  while (true) {
+    Request request;
+    if (!ParseRequest(connection->fd, request)) {
+      break;
+    }
+
+    request.connection = connection;
+    pending_.Push(std::move(request), blocked);
+  }
+
+  connection->done = true;
+}
+
+bool Server::ParseRequest(int fd, Request &request) {
+  ServerRequestHeader header;
+  if (!ReadAll(fd, &header, sizeof(header))) {
+    return false;
+  }
+
+  // A broken stream can not be resynchronized, so the connection is dropped.
+  if (header.magic != kServerRequestMagic ||
+      header.method_size > kMaxServerMethodSize ||
+      header.image_size > kMaxServerImageSize) {
+    return false;
+  }
+
+  std::string methods(header.method_size, '\0');
+  request.input = TakeBuffer();
+  request.output = TakeBuffer();
+  request.input.resize(static_cast<size_t>(header.image_size));
+
+  if (!ReadAll(fd, methods.data(), methods.size()) ||
+      !ReadAll(fd, request.input.data(), request.input.size())) {
+    GiveBuffer(std::move(request.input));
+    GiveBuffer(std::move(request.output));
+    return false;
+  }
+
+  request.received = Clock::now();
+  request.options.pack_bilevel = (header.flags & kServerPackBilevel) != 0;
+  request.options.histogram_format =
+      static_cast<HistogramFormat>(header.histogram_format);
+
+  bool valid = PipelineByMethods(methods, request.pipeline) &&
+               header.histogram_format <=
+                   static_cast<uint32_t>(HistogramFormat::kBinary);
+  if (valid && request.options.histogram_format != HistogramFormat::kImage) {
+    valid = request.pipeline.back() == Command::kHistogram ||
+            request.pipeline.back() == Command::kComponents;
+  }
+
+  if (!valid) {
+    request.error = BMP_ERROR;
+  }
+
+  return true;
+}
+
+void Server::Dispatch() {
+  ThreadPool &pool = GetThreadPool();
+  std::vector<Request> batch;
+  batch.reserve(pool.size());
+
+  Request request;
+  double starved = 0.0;
+
+  while (pending_.Pop(request, starved)) {
+    // Takes whatever else arrived meanwhile, so a busy server runs one
+    // request per worker instead of splitting each one among them.
+    batch.push_back(std::move(request));
+    while (static_cast<int>(batch.size()) < pool.size() &&
+           pending_.TryPop(request)) {
+      batch.push_back(std::move(request));
+    }
+
+    pool.ParallelFor(static_cast<int>(batch.size()), [&](int i) {
+      Request &job = batch[i];
+      if (job.error == BMP_OK) {
+        job.error = RunCommandInMemory(job.pipeline, job.input, job.output,
+                                       ImageFileType::kBmp, job.options);
+      }
+    });
+
+    for (Request &job : batch) {
+      Respond(job);
+    }
+
+    batches_++;
+    batch.clear();
+  }
+}
+
+void Server::Respond(Request &request) {
+  ServerResponseHeader header;
+  header.status = request.error;
+  header.size = request.error == BMP_OK ? request.output.size() : 0;
+
+  // A client that went away only loses its own responses.
+  int fd = request.connection->fd;
+  if (WriteAll(fd, &header, sizeof(header))) {
+    WriteAll(fd, request.output.data(), static_cast<size_t>(header.size));
+  }
+
+  double latency =
+      std::chrono::duration<double>(Clock::now() - request.received).count();
+  if (latencies_.size() < kLatencySamples) {
+    latencies_.push_back(latency);
+  } else {
+    latencies_[requests_ % kLatencySamples] = latency;
+  }
+
+  requests_++;
+  failed_ += request.error != BMP_OK;
+
+  GiveBuffer(std::move(request.input));
+  GiveBuffer(std::move(request.output));
+  request.connection.reset();
+}
+
+std::vector<byte> Server::TakeBuffer() {
+  std::lock_guard lock(buffers_mutex_);
+  if (buffers_.empty()) {
+    return {};
+  }
+
+  std::vector<byte> buffer = std::move(buffers_.back());
+  buffers_.pop_back();
+  buffer.clear();
+  return buffer;
+}
+
+void Server::GiveBuffer(std::vector<byte> buffer) {
+  std::lock_guard lock(buffers_mutex_);
+
+  // Enough for every request that can be in flight at once.
+  if (buffers_.size() < 2 * kServerQueueDepth) {
+    buffers_.push_back(std::move(buffer));
+  }
+}
+
+void Server::PrintReport() const {
+  fmt::print("{} requests ({} failed) in {} batches\n", requests_, failed_,
+             batches_);
+  PrintLatencyPercentiles(latencies_);
+}
+
+#endif
+
+} // namespace
+
+void PrintLatencyPercentiles(std::vector<double> seconds) {
+  if (seconds.empty()) {
+    return;
+  }
+
+  std::sort(seconds.begin(), seconds.end());
+  auto percentile = [&](double p) {
+    size_t index = static_cast<size_t>(p * (seconds.size() - 1) + 0.5);
+    return 1e3 * seconds[index];
+  };
+
+  fmt::print("latency: p50 {:.2f} ms, p90 {:.2f} ms, p99 {:.2f} ms, max "
+             "{:.2f} ms over {} requests\n",
+             percentile(0.5), percentile(0.9), percentile(0.99),
+             1e3 * seconds.back(), seconds.size());
+}
+
+#if defined(_WIN32)
+
+bool RunServer(const std::string &) {
+  fmt::print("The server mode needs unix domain sockets\n");
+  return false;
+}
+
+ServerClient::~ServerClient() {}
+
+bool ServerClient::Connect(const std::string &) { return false; }
+
+BmpError ServerClient::Process(const std::string &, const std::vector<byte> &,
+                               const RunOptions &, std::vector<byte> &) {
+  return BMP_ERROR;
+}
+
+#else
+
+bool RunServer(const std::string &socket_path) {
+  Server server;
+  if (!server.Listen(socket_path)) {
+    return false;
+  }
+
+  struct sigaction action = {};
+  action.sa_handler = RequestStop;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  fmt::print("Serving on {} with {} workers\n", socket_path,
+             GetThreadPool().size());
+  server.Run();
+
+  return true;
+}
+
+ServerClient::~ServerClient() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+bool ServerClient::Connect(const std::string &socket_path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    return false;
+  }
+
+  return connect(fd_, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)) == 0;
+}
+
+BmpError ServerClient::Process(const std::string &methods,
+                               const std::vector<byte> &input,
+                               const RunOptions &options,
+                               std::vector<byte> &output) {
+  ServerRequestHeader request;
+  request.flags = options.pack_bilevel ? kServerPackBilevel : 0;
+  request.histogram_format =
+      static_cast<uint32_t>(options.histogram_format);
+  request.method_size = static_cast<uint32_t>(methods.size());
+  request.image_size = input.size();
+
+  ServerResponseHeader response;
+  bool sent = WriteAll(fd_, &request, sizeof(request)) &&
+              WriteAll(fd_, methods.data(), methods.size()) &&
+              WriteAll(fd_, input.data(), input.size());
+  if (!sent || !ReadAll(fd_, &response, sizeof(response)) ||
+      response.magic != kServerResponseMagic) {
+    return BMP_ERROR;
+  }
+
+  output.resize(static_cast<size_t>(response.size));
+  if (!ReadAll(fd_, output.data(), output.size())) {
+    return BMP_ERROR;
+  }
+
+  return static_cast<BmpError>(response.status);
+}
+
+#endif
@@ -0,0 +1,91 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "commands.h"
+
+/// The first field of every request, "PDRQ" on little endian machines.
+const uint32_t kServerRequestMagic = 0x51524450;
+/// The first field of every response, "PDRS" on little endian machines.
+const uint32_t kServerResponseMagic = 0x53524450;
+
+/// Longest method chain a request may name.
+const uint32_t kMaxServerMethodSize = 1024;
+/// Biggest image a request may carry.
+const uint64_t kMaxServerImageSize = uint64_t(1) << 32;
+
+/// Requests received but not processed yet before the readers wait.
+const int kServerQueueDepth = 64;
+
+/// @brief Set on @see ServerRequestHeader::flags to write bilevel results
+/// packed, see @see RunOptions::pack_bilevel
+const uint32_t kServerPackBilevel = 1;
+
+/// @brief Starts every request sent to @see RunServer , in the byte order of
+/// the machine (both ends run on the same one). It is followed by the
+/// @see method_size characters of the method chain, like the --method of
+/// the command line, and the @see image_size bytes of the BMP file.
+struct ServerRequestHeader {
+  uint32_t magic = kServerRequestMagic;
+  uint32_t flags = 0;
+  /// A @see HistogramFormat
+  uint32_t histogram_format = 0;
+  uint32_t method_size = 0;
+  uint64_t image_size = 0;
+};
+
+/// @brief Starts every response, followed by the @see size bytes of the
+/// result: the BMP file or the encoded histogram a file run would write.
+struct ServerResponseHeader {
+  uint32_t magic = kServerResponseMagic;
+  /// BMP_OK or the @see BmpError of the request, with no bytes after it.
+  int32_t status = 0;
+  uint64_t size = 0;
+};
+
+/// @brief Serves requests on the local socket @p socket_path until SIGINT or
+/// SIGTERM. Every connection may send any number of requests, answered in
+/// order. The requests waiting when the pool gets free are processed
+/// together as a batch, one per worker of @see GetThreadPool , so the pool,
+/// the scratch arenas of its workers and the request buffers stay warm from
+/// one request to the next. Prints the latency of the requests at the end.
+/// The files are processed in memory, see @see RunCommandInMemory .
+/// @param socket_path The path of the socket, replaced if it exists
+/// @return false if the socket could not be created
+bool RunServer(const std::string &socket_path);
+
+/// @brief Prints the median, the 90th and 99th percentiles and the maximum of
+/// @p seconds , the latencies of some requests.
+void PrintLatencyPercentiles(std::vector<double> seconds);
+
+/// @brief A connection to a @see RunServer , sending one request at a time.
+class ServerClient {
+public:
+  ServerClient() = default;
+  ~ServerClient();
+
+  ServerClient(const ServerClient &) = delete;
+  ServerClient &operator=(const ServerClient &) = delete;
+
+  /// @brief Connects to the server listening on @p socket_path .
+  /// @return false if it could not connect
+  bool Connect(const std::string &socket_path);
+
+  /// @brief Sends a request and waits for its response.
+  /// @param methods The method chain, like the --method of the command line
+  /// @param input The bytes of the BMP file
+  /// @param options Only @see RunOptions::histogram_format and
+  /// @see RunOptions::pack_bilevel are sent, the server sets the rest
+  /// @param output [out] Receives the bytes of the result
+  /// @return The status of the response, BMP_ERROR if the connection failed
+  BmpError Process(const std::string &methods, const std::vector<byte> &input,
+                   const RunOptions &options, std::vector<byte> &output);
+
+private:
+  int fd_ = -1;
+};
@@ -0,0 +1,295 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "streaming.h"
+
+#include <string.h>
+#include <thread>
+
+#include "profiler.h"
+
+namespace {
+
+/// Bands in flight on a staged pass: enough for both queues to be full while
+/// the compute stage holds one more.
+const int kStagedBands = 2 * kDefaultQueueDepth + 1;
+
+/// @brief Adds the histogram of @p band , whose first row is the row
+/// @p first_row of the file @p info , to @p histogram , profiled as
+/// @see ProfileStage::kHistogram . With a @see GetHistogramSampleStep only
+/// the samples of the band are counted, see @see AccumulateSampledHistogram .
+/// @return The number of pixels counted
+int64_t AccumulateBand(Image &band, int first_row, const BmpInfo &info,
+                       RGBHistogram &histogram) {
+  ProfileScope profile(ProfileStage::kHistogram);
+  int64_t pixels = static_cast<int64_t>(band.width()) * band.height();
+  profile.Count(pixels, 0);
+
+  int step = GetHistogramSampleStep();
+  if (step > 1 && info.bottom_up) {
+    // Sampled on the rows of the image, not of the file, so the estimate is
+    // the same as the one of the whole image.
+    Image view = Image::Wrap(band.row(band.height() - 1), band.width(),
+                             band.height(), -band.stride(), band.format());
+    return AccumulateSampledHistogram(
+        view, info.height - first_row - band.height(), step, histogram);
+  }
+
+  if (step > 1) {
+    return AccumulateSampledHistogram(band, first_row, step, histogram);
+  }
+
+  AccumulateHistogram(band, 0, band.height(), histogram);
+  return pixels;
+}
+
+/// @brief @see ApplyChannelLUT on @p band , profiled as
+/// @see ProfileStage::kApply
+void ApplyBand(Image &band, const LUT3 &lut) {
+  ProfileScope profile(ProfileStage::kApply);
+  profile.Count(static_cast<int64_t>(band.width()) * band.height(), 0);
+
+  ApplyChannelLUT(band, lut);
+}
+
+/// @brief Reads the bands of a file on a thread of its own, ahead of the
+/// stage consuming them. The consumer gives every band back through
+/// @see Recycle , so the reader keeps refilling the same images.
+class BandReadStage {
+public:
+  BandReadStage(BmpBandReader &reader, int band_rows, StageStats &stats)
+      : reader_(reader), band_rows_(band_rows), stats_(stats),
+        free_(kStagedBands) {
+    double unused = 0.0;
+    for (int i = 0; i < kStagedBands; i++) {
+      free_.Push(Image(), unused);
+    }
+
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  ~BandReadStage() { Finish(); }
+
+  /// @brief Takes the next band read, waiting for it.
+  /// @return false once every band was taken, or the read failed
+  bool Next(Image &band, double &starved) { return full_.Pop(band, starved); }
+
+  /// @brief Gives @p band back to be read into again. Never blocks.
+  void Recycle(Image band) {
+    double unused = 0.0;
+    free_.Push(std::move(band), unused);
+  }
+
+  /// @brief Waits for the reader thread.
+  /// @return BMP_OK, or BMP_INVALID_FILE if a band could not be read
+  BmpError Finish() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+
+    return error_;
+  }
+
+private:
+  void Run() {
+    StageClock clock;
+
+    while (reader_.remaining_rows() > 0) {
+      Image band;
+      // Waiting for a free band means the stages after this one are behind.
+      free_.Pop(band, stats_.blocked_seconds);
+
+      clock.Lap();
+      if (reader_.ReadBand(band, band_rows_) == 0) {
+        error_ = BMP_INVALID_FILE;
+        break;
+      }
+      stats_.busy_seconds += clock.Lap();
+      stats_.items++;
+
+      full_.Push(std::move(band), stats_.blocked_seconds);
+    }
+
+    full_.Close();
+  }
+
+  BmpBandReader &reader_;
+  int band_rows_;
+  StageStats &stats_;
+  BmpError error_ = BMP_OK;
+  BoundedQueue<Image> free_;
+  BoundedQueue<Image> full_;
+  std::thread thread_;
+};
+
+/// @brief Writes bands on a thread of its own and hands them back to the
+/// @see BandReadStage they came from.
+class BandWriteStage {
+public:
+  BandWriteStage(BmpBandWriter &writer, BandReadStage &source,
+                 StageStats &stats)
+      : writer_(writer), source_(source), stats_(stats) {
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  ~BandWriteStage() { Finish(); }
+
+  /// @brief Queues @p band to be written, waiting for room first.
+  void Push(Image band, double &blocked) {
+    queue_.Push(std::move(band), blocked);
+  }
+
+  /// @brief Writes what is queued and waits for the writer thread.
+  /// @return BMP_OK or the first write error
+  BmpError Finish() {
+    if (thread_.joinable()) {
+      queue_.Close();
+      thread_.join();
+    }
+
+    return error_;
+  }
+
+private:
+  void Run() {
+    StageClock clock;
+    Image band;
+
+    while (queue_.Pop(band, stats_.starved_seconds)) {
+      clock.Lap();
+      // After an error the bands are only drained, so no stage is left
+      // waiting on this one.
+      if (error_ == BMP_OK) {
+        error_ = writer_.WriteBand(band);
+        stats_.busy_seconds += clock.Lap();
+        stats_.items++;
+      }
+
+      source_.Recycle(std::move(band));
+    }
+  }
+
+  BmpBandWriter &writer_;
+  BandReadStage &source_;
+  StageStats &stats_;
+  BmpError error_ = BMP_OK;
+  BoundedQueue<Image> queue_;
+  std::thread thread_;
+};
+
+} // namespace
+
+BmpError StreamHistogram(const std::string &filename, int band_rows,
+                         RGBHistogram &histogram, PipelineStats *stats) {
+  memset(&histogram, 0, sizeof(RGBHistogram));
+
+  BmpBandReader reader;
+  BmpError error = reader.Open(filename);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  const int64_t pixels =
+      static_cast<int64_t>(reader.info().width) * reader.info().height;
+  int64_t counted = 0;
+  int first_row = 0;
+
+  Image band;
+  if (stats == nullptr) {
+    while (reader.remaining_rows() > 0) {
+      if (reader.ReadBand(band, band_rows) == 0) {
+        return BMP_INVALID_FILE;
+      }
+
+      counted += AccumulateBand(band, first_row, reader.info(), histogram);
+      first_row += band.height();
+    }
+
+    ScaleHistogram(histogram, counted, pixels);
+    return BMP_OK;
+  }
+
+  StageClock wall;
+  StageClock clock;
+  BandReadStage read(reader, band_rows, stats->read);
+
+  while (read.Next(band, stats->compute.starved_seconds)) {
+    clock.Lap();
+    counted += AccumulateBand(band, first_row, reader.info(), histogram);
+    first_row += band.height();
+    stats->compute.busy_seconds += clock.Lap();
+    stats->compute.items++;
+
+    read.Recycle(std::move(band));
+  }
+
+  error = read.Finish();
+  stats->wall_seconds += wall.Lap();
+
+  ScaleHistogram(histogram, counted, pixels);
+  return error;
+}
+
+BmpError StreamApplyLUT(const std::string &input, const std::string &output,
+                        const LUT3 &lut, int band_rows, bool pack_bilevel,
+                        PipelineStats *stats) {
+  BmpBandReader reader;
+  BmpError error = reader.Open(input);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  const BmpInfo &info = reader.info();
+  PixelFormat format = FormatOf(info);
+  BilevelPacking packing = BilevelPacking::kNone;
+  if (pack_bilevel && IsBilevelLUT(lut)) {
+    packing = format == PixelFormat::kGray8    ? BilevelPacking::k1bpp
+              : format == PixelFormat::kRGB24 ? BilevelPacking::k4bpp
+                                              : BilevelPacking::kNone;
+  }
+
+  BmpBandWriter writer;
+  error = writer.Open(output, info.width, info.height, info.bottom_up, format,
+                      packing);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  Image band;
+  if (stats == nullptr) {
+    while (reader.remaining_rows() > 0) {
+      if (reader.ReadBand(band, band_rows) == 0) {
+        return BMP_INVALID_FILE;
+      }
+
+      ApplyBand(band, lut);
+
+      error = writer.WriteBand(band);
+      if (error != BMP_OK) {
+        return error;
+      }
+    }
+
+    return BMP_OK;
+  }
+
+  StageClock wall;
+  StageClock clock;
+  BandReadStage read(reader, band_rows, stats->read);
+  BandWriteStage write(writer, read, stats->write);
+
+  while (read.Next(band, stats->compute.starved_seconds)) {
+    clock.Lap();
+    ApplyBand(band, lut);
+    stats->compute.busy_seconds += clock.Lap();
+    stats->compute.items++;
+
+    write.Push(std::move(band), stats->compute.blocked_seconds);
+  }
+
+  BmpError read_error = read.Finish();
+  BmpError write_error = write.Finish();
+  stats->wall_seconds += wall.Lap();
+
+  return read_error != BMP_OK ? read_error : write_error;
+}
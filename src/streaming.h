@@ -0,0 +1,47 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <string>
+
+#include "bmp_io.h"
+#include "histogram.h"
+#include "io_pipeline.h"
+#include "lut.h"
+
+/// Default height of the bands read by the streaming mode.
+const int kDefaultBandRows = 256;
+
+/// @brief Builds the histogram of the BMP @p filename reading @p band_rows
+/// rows at a time, so only one band is ever in memory.
+/// @param filename The BMP to be read
+/// @param band_rows The height of each band
+/// @param histogram [out] The histogram of the whole file, estimated from
+/// the samples of the bands with a @see GetHistogramSampleStep
+/// @param stats When given, the bands are read on a thread of their own while
+/// the previous ones are counted, and the time of both stages is added to it
+/// @return BMP_OK or the error found reading the file
+BmpError StreamHistogram(const std::string &filename, int band_rows,
+                         RGBHistogram &histogram,
+                         PipelineStats *stats = nullptr);
+
+/// @brief Applies @p lut to the BMP @p input and writes the result to
+/// @p output , @p band_rows rows at a time. Peak memory is one band, or a
+/// few with @p stats .
+/// @param input The BMP to be read
+/// @param output The BMP to be written
+/// @param lut The tables to be applied on each band
+/// @param band_rows The height of each band
+/// @param pack_bilevel Write a 1bpp file (4bpp for RGB ones) when every entry
+/// of @p lut is 0 or 255, see @see BilevelPacking . The bands are not seen
+/// before they are written, so RGB files are never reduced to 1bpp.
+/// @param stats When given, reading, applying and writing run as three
+/// stages, on a reader thread, the calling thread and a writer thread, with
+/// bounded queues of bands between them. The time of each stage is added to
+/// it.
+/// @return BMP_OK or the first error found
+BmpError StreamApplyLUT(const std::string &input, const std::string &output,
+                        const LUT3 &lut, int band_rows,
+                        bool pack_bilevel = false,
+                        PipelineStats *stats = nullptr);
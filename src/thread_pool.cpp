@@ -0,0 +1,113 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+int thread_count = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(int threads) {
+  for (int i = 1; i < threads; i++) {
+    workers_.emplace_back([this] { WorkerLoop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_ready_.notify_all();
+
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(int count, FunctionRef<void(int)> fn) {
+  if (count <= 0) {
+    return;
+  }
+
+  if (count == 1 || workers_.empty()) {
+    for (int i = 0; i < count; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  int pending = count;
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  for (int i = 0; i < count; i++) {
+    tasks_.push_back(Task{.fn = fn, .index = i, .pending = &pending});
+  }
+  task_ready_.notify_all();
+
+  while (pending > 0) {
+    if (!RunPendingTask(lock, &pending)) {
+      task_done_.wait(lock);
+    }
+  }
+}
+
+bool ThreadPool::RunPendingTask(std::unique_lock<std::mutex> &lock,
+                                const int *owner) {
+  auto task = tasks_.begin();
+  if (owner != nullptr) {
+    task = std::find_if(tasks_.begin(), tasks_.end(), [owner](const Task &t) {
+      return t.pending == owner;
+    });
+  }
+
+  if (task == tasks_.end()) {
+    return false;
+  }
+
+  Task run = *task;
+  tasks_.erase(task);
+
+  lock.unlock();
+  run.fn(run.index);
+  lock.lock();
+
+  if (--*run.pending == 0) {
+    task_done_.notify_all();
+  }
+
+  return true;
+}
+
+void ThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  while (true) {
+    task_ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+
+    if (stopping_ && tasks_.empty()) {
+      return;
+    }
+
+    RunPendingTask(lock, nullptr);
+  }
+}
+
+void SetThreadCount(int threads) { thread_count = std::max(threads, 0); }
+
+int GetThreadCount() {
+  if (thread_count > 0) {
+    return thread_count;
+  }
+
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+ThreadPool &GetThreadPool() {
+  static ThreadPool pool(GetThreadCount());
+  return pool;
+}
@@ -0,0 +1,62 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "function_ref.h"
+
+/// @brief A fixed set of worker threads consuming a shared task queue.
+class ThreadPool {
+public:
+  /// @brief Creates a pool with @p threads workers. The thread calling
+  /// @see ParallelFor also runs tasks, so a pool of 1 spawns no thread.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /// @brief The number of threads that run tasks, the caller included.
+  int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+  /// @brief Calls @p fn for every index in [0, @p count ) spread on the
+  /// workers and returns when all of them finished. While waiting, the caller
+  /// only runs tasks of this same call, so it is safe (and does not delay the
+  /// caller) to call it from inside a task. Queuing the tasks does not
+  /// allocate once the queue has grown to the largest @p count seen.
+  void ParallelFor(int count, FunctionRef<void(int)> fn);
+
+private:
+  struct Task {
+    FunctionRef<void(int)> fn;
+    int index;
+    /// The tasks of the @see ParallelFor call that queued this one still
+    /// running, which also identifies the call.
+    int *pending;
+  };
+
+  void WorkerLoop();
+  bool RunPendingTask(std::unique_lock<std::mutex> &lock, const int *owner);
+
+  std::vector<std::thread> workers_;
+  std::vector<Task> tasks_;
+  std::mutex mutex_;
+  std::condition_variable task_ready_;
+  std::condition_variable task_done_;
+  bool stopping_ = false;
+};
+
+/// @brief Sets how many threads the kernels may use. 0 means one per
+/// hardware thread. Must be called before the first @see GetThreadPool .
+void SetThreadCount(int threads);
+
+/// @brief The number of threads the kernels may use.
+int GetThreadCount();
+
+/// @brief The pool shared by all kernels, sized by @see SetThreadCount .
+ThreadPool &GetThreadPool();
@@ -0,0 +1,117 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "threshold.h"
+
+#include <algorithm>
+
+ThresholdEngine::ThresholdEngine(const uint64_t *bins) {
+  counts_[0] = 0;
+  moments_[0] = 0;
+
+  for (int i = 0; i < 256; i++) {
+    int64_t count = static_cast<int64_t>(bins[i]);
+    counts_[i + 1] = counts_[i] + count;
+    moments_[i + 1] = moments_[i] + i * count;
+  }
+}
+
+byte ThresholdEngine::TwoPeaks() const {
+  int first_peak = 0;
+  for (int i = 1; i < 256; i++) {
+    if (count(i, i + 1) > count(first_peak, first_peak + 1)) {
+      first_peak = i;
+    }
+  }
+
+  int second_peak = 0;
+  int64_t best_distance = -1;
+  for (int i = 0; i < 256; i++) {
+    int64_t distance = i - first_peak;
+    int64_t sparse_distance = distance * distance * count(i, i + 1);
+
+    if (sparse_distance > best_distance) {
+      best_distance = sparse_distance;
+      second_peak = i;
+    }
+  }
+
+  return static_cast<byte>((first_peak + second_peak) >> 1);
+}
+
+byte ThresholdEngine::Otsu() const {
+  int64_t total = count(0, 256);
+  int64_t total_moment = moment(0, 256);
+  double best_variance = -1.0;
+  int cut = 0;
+
+  // The samples below t form the dark class.
+  for (int t = 1; t < 256; t++) {
+    int64_t low = count(0, t);
+    int64_t high = total - low;
+    if (low == 0 || high == 0) {
+      continue;
+    }
+
+    double low_moment = static_cast<double>(moment(0, t));
+    double mean_gap = low_moment / low - (total_moment - low_moment) / high;
+    double variance = static_cast<double>(low) * high * mean_gap * mean_gap;
+
+    if (variance > best_variance) {
+      best_variance = variance;
+      cut = t;
+    }
+  }
+
+  return static_cast<byte>(cut);
+}
+
+void ThresholdEngine::MultiOtsu(int classes, byte *cuts) const {
+  classes = std::clamp(classes, 2, kMaxThresholdClasses);
+
+  // The between-class variance of a split only depends on the sum of
+  // moment^2 / count of its classes, so best[k][j] is the largest sum for
+  // the values [0, j) split in k + 1 classes and start[k][j] is where the
+  // last of them begins.
+  double best[kMaxThresholdClasses][257];
+  int start[kMaxThresholdClasses][257];
+
+  auto score = [this](int begin, int end) {
+    int64_t samples = count(begin, end);
+    if (samples == 0) {
+      return 0.0;
+    }
+
+    double sum = static_cast<double>(moment(begin, end));
+    return sum * sum / samples;
+  };
+
+  for (int j = 0; j <= 256; j++) {
+    best[0][j] = score(0, j);
+    start[0][j] = 0;
+  }
+
+  for (int k = 1; k < classes; k++) {
+    // The last class always ends at 256, so its row needs a single entry.
+    int first = k == classes - 1 ? 256 : 0;
+
+    for (int j = first; j <= 256; j++) {
+      best[k][j] = -1.0;
+      start[k][j] = j;
+
+      for (int i = k; i <= j; i++) {
+        double value = best[k - 1][i] + score(i, j);
+        if (value > best[k][j]) {
+          best[k][j] = value;
+          start[k][j] = i;
+        }
+      }
+    }
+  }
+
+  int end = 256;
+  for (int k = classes - 1; k > 0; k--) {
+    end = start[k][end];
+    cuts[k - 1] = static_cast<byte>(std::min(end, 255));
+  }
+}
@@ -0,0 +1,55 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+
+#include "image.h"
+
+/// Most classes @see ThresholdEngine::MultiOtsu splits a channel in.
+const int kMaxThresholdClasses = 4;
+
+/// @brief Picks cut points for a channel from its histogram alone. The prefix
+/// sums of the counts and of the first moments are built once, so the count
+/// and the mean of any range of values cost O(1) and every rule runs in
+/// O(256) (O(256^2) per class for @see MultiOtsu ) without a pixel pass.
+class ThresholdEngine {
+public:
+  /// @param bins The 256 counts of the channel
+  explicit ThresholdEngine(const uint64_t *bins);
+
+  /// @brief Samples with a value in [ @p begin , @p end ).
+  int64_t count(int begin, int end) const {
+    return counts_[end] - counts_[begin];
+  }
+
+  /// @brief Sum of the values of the samples in [ @p begin , @p end ).
+  int64_t moment(int begin, int end) const {
+    return moments_[end] - moments_[begin];
+  }
+
+  /// @brief The Two Peaks cut point: halfway between the highest bin and
+  /// the bin that maximizes its count times its squared distance to the
+  /// first one.
+  byte TwoPeaks() const;
+
+  /// @brief The cut point that splits the samples in the two classes with
+  /// the largest between-class variance (Otsu's method). Samples below it
+  /// belong to the dark class.
+  byte Otsu() const;
+
+  /// @brief Otsu's method for @p classes classes: the cut points that
+  /// maximize the between-class variance, found by dynamic programming over
+  /// the prefix sums.
+  /// @param classes The number of classes, from 2 to
+  /// @see kMaxThresholdClasses
+  /// @param cuts [out] Receives the @p classes - 1 cut points, increasing.
+  /// The class k holds the values in [ cuts[k - 1] , cuts[k] ).
+  void MultiOtsu(int classes, byte *cuts) const;
+
+private:
+  /// The sums over the values [0, i).
+  int64_t counts_[257];
+  int64_t moments_[257];
+};
@@ -0,0 +1,101 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "tile_scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "processing_context.h"
+#include "thread_pool.h"
+#include "traversal.h"
+
+namespace {
+
+TileSchedule tile_schedule = TileSchedule::kWorkStealing;
+
+/// @brief The tiles [next, end) of a band not claimed yet. Each band sits on
+/// its own cache line so claiming tiles does not bounce the other cursors.
+struct alignas(64) TileBand {
+  std::atomic<int> next;
+  int end;
+};
+
+Rectangle TileAt(const Rectangle &area, int tile_width, int tile_height,
+                 int columns, int index) {
+  int x = area.x + (index % columns) * tile_width;
+  int y = area.y + (index / columns) * tile_height;
+
+  return Rectangle{.x = x,
+                   .y = y,
+                   .width = std::min(tile_width, area.x + area.width - x),
+                   .height = std::min(tile_height, area.y + area.height - y)};
+}
+
+} // namespace
+
+void SetTileSchedule(TileSchedule schedule) { tile_schedule = schedule; }
+
+TileSchedule GetTileSchedule() { return tile_schedule; }
+
+void ParallelForEachTile(const Rectangle &area, int tile_width,
+                         int tile_height,
+                         FunctionRef<void(const Rectangle &)> fn) {
+  if (area.width <= 0 || area.height <= 0) {
+    return;
+  }
+
+  tile_width = std::max(tile_width, 1);
+  tile_height = std::max(tile_height, 1);
+
+  int columns = (area.width + tile_width - 1) / tile_width;
+  int rows = (area.height + tile_height - 1) / tile_height;
+  int tiles = columns * rows;
+
+  ThreadPool &pool = GetThreadPool();
+  int bands = std::min(pool.size(), tiles);
+
+  if (bands == 1) {
+    ForEachTile(area, tile_width, tile_height, fn);
+    return;
+  }
+
+  ScratchScope scope(GetProcessingContext().arena());
+  TileBand *cursors = scope.arena().Allocate<TileBand>(bands);
+  for (int band = 0; band < bands; band++) {
+    RowBand range = SplitRows(0, tiles, band, bands);
+    cursors[band].next.store(range.begin, std::memory_order_relaxed);
+    cursors[band].end = range.end;
+  }
+
+  bool steal = tile_schedule == TileSchedule::kWorkStealing;
+
+  pool.ParallelFor(bands, [&](int band) {
+    auto drain = [&](TileBand &cursor) {
+      while (true) {
+        int tile = cursor.next.fetch_add(1, std::memory_order_relaxed);
+        if (tile >= cursor.end) {
+          return;
+        }
+
+        fn(TileAt(area, tile_width, tile_height, columns, tile));
+      }
+    };
+
+    drain(cursors[band]);
+
+    for (int k = 1; steal && k < bands; k++) {
+      drain(cursors[(band + k) % bands]);
+    }
+  });
+}
+
+void ParallelForEachTile(const Image &img,
+                         FunctionRef<void(const Rectangle &)> fn) {
+  int width = std::max(img.width(), 1);
+  int tile_rows = std::max(kDefaultTileSize * kDefaultTileSize / width, 1);
+
+  ParallelForEachTile(
+      Rectangle{.x = 0, .y = 0, .width = img.width(), .height = img.height()},
+      width, tile_rows, fn);
+}
@@ -0,0 +1,49 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include "function_ref.h"
+#include "image.h"
+
+/// Side of the square tiles the work is split in, see @see ParallelForEachTile
+const int kDefaultTileSize = 256;
+
+/// @brief How @see ParallelForEachTile hands the tiles to the threads
+enum class TileSchedule {
+  /// Each thread starts on its own band of tiles and, once done, steals the
+  /// remaining tiles of the other bands.
+  kWorkStealing = 0,
+  /// Each band of tiles runs whole as a single task, in order, so with the
+  /// same thread count the split of the work never changes between runs.
+  /// Useful to compare profiles.
+  kDeterministic
+};
+
+/// @brief Sets the schedule used by @see ParallelForEachTile .
+void SetTileSchedule(TileSchedule schedule);
+
+/// @brief The schedule used by @see ParallelForEachTile .
+TileSchedule GetTileSchedule();
+
+/// @brief Splits @p area like @see ForEachTile and runs @p fn on the tiles
+/// on the shared pool (see thread_pool.h). The tiles are numbered in
+/// row-major order and each thread owns a contiguous band of them, so a
+/// thread works on a contiguous range of rows before going anywhere else.
+/// @p fn must only touch the pixels of the tile it receives, the order in
+/// which the tiles run is unspecified.
+/// @param area The region to be covered by the tiles
+/// @param tile_width The maximum width of a tile
+/// @param tile_height The maximum height of a tile
+/// @param fn Called once per tile, possibly from several threads at once
+void ParallelForEachTile(const Rectangle &area, int tile_width,
+                         int tile_height,
+                         FunctionRef<void(const Rectangle &)> fn);
+
+/// @brief Runs @p fn on tiles of @p img holding about @see kDefaultTileSize
+/// squared pixels each. The tiles are as wide as the image: point operations
+/// touch every pixel once, so full rows keep the accesses sequential for the
+/// prefetcher, which square tiles would break every few hundred bytes.
+/// @see ParallelForEachTile
+void ParallelForEachTile(const Image &img,
+                         FunctionRef<void(const Rectangle &)> fn);
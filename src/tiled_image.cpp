@@ -0,0 +1,267 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include "tiled_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string.h>
+#include <vector>
+
+#include "profiler.h"
+
+namespace {
+
+const uint32_t kTiledVersion = 1;
+
+/// Bytes before the index of the tiles.
+const size_t kTiledHeaderSize = 40;
+
+/// Bytes of each entry of the index.
+const size_t kTiledEntrySize = 16;
+
+/// The tiles start on their own pages, so mapping one touches no other.
+const size_t kTileAlignment = 4096;
+
+/// Largest side of a tile read or written.
+const int kMaxFileTile = 1 << 16;
+
+size_t AlignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void PutU32(byte *to, uint32_t value) {
+  to[0] = static_cast<byte>(value);
+  to[1] = static_cast<byte>(value >> 8);
+  to[2] = static_cast<byte>(value >> 16);
+  to[3] = static_cast<byte>(value >> 24);
+}
+
+void PutU64(byte *to, uint64_t value) {
+  PutU32(to, static_cast<uint32_t>(value));
+  PutU32(to + 4, static_cast<uint32_t>(value >> 32));
+}
+
+uint32_t GetU32(const byte *from) {
+  return static_cast<uint32_t>(from[0]) |
+         static_cast<uint32_t>(from[1]) << 8 |
+         static_cast<uint32_t>(from[2]) << 16 |
+         static_cast<uint32_t>(from[3]) << 24;
+}
+
+uint64_t GetU64(const byte *from) {
+  return static_cast<uint64_t>(GetU32(from)) |
+         static_cast<uint64_t>(GetU32(from + 4)) << 32;
+}
+
+/// @brief The format stored with @p bits_per_pixel bits per pixel.
+/// @return false for none of the formats
+bool FormatByBits(uint32_t bits_per_pixel, PixelFormat &format) {
+  switch (bits_per_pixel) {
+  case 8:
+    format = PixelFormat::kGray8;
+    return true;
+
+  case 24:
+    format = PixelFormat::kRGB24;
+    return true;
+
+  case 32:
+    format = PixelFormat::kBGRA32;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+/// @brief Whether the sizes of @p info can be tiled: positive, with tiles
+/// of at most @see kMaxFileTile pixels a side.
+bool IsValidInfo(const TiledInfo &info) {
+  return info.width > 0 && info.height > 0 && info.tile_width > 0 &&
+         info.tile_height > 0 && info.tile_width <= kMaxFileTile &&
+         info.tile_height <= kMaxFileTile;
+}
+
+/// @brief A view of the @p width x @p height pixels of the interleaved
+/// @p img starting at ( @p x , @p y ), in its format and channel order.
+Image AreaView(const Image &img, int x, int y, int width, int height) {
+  byte *top_row = const_cast<byte *>(img.row(y)) +
+                  static_cast<ptrdiff_t>(x) * img.pixel_step();
+
+  if (img.format() != PixelFormat::kRGB24) {
+    return Image::Wrap(top_row, width, height, img.stride(), img.format());
+  }
+
+  return Image::WrapInterleaved(top_row, width, height, img.stride(),
+                                img.channel_offset(kRed) == 0
+                                    ? ChannelOrder::kRGB
+                                    : ChannelOrder::kBGR);
+}
+
+} // namespace
+
+bool IsTiledImageFile(const std::string &filename) {
+  size_t dot = filename.find_last_of('.');
+  std::string extension =
+      dot == std::string::npos ? std::string() : filename.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+
+  return extension == ".pdt";
+}
+
+BmpError TiledImage::Open(const std::string &filename) {
+  if (!file_.Open(filename, MappedFile::Mode::kCopyOnWrite)) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  const byte *header = file_.data();
+  size_t size = file_.size();
+  if (size < kTiledHeaderSize || memcmp(header, "PDIT", 4) != 0 ||
+      GetU32(header + 4) != kTiledVersion ||
+      !FormatByBits(GetU32(header + 32), info_.format)) {
+    return BMP_INVALID_FILE;
+  }
+
+  uint64_t width = GetU64(header + 8);
+  uint64_t height = GetU64(header + 16);
+  uint32_t tile_width = GetU32(header + 24);
+  uint32_t tile_height = GetU32(header + 28);
+  if (width > INT64_MAX / 2 || height > INT64_MAX / 2 ||
+      tile_width > static_cast<uint32_t>(kMaxFileTile) ||
+      tile_height > static_cast<uint32_t>(kMaxFileTile)) {
+    return BMP_INVALID_FILE;
+  }
+
+  info_.width = static_cast<int64_t>(width);
+  info_.height = static_cast<int64_t>(height);
+  info_.tile_width = static_cast<int>(tile_width);
+  info_.tile_height = static_cast<int>(tile_height);
+  // Checked without multiplying, the sizes come from the file.
+  int64_t entries =
+      static_cast<int64_t>((size - kTiledHeaderSize) / kTiledEntrySize);
+  if (!IsValidInfo(info_) || info_.columns() > entries ||
+      info_.rows() > entries / info_.columns()) {
+    return BMP_INVALID_FILE;
+  }
+
+  // Every tile must lie inside the file, holding all of its rows.
+  for (int64_t i = 0; i < info_.tiles(); i++) {
+    uint64_t offset = GetU64(Entry(i));
+    uint64_t bytes = GetU64(Entry(i) + 8);
+    uint64_t needed = static_cast<uint64_t>(TileStride(i)) * TileHeight(i);
+
+    if (offset > size || bytes > size - offset || bytes < needed) {
+      return BMP_INVALID_FILE;
+    }
+  }
+
+  return BMP_OK;
+}
+
+BmpError TiledImage::Create(const std::string &filename, int64_t width,
+                            int64_t height, PixelFormat format,
+                            int tile_width, int tile_height) {
+  info_ = TiledInfo{.width = width,
+                    .height = height,
+                    .tile_width = tile_width,
+                    .tile_height = tile_height,
+                    .format = format};
+  if (!IsValidInfo(info_)) {
+    return BMP_ERROR;
+  }
+
+  std::vector<uint64_t> offsets(info_.tiles());
+  size_t end =
+      AlignUp(kTiledHeaderSize + kTiledEntrySize * offsets.size(),
+              kTileAlignment);
+  for (int64_t i = 0; i < info_.tiles(); i++) {
+    offsets[i] = end;
+    end = AlignUp(end + TileStride(i) * TileHeight(i), kTileAlignment);
+  }
+
+  if (!file_.Create(filename, end)) {
+    return BMP_FILE_NOT_OPENED;
+  }
+
+  byte *header = file_.data();
+  memcpy(header, "PDIT", 4);
+  PutU32(header + 4, kTiledVersion);
+  PutU64(header + 8, static_cast<uint64_t>(width));
+  PutU64(header + 16, static_cast<uint64_t>(height));
+  PutU32(header + 24, static_cast<uint32_t>(tile_width));
+  PutU32(header + 28, static_cast<uint32_t>(tile_height));
+  PutU32(header + 32, static_cast<uint32_t>(8 * BytesPerPixel(format)));
+  PutU32(header + 36, 0);
+
+  for (int64_t i = 0; i < info_.tiles(); i++) {
+    PutU64(Entry(i), offsets[i]);
+    PutU64(Entry(i) + 8, TileStride(i) * TileHeight(i));
+  }
+
+  return BMP_OK;
+}
+
+Image TiledImage::tile(int64_t index) {
+  return Image::Wrap(file_.data() + GetU64(Entry(index)), TileWidth(index),
+                     TileHeight(index),
+                     static_cast<ptrdiff_t>(TileStride(index)), info_.format);
+}
+
+size_t TiledImage::TileStride(int64_t index) const {
+  return AlignUp(static_cast<size_t>(TileWidth(index)) *
+                     BytesPerPixel(info_.format),
+                 Image::kRowAlignment);
+}
+
+int TiledImage::TileWidth(int64_t index) const {
+  return static_cast<int>(
+      std::min<int64_t>(info_.tile_width, info_.width - tile_x(index)));
+}
+
+int TiledImage::TileHeight(int64_t index) const {
+  return static_cast<int>(
+      std::min<int64_t>(info_.tile_height, info_.height - tile_y(index)));
+}
+
+void CopyFromTiles(TiledImage &tiled, Image &img) {
+  ProfileScope profile(ProfileStage::kRead);
+  profile.Count(static_cast<int64_t>(img.width()) * img.height(), 0);
+
+  for (int64_t i = 0; i < tiled.info().tiles(); i++) {
+    Image tile = tiled.tile(i);
+    Image area = AreaView(img, static_cast<int>(tiled.tile_x(i)),
+                          static_cast<int>(tiled.tile_y(i)), tile.width(),
+                          tile.height());
+    CopyPixels(tile, area);
+  }
+}
+
+BmpError WriteTiledImage(const Image &img, const std::string &filename,
+                         int tile) {
+  if (img.layout() == PixelLayout::kPlanar) {
+    return WriteTiledImage(img.ToLayout(PixelLayout::kInterleaved), filename,
+                           tile);
+  }
+
+  ProfileScope profile(ProfileStage::kWrite);
+  profile.Count(static_cast<int64_t>(img.width()) * img.height(), 0);
+
+  TiledImage tiled;
+  BmpError error = tiled.Create(filename, img.width(), img.height(),
+                                img.format(), tile, tile);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  for (int64_t i = 0; i < tiled.info().tiles(); i++) {
+    Image tile_view = tiled.tile(i);
+    Image area = AreaView(img, static_cast<int>(tiled.tile_x(i)),
+                          static_cast<int>(tiled.tile_y(i)),
+                          tile_view.width(), tile_view.height());
+    CopyPixels(area, tile_view);
+  }
+
+  return BMP_OK;
+}
@@ -0,0 +1,103 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "image.h"
+#include "libbmp.h"
+#include "mapped_file.h"
+
+/// Side of the tiles of the files made by @see TiledImage::Create .
+const int kDefaultFileTile = 1024;
+
+/// @brief What the header of a tiled file describes
+struct TiledInfo {
+  int64_t width = 0;
+  int64_t height = 0;
+  int tile_width = 0;
+  int tile_height = 0;
+  PixelFormat format = PixelFormat::kRGB24;
+
+  int64_t columns() const { return (width + tile_width - 1) / tile_width; }
+  int64_t rows() const { return (height + tile_height - 1) / tile_height; }
+  int64_t tiles() const { return columns() * rows(); }
+};
+
+/// @brief Whether @p filename is a tiled file by its extension, ".pdt" in
+/// any case.
+bool IsTiledImageFile(const std::string &filename);
+
+/// @brief An image stored on disk as tiles, for images too big for a BMP
+/// (whose sizes are 32 bits) or for memory. The file is mapped and each tile
+/// is exposed in place as an @see Image view, so any tile is read without
+/// touching the others.
+///
+/// The file is little endian: "PDIT", a uint32 version (1), the width and
+/// height as uint64, the tile width and height and the bits per pixel (8 for
+/// gray, 24 for R, G, B and 32 for B, G, R, A) as uint32 and a reserved
+/// uint32. Then an index of one uint64 offset and one uint64 size per tile,
+/// row by row, and the tiles, top-down with each row padded to
+/// @see Image::kRowAlignment bytes. The tiles on the right and bottom edges
+/// are clipped to the image.
+class TiledImage {
+public:
+  TiledImage() = default;
+
+  TiledImage(const TiledImage &) = delete;
+  TiledImage &operator=(const TiledImage &) = delete;
+
+  /// @brief Maps @p filename copy-on-write: kernels may change the tiles
+  /// without touching the file.
+  /// @return BMP_OK, BMP_FILE_NOT_OPENED or BMP_INVALID_FILE if the header or
+  /// the index do not describe the file
+  BmpError Open(const std::string &filename);
+
+  /// @brief Creates @p filename as a @p width x @p height image of
+  /// @p format , cut in tiles of @p tile_width x @p tile_height pixels, and
+  /// maps it for writing. Whatever is stored on the tiles is on the file once
+  /// this object is destroyed.
+  /// @return BMP_OK, BMP_ERROR for invalid sizes or BMP_FILE_NOT_OPENED
+  BmpError Create(const std::string &filename, int64_t width, int64_t height,
+                  PixelFormat format, int tile_width = kDefaultFileTile,
+                  int tile_height = kDefaultFileTile);
+
+  const TiledInfo &info() const { return info_; }
+
+  /// @brief Where tile @p index starts on the image, the tiles being
+  /// numbered row by row.
+  int64_t tile_x(int64_t index) const {
+    return index % info_.columns() * info_.tile_width;
+  }
+  int64_t tile_y(int64_t index) const {
+    return index / info_.columns() * info_.tile_height;
+  }
+
+  /// @brief A view of the pixels of tile @p index , valid while this object
+  /// lives.
+  Image tile(int64_t index);
+
+private:
+  /// @brief The index entry of tile @p index : its offset, then its size.
+  byte *Entry(int64_t index) { return file_.data() + 40 + 16 * index; }
+
+  /// @brief Bytes from a row of tile @p index to the next one.
+  size_t TileStride(int64_t index) const;
+  int TileWidth(int64_t index) const;
+  int TileHeight(int64_t index) const;
+
+  MappedFile file_;
+  TiledInfo info_;
+};
+
+/// @brief Copies the tiles of @p tiled into @p img , which must be an
+/// interleaved image of the size of the whole tiled image.
+void CopyFromTiles(TiledImage &tiled, Image &img);
+
+/// @brief Writes @p img on the tiled file @p filename , in its own format,
+/// cut in tiles of @p tile x @p tile pixels.
+/// @return BMP_OK or the error of @see TiledImage::Create
+BmpError WriteTiledImage(const Image &img, const std::string &filename,
+                         int tile = kDefaultFileTile);
@@ -0,0 +1,70 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+
+#include "image.h"
+
+/// @brief Visits the rows [ @p begin , @p end ) in memory order, calling
+/// @p fn with the index of each row. Kernels should fetch their row pointers
+/// inside @p fn and walk the columns on the inner loop.
+/// @param begin The first row to visit
+/// @param end One past the last row to visit
+/// @param fn A callable with the signature void(int y)
+template <typename Fn> void ForEachRow(int begin, int end, Fn &&fn) {
+  for (int y = begin; y < end; y++) {
+    fn(y);
+  }
+}
+
+/// @brief Visits every row of @p img in memory order. @see ForEachRow
+template <typename Fn> void ForEachRow(const Image &img, Fn &&fn) {
+  ForEachRow(0, img.height(), fn);
+}
+
+/// @brief A range of rows [ @p begin , @p end )
+struct RowBand {
+  int begin, end;
+};
+
+/// @brief Splits the rows [ @p begin , @p end ) in @p bands contiguous bands
+/// of almost the same height and returns the band number @p band .
+inline RowBand SplitRows(int begin, int end, int band, int bands) {
+  int64_t rows = end - begin;
+  return RowBand{.begin = begin + static_cast<int>(rows * band / bands),
+                 .end = begin + static_cast<int>(rows * (band + 1) / bands)};
+}
+
+/// @brief Splits @p area in tiles of at most @p tile_width x @p tile_height
+/// pixels and visits them in row-major order, calling @p fn with the
+/// rectangle of each tile. Kernels should walk each tile with @see ForEachRow
+/// so the rows of a tile stay cache resident.
+/// @param area The region to be covered by the tiles
+/// @param tile_width The maximum width of a tile
+/// @param tile_height The maximum height of a tile
+/// @param fn A callable with the signature void(const Rectangle &tile)
+template <typename Fn>
+void ForEachTile(const Rectangle &area, int tile_width, int tile_height,
+                 Fn &&fn) {
+  for (int y = area.y; y < area.y + area.height; y += tile_height) {
+    for (int x = area.x; x < area.x + area.width; x += tile_width) {
+      Rectangle tile = {.x = x,
+                        .y = y,
+                        .width = std::min(tile_width, area.x + area.width - x),
+                        .height =
+                            std::min(tile_height, area.y + area.height - y)};
+      fn(tile);
+    }
+  }
+}
+
+/// @brief Visits the tiles covering the whole @p img . @see ForEachTile
+template <typename Fn>
+void ForEachTile(const Image &img, int tile_width, int tile_height, Fn &&fn) {
+  ForEachTile(Rectangle{.x = 0, .y = 0, .width = img.width(),
+                        .height = img.height()},
+              tile_width, tile_height, fn);
+}
@@ -0,0 +1,226 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <filesystem>
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bmp_io.h"
+#include "image.h"
+
+namespace {
+
+const int kWidth = 3;
+const int kHeight = 2;
+
+/// @brief How the headers of a 32bpp test file are written
+struct BmpVariant {
+  const char *name;
+  /// 40 for a BITMAPINFOHEADER, 108 for a BITMAPV4HEADER, 124 for a
+  /// BITMAPV5HEADER
+  uint32_t info_size;
+  /// 0 for BI_RGB, 3 for BI_BITFIELDS
+  uint32_t compression;
+  /// The red, green, blue and alpha masks, written after the first 40 bytes
+  /// of the info header when the compression is BI_BITFIELDS (the alpha one
+  /// only on the longer headers)
+  uint32_t masks[4];
+  int bits_per_pixel = 32;
+  int32_t height = kHeight;
+  /// Whether every reader must take the file
+  bool valid = true;
+};
+
+const uint32_t kBgraMasks[4] = {0x00FF0000, 0x0000FF00, 0x000000FF,
+                                0xFF000000};
+
+const BmpVariant kVariants[] = {
+    {"BI_RGB", 40, 0, {}},
+    {"BI_RGB top-down", 40, 0, {}, 32, -kHeight},
+    {"BI_BITFIELDS", 40, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2]}},
+    {"BI_BITFIELDS top-down", 40, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2]}, 32, -kHeight},
+    {"V4 BI_BITFIELDS", 108, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2], kBgraMasks[3]}},
+    {"V5 BI_BITFIELDS", 124, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2], kBgraMasks[3]}},
+    {"V5 BI_BITFIELDS without alpha", 124, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2], 0}},
+    {"V5 BI_RGB", 124, 0, {}},
+    {"red and blue masks swapped", 124, 3,
+     {kBgraMasks[2], kBgraMasks[1], kBgraMasks[0], kBgraMasks[3]}, 32,
+     kHeight, false},
+    {"BI_BITFIELDS on 24bpp", 40, 3,
+     {kBgraMasks[0], kBgraMasks[1], kBgraMasks[2]}, 24, kHeight, false},
+    {"BI_RLE8", 40, 1, {}, 32, kHeight, false},
+    {"BITMAPCOREHEADER", 12, 0, {}, 32, kHeight, false},
+    {"height of INT32_MIN", 40, 0, {}, 32, INT32_MIN, false},
+};
+
+void PutU16(std::vector<byte> &bytes, size_t at, uint16_t value) {
+  bytes[at] = static_cast<byte>(value);
+  bytes[at + 1] = static_cast<byte>(value >> 8);
+}
+
+void PutU32(std::vector<byte> &bytes, size_t at, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    bytes[at + i] = static_cast<byte>(value >> (8 * i));
+  }
+}
+
+/// @brief The B, G, R, A samples of pixel @p x , @p y of the test files.
+byte Sample(int x, int y, int c) {
+  return static_cast<byte>(40 * y + 10 * x + c + 1);
+}
+
+/// @brief A @see kWidth x @see kHeight file with the pixels of
+/// @see Sample , its top row first when the height is negative. A
+/// BITMAPINFOHEADER is followed by the three masks.
+std::vector<byte> MakeBmp(const BmpVariant &variant) {
+  uint32_t masks_after = variant.info_size == 40 && variant.compression == 3
+                             ? 12
+                             : 0;
+  uint32_t pixel_offset = 14 + variant.info_size + masks_after;
+  int bytes_per_pixel = variant.bits_per_pixel / 8;
+  size_t row_bytes = (kWidth * bytes_per_pixel + 3) / 4 * 4;
+  std::vector<byte> bytes(pixel_offset + row_bytes * kHeight, 0);
+
+  PutU16(bytes, 0, 0x4D42);
+  PutU32(bytes, 2, static_cast<uint32_t>(bytes.size()));
+  PutU32(bytes, 10, pixel_offset);
+  PutU32(bytes, 14, variant.info_size);
+  PutU32(bytes, 18, kWidth);
+  PutU32(bytes, 22, static_cast<uint32_t>(variant.height));
+  PutU16(bytes, 26, 1);
+  PutU16(bytes, 28, static_cast<uint16_t>(variant.bits_per_pixel));
+  PutU32(bytes, 30, variant.compression);
+
+  if (variant.compression == 3) {
+    int masks = variant.info_size >= 56 ? 4 : 3;
+    for (int i = 0; i < masks; i++) {
+      PutU32(bytes, 54 + 4 * i, variant.masks[i]);
+    }
+  }
+
+  bool top_down = variant.height < 0;
+  for (int y = 0; y < kHeight; y++) {
+    int file_row = top_down ? y : kHeight - 1 - y;
+    size_t row = pixel_offset + row_bytes * file_row;
+    for (int x = 0; x < kWidth; x++) {
+      for (int c = 0; c < bytes_per_pixel; c++) {
+        bytes[row + x * bytes_per_pixel + c] = Sample(x, y, c);
+      }
+    }
+  }
+
+  return bytes;
+}
+
+/// @brief Whether @p img holds the pixels of @see Sample with their alpha.
+bool HasTestPixels(const Image &img) {
+  if (img.width() != kWidth || img.height() != kHeight ||
+      img.format() != PixelFormat::kBGRA32) {
+    return false;
+  }
+
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth; x++) {
+      RGBColor color = img.pixel(x, y);
+      byte alpha = img.row(y)[x * img.pixel_step() + 3];
+      if (color.b != Sample(x, y, 0) || color.g != Sample(x, y, 1) ||
+          color.r != Sample(x, y, 2) || alpha != Sample(x, y, 3)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// @brief Opens @p variant with @see MappedBmp , like the in-memory and
+/// --mmap runs, and with @see BmpBandReader , like the --stream ones.
+/// @return The number of readers that did not do what the variant expects
+int CheckVariant(const BmpVariant &variant,
+                 const std::filesystem::path &work_dir) {
+  std::vector<byte> bytes = MakeBmp(variant);
+  int failures = 0;
+
+  MappedBmp mapped;
+  bool mapped_ok = mapped.Open(bytes.data(), bytes.size()) == BMP_OK &&
+                   HasTestPixels(mapped.image());
+  if (mapped_ok != variant.valid) {
+    fmt::print("FAIL {}: the mapping {} it\n", variant.name,
+               variant.valid ? "does not read" : "reads");
+    failures++;
+  }
+
+  std::filesystem::path file = work_dir / "variant.bmp";
+  std::ofstream(file, std::ios::binary)
+      .write(reinterpret_cast<const char *>(bytes.data()),
+             static_cast<std::streamsize>(bytes.size()));
+
+  BmpBandReader reader;
+  Image img;
+  bool streamed_ok = false;
+  if (reader.Open(file.string()) == BMP_OK) {
+    img = Image(reader.info().width, reader.info().height,
+                FormatOf(reader.info()));
+    streamed_ok = reader.ReadImage(img) == BMP_OK && HasTestPixels(img);
+  }
+  if (streamed_ok != variant.valid) {
+    fmt::print("FAIL {}: the band reader {} it\n", variant.name,
+               variant.valid ? "does not read" : "reads");
+    failures++;
+  }
+
+  return failures;
+}
+
+/// @brief Checks that headers cut short are refused instead of read past
+/// their end.
+int CheckTruncated() {
+  std::vector<byte> bytes = MakeBmp(kVariants[2]);
+  int failures = 0;
+
+  for (size_t size : {size_t{20}, size_t{54}, size_t{60}}) {
+    std::vector<byte> cut(bytes.begin(), bytes.begin() + size);
+    MappedBmp mapped;
+    if (mapped.Open(cut.data(), cut.size()) == BMP_OK) {
+      fmt::print("FAIL a file cut to {} bytes is read\n", size);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+} // namespace
+
+/// Checks which BMP headers the readers take: 32bpp files with BI_RGB and
+/// with BI_BITFIELDS of the BGRA masks, under the BITMAPINFOHEADER and the
+/// V4 and V5 headers, and none of the malformed ones.
+///   bmp_io_tests <work directory>
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fmt::print("Usage: bmp_io_tests <work directory>\n");
+    return 1;
+  }
+
+  std::filesystem::path work_dir = argv[1];
+  std::error_code error;
+  std::filesystem::create_directories(work_dir, error);
+
+  int failures = 0;
+  for (const BmpVariant &variant : kVariants) {
+    failures += CheckVariant(variant, work_dir);
+  }
+  failures += CheckTruncated();
+
+  fmt::print("{} failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,444 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bmp_io.h"
+#include "cpu_features.h"
+#include "image.h"
+#include "image_codec.h"
+#include "tiled_image.h"
+
+namespace {
+
+/// @brief How a path hands the files to the tool
+enum class PathKind {
+  /// One run with -i and -o
+  kSingle = 0,
+  /// One run with --batch over a list of the input
+  kBatch,
+  /// The input converted to a tiled file of @see kTestTile tiles, then a run
+  /// from that file to another tiled file
+  kTiled
+};
+
+/// @brief Which results of a path must come packed to 1 or 4bpp
+enum class PackCheck {
+  kNone = 0,
+  /// Every result whose samples are all 0 or 255, packed by its pixels
+  kBilevel,
+  /// The results of a single threshold, packed by the table of the chain
+  /// when the image is streamed
+  kThreshold
+};
+
+/// Side of the tiles of the inputs of the tiled path, small enough to cut
+/// the assets in many tiles, clipped on the right and bottom edges.
+const int kTestTile = 64;
+
+/// @brief A way through the tool that must give the golden results
+struct TestPath {
+  const char *name;
+  PathKind kind;
+  /// Options added to every run of the path
+  const char *options;
+  PackCheck pack_check = PackCheck::kNone;
+  /// The --cpu-features level of every run, nullptr for the best one. The
+  /// path is skipped on CPUs without it.
+  const char *isa = nullptr;
+};
+
+/// The bands of the streamed paths are short and do not divide the height of
+/// the assets, so each run goes through many bands and a partial last one.
+const TestPath kPaths[] = {
+    {"memory", PathKind::kSingle, ""},
+    {"out_of_place", PathKind::kSingle, "--out-of-place"},
+    {"stream", PathKind::kSingle, "--stream --band-rows 7"},
+    {"stream_async", PathKind::kSingle, "--stream --async-io --band-rows 7"},
+    {"mmap", PathKind::kSingle, "--mmap"},
+    {"pack_bilevel", PathKind::kSingle, "--pack-bilevel", PackCheck::kBilevel},
+    {"stream_pack_bilevel", PathKind::kSingle,
+     "--stream --pack-bilevel --band-rows 7", PackCheck::kThreshold},
+    {"batch", PathKind::kBatch, ""},
+    {"tiled", PathKind::kTiled, ""},
+    // Every level of the kernels, packing the binarized results so the
+    // bilevel scans run too.
+    {"cpu_baseline", PathKind::kSingle, "--pack-bilevel", PackCheck::kBilevel,
+     "baseline"},
+    {"cpu_ssse3", PathKind::kSingle, "--pack-bilevel", PackCheck::kBilevel,
+     "ssse3"},
+    {"cpu_avx2", PathKind::kSingle, "--pack-bilevel", PackCheck::kBilevel,
+     "avx2"},
+    {"cpu_avx512", PathKind::kSingle, "--pack-bilevel", PackCheck::kBilevel,
+     "avx512"},
+    {"cpu_avx512vbmi", PathKind::kSingle, "--pack-bilevel",
+     PackCheck::kBilevel, "avx512vbmi"},
+};
+
+/// What the tests of a path return when the CPU can not run it, see
+/// SKIP_RETURN_CODE on CMakeLists.txt.
+const int kSkipped = 77;
+
+/// @brief A chain of methods on one asset and the golden file it must match
+struct GoldenCase {
+  const char *input;
+  const char *methods;
+  /// Options the methods need
+  const char *options;
+  /// How far a sample may be from the golden one, 0 for a bit exact match
+  int tolerance;
+};
+
+// The gray pout.bmp goes through every command, and the color
+// sample_crop.bmp, a crop of sample.bmp with every value on each channel,
+// through the ones that treat the channels differently. The Gaussian taps
+// come from exp(), which may round differently on other math libraries, so
+// the blurs allow one level.
+const GoldenCase kCases[] = {
+    {"pout.bmp", "equalize", "", 0},
+    {"pout.bmp", "equalize_local", "", 0},
+    {"pout.bmp", "cutout", "", 0},
+    {"pout.bmp", "two_peaks", "", 0},
+    {"pout.bmp", "otsu", "", 0},
+    {"pout.bmp", "multi_otsu", "", 0},
+    {"pout.bmp", "histogram", "", 0},
+    {"pout.bmp", "equalize,two_peaks,histogram", "", 0},
+    {"pout.bmp", "otsu,erode", "", 0},
+    {"pout.bmp", "otsu,dilate", "", 0},
+    {"pout.bmp", "otsu,open", "", 0},
+    {"pout.bmp", "otsu,close", "", 0},
+    {"pout.bmp", "otsu,labels", "", 0},
+    {"pout.bmp", "otsu,components", "", 0},
+    {"pout.bmp", "blur", "", 1},
+    {"pout.bmp", "box_blur", "", 0},
+    {"pout.bmp", "sharpen", "", 0},
+    {"pout.bmp", "convolve", "--kernel 1,2,1,2,4,2,1,2,1 --kernel-shift 4",
+     0},
+    {"sample_crop.bmp", "equalize", "", 0},
+    {"sample_crop.bmp", "equalize_luma", "", 0},
+    {"sample_crop.bmp", "cutout", "", 0},
+    {"sample_crop.bmp", "two_peaks", "", 0},
+    {"sample_crop.bmp", "otsu", "", 0},
+    {"sample_crop.bmp", "two_peaks_luma", "", 0},
+    {"sample_crop.bmp", "multi_otsu", "", 0},
+    {"sample_crop.bmp", "blur", "", 1},
+    {"sample_crop.bmp", "histogram", "", 0},
+};
+
+std::string AssetPath(const std::string &name) {
+  return std::string(PDI_LI_ASSETS_DIR "/") + name;
+}
+
+/// @brief Whether the chain of @p test writes the components table instead
+/// of an image.
+bool WritesTable(const GoldenCase &test) {
+  std::string methods = test.methods;
+  return methods.ends_with("components");
+}
+
+/// @brief Whether @p test is a single threshold, whose table gives only 0
+/// and 255.
+bool IsThreshold(const GoldenCase &test) {
+  std::string methods = test.methods;
+  return methods == "cutout" || methods == "two_peaks" || methods == "otsu";
+}
+
+/// @brief The name of the golden file of @p test , without the extension:
+/// "pout.bmp" and "equalize,histogram" give "pout_equalize_histogram".
+std::string GoldenStem(const GoldenCase &test) {
+  std::string input = test.input;
+  std::string name = input.substr(0, input.rfind('.')) + "_" + test.methods;
+  std::replace(name.begin(), name.end(), ',', '_');
+  return name;
+}
+
+/// @brief The golden file of @p test : a csv for the components tables and a
+/// PNG, small and lossless, for the images.
+std::string GoldenPath(const GoldenCase &test) {
+  return AssetPath("golden/" + GoldenStem(test) +
+                   (WritesTable(test) ? ".csv" : ".png"));
+}
+
+/// @brief Runs the tool @p tool with @p arguments .
+/// @return Whether it exited with 0
+bool RunTool(const std::string &tool, const std::string &arguments) {
+  std::string command = "\"" + tool + "\" " + arguments;
+#ifdef _WIN32
+  // cmd.exe drops the first and last quotes of the line.
+  command = "\"" + command + "\"";
+#endif
+
+  std::fflush(stdout);
+  return std::system(command.c_str()) == 0;
+}
+
+std::string Quoted(const std::filesystem::path &path) {
+  return "\"" + path.string() + "\"";
+}
+
+bool ReadBytes(const std::string &filename, std::string &bytes) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  bytes.assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return true;
+}
+
+/// @brief Reads a BMP or a tiled file, an asset or a result of the tool, in
+/// its own format.
+/// @param bits_per_pixel [out] The bits per pixel of the file, which tells a
+/// packed BMP from the others
+/// @return BMP_OK or the reason the file could not be read
+BmpError ReadImageFile(const std::string &filename, Image &img,
+                       int &bits_per_pixel) {
+  if (IsTiledImageFile(filename)) {
+    TiledImage tiled;
+    BmpError error = tiled.Open(filename);
+    if (error != BMP_OK) {
+      return error;
+    }
+
+    const TiledInfo &info = tiled.info();
+    img = Image(static_cast<int>(info.width), static_cast<int>(info.height),
+                info.format);
+    bits_per_pixel = 8 * BytesPerPixel(info.format);
+    CopyFromTiles(tiled, img);
+    return BMP_OK;
+  }
+
+  BmpBandReader reader;
+  BmpError error = reader.Open(filename);
+  if (error != BMP_OK) {
+    return error;
+  }
+
+  const BmpInfo &info = reader.info();
+  img = Image(info.width, info.height, FormatOf(info));
+  bits_per_pixel = info.bits_per_pixel;
+  return reader.ReadImage(img);
+}
+
+/// @brief Checks the image written on @p output against the golden file of
+/// @p test : the same size, the same format and every sample within the
+/// tolerance of the test. Per @p pack_check , the binarized goldens must
+/// also have been written with 1 or 4 bits per pixel.
+/// @param why [out] What differs, when it does
+/// @return Whether the result matches
+bool MatchesGoldenImage(const GoldenCase &test, const std::string &output,
+                        PackCheck pack_check, std::string &why) {
+  DecodedImage decoded;
+  if (decoded.Open(GoldenPath(test)) != BMP_OK) {
+    why = GoldenPath(test) + " could not be read";
+    return false;
+  }
+
+  Image result;
+  int bits_per_pixel = 0;
+  if (ReadImageFile(output, result, bits_per_pixel) != BMP_OK) {
+    why = output + " could not be read";
+    return false;
+  }
+
+  const Image &expected = decoded.image();
+  if (expected.width() != result.width() ||
+      expected.height() != result.height()) {
+    why = fmt::format("{}x{} instead of {}x{}", result.width(),
+                      result.height(), expected.width(), expected.height());
+    return false;
+  }
+
+  if (expected.format() != result.format()) {
+    why = fmt::format("{} bytes per pixel instead of {}",
+                      BytesPerPixel(result.format()),
+                      BytesPerPixel(expected.format()));
+    return false;
+  }
+
+  if (pack_check == PackCheck::kBilevel ||
+      (pack_check == PackCheck::kThreshold && IsThreshold(test))) {
+    BilevelPacking packing = BilevelPackingOf(expected);
+    int expected_bits = packing == BilevelPacking::k1bpp   ? 1
+                        : packing == BilevelPacking::k4bpp ? 4
+                                                           : bits_per_pixel;
+    if (bits_per_pixel != expected_bits) {
+      why = fmt::format("{} bits per pixel instead of {}", bits_per_pixel,
+                        expected_bits);
+      return false;
+    }
+  }
+
+  int worst = 0;
+  int64_t differing = 0;
+  for (int y = 0; y < result.height(); y++) {
+    for (int x = 0; x < result.width(); x++) {
+      RGBColor a = result.pixel(x, y);
+      RGBColor b = expected.pixel(x, y);
+      int distance = std::max({std::abs(a.r - b.r), std::abs(a.g - b.g),
+                               std::abs(a.b - b.b)});
+      worst = std::max(worst, distance);
+      differing += distance > test.tolerance ? 1 : 0;
+    }
+  }
+
+  if (worst > test.tolerance) {
+    why = fmt::format("{} pixels differ, by up to {} levels", differing,
+                      worst);
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Checks the components table written on @p output against the
+/// golden one, byte by byte.
+bool MatchesGoldenTable(const GoldenCase &test, const std::string &output,
+                        std::string &why) {
+  std::string expected;
+  std::string result;
+  if (!ReadBytes(GoldenPath(test), expected)) {
+    why = GoldenPath(test) + " could not be read";
+    return false;
+  }
+
+  if (!ReadBytes(output, result)) {
+    why = output + " could not be read";
+    return false;
+  }
+
+  if (result != expected) {
+    why = "the table differs";
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Runs @p test through @p path with the tool @p tool , writing under
+/// @p work_dir .
+/// @param why [out] What went wrong, when something did
+/// @return Whether the result matches its golden file
+bool RunCase(const std::string &tool, const std::filesystem::path &work_dir,
+             const TestPath &path, const GoldenCase &test, std::string &why) {
+  std::filesystem::path dir = work_dir / GoldenStem(test);
+  std::error_code error;
+  std::filesystem::remove_all(dir, error);
+  std::filesystem::create_directories(dir, error);
+
+  std::string methods = fmt::format("-m {} {} {}", test.methods, test.options,
+                                    path.options);
+  if (path.isa != nullptr) {
+    methods += fmt::format(" --cpu-features {}", path.isa);
+  }
+  std::string extension = WritesTable(test) ? ".csv" : ".bmp";
+  std::filesystem::path input = AssetPath(test.input);
+  std::filesystem::path output;
+  bool ran = false;
+
+  switch (path.kind) {
+    using enum PathKind;
+
+  case kSingle:
+    output = dir / ("result" + extension);
+    ran = RunTool(tool, fmt::format("-i {} -o {} {}", Quoted(input),
+                                    Quoted(output), methods));
+    break;
+
+  case kBatch: {
+    std::filesystem::path list = dir / "list.txt";
+    std::ofstream(list) << input.string() << "\n";
+
+    // The batch keeps the name of the input, with the extension of the
+    // components table when it writes one.
+    output = (dir / "out" / input.filename()).replace_extension(extension);
+    ran = RunTool(tool,
+                  fmt::format("--batch {} --output-dir {} {}", Quoted(list),
+                              Quoted(dir / "out"), methods));
+    break;
+  }
+
+  case kTiled: {
+    std::filesystem::path tiled = dir / "input.pdt";
+    Image source;
+    int bits_per_pixel = 0;
+    if (ReadImageFile(input.string(), source, bits_per_pixel) != BMP_OK ||
+        WriteTiledImage(source, tiled.string(), kTestTile) != BMP_OK) {
+      why = "the input could not be converted to a tiled file";
+      return false;
+    }
+
+    output = dir / (WritesTable(test) ? "result.csv" : "result.pdt");
+    ran = RunTool(tool, fmt::format("-i {} -o {} {}", Quoted(tiled),
+                                    Quoted(output), methods));
+    break;
+  }
+  }
+
+  if (!ran) {
+    why = "the tool failed";
+    return false;
+  }
+
+  return WritesTable(test)
+             ? MatchesGoldenTable(test, output.string(), why)
+             : MatchesGoldenImage(test, output.string(), path.pack_check, why);
+}
+
+} // namespace
+
+/// Runs every golden case through one path of the tool, see the tests target
+/// of CMakeLists.txt:
+///   tests <main executable> <work directory> <path>
+/// Exits with 1 when some result does not match its golden file and with
+/// @see kSkipped when the CPU has not the instructions of the path.
+int main(int argc, char **argv) {
+  if (argc != 4) {
+    fmt::print("Usage: tests <main executable> <work directory> <path>\n");
+    return 1;
+  }
+
+  std::string tool = argv[1];
+  std::string name = argv[3];
+  const TestPath *path =
+      std::find_if(std::begin(kPaths), std::end(kPaths),
+                   [&](const TestPath &p) { return name == p.name; });
+  if (path == std::end(kPaths)) {
+    fmt::print("Unknown path {}\n", name);
+    return 1;
+  }
+
+  CpuIsa isa = CpuIsa::kBaseline;
+  if (path->isa != nullptr &&
+      (!CpuIsaByName(path->isa, isa) || isa > DetectCpuIsa())) {
+    fmt::print("Skipping {}, the CPU supports up to {}\n", name,
+               CpuIsaName(DetectCpuIsa()));
+    return kSkipped;
+  }
+
+  std::filesystem::path work_dir = std::filesystem::path(argv[2]) / name;
+  int failures = 0;
+  for (const GoldenCase &test : kCases) {
+    std::string why;
+    bool matches = RunCase(tool, work_dir, *path, test, why);
+
+    fmt::print("{} {} on {}: {}\n", matches ? "PASS" : "FAIL", test.methods,
+               test.input, matches ? "matches" : why);
+    failures += matches ? 0 : 1;
+  }
+
+  fmt::print("{} of {} cases failed on {}\n", failures, std::size(kCases),
+             name);
+  return failures == 0 ? 0 : 1;
+}
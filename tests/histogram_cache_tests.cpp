@@ -0,0 +1,158 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "bmp_io.h"
+#include "commands.h"
+#include "histogram_cache.h"
+#include "image.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+bool ReadBytes(const fs::path &filename, std::string &bytes) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  bytes.assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return true;
+}
+
+/// @brief Writes @p input with red and blue swapped on @p output , a 24bpp
+/// BMP like the input.
+bool WriteSwapped(const std::string &input, const std::string &output) {
+  BmpBandReader reader;
+  if (reader.Open(input) != BMP_OK) {
+    return false;
+  }
+
+  Image img(reader.info().width, reader.info().height,
+            FormatOf(reader.info()));
+  MappedBmp swapped;
+  if (reader.ReadImage(img) != BMP_OK ||
+      swapped.Create(output, img.width(), img.height()) != BMP_OK) {
+    return false;
+  }
+
+  for (int y = 0; y < img.height(); y++) {
+    for (int x = 0; x < img.width(); x++) {
+      RGBColor color = img.pixel(x, y);
+      swapped.image().set_pixel(x, y,
+                                RGBColor{color.b, color.g, color.r});
+    }
+  }
+
+  return true;
+}
+
+/// @brief A run of the histogram of one file through the cache
+struct CacheRun {
+  const char *input;
+  bool mmap;
+  /// Whether the run must find the histogram of an earlier one
+  bool hit;
+};
+
+} // namespace
+
+/// Runs the histogram of assets/sample.bmp and of its copy with red and
+/// blue swapped through the histogram cache, alternating mapped inputs
+/// (BGR views) and loaded ones (RGB images). Each run must write the
+/// histogram of its own file, and the same pixels must hit the cache
+/// whichever way they were read.
+///   histogram_cache_tests <work directory>
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fmt::print("Usage: histogram_cache_tests <work directory>\n");
+    return 1;
+  }
+
+  fs::path work_dir = argv[1];
+  std::error_code error;
+  fs::remove_all(work_dir, error);
+  fs::create_directories(work_dir, error);
+
+  std::string original = PDI_LI_ASSETS_DIR "/sample.bmp";
+  std::string swapped = (work_dir / "swapped.bmp").string();
+  if (!WriteSwapped(original, swapped)) {
+    fmt::print("Could not write {}\n", swapped);
+    return 1;
+  }
+
+  Pipeline pipeline;
+  PipelineByMethods("histogram", pipeline);
+  RunOptions options;
+  options.histogram_format = HistogramFormat::kCsv;
+
+  // The expected tables, counted before the cache is open.
+  std::string expected_original;
+  std::string expected_swapped;
+  fs::path expected = work_dir / "expected.csv";
+  if (RunCommand(pipeline, original, expected.string(), options) != BMP_OK ||
+      !ReadBytes(expected, expected_original) ||
+      RunCommand(pipeline, swapped, expected.string(), options) != BMP_OK ||
+      !ReadBytes(expected, expected_swapped)) {
+    fmt::print("Could not count the histograms\n");
+    return 1;
+  }
+
+  if (expected_original == expected_swapped) {
+    fmt::print("The swapped copy has the histogram of the original\n");
+    return 1;
+  }
+
+  if (!OpenHistogramCache((work_dir / "cache").string(),
+                          kDefaultHistogramCacheBytes)) {
+    fmt::print("Could not open the histogram cache\n");
+    return 1;
+  }
+
+  const CacheRun runs[] = {
+      {"original", true, false}, {"swapped", false, false},
+      {"original", false, true}, {"swapped", true, true},
+      {"original", true, true},
+  };
+  int failures = 0;
+  for (const CacheRun &run : runs) {
+    bool is_original = std::string(run.input) == "original";
+    options.mmap = run.mmap;
+    int64_t hits = GetHistogramCacheStats().hits;
+
+    std::string table;
+    fs::path output = work_dir / "result.csv";
+    if (RunCommand(pipeline, is_original ? original : swapped,
+                   output.string(), options) != BMP_OK ||
+        !ReadBytes(output, table)) {
+      fmt::print("FAIL the {} file could not be run\n", run.input);
+      failures++;
+      continue;
+    }
+
+    const char *read = run.mmap ? "mapped" : "loaded";
+    if (table != (is_original ? expected_original : expected_swapped)) {
+      fmt::print("FAIL the {} {} file got another histogram\n", read,
+                 run.input);
+      failures++;
+    }
+
+    bool hit = GetHistogramCacheStats().hits > hits;
+    if (hit != run.hit) {
+      fmt::print("FAIL the {} {} file {} the cache\n", read, run.input,
+                 hit ? "hit" : "missed");
+      failures++;
+    }
+  }
+
+  fmt::print("{} failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}
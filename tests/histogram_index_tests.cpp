@@ -0,0 +1,210 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "histogram.h"
+#include "histogram_index.h"
+#include "image.h"
+
+namespace {
+
+/// @brief A small xorshift generator, so every run checks the same cases.
+class Random {
+public:
+  uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+  /// @brief A value in [ @p begin , @p end ].
+  int Between(int begin, int end) {
+    return begin + static_cast<int>(Next() % static_cast<uint32_t>(
+                                                 end - begin + 1));
+  }
+
+private:
+  uint32_t state_ = 2463534242u;
+};
+
+/// @brief A @p width x @p height image of @p format with every sample
+/// random.
+Image RandomImage(int width, int height, PixelFormat format,
+                  Random &random) {
+  Image img(width, height, format);
+
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint32_t bits = random.Next();
+      img.set_pixel(x, y,
+                    RGBColor{static_cast<byte>(bits),
+                             static_cast<byte>(bits >> 8),
+                             static_cast<byte>(bits >> 16)});
+    }
+  }
+
+  return img;
+}
+
+/// @brief The part of @p area inside @p img , with no pixels when they do
+/// not meet.
+Rectangle ClipToImage(const Image &img, const Rectangle &area) {
+  int x0 = std::clamp(area.x, 0, img.width());
+  int y0 = std::clamp(area.y, 0, img.height());
+  int x1 = std::clamp(area.x + area.width, 0, img.width());
+  int y1 = std::clamp(area.y + area.height, 0, img.height());
+
+  return Rectangle{.x = x0,
+                   .y = y0,
+                   .width = std::max(x1 - x0, 0),
+                   .height = std::max(y1 - y0, 0)};
+}
+
+/// @brief The histogram of @p area counted pixel by pixel, the reference for
+/// the index and the window.
+RGBHistogram BruteForce(const Image &img, const Rectangle &area) {
+  RGBHistogram histogram{};
+  Rectangle clipped = ClipToImage(img, area);
+
+  if (clipped.width > 0 && clipped.height > 0) {
+    AccumulateHistogram(img, clipped, histogram);
+  }
+
+  return histogram;
+}
+
+bool SameHistogram(const RGBHistogram &a, const RGBHistogram &b) {
+  return memcmp(&a, &b, sizeof(RGBHistogram)) == 0;
+}
+
+/// @brief A rectangle around @p img , often partly or wholly outside of
+/// it, now and then empty.
+Rectangle RandomArea(const Image &img, Random &random) {
+  return Rectangle{.x = random.Between(-20, img.width() + 4),
+                   .y = random.Between(-20, img.height() + 4),
+                   .width = random.Between(0, img.width() + 8),
+                   .height = random.Between(0, img.height() + 8)};
+}
+
+std::string Describe(const Rectangle &area) {
+  return fmt::format("{}x{} at {},{}", area.width, area.height, area.x,
+                     area.y);
+}
+
+/// @brief Compares random queries of a @see HistogramIndex with tiles of
+/// @p tile against @see BruteForce .
+/// @return The number of mismatches
+int CheckQueries(const Image &img, int tile, Random &random) {
+  HistogramIndex index(img, tile);
+  int failures = 0;
+
+  // The whole image, a single pixel, each edge tile and random areas.
+  Rectangle areas[] = {
+      {0, 0, img.width(), img.height()},
+      {img.width() - 1, img.height() - 1, 1, 1},
+      {img.width() / tile * tile, 0, tile, img.height()},
+      {0, img.height() / tile * tile, img.width(), tile},
+      {tile - 1, tile - 1, tile + 2, tile + 2},
+  };
+  for (const Rectangle &area : areas) {
+    if (!SameHistogram(index.Query(area), BruteForce(img, area))) {
+      fmt::print("FAIL query {} with tiles of {}\n", Describe(area), tile);
+      failures++;
+    }
+  }
+
+  for (int i = 0; i < 300; i++) {
+    Rectangle area = RandomArea(img, random);
+    if (!SameHistogram(index.Query(area), BruteForce(img, area))) {
+      fmt::print("FAIL query {} with tiles of {}\n", Describe(area), tile);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+/// @brief Slides a @see SlidingHistogram by random steps, small and as large
+/// as the window, and now and then past the edges of @p img , comparing it
+/// against @see BruteForce after each one.
+/// @return The number of mismatches
+int CheckSlides(const Image &img, Random &random) {
+  int failures = 0;
+
+  for (int run = 0; run < 8; run++) {
+    Rectangle window{.x = random.Between(-4, img.width() - 1),
+                     .y = random.Between(-4, img.height() - 1),
+                     .width = random.Between(1, img.width() / 2 + 1),
+                     .height = random.Between(1, img.height() / 2 + 1)};
+    SlidingHistogram sliding(img, window);
+
+    for (int i = 0; i < 200; i++) {
+      int dx = random.Next() % 8 == 0
+                   ? random.Between(-2 * window.width, 2 * window.width)
+                   : random.Between(-2, 2);
+      int dy = random.Next() % 8 == 0
+                   ? random.Between(-2 * window.height, 2 * window.height)
+                   : random.Between(-2, 2);
+      // Keep the window overlapping the image most of the time.
+      if (sliding.window().x + dx < -window.width ||
+          sliding.window().x + dx > img.width()) {
+        dx = -dx;
+      }
+      if (sliding.window().y + dy < -window.height ||
+          sliding.window().y + dy > img.height()) {
+        dy = -dy;
+      }
+
+      sliding.Slide(dx, dy);
+      if (!SameHistogram(sliding.histogram(),
+                         BruteForce(img, sliding.window()))) {
+        fmt::print("FAIL window {} after a slide by {},{}\n",
+                   Describe(sliding.window()), dx, dy);
+        failures++;
+      }
+    }
+  }
+
+  return failures;
+}
+
+} // namespace
+
+/// Checks @see HistogramIndex::Query and @see SlidingHistogram against a
+/// histogram counted pixel by pixel, on images of odd sizes whose edge
+/// tiles are partial. Exits with 1 on any mismatch.
+int main() {
+  Random random;
+  int failures = 0;
+
+  const PixelFormat formats[] = {PixelFormat::kRGB24, PixelFormat::kGray8,
+                                 PixelFormat::kBGRA32};
+  for (PixelFormat format : formats) {
+    Image img = RandomImage(203, 157, format, random);
+
+    for (int tile : {3, 16, kDefaultIndexTile, 256}) {
+      failures += CheckQueries(img, tile, random);
+    }
+    failures += CheckSlides(img, random);
+  }
+
+  // Planar images, and images thinner than a tile.
+  Image planar = RandomImage(131, 97, PixelFormat::kRGB24, random)
+                     .ToLayout(PixelLayout::kPlanar);
+  failures += CheckQueries(planar, 16, random);
+  failures += CheckSlides(planar, random);
+
+  Image thin = RandomImage(3, 150, PixelFormat::kRGB24, random);
+  failures += CheckQueries(thin, 16, random);
+  failures += CheckSlides(thin, random);
+
+  fmt::print("{} mismatches\n", failures);
+  return failures == 0 ? 0 : 1;
+}
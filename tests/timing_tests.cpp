@@ -0,0 +1,356 @@
+/// Copyright: Made by Marcos Oliveira (mhco@cin.ufpe.br 2023)
+/// Github: mhco0
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bmp_io.h"
+#include "commands.h"
+#include "cpu_features.h"
+#include "image.h"
+#include "processing_context.h"
+
+namespace {
+
+/// Percentage a chain may be slower than its baseline by default. The
+/// baseline comes from another machine more often than not, and shared
+/// machines time the same chain up to a third apart from run to run, so
+/// this only catches the large regressions. Quiet machines can pass a
+/// tighter one.
+const double kDefaultMaxRegression = 50.0;
+
+/// How many times the chains slower than the tolerance are timed again
+/// before they fail, each after @see kRetryPause . A slow spell of the
+/// machine passes, a regression stays.
+const int kRetries = 3;
+
+const std::chrono::milliseconds kRetryPause{500};
+
+/// The exit code ctest reports as a skipped test
+const int kSkipped = 77;
+
+/// Timed rounds of each chain, of which the fastest is kept, the least
+/// disturbed by the rest of the machine
+const int kRounds = 11;
+
+/// A round repeats its chain for at least this long.
+const std::chrono::milliseconds kMinRoundTime{20};
+
+/// The steps of the calibration loop, see @see CalibrationLoop .
+const int kCalibrationSteps = 1 << 22;
+
+/// @brief A chain of the golden tests timed on one asset
+struct TimingCase {
+  const char *input;
+  const char *methods;
+};
+
+// The chains of bench/golden_bench.cpp: every kind of table chain, a filter,
+// the morphology and the components.
+const TimingCase kCases[] = {
+    {"pout.bmp", "equalize"},
+    {"pout.bmp", "equalize_local"},
+    {"pout.bmp", "cutout"},
+    {"pout.bmp", "otsu"},
+    {"pout.bmp", "multi_otsu"},
+    {"pout.bmp", "equalize,two_peaks,histogram"},
+    {"pout.bmp", "otsu,open"},
+    {"pout.bmp", "otsu,labels"},
+    {"pout.bmp", "blur"},
+    {"sample_crop.bmp", "equalize"},
+    {"sample_crop.bmp", "equalize_luma"},
+    {"sample_crop.bmp", "two_peaks_luma"},
+    {"sample_crop.bmp", "multi_otsu"},
+    {"sample_crop.bmp", "histogram"},
+};
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief Calls @p run for at least @see kMinRoundTime .
+/// @return The seconds per call
+template <typename Run> double RoundSeconds(Run &&run) {
+  int64_t calls = 0;
+  Clock::time_point start = Clock::now();
+  Clock::duration elapsed{};
+  do {
+    run();
+    calls++;
+    elapsed = Clock::now() - start;
+  } while (elapsed < kMinRoundTime);
+
+  return std::chrono::duration<double>(elapsed).count() /
+         static_cast<double>(calls);
+}
+
+/// @brief A fixed scalar loop. The chains are timed in units of it, which
+/// takes the clock speed of the machine out of the comparison with a
+/// baseline written on another one.
+void CalibrationLoop() {
+  static volatile uint32_t sink = 0;
+
+  uint32_t state = 2463534242u;
+  for (int i = 0; i < kCalibrationSteps; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+  }
+  sink = sink + state;
+}
+
+/// @brief Loads the BMP @p name of the assets directory in the format of
+/// the file, like the in-memory runs of main.
+bool LoadAsset(const std::string &name, Image &img) {
+  BmpBandReader reader;
+  if (reader.Open(std::string(PDI_LI_ASSETS_DIR "/") + name) != BMP_OK) {
+    return false;
+  }
+
+  img = Image(reader.info().width, reader.info().height,
+              FormatOf(reader.info()));
+  return reader.ReadImage(img) == BMP_OK;
+}
+
+/// @brief A case of @see kCases timed with the kernels of one instruction
+/// set
+struct TimedCase {
+  CpuIsa isa = CpuIsa::kBaseline;
+  std::string name;
+  Pipeline pipeline;
+  const Image *source = nullptr;
+  /// The seconds of the fastest call of the last @see TimeCases
+  double seconds = 0.0;
+  /// The fastest time of all the calls to @see TimeCases , in units of the
+  /// calibration loop
+  double relative = std::numeric_limits<double>::infinity();
+};
+
+/// A baseline entry: the instruction set and the name of the case
+using BaselineKey = std::pair<std::string, std::string>;
+
+/// @brief Reads the "<instruction set> <case> <time>" lines of @p path ,
+/// skipping the "#" comments. The times are in units of the calibration
+/// loop.
+/// @return false if there is no such file
+bool LoadBaseline(const std::string &path,
+                  std::map<BaselineKey, double> &baseline) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::istringstream fields(line);
+    std::string isa;
+    std::string name;
+    double value = 0.0;
+    if (fields >> isa >> name >> value) {
+      baseline[{isa, name}] = value;
+    }
+  }
+
+  return true;
+}
+
+bool SaveBaseline(const std::string &path,
+                  const std::map<BaselineKey, double> &baseline) {
+  std::ofstream file(path);
+  file << "# The times of tests/timing_tests.cpp in units of its calibration\n"
+          "# loop, written with --save by an optimized build.\n";
+  for (const auto &[key, value] : baseline) {
+    file << fmt::format("{} {} {:.5g}\n", key.first, key.second, value);
+  }
+
+  return static_cast<bool>(file);
+}
+
+/// @brief The name of @p timing_case in the baseline, like
+/// "pout.bmp:equalize,histogram".
+std::string CaseName(const TimingCase &timing_case) {
+  return std::string(timing_case.input) + ":" + timing_case.methods;
+}
+
+/// @brief Times @p cases in @see kRounds rounds, each going through all of
+/// them and the calibration loop once, so a slow spell of the machine slows
+/// every case alike. The fastest round of each is kept, the least disturbed,
+/// and lowers its @see TimedCase::relative if it is faster.
+/// @return The seconds of the calibration loop
+double TimeCases(std::vector<TimedCase> &cases) {
+  ScratchArena &arena = GetProcessingContext().arena();
+  double unit = 0.0;
+
+  for (int round = 0; round < kRounds; round++) {
+    double seconds = RoundSeconds(CalibrationLoop);
+    unit = round == 0 ? seconds : std::min(unit, seconds);
+
+    for (TimedCase &timed : cases) {
+      SetCpuIsa(timed.isa);
+      seconds = RoundSeconds([&] {
+        ScratchScope scope(arena);
+        Image result;
+        RunPipeline(*timed.source, result, timed.pipeline, true,
+                    &scope.arena());
+      });
+      timed.seconds =
+          round == 0 ? seconds : std::min(timed.seconds, seconds);
+    }
+  }
+  SetCpuIsa(DetectCpuIsa());
+
+  for (TimedCase &timed : cases) {
+    timed.relative = std::min(timed.relative, timed.seconds / unit);
+  }
+
+  return unit;
+}
+
+} // namespace
+
+/// Times the chains of @see kCases with the kernels of each instruction set
+/// the CPU has, in units of a calibration loop, and fails when one got
+/// slower than its entry in the baseline file by more than the tolerance,
+/// after timing the slow ones again @see kRetries times.
+/// With --save it writes the times of this machine on the file instead,
+/// keeping the entries of the sets it lacks. It is skipped on builds
+/// without optimizations and when the baseline has no entry for the sets of
+/// the CPU.
+///   timing_tests <baseline file> [--save] [--max-regression=<percent>]
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fmt::print("Usage: timing_tests <baseline file> [--save] "
+               "[--max-regression=<percent>]\n");
+    return 1;
+  }
+
+  std::string baseline_path = argv[1];
+  bool save = false;
+  double max_regression = kDefaultMaxRegression;
+  const std::string regression_flag = "--max-regression=";
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--save") {
+      save = true;
+    } else if (arg.rfind(regression_flag, 0) == 0) {
+      max_regression = std::atof(arg.c_str() + regression_flag.size());
+    } else {
+      fmt::print("Unknown argument {}\n", arg);
+      return 1;
+    }
+  }
+
+#ifndef NDEBUG
+  fmt::print("SKIP the timings only mean something on an optimized build\n");
+  return kSkipped;
+#endif
+
+  std::map<BaselineKey, double> baseline;
+  if (!LoadBaseline(baseline_path, baseline) && !save) {
+    fmt::print("SKIP there is no baseline {}\n", baseline_path);
+    return kSkipped;
+  }
+
+  std::map<std::string, Image> assets;
+  std::vector<TimedCase> cases;
+  int detected = static_cast<int>(DetectCpuIsa());
+  for (int level = 0; level <= detected; level++) {
+    CpuIsa isa = static_cast<CpuIsa>(level);
+    for (const TimingCase &timing_case : kCases) {
+      TimedCase timed;
+      timed.isa = isa;
+      timed.name = CaseName(timing_case);
+      Image &source = assets[timing_case.input];
+      if ((source.empty() && !LoadAsset(timing_case.input, source)) ||
+          !PipelineByMethods(timing_case.methods, timed.pipeline)) {
+        fmt::print("FAIL {} could not be run\n", timed.name);
+        return 1;
+      }
+      timed.source = &source;
+
+      bool has_baseline =
+          baseline.count({CpuIsaName(isa), timed.name}) > 0;
+      if (save || has_baseline) {
+        cases.push_back(std::move(timed));
+      }
+    }
+  }
+
+  if (cases.empty()) {
+    fmt::print("SKIP {} has no timings for this CPU\n", baseline_path);
+    return kSkipped;
+  }
+
+  double unit = TimeCases(cases);
+  fmt::print("calibration loop: {:.3f} ms\n", unit * 1e3);
+
+  if (save) {
+    for (const TimedCase &timed : cases) {
+      baseline[{CpuIsaName(timed.isa), timed.name}] = timed.relative;
+      fmt::print("{} {}: {:.1f} us, {:.5g}\n", CpuIsaName(timed.isa),
+                 timed.name, timed.seconds * 1e6, timed.relative);
+    }
+
+    if (!SaveBaseline(baseline_path, baseline)) {
+      fmt::print("Could not write the baseline {}\n", baseline_path);
+      return 1;
+    }
+    return 0;
+  }
+
+  auto change = [&](const TimedCase &timed) {
+    double expected = baseline[{CpuIsaName(timed.isa), timed.name}];
+    return 100.0 * (timed.relative - expected) / expected;
+  };
+
+  for (int retry = 0; retry < kRetries; retry++) {
+    std::vector<TimedCase> slow;
+    for (const TimedCase &timed : cases) {
+      if (change(timed) > max_regression) {
+        slow.push_back(timed);
+      }
+    }
+    if (slow.empty()) {
+      break;
+    }
+
+    fmt::print("timing {} slow chains again\n", slow.size());
+    std::this_thread::sleep_for(kRetryPause);
+    TimeCases(slow);
+    for (const TimedCase &timed : slow) {
+      for (TimedCase &first : cases) {
+        if (first.isa == timed.isa && first.name == timed.name) {
+          first.relative = timed.relative;
+        }
+      }
+    }
+  }
+
+  int failures = 0;
+  for (const TimedCase &timed : cases) {
+    bool regressed = change(timed) > max_regression;
+    fmt::print("{}{} {}: {:.1f} us, {:+.1f}% against the baseline\n",
+               regressed ? "FAIL " : "", CpuIsaName(timed.isa), timed.name,
+               timed.relative * unit * 1e6, change(timed));
+    if (regressed) {
+      failures++;
+    }
+  }
+
+  fmt::print("{} failures\n", failures);
+  return failures == 0 ? 0 : 1;
+}